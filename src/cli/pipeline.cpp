@@ -23,7 +23,7 @@ static int get_bytecode(std::string prog, Runtime &runtime) {
 
     auto block = Intermediate::LabelIR();
 
-    Compiler compiler(block, output);
+    Compiler compiler(block, runtime, output);
     bool compile_success = compiler.compile(node);
 
     delete node;
@@ -38,7 +38,7 @@ static int get_bytecode(std::string prog, Runtime &runtime) {
     // block.log_ir();
 
     auto optimized = Intermediate::LabelIR();
-    optimize_labels(block, optimized);
+    optimize_labels(block, optimized, runtime, output);
 
     // std::cout << "got past optimization\n";
 
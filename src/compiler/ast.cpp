@@ -106,6 +106,8 @@ const char* AST::node_type_to_string(NodeType type) {
             return "continue statement";
         case NODE_FUNCTION_CALL:
             return "function call";
+        case NODE_STRUCT_DEFINITION:
+            return "struct definition";
         case NODE_BODY:
             return "body";
         default:
@@ -148,6 +150,7 @@ AST_CAST_DEFINE(Continue, as_continue_statement, NODE_CONTINUE)
 AST_CAST_DEFINE(FunctionCall, as_function_call, NODE_FUNCTION_CALL)
 AST_CAST_DEFINE(Function, as_function, NODE_FUNCTION_DEFINITION)
 AST_CAST_DEFINE(Return, as_return_statement, NODE_RETURN)
+AST_CAST_DEFINE(StructDefinition, as_struct_definition, NODE_STRUCT_DEFINITION)
 AST_CAST_DEFINE(Body, as_body, NODE_BODY)
 
 Array::Array(): Node(NodeType::NODE_ARRAY) {}
@@ -294,6 +297,22 @@ Return::~Return() {
     if (this->return_value != nullptr) delete this->return_value;
 }
 
+StructDefinition::StructDefinition(std::string* name, TokenPosition name_position) :
+    Node(NodeType::NODE_STRUCT_DEFINITION, name_position),
+    name(name) {};
+
+void StructDefinition::add_field(std::string* field) {
+    this->fields.push_back(field);
+}
+
+StructDefinition::~StructDefinition() {
+    if (this->name != nullptr) delete this->name;
+
+    for (std::string* field : this->fields) {
+        if (field != nullptr) delete field;
+    }
+}
+
 Body::Body() : Node(NodeType::NODE_BODY) {};
 
 void Body::add_statement(Node* statement) {
@@ -33,6 +33,8 @@ namespace AST {
         NODE_FUNCTION_DEFINITION,
         NODE_RETURN,
 
+        NODE_STRUCT_DEFINITION,
+
         NODE_BODY
     };
 
@@ -63,6 +65,7 @@ namespace AST {
     class FunctionCall;
     class Function;
     class Return;
+    class StructDefinition;
     class Body;
 
     // @REVIEW: Don't free until end of compilation.
@@ -100,6 +103,7 @@ namespace AST {
             FunctionCall* as_function_call();
             Function* as_function();
             Return* as_return_statement();
+            StructDefinition* as_struct_definition();
             Body* as_body();
 
             virtual ~Node() = default;
@@ -326,16 +330,21 @@ namespace AST {
             std::string* name;
             std::vector<std::string*> arguments = std::vector<std::string*>();
             Node* function_body;
+            /* Annotated with @memo, so calls with the same arguments can reuse the result */
+            bool memoized = false;
         public:
             Function(std::string* name, TokenPosition name_position);
 
             inline auto            begin() const { return this->arguments.begin(); };
             inline auto              end() const { return this->arguments.end(); };
+            inline auto   argument_count() const { return this->arguments.size(); };
             inline std::string* get_name() const { return this->name; };
             inline Node*        get_body() const { return this->function_body; };
+            inline bool      is_memoized() const { return this->memoized; };
 
             void add_argument(std::string* argument);
             void set_body(Node* Body);
+            inline void set_memoized(bool memoized) { this->memoized = memoized; };
 
             ~Function();
     };
@@ -350,6 +359,24 @@ namespace AST {
             ~Return();
     };
 
+    /* E.g., struct Point { x, y } */
+    class StructDefinition : public Node {
+        private:
+            std::string* name;
+            std::vector<std::string*> fields = std::vector<std::string*>();
+        public:
+            StructDefinition(std::string* name, TokenPosition name_position);
+
+            inline auto            begin() const { return this->fields.begin(); };
+            inline auto              end() const { return this->fields.end(); };
+            inline auto      field_count() const { return this->fields.size(); };
+            inline std::string* get_name() const { return this->name; };
+
+            void add_field(std::string* field);
+
+            ~StructDefinition();
+    };
+
     class Body : public Node {
         private:
             /* Whether or not this node should create a scope during compilation.
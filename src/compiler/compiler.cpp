@@ -2,6 +2,7 @@
 #include "../globals.hpp"
 #include "../ir/bytecode.hpp"
 #include "../memory.hpp"
+#include "../natives/natives.hpp"
 
 #ifdef DEBUG
 #include <cassert>
@@ -13,7 +14,8 @@ using namespace Bytecode;
 using Intermediate::ir_instruction_arg_t, Intermediate::label_index_t, Intermediate::Variable;
 using Scopes::ScopeType;
 
-Compiler::Compiler(Intermediate::LabelIR& block, Output &output) : ir(block), main_block(block.get_main()->get_block()), output(output) {
+Compiler::Compiler(Intermediate::LabelIR& block, const Runtime &runtime, Output &output) :
+    ir(block), main_block(block.get_main()->get_block()), output(output), runtime(runtime) {
     this->scopes.new_scope(ScopeType::NORMAL);
 };
 
@@ -41,6 +43,13 @@ void Compiler::compile_array_index(AST::ArrayIndex* node) {
 void Compiler::compile_dot(AST::Dot* node) {
     this->compile_node(node->get_object());
 
+    /* If a struct has the field, read its slot directly */
+    Intermediate::field_reference_t field;
+    if (this->resolve_field(node->get_object(), *node->get_property(), field)) {
+        this->main_block->add_instruction(Intermediate::Instruction(Intermediate::INSTR_GET_FIELD, field));
+        return;
+    }
+
     std::string *string_copy = Allocate<std::string>::create(*node->get_property());
     this->main_block->add_instruction(Intermediate::Instruction(
         Intermediate::INSTR_CONSTANT_PROPERTY_ACCESS,
@@ -115,7 +124,10 @@ bool Compiler::get_variable_info(AST::VarValue* variable, Intermediate::Variable
         truncate_string(name, 30, *variable->get_name());
 
         char error[100];
-        snprintf(error, 100, "Variable \"%s\" does not exist.", name.c_str());
+        if (this->structs.find(*variable->get_name()) != this->structs.end()) {
+            snprintf(error, 100, "Struct \"%s\" is not a value. It can only be called to make a record.", name.c_str());
+        }
+        else snprintf(error, 100, "Variable \"%s\" does not exist.", name.c_str());
         this->output.error(variable->get_position(), error, Errors::COMPILE_ERROR);
         this->error = true;
         return false;
@@ -123,8 +135,22 @@ bool Compiler::get_variable_info(AST::VarValue* variable, Intermediate::Variable
     return true;
 };
 
+bool Compiler::check_not_struct_name(std::string *name, TokenPosition position) {
+    if (this->structs.find(*name) == this->structs.end()) return true;
+
+    std::string truncated;
+    truncate_string(truncated, 30, *name);
+
+    char error[100];
+    snprintf(error, 100, "\"%s\" is already the name of a struct.", truncated.c_str());
+    this->output.error(position, error, Errors::COMPILE_ERROR);
+    this->error = true;
+    return false;
+}
+
 void Compiler::compile_variable_definition(AST::VarDefinition* def) {
     this->compile_node(def->get_value());
+    if (!this->check_not_struct_name(def->get_name(), def->get_position())) return;
 
     /* Make sure the variable can be declared. */
     if (this->scopes.last_scope_has_variable(def->get_name())) {
@@ -144,6 +170,9 @@ void Compiler::compile_variable_definition(AST::VarDefinition* def) {
         Intermediate::Instruction(
             Intermediate::INSTR_STORE,
             variable ));
+
+    int struct_index = this->get_constructed_struct(def->get_value());
+    if (struct_index >= 0) this->variable_structs[variable] = static_cast<uint>(struct_index);
 }
 void Compiler::compile_variable_value(AST::VarValue* node) {
     Intermediate::Variable *var_info;
@@ -167,13 +196,13 @@ void Compiler::compile_variable_value(AST::VarValue* node) {
     }
 };
 void Compiler::compile_variable_assignment(AST::VarAssignment* node) {
-    this->compile_node(node->get_value());
-
     AST::Node* variable = node->get_variable();
 
     switch (variable->get_type()) {
         case AST::NODE_VAR_VALUE:
         {
+            this->compile_node(node->get_value());
+
             Intermediate::Variable *var_info;
             
             if (!this->get_variable_info(node->get_variable()->as_variable_value(), var_info)) return;
@@ -205,6 +234,32 @@ void Compiler::compile_variable_assignment(AST::VarAssignment* node) {
                 Intermediate::Instruction(
                     Intermediate::INSTR_LOAD,
                     var_info ));
+
+            int struct_index = this->get_constructed_struct(node->get_value());
+            if (struct_index >= 0) this->variable_structs[var_info] = static_cast<uint>(struct_index);
+            else this->variable_structs.erase(var_info);
+        }
+            break;
+        /* p.x = 3. The record is evaluated before the value. */
+        case AST::NODE_DOT:
+        {
+            AST::Dot *dot = variable->as_dot();
+            this->compile_node(dot->get_object());
+            this->compile_node(node->get_value());
+
+            Intermediate::field_reference_t field;
+            if (!this->resolve_field(dot->get_object(), *dot->get_property(), field)) {
+                std::string name;
+                truncate_string(name, 30, *dot->get_property());
+
+                char error[100];
+                snprintf(error, 100, "Cannot set \"%s\", because no struct has a field with that name.", name.c_str());
+                this->output.error(node->get_position(), error, Errors::COMPILE_ERROR);
+                this->error = true;
+                return;
+            }
+
+            this->main_block->add_instruction(Intermediate::Instruction(Intermediate::INSTR_SET_FIELD, field));
         }
             break;
         /* Unknown variable to set */
@@ -289,11 +344,95 @@ void Compiler::compile_continue_statement(AST::Continue* node) {
             loop_start ) );
 }
 
+bool Compiler::resolve_native_function(AST::Node* function, std::string &name, TokenPosition &position, Values::native_method_t &method) {
+    // Walk down to the namespace, e.g. Math in Math.floor
+    std::vector<std::string*> members;
+    AST::Node *root = function;
+    while (root->get_type() == AST::NODE_DOT) {
+        members.push_back(root->as_dot()->get_property());
+        root = root->as_dot()->get_object();
+    }
+    if (members.empty() || root->get_type() != AST::NODE_VAR_VALUE) return false;
+
+    std::string *native_name = root->as_variable_value()->get_name();
+    Intermediate::Variable *variable;
+    if (!this->scopes.get_variable(native_name, variable) || variable->type != Intermediate::NATIVE) return false;
+
+    Values::Value value = this->runtime.get_native(Natives::get_native_index(*native_name));
+    name = *native_name;
+    for (auto member = members.rbegin(); member != members.rend(); member++) {
+        if (!Natives::get_member(value, **member, value)) return false;
+        name += '.';
+        name += **member;
+    }
+    if (Values::get_value_type(value) != Values::ValueType::NATIVE_FUNCTION) return false;
+
+    position = root->get_position();
+    method = Values::get_value_native_function(value);
+    return true;
+}
 void Compiler::compile_function_call(AST::FunctionCall* node) {
     for (auto argument : *node) {
         this->compile_node(argument);
     }
-    this->compile_node(node->get_function());
+
+    /* Calling a struct makes a record, with the arguments as the fields in order */
+    int struct_index = this->get_constructed_struct(node);
+    if (struct_index >= 0) {
+        const Values::record_shape_t &shape = this->ir.get_struct(struct_index);
+        if (node->argument_count() != shape.fields.size()) {
+            std::string name;
+            truncate_string(name, 30, shape.name);
+
+            char error[100];
+            snprintf(error, 100, "Struct \"%s\" has %zu field(s), but %zu value(s) were given.",
+                name.c_str(), shape.fields.size(), node->argument_count());
+            this->output.error(node->get_function()->get_position(), error, Errors::COMPILE_ERROR);
+            this->error = true;
+        }
+
+        this->main_block->add_instruction(
+            Intermediate::Instruction(
+                Intermediate::INSTR_MAKE_RECORD,
+                static_cast<uint>(struct_index) ));
+        return;
+    }
+
+    /* A top level function always takes the same number of arguments */
+    AST::Node *function = node->get_function();
+    Intermediate::Variable *variable;
+    if (function->get_type() == AST::NODE_VAR_VALUE && this->scopes.get_variable(function->as_variable_value()->get_name(), variable)) {
+        auto arity = this->function_arities.find(variable);
+        if (arity != this->function_arities.end() && arity->second != node->argument_count()) {
+            std::string name;
+            truncate_string(name, 30, *function->as_variable_value()->get_name());
+
+            char error[100];
+            snprintf(error, 100, "Function \"%s\" takes %zu argument(s), but %zu were given.",
+                name.c_str(), arity->second, node->argument_count());
+            this->output.error(function->get_position(), error, Errors::COMPILE_ERROR);
+            this->error = true;
+        }
+    }
+
+    /* So do native functions, unless they take any number */
+    std::string native_name;
+    TokenPosition position;
+    Values::native_method_t method;
+    if (this->resolve_native_function(function, native_name, position, method) &&
+        method.number_arguments != Values::VARIADIC_ARGUMENTS &&
+        static_cast<size_t>(method.number_arguments) != node->argument_count()) {
+        std::string name;
+        truncate_string(name, 30, native_name);
+
+        char error[100];
+        snprintf(error, 100, "Function \"%s\" takes %zu argument(s), but %zu were given.",
+            name.c_str(), static_cast<size_t>(method.number_arguments), node->argument_count());
+        this->output.error(position, error, Errors::COMPILE_ERROR);
+        this->error = true;
+    }
+
+    this->compile_node(function);
     this->main_block->add_instruction(
         Intermediate::Instruction(
             Intermediate::INSTR_CALL,
@@ -309,6 +448,17 @@ void Compiler::compile_function_definition(AST::Function* node) {
         this->output.error(node->get_position(), error, Errors::COMPILE_ERROR);
         this->error = true;
     }
+    this->check_not_struct_name(node->get_name(), node->get_position());
+    // Calls are cached by their arguments, which the cache only has room for so many of
+    if (node->is_memoized() && node->argument_count() > MAX_MEMO_ARGUMENTS) {
+        std::string name;
+        char error[150];
+        truncate_string(name, 30, *node->get_name());
+        snprintf(error, 150, "@memo function \"%s\" takes %zu arguments, but memoized functions can take at most %u.",
+            name.c_str(), node->argument_count(), MAX_MEMO_ARGUMENTS);
+        this->output.error(node->get_position(), error, Errors::COMPILE_ERROR);
+        this->error = true;
+    }
 
     this->main_block->add_instruction(Intermediate::Instruction(
             Intermediate::INSTR_GET_FUNCTION_REFERENCE,
@@ -317,6 +467,7 @@ void Compiler::compile_function_definition(AST::Function* node) {
     if (!this->scopes.in_function()) {
         /* Add the variable to scopes */
         Intermediate::Variable *variable = this->scopes.add_variable(node->get_name(), Intermediate::GLOBAL_CONSTANT, this->function_index);
+        this->function_arities[variable] = node->argument_count();
         this->main_block->add_instruction(
             Intermediate::Instruction(
                 Intermediate::INSTR_STORE,
@@ -329,6 +480,8 @@ void Compiler::compile_function_definition(AST::Function* node) {
 
     Intermediate::Block *old_compile = this->main_block;
     Intermediate::Function *function = this->ir.new_function(*node->get_name());
+    function->set_memoized(node->is_memoized());
+    function->set_position(node->get_position());
 
     this->main_block = function->get_block();
 
@@ -364,6 +517,103 @@ void Compiler::compile_return_statement(AST::Return* node) {
     );
 };
 
+void Compiler::declare_structs(AST::Node* program) {
+    if (program->get_type() != AST::NODE_BODY) return;
+
+    for (AST::Node* statement : *program->as_body()) {
+        if (statement->get_type() != AST::NODE_STRUCT_DEFINITION) continue;
+
+        AST::StructDefinition *definition = statement->as_struct_definition();
+        this->top_level_structs.insert(definition);
+
+        std::string name;
+        truncate_string(name, 30, *definition->get_name());
+        char error[100];
+
+        if (this->structs.find(*definition->get_name()) != this->structs.end()) {
+            snprintf(error, 100, "Struct \"%s\" has already been declared.", name.c_str());
+            this->output.error(definition->get_position(), error, Errors::COMPILE_ERROR);
+            this->error = true;
+            continue;
+        }
+        Intermediate::Variable *native;
+        if (this->scopes.get_variable(definition->get_name(), native)) {
+            snprintf(error, 100, "Struct \"%s\" cannot have the same name as a native.", name.c_str());
+            this->output.error(definition->get_position(), error, Errors::COMPILE_ERROR);
+            this->error = true;
+            continue;
+        }
+        // Field slots have to fit in a Bytecode::field_index_t
+        if (definition->field_count() > MAX_STRUCT_FIELDS) {
+            snprintf(error, 100, "Struct \"%s\" has too many fields. A struct may have up to %d fields.", name.c_str(), MAX_STRUCT_FIELDS);
+            this->output.error(definition->get_position(), error, Errors::COMPILE_ERROR);
+            this->error = true;
+            continue;
+        }
+
+        Values::record_shape_t shape;
+        shape.name = *definition->get_name();
+        for (std::string *field : *definition) {
+            if (shape.field_index(*field) >= 0) {
+                std::string field_name;
+                truncate_string(field_name, 30, *field);
+                snprintf(error, 100, "Field \"%s\" appears twice in struct \"%s\".", field_name.c_str(), name.c_str());
+                this->output.error(definition->get_position(), error, Errors::COMPILE_ERROR);
+                this->error = true;
+            }
+            shape.fields.push_back(*field);
+        }
+
+        uint index = this->ir.add_struct(shape);
+        this->structs.emplace(shape.name, index);
+
+        for (uint field_index = 0; field_index < shape.fields.size(); field_index += 1) {
+            // Keeps the first struct to declare the field
+            this->field_owners.emplace(shape.fields[field_index], Intermediate::field_reference_t{
+                .struct_index = index, .field_index = field_index });
+        }
+    }
+}
+int Compiler::get_constructed_struct(AST::Node* node) const {
+    if (node->get_type() != AST::NODE_FUNCTION_CALL) return -1;
+
+    AST::Node *function = node->as_function_call()->get_function();
+    if (function->get_type() != AST::NODE_VAR_VALUE) return -1;
+
+    auto found = this->structs.find(*function->as_variable_value()->get_name());
+    if (found == this->structs.end()) return -1;
+    return static_cast<int>(found->second);
+}
+bool Compiler::resolve_field(AST::Node* object, const std::string &field, Intermediate::field_reference_t &reference) {
+    // If the variable was last given a record, it most likely still holds one of the same struct
+    if (object->get_type() == AST::NODE_VAR_VALUE) {
+        Intermediate::Variable *variable;
+        if (this->scopes.get_variable(object->as_variable_value()->get_name(), variable)) {
+            auto known = this->variable_structs.find(variable);
+            if (known != this->variable_structs.end()) {
+                int field_index = this->ir.get_struct(known->second).field_index(field);
+                if (field_index >= 0) {
+                    reference = Intermediate::field_reference_t{
+                        .struct_index = known->second, .field_index = static_cast<uint>(field_index) };
+                    return true;
+                }
+            }
+        }
+    }
+
+    auto owner = this->field_owners.find(field);
+    if (owner == this->field_owners.end()) return false;
+    reference = owner->second;
+    return true;
+}
+void Compiler::compile_struct_definition(AST::StructDefinition* node) {
+    /* The layout was registered before compilation started, so there's no code to generate */
+    if (this->top_level_structs.find(node) != this->top_level_structs.end()) return;
+
+    this->output.error(node->get_position(), "A struct may only be declared at the top level of the program.", Errors::COMPILE_ERROR);
+    this->error = true;
+}
+
 void Compiler::compile_body(AST::Body* body) {
     if (!body->will_create_scope()) scopes.new_scope(ScopeType::NORMAL);
 
@@ -455,12 +705,16 @@ void Compiler::compile_node(AST::Node* node) {
         case AST::NodeType::NODE_RETURN:
             this->compile_return_statement(node->as_return_statement());
             break;
+        case AST::NodeType::NODE_STRUCT_DEFINITION:
+            this->compile_struct_definition(node->as_struct_definition());
+            break;
 
         case AST::NodeType::NODE_BODY:
             this->compile_body(node->as_body());
     }
 }
 bool Compiler::compile(AST::Node* node) {
+    this->declare_structs(node);
     this->compile_node(node);
     this->main_block->new_label();
     this->main_block->add_instruction(Intermediate::Instruction(Intermediate::INSTR_EXIT));
@@ -4,8 +4,12 @@
 #include "ast.hpp"
 #include "../errors.hpp"
 #include "../ir/intermediate.hpp"
+#include "../runtime/runtime.hpp"
 #include "scopes.hpp"
 
+#include <unordered_map>
+#include <unordered_set>
+
 class Compiler {
     private:
         bool error = false;
@@ -15,11 +19,42 @@ class Compiler {
         /* A reference to the main chunk we'll compiling into at the moment */
         Intermediate::Block *main_block;
         Output &output;
+        /* Only read for the natives, so calls to them can be checked */
+        const Runtime &runtime;
         Scopes::ScopeManager scopes = Scopes::ScopeManager();
 
+        /* Struct name to index in the IR. Structs are declared before anything else is compiled,
+            so they can be used above their declaration. */
+        std::unordered_map<std::string, uint> structs = std::unordered_map<std::string, uint>();
+        /* Every struct declaration at the top level, including ones that had errors.
+            Any other declaration is nested, which isn't allowed. */
+        std::unordered_set<AST::StructDefinition*> top_level_structs = std::unordered_set<AST::StructDefinition*>();
+        /* The slot of each field name in the first struct that declared it. Used to guess the slot
+            when the struct of a record isn't known. The runtime checks the guess. */
+        std::unordered_map<std::string, Intermediate::field_reference_t> field_owners =
+            std::unordered_map<std::string, Intermediate::field_reference_t>();
+        /* The struct of the record a variable was last given, e.g. var p = Point(1, 2) */
+        std::unordered_map<Intermediate::Variable*, uint> variable_structs = std::unordered_map<Intermediate::Variable*, uint>();
+        /* The number of arguments each top level function takes, by its variable. Those
+            variables can't be stored to, so calls through them can be checked. */
+        std::unordered_map<Intermediate::Variable*, size_t> function_arities = std::unordered_map<Intermediate::Variable*, size_t>();
+
+        /* The native function a call is made on, like Math.floor. Returns false if it isn't a
+            member of a native namespace. The name is filled in with the whole path, and the
+            position with the namespace's. */
+        bool resolve_native_function(AST::Node* function, std::string &name, TokenPosition &position, Values::native_method_t &method);
         /* Try to get variable info from name. Return whether or not it was successful.
             Error if there was an error. */
         bool get_variable_info(AST::VarValue* variable, Intermediate::Variable *&info);
+        /* Error if the name is taken by a struct. Returns whether or not it was free. */
+        bool check_not_struct_name(std::string *name, TokenPosition position);
+
+        /* Register every struct declared at the top level of the program */
+        void declare_structs(AST::Node* program);
+        /* The index of the struct, if the node is a call that makes a record. Otherwise, -1. */
+        int get_constructed_struct(AST::Node* node) const;
+        /* Work out the slot of a field accessed on the object. Returns false if no struct has the field. */
+        bool resolve_field(AST::Node* object, const std::string &field, Intermediate::field_reference_t &reference);
 
         /* All the compilation functions for specific nodes */
         void compile_array(AST::Array* node);
@@ -45,13 +80,14 @@ class Compiler {
         void compile_function_call(AST::FunctionCall* node);
         void compile_function_definition(AST::Function* node);
         void compile_return_statement(AST::Return* node);
+        void compile_struct_definition(AST::StructDefinition* node);
 
         void compile_body(AST::Body* body);
 
         /* Compile a node into the chunk */
         void compile_node(AST::Node* node);
     public:
-        Compiler(Intermediate::LabelIR& ir, Output &output);
+        Compiler(Intermediate::LabelIR& ir, const Runtime &runtime, Output &output);
 
         /* Compile the whole program, and then add an exit instruction.
             Returns true if the program was compiled successfully. */
@@ -1,6 +1,7 @@
 #include "lexer.hpp"
 #include "../globals.hpp"
 #include "../memory.hpp"
+#include "../number-parse.hpp"
 #include "../utils.hpp"
 
 #include <unordered_map> // Keyword map
@@ -45,6 +46,7 @@ const char* Scan::tok_type_to_string(TokType type) {
         case SEMICOLON: return ";";
         case COMMA: return ",";
         case DOT: return ".";
+        case AT: return "@";
 
         case BREAK: return "break";
         case CONST: return "const";
@@ -54,6 +56,7 @@ const char* Scan::tok_type_to_string(TokType type) {
         case IF: return "if";
         case NULL_TOKEN: return "null";
         case RETURN: return "return";
+        case STRUCT: return "struct";
         case TRUE: return "true";
         case VAR: return "var";
         case WHILE: return "while";
@@ -136,6 +139,7 @@ namespace {
         { "if", TokType::IF },
         { "null", TokType::NULL_TOKEN },
         { "return", TokType::RETURN },
+        { "struct", TokType::STRUCT },
         { "true", TokType::TRUE },
         { "var", TokType::VAR },
         { "while", TokType::WHILE }
@@ -411,6 +415,8 @@ Token Scanner::parse_number() {
         }
     }
     const char *base_str = base_to_string(base);
+    // Decimal numbers are parsed straight from the source, separators and all
+    uint start_ind = this->ind;
 
     // Certain errors mean the number is no longer processable,
     // so we shouldn't add a number to the number string
@@ -451,10 +457,7 @@ Token Scanner::parse_number() {
                 aggregate_characters = false;
             }
 
-            else {
-                number_string += '.';
-                dec = true;
-            }
+            else dec = true;
         }
         else if (curr == '_') {
             if (last_underscore) too_many_underscores = true;
@@ -471,7 +474,8 @@ Token Scanner::parse_number() {
                 ) {
                     invalid_base_character = curr;
                 }
-                else if (aggregate_characters) number_string += curr;
+                // Decimal numbers are read from the source instead
+                else if (aggregate_characters && base != DECIMAL) number_string += curr;
             }
             else break;
         };
@@ -483,12 +487,13 @@ Token Scanner::parse_number() {
     }
 
     // We need the number for errors
-    Values::number_t number;
+    Values::number_t number = 0;
     try {
         if (base != 10) {
             number = static_cast<Values::number_t>(std::stoi(number_string, 0, base));
         }
-        else number = static_cast<Values::number_t>(std::stod(number_string));
+        // If the digits can't be parsed, the checks below report why, so the value doesn't matter
+        else NumberParse::parse(std::string_view(this->str).substr(start_ind, this->ind - start_ind), number, true);
     } catch (const std::exception&) {
         // If we catch an exception, that means the number failed to parse
         // That's an internal error and we should warn the user
@@ -585,6 +590,7 @@ Token Scanner::next_token() {
         case ';': one_char_type = TokType::SEMICOLON; break;
         case ',': one_char_type = TokType::COMMA; break;
         case '.': one_char_type = TokType::DOT; break;
+        case '@': one_char_type = TokType::AT; break;
         case '!': {
             if (this->peek(1) == '=') two_char_type = TokType::BANG_EQ;
         }
@@ -81,6 +81,8 @@ namespace Scan {
         COMMA,
         // .
         DOT,
+        // @
+        AT,
         // < Operators
 
         // Keywords >
@@ -92,6 +94,7 @@ namespace Scan {
         IF,
         NULL_TOKEN,
         RETURN,
+        STRUCT,
         TRUE,
         VAR,
         WHILE,
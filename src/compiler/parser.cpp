@@ -64,7 +64,7 @@ AST::Node *Parse::Rules::parse_array_index([[maybe_unused]] Scan::Token &current
     if (!AST::node_may_be_array(left->get_type())) {
         char error_message[100];
         snprintf(error_message, 100, "Cannot index non-array type %s", AST::node_type_to_string(left->get_type()));
-        parser->get_output().error(current.get_position(), "", Errors::PARSE_ERROR);
+        parser->get_output().error(current.get_position(), error_message, Errors::PARSE_ERROR);
     }
 
     AST::Node *index = parser->parse_expression();
@@ -234,8 +234,8 @@ AST::Node* Parse::Rules::var_value(Scan::Token &current, [[maybe_unused]] Parser
     return Allocate<AST::VarValue>::create(current.get_string(), current.get_position());
 };
 AST::Node* Parse::Rules::var_assignment(Scan::Token &current, AST::Node* left, Parser* parser) {
-    if (left->get_type() != AST::NODE_VAR_VALUE) {
-        parser->get_output().error(current.get_position(), "Only a variable may be followed by an equals sign. (=)", Errors::PARSE_ERROR);
+    if (left->get_type() != AST::NODE_VAR_VALUE && left->get_type() != AST::NODE_DOT) {
+        parser->get_output().error(current.get_position(), "Only a variable or a field may be followed by an equals sign. (=)", Errors::PARSE_ERROR);
     }
 
     AST::Node* value = parser->parse_expression();
@@ -316,7 +316,7 @@ void Parser::initialize_parse_rules() {
     rules[TokType::LBRACE] = ParseRule{
         .nud = Rules::parse_array,
         .led = Rules::parse_array_index,
-        .precedence = Precedence::PREC_NONE
+        .precedence = Precedence::PREC_DOT
     };
     rules[TokType::DOT] = ParseRule{
         .nud = nullptr,
@@ -608,6 +608,58 @@ AST::Function* Parser::parse_function() {
     function->set_body(this->parse_braced_block());
     return function;
 }
+AST::Function* Parser::parse_annotated_function() {
+    // Go through @ token
+    this->advance();
+
+    bool found_identifier = this->expect(TokType::IDENTIFIER, "Expected annotation name after @");
+    bool memoized = found_identifier && *this->previous_token.get_string() == "memo";
+    if (found_identifier && !memoized) {
+        this->output.error(this->previous_token.get_position(), "Unknown annotation. Only @memo is supported.", Errors::PARSE_ERROR);
+    }
+
+    if (this->curr().get_type() != TokType::FUNCTION) {
+        this->output.error(this->curr().get_position(), "Expected function after annotation", Errors::PARSE_ERROR);
+        this->synchronize();
+        return nullptr;
+    }
+
+    AST::Function* function = this->parse_function();
+    function->set_memoized(memoized);
+    return function;
+}
+
+AST::StructDefinition* Parser::parse_struct() {
+    // Go through struct token
+    this->advance();
+
+    bool found_identifier = this->expect(TokType::IDENTIFIER, "Expected identifier to name struct");
+    std::string* name = found_identifier ? this->previous_token.get_string() : nullptr;
+    if (found_identifier) this->previous_token.mark_payload();
+
+    AST::StructDefinition* definition = Allocate<AST::StructDefinition>::create(name, this->previous_token.get_position());
+
+    this->expect_symbol(TokType::LBRACKET, "Expected { before struct fields");
+
+    while (this->curr().get_type() != TokType::RBRACKET && this->curr().get_type() != TokType::EOI) {
+        bool found_field = this->expect(TokType::IDENTIFIER, "Expected identifier as struct field");
+        if (!found_field) break;
+
+        this->previous_token.mark_payload();
+        definition->add_field(this->previous_token.get_string());
+
+        // Fields are separated by commas, and the last one may have one too
+        if (this->curr().get_type() == TokType::COMMA) {
+            this->advance();
+        }
+        else {
+            break;
+        }
+    }
+
+    this->expect_symbol(TokType::RBRACKET, "Expected } after struct fields");
+    return definition;
+}
 
 AST::Node* Parser::parse_statement() {
     // Skip over redundant semicolons
@@ -640,6 +692,12 @@ AST::Node* Parser::parse_statement() {
         case TokType::FUNCTION:
             node = this->parse_function();
             break;
+        case TokType::AT:
+            node = this->parse_annotated_function();
+            break;
+        case TokType::STRUCT:
+            node = this->parse_struct();
+            break;
         case TokType::RETURN:
             node = this->parse_return_statement();
             break;
@@ -29,7 +29,7 @@ namespace Parse {
 
         PREC_UNARY,
 
-        // a.b
+        // a.b or a[
         PREC_DOT,
     };
 
@@ -147,6 +147,9 @@ namespace Parse {
 
             std::string* parse_function_parameter();
             AST::Function* parse_function();
+            /* A function with an annotation before it, like @memo */
+            AST::Function* parse_annotated_function();
+            AST::StructDefinition* parse_struct();
 
             AST::Node *parse_statement();
 
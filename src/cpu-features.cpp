@@ -0,0 +1,18 @@
+#include "cpu-features.hpp"
+
+#ifdef SGCPP_X86_SIMD
+// These may be called from static initializers, before the CPU model has been read
+bool CPU::has_sse2() {
+    __builtin_cpu_init();
+    static const bool supported = __builtin_cpu_supports("sse2");
+    return supported;
+}
+bool CPU::has_avx2() {
+    __builtin_cpu_init();
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+#else
+bool CPU::has_sse2() { return false; }
+bool CPU::has_avx2() { return false; }
+#endif
@@ -0,0 +1,17 @@
+/* Runtime detection of the vector instruction sets that the natives can dispatch to.
+    The build doesn't pass -mavx2, so AVX2 kernels are compiled with the target attribute
+    and only called when the CPU running the program supports them. */
+
+#ifndef _SGCPP_CPU_FEATURES_HPP
+#define _SGCPP_CPU_FEATURES_HPP
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SGCPP_X86_SIMD
+#endif
+
+namespace CPU {
+    bool has_sse2();
+    bool has_avx2();
+};
+
+#endif
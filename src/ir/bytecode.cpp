@@ -26,6 +26,7 @@ void Chunk::push_unary_op_type(Operations::UnaryOpType type) {
 const char* Bytecode::instruction_to_string(OpCode code) {
     switch (code) {
         case OpCode::OP_POP: return "POP";
+        case OpCode::OP_DUP: return "DUP";
         case OpCode::OP_GOTO: return "GOTO";
         case OpCode::OP_POP_JIZ: return "POP_JIZ";
         case OpCode::OP_POP_JNZ: return "POP_JNZ";
@@ -37,15 +38,23 @@ const char* Bytecode::instruction_to_string(OpCode code) {
         case OpCode::OP_NUMBER: return "OP_NUMBER";
         case OpCode::OP_LOAD_CONST: return "LOAD_CONST";
         case OpCode::OP_MAKE_ARRAY: return "MAKE_ARRAY";
+        case OpCode::OP_LOAD_CONST_ARRAY: return "LOAD_CONST_ARRAY";
         case OpCode::OP_GET_ARRAY_VALUE: return "GET_ARRAY_VALUE";
         case OpCode::OP_SET_ARRAY_VALUE: return "SET_ARRAY_VALUE";
         case OpCode::OP_CONSTANT_PROPERTY_ACCESS: return "CONSTANT_PROPERTY_ACCESS";
+        case OpCode::OP_MAKE_RECORD: return "MAKE_RECORD";
+        case OpCode::OP_GET_FIELD: return "GET_FIELD";
+        case OpCode::OP_SET_FIELD: return "SET_FIELD";
         case OpCode::OP_LOAD_GLOBAL: return "LOAD_GLOBAL";
         case OpCode::OP_STORE_GLOBAL: return "STORE_GLOBAL";
         case OpCode::OP_LOAD_FRAME_VAR: return "LOAD_FRAME_VAR";
         case OpCode::OP_STORE_FRAME_VAR: return "STORE_FRAME_VAR";
         case OpCode::OP_LOAD_NATIVE: return "LOAD_NATIVE";
         case OpCode::OP_CALL: return "CALL";
+        case OpCode::OP_CALL_FUNCTION: return "CALL_FUNCTION";
+        case OpCode::OP_CALL_NATIVE: return "CALL_NATIVE";
+        case OpCode::OP_TAIL_CALL: return "TAIL_CALL";
+        case OpCode::OP_TAIL_CALL_FUNCTION: return "TAIL_CALL_FUNCTION";
         case OpCode::OP_RETURN: return "RETURN";
         case OpCode::OP_EXIT: return "EXIT";
 
@@ -102,6 +111,7 @@ void Chunk::print_instruction(uint &current_byte_index, const Runtime *runtime)
         }
             break;
         case OpCode::OP_LOAD_CONST:
+        case OpCode::OP_LOAD_CONST_ARRAY:
         {
             constant_index_t constant_index = this->read_value<constant_index_t>(current_byte_index);
             argument = std::to_string(constant_index);
@@ -125,10 +135,41 @@ void Chunk::print_instruction(uint &current_byte_index, const Runtime *runtime)
             argument = *property;
         }
             break;
+        case OpCode::OP_MAKE_RECORD:
+        {
+            const Values::record_shape_t *shape = this->read_value<const Values::record_shape_t*>(current_byte_index);
+            argument = shape->name;
+        }
+            break;
+        case OpCode::OP_GET_FIELD:
+        case OpCode::OP_SET_FIELD:
+        {
+            const Values::record_shape_t *shape = this->read_value<const Values::record_shape_t*>(current_byte_index);
+            field_index_t field = this->read_value<field_index_t>(current_byte_index);
+            argument = std::to_string(field);
+            comment = shape->name + '.' + shape->fields[field];
+        }
+            break;
         case OpCode::OP_CALL:
+        case OpCode::OP_TAIL_CALL:
+        {
+            call_arguments_t arg_count = this->read_value<call_arguments_t>(current_byte_index);
+            argument = std::to_string(arg_count);
+        }
+            break;
+        case OpCode::OP_CALL_FUNCTION:
+        case OpCode::OP_TAIL_CALL_FUNCTION:
+        {
+            constant_index_t function_index = this->read_value<constant_index_t>(current_byte_index);
+            argument = std::to_string(function_index);
+        }
+            break;
+        case OpCode::OP_CALL_NATIVE:
         {
+            constant_index_t constant_index = this->read_value<constant_index_t>(current_byte_index);
             call_arguments_t arg_count = this->read_value<call_arguments_t>(current_byte_index);
             argument = std::to_string(arg_count);
+            comment = Values::value_to_debug_string(runtime->get_constant(constant_index));
         }
             break;
         case OpCode::OP_NUMBER:
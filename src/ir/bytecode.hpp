@@ -15,12 +15,19 @@
 // Forward declaration for class descibed in runtime/runtime.hpp
 // This is because the bytecode logger function depends on the runtime class
 class Runtime;
+// Described in value.hpp, which includes this file
+namespace Values {
+    struct record_shape_t;
+};
 
 namespace Bytecode {
     enum OpCode {
         /* Pops the top value on the stack.
         0 arguments */
         OP_POP,
+        /* Pushes a copy of the top value on the stack.
+        0 arguments */
+        OP_DUP,
 
         /* Goes to the byte at the specified index.
             This byte with be interpreter as the next instruction to perform.
@@ -71,6 +78,10 @@ namespace Bytecode {
         /* Make the last n elements of the stack into an array. The topmost element of the stack is the
             last element of the array. Argument is variable_index_t, the number of elements in the array */
         OP_MAKE_ARRAY,
+        /* Push a new array slice that views the whole constant array at this index in the constant pool.
+            The slice copies the elements the first time it's written to, so the constant never changes.
+            Argument is constant_index_t. */
+        OP_LOAD_CONST_ARRAY,
         /* Get the element in the array at the given index. Top of stack is index, value under that is array. */
         OP_GET_ARRAY_VALUE,
         /* Set the value at the top of the stack in the index at the array. Stack is:
@@ -82,6 +93,20 @@ namespace Bytecode {
             Argument is a pointer to a string, but the string is a constant loaded into the pool.
             It is just a string pointer to get rid of redundant value check */
         OP_CONSTANT_PROPERTY_ACCESS,
+        /* Make the last n elements of the stack into a record, where n is the number of fields.
+            The topmost element is the last field. Argument is a pointer to the record_shape_t
+            of the struct, which the runtime owns. */
+        OP_MAKE_RECORD,
+        /* Gets a field of the record at the top of the stack. Arguments are a pointer to the
+            record_shape_t the compiler expects, then the field's slot in it (field_index_t).
+            If the record has that shape, the slot is read directly. Otherwise, the field is
+            looked up by name, so records of other structs and namespaces still work. */
+        OP_GET_FIELD,
+        /* Sets a field of a record, and pushes the value back. Stack is:
+            value
+            record
+            Same arguments as OP_GET_FIELD. */
+        OP_SET_FIELD,
 
         /* Argument is call_arguments_t, number of arguments that are used to call the function.
             Top value of stack must be the function to call.
@@ -91,6 +116,22 @@ namespace Bytecode {
             2
             1 */
         OP_CALL,
+        /* Call the program function at the index. The compiler checked that the call gives it as
+            many arguments as it takes, and only the arguments are on the stack.
+            Argument is constant_index_t, the index of the function. */
+        OP_CALL_FUNCTION,
+        /* Call the native function in the constant pool at the index. The compiler checked that the
+            native takes as many arguments as the call gives it, and only the arguments are on the stack.
+            Arguments are constant_index_t, then call_arguments_t, the number of arguments. */
+        OP_CALL_NATIVE,
+        /* Call a function in place of the current function, whose result is the callee's. A program
+            function takes over the current frame, so tail recursion runs in constant stack.
+            Natives, and calls from a memoized function, which still has to cache its result, are
+            normal calls, and the OP_RETURN that follows, right after or past a goto, returns the result.
+            Same argument and stack as OP_CALL. */
+        OP_TAIL_CALL,
+        /* A tail call to the program function at the index. Same argument as OP_CALL_FUNCTION. */
+        OP_TAIL_CALL_FUNCTION,
         /* Return from the current function */
         OP_RETURN,
 
@@ -121,6 +162,8 @@ namespace Bytecode {
     typedef uint8_t call_arguments_t;
     /* Size of constant pool */
     typedef uint32_t constant_index_t;
+    /* Slot of a field in a record */
+    typedef uint8_t field_index_t;
 
     typedef std::vector<uint8_t> bytecode_t;
     class Chunk {
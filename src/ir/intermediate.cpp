@@ -54,29 +54,45 @@ Instruction::Instruction(InstrCode code, Operations::UnaryOpType type) :
 Instruction::Instruction(InstrCode code, Variable *variable) :
     code(code), payload(ir_instruction_arg_t{ .variable = variable }) {};
 Instruction::Instruction(InstrCode code, uint argument) : code(code) {
-    if (code == InstrCode::INSTR_CALL) {
+    if (code == InstrCode::INSTR_CALL || code == InstrCode::INSTR_TAIL_CALL) {
         this->payload.num_arguments = argument;
     }
-    else if (code == InstrCode::INSTR_GET_FUNCTION_REFERENCE) {
+    else if (code == InstrCode::INSTR_GET_FUNCTION_REFERENCE || code == InstrCode::INSTR_CALL_FUNCTION || code == InstrCode::INSTR_TAIL_CALL_FUNCTION) {
         this->payload.function_index = argument;
     }
     else if (code == InstrCode::INSTR_MAKE_ARRAY) {
         this->payload.array_element_count = argument;
     }
+    else if (code == InstrCode::INSTR_CONSTANT_ARRAY) {
+        this->payload.constant_array_index = argument;
+    }
+    else if (code == InstrCode::INSTR_MAKE_RECORD) {
+        this->payload.struct_index = argument;
+    }
     else {
         #ifdef DEBUG
         assert(false && "The instruction code given does not accept an unsigned integer (uint) argument");
         #endif
     }
 }
+Instruction::Instruction(InstrCode code, field_reference_t field) :
+    code(code), payload(ir_instruction_arg_t{ .field = field }) {};
+Instruction::Instruction(InstrCode code, native_call_t native_call) :
+    code(code), payload(ir_instruction_arg_t{ .native_call = native_call }) {};
 
 Instruction::Instruction(Values::number_t number) :
     code(Intermediate::INSTR_NUMBER), payload(ir_instruction_arg_t{ .number = number }) {};
 // < Constructor overloads
 
 bool Instruction::is_truthy_constant() const {
-    return this->code == InstrCode::INSTR_TRUE || this->code == InstrCode::INSTR_FALSE ||
-        (this->has_number_payload() && this->get_number() != 0);
+    switch (this->code) {
+        case InstrCode::INSTR_TRUE:
+        case InstrCode::INSTR_GET_FUNCTION_REFERENCE:
+            return true;
+        case InstrCode::INSTR_NUMBER: return this->get_number() != 0;
+        case InstrCode::INSTR_STRING: return this->payload.str->size() > 0;
+        default: return false;
+    }
 }
 bool Instruction::is_constant() const {
     return this->code == InstrCode::INSTR_TRUE ||
@@ -84,11 +100,10 @@ bool Instruction::is_constant() const {
         this->code == InstrCode::INSTR_NULL ||
         this->code == InstrCode::INSTR_NUMBER ||
         this->code == InstrCode::INSTR_STRING ||
-        this->code == InstrCode::INSTR_MAKE_ARRAY ||
         this->code == InstrCode::INSTR_GET_FUNCTION_REFERENCE;
 }
 bool Instruction::is_static_flow_load() const {
-    if (this->code == InstrCode::INSTR_LOAD) return true;
+    if (this->code == InstrCode::INSTR_LOAD || this->code == InstrCode::INSTR_DUP || this->code == InstrCode::INSTR_CONSTANT_ARRAY) return true;
     return this->is_constant();
 }
 
@@ -106,7 +121,7 @@ Value Instruction::payload_to_value() const {
         case InstrCode::INSTR_STRING:
             return Value(
                 Allocate<Object>::create(
-                    Allocate<std::string>::create(*this->payload.str)));
+                    Allocate<Values::string_t>::create(std::string_view(*this->payload.str))));
         case InstrCode::INSTR_GET_FUNCTION_REFERENCE:
             return Value(this->get_function_index(), ValueType::PROGRAM_FUNCTION);
         default:
@@ -120,7 +135,9 @@ Instruction Instruction::value_to_instruction(Values::Value value) {
             Object *obj = get_value_object(value);
 
             switch (obj->type) {
-                case ObjectType::STRING: return Instruction(InstrCode::INSTR_STRING, get_value_string(value));
+                // The instruction owns its payload, so it needs its own copy of the characters
+                case ObjectType::STRING:
+                    return Instruction(InstrCode::INSTR_STRING, Allocate<std::string>::create(*get_value_string(value)));
                 default: throw sg_assert_error("Optimization tried to condense array when it shouldn't have");
             }
         }
@@ -130,6 +147,10 @@ Instruction Instruction::value_to_instruction(Values::Value value) {
             return Instruction(InstrCode::INSTR_TRUE);
         case ValueType::FALSE:
             return Instruction(InstrCode::INSTR_FALSE);
+        case ValueType::NULL_VALUE:
+            return Instruction(InstrCode::INSTR_NULL);
+        case ValueType::PROGRAM_FUNCTION:
+            return Instruction(InstrCode::INSTR_GET_FUNCTION_REFERENCE, static_cast<uint>(get_value_program_function(value)));
         default:
             throw sg_assert_error("Tried to convert instruction to a value that could not become a value");
     }
@@ -143,6 +164,13 @@ void Instruction::free_payload() {
         delete this->payload.str;
     }
 };
+Instruction Instruction::copy() const {
+    Instruction copy = *this;
+    if (this->code == InstrCode::INSTR_STRING || this->code == InstrCode::INSTR_CONSTANT_PROPERTY_ACCESS) {
+        copy.payload.str = Allocate<std::string>::create(*this->payload.str);
+    }
+    return copy;
+};
 
 #include "../errors.hpp"
 
@@ -155,6 +183,8 @@ const char* Intermediate::instr_type_to_string(InstrCode code) {
     switch (code) {
         case InstrCode::INSTR_POP:
             return "POP";
+        case InstrCode::INSTR_DUP:
+            return "DUP";
         case InstrCode::INSTR_GOTO:
             return "GOTO";
         case InstrCode::INSTR_POP_JIZ:
@@ -177,12 +207,20 @@ const char* Intermediate::instr_type_to_string(InstrCode code) {
             return "INSTR_STRING";
         case InstrCode::INSTR_MAKE_ARRAY:
             return "INSTR_MAKE_ARRAY";
+        case InstrCode::INSTR_CONSTANT_ARRAY:
+            return "INSTR_CONSTANT_ARRAY";
         case InstrCode::INSTR_GET_ARRAY_VALUE:
             return "INSTR_GET_ARRAY_VALUE";
         case InstrCode::INSTR_SET_ARRAY_VALUE:
             return "INSTR_SET_ARRAY_VALUE";
         case InstrCode::INSTR_CONSTANT_PROPERTY_ACCESS:
             return "INSTR_CONSTANT_PROPERTY_ACCESS";
+        case InstrCode::INSTR_MAKE_RECORD:
+            return "INSTR_MAKE_RECORD";
+        case InstrCode::INSTR_GET_FIELD:
+            return "INSTR_GET_FIELD";
+        case InstrCode::INSTR_SET_FIELD:
+            return "INSTR_SET_FIELD";
         case InstrCode::INSTR_GET_FUNCTION_REFERENCE:
             return "GET_FUNCTION_REFERENCE";
         case InstrCode::INSTR_MAKE_FUNCTION:
@@ -195,6 +233,14 @@ const char* Intermediate::instr_type_to_string(InstrCode code) {
             return "STORE";
         case InstrCode::INSTR_CALL:
             return "CALL";
+        case InstrCode::INSTR_CALL_FUNCTION:
+            return "CALL_FUNCTION";
+        case InstrCode::INSTR_CALL_NATIVE:
+            return "CALL_NATIVE";
+        case InstrCode::INSTR_TAIL_CALL:
+            return "TAIL_CALL";
+        case InstrCode::INSTR_TAIL_CALL_FUNCTION:
+            return "TAIL_CALL_FUNCTION";
         case InstrCode::INSTR_EXIT:
             return "EXIT";
         default:
@@ -309,6 +355,12 @@ void Intermediate::log_instruction(Instruction instr) {
             comment += "]";
         }
             break;
+        case InstrCode::INSTR_CONSTANT_ARRAY:
+        {
+            argument = std::to_string(instr.get_constant_array_index());
+            std::cout << number_c << argument;
+        }
+            break;
         case InstrCode::INSTR_CONSTANT_PROPERTY_ACCESS:
         {
             argument = *instr.get_string();
@@ -320,6 +372,23 @@ void Intermediate::log_instruction(Instruction instr) {
             std::cout << variable_c << instr.get_function_index();
         }
             break;
+        case InstrCode::INSTR_MAKE_RECORD:
+        {
+            argument = std::to_string(instr.get_struct_index());
+            std::cout << number_c << argument;
+        }
+            break;
+        case InstrCode::INSTR_GET_FIELD:
+        case InstrCode::INSTR_SET_FIELD:
+        {
+            argument = std::to_string(instr.get_field().field_index);
+            std::cout << number_c << argument;
+
+            comment = "[struct=";
+            comment += std::to_string(instr.get_field().struct_index);
+            comment += "]";
+        }
+            break;
         case InstrCode::INSTR_LOAD:
         case InstrCode::INSTR_STORE:
         {
@@ -343,11 +412,28 @@ void Intermediate::log_instruction(Instruction instr) {
         }
             break;
         case InstrCode::INSTR_CALL:
+        case InstrCode::INSTR_TAIL_CALL:
         {
             argument = std::to_string(instr.get_argument_count());
             std::cout << number_c << argument;
         }
             break;
+        case InstrCode::INSTR_CALL_FUNCTION:
+        case InstrCode::INSTR_TAIL_CALL_FUNCTION:
+        {
+            std::cout << variable_c << instr.get_function_index();
+        }
+            break;
+        case InstrCode::INSTR_CALL_NATIVE:
+        {
+            argument = std::to_string(instr.get_native_call().num_arguments);
+            std::cout << number_c << argument;
+
+            comment = "[native=";
+            comment += std::to_string(instr.get_native_call().native_index);
+            comment += "]";
+        }
+            break;
         default: break;
     }
     std::cout << rang::style::reset;
@@ -411,6 +497,21 @@ Function *LabelIR::new_function(const std::string &name) {
     this->functions.push_back(function);
     return function;
 }
+uint LabelIR::add_struct(const Values::record_shape_t &shape) {
+    this->structs.push_back(shape);
+    return this->structs.size() - 1;
+}
+uint LabelIR::add_constant_array(const intermediate_set_t &elements) {
+    this->constant_arrays.push_back(elements);
+    return this->constant_arrays.size() - 1;
+}
+uint LabelIR::add_native(const Values::native_method_t &method) {
+    for (uint native_index = 0; native_index < this->natives.size(); native_index += 1) {
+        if (this->natives[native_index].func == method.func) return native_index;
+    }
+    this->natives.push_back(method);
+    return this->natives.size() - 1;
+}
 int LabelIR::last_function_index() const {
     return this->functions.size() == 0 ? global_function_ind : static_cast<int>(this->functions.size()) - 1;
 };
@@ -434,22 +535,79 @@ void LabelIR::log_ir() const {
 
     std::cout << "-------------------------------------------------------" << std::endl;
 }
+Variable *LabelIR::new_temporary(VariableType type, int function_ind) {
+    // Identifiers can't start with $
+    std::string *name = Allocate<std::string>::create("$");
+    *name += std::to_string(this->temporaries.size());
+    this->temporaries.push_back(Allocate<Variable>::create(name, type, function_ind, function_ind));
+    return this->temporaries.back();
+}
+void LabelIR::stack_effect(const Instruction &instr, size_t &pops, size_t &pushes) const {
+    pops = 0;
+    pushes = 1;
+    switch (instr.code) {
+        case InstrCode::INSTR_POP:
+        case InstrCode::INSTR_POP_JIZ:
+        case InstrCode::INSTR_POP_JNZ:
+        case InstrCode::INSTR_RETURN:
+        case InstrCode::INSTR_STORE:
+            pops = 1; pushes = 0; break;
+        case InstrCode::INSTR_GOTO:
+        case InstrCode::INSTR_EXIT:
+        case InstrCode::INSTR_MAKE_FUNCTION:
+            pushes = 0; break;
+        case InstrCode::INSTR_BIN_OP: pops = 2; break;
+        case InstrCode::INSTR_UNARY_OP:
+        case InstrCode::INSTR_CONSTANT_PROPERTY_ACCESS:
+        case InstrCode::INSTR_GET_FIELD:
+            pops = 1; break;
+        case InstrCode::INSTR_MAKE_ARRAY: pops = instr.get_array_element_count(); break;
+        case InstrCode::INSTR_GET_ARRAY_VALUE: pops = 2; break;
+        case InstrCode::INSTR_SET_ARRAY_VALUE: pops = 3; break;
+        case InstrCode::INSTR_SET_FIELD: pops = 2; break;
+        case InstrCode::INSTR_MAKE_RECORD: pops = this->get_struct(instr.get_struct_index()).fields.size(); break;
+        case InstrCode::INSTR_CALL:
+        case InstrCode::INSTR_TAIL_CALL:
+            pops = instr.get_argument_count() + 1; break;
+        case InstrCode::INSTR_CALL_FUNCTION:
+        case InstrCode::INSTR_TAIL_CALL_FUNCTION:
+            pops = this->get_function(instr.get_function_index())->argument_count(); break;
+        case InstrCode::INSTR_CALL_NATIVE: pops = instr.get_native_call().num_arguments; break;
+        default: break;
+    }
+}
+Values::native_flags_t LabelIR::call_flags(const Instruction &instr) const {
+    switch (instr.code) {
+        case InstrCode::INSTR_CALL_FUNCTION:
+        case InstrCode::INSTR_TAIL_CALL_FUNCTION:
+            return this->get_function(instr.get_function_index())->get_flags();
+        case InstrCode::INSTR_CALL_NATIVE: return this->get_native(instr.get_native_call().native_index).flags;
+        default: return 0;
+    }
+}
 LabelIR::~LabelIR() {
     for (Function *function : this->functions) {
         delete function;
     }
+    for (Variable *variable : this->temporaries) {
+        delete variable->name;
+        delete variable;
+    }
 }
 // < Label IR
 
 Intermediate::Label::Label(label_index_t* index) : name(index) {};
 
+Label &Block::insert_label(uint index, label_index_t* name) {
+    return *this->labels.insert(this->labels.begin() + index, Label(name));
+}
 Label &Block::get_label_at_numerical_index(uint index) {
     return this->labels.at(index);
 }
 
 // Label name generation >
 std::uniform_int_distribution<uint32_t> Block::label_generator =
-                std::uniform_int_distribution<uint32_t>(0, CHAR_LABEL_COUNT);
+                std::uniform_int_distribution<uint32_t>(0, CHAR_LABEL_COUNT - 1);
 static char label_chars[CHAR_LABEL_COUNT] = {
     'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm',
     'n', 'o', 'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y', 'z',
@@ -4,6 +4,7 @@
 #define _SGCPP_CHUNK_HPP
 
 #include "bytecode.hpp"
+#include "../errors.hpp"
 #include "../globals.hpp"
 #include "../utils.hpp"
 #include "../value.hpp"
@@ -79,6 +80,7 @@ namespace Intermediate {
         go to bytecode.hpp for an explanation. */
     enum InstrCode {
         INSTR_POP,
+        INSTR_DUP,
 
         /* These intermediate representation commands have an address they point to */
         INSTR_POP_JNZ,
@@ -97,12 +99,23 @@ namespace Intermediate {
         INSTR_STRING,
         /* Argument is the number of elements in the array */
         INSTR_MAKE_ARRAY,
+        /* An array literal whose elements are all constants, built once before the program runs.
+            Argument is the index of its elements in the IR. The optimizer makes these. */
+        INSTR_CONSTANT_ARRAY,
         /* Get value of array at the index on the stack */
         INSTR_GET_ARRAY_VALUE,
         /* Set value of array at the index under the value */
         INSTR_SET_ARRAY_VALUE,
         /* Get property of object at the string index given as the argument */
         INSTR_CONSTANT_PROPERTY_ACCESS,
+        /* Make a record out of the last n values on the stack, where n is the field count.
+            Argument is the index of the struct in the IR. */
+        INSTR_MAKE_RECORD,
+        /* Get the field of the record on the stack. Argument is a field reference,
+            the struct the compiler expects the record to be and the field's slot in it. */
+        INSTR_GET_FIELD,
+        /* Set the field of the record under the value. Same argument as INSTR_GET_FIELD. */
+        INSTR_SET_FIELD,
 
         /* Create a reference to a function at the given index, which is a value.
             Argument is index of function. */
@@ -122,6 +135,19 @@ namespace Intermediate {
             2
             1 */
         INSTR_CALL,
+        /* Call a function the optimizer knows is called, after checking the call gives it
+            as many arguments as it takes. Argument is the index of the function.
+            Only the arguments are on the stack. */
+        INSTR_CALL_FUNCTION,
+        /* Call a native the optimizer knows is called, after checking the call gives it
+            as many arguments as it takes. Argument is a native call. Only the arguments are on the stack. */
+        INSTR_CALL_NATIVE,
+        /* A call whose result the function returns right away, so the callee can take over the
+            caller's frame. The return still follows, right after or past a goto, for when it can't.
+            Same argument and stack as INSTR_CALL. */
+        INSTR_TAIL_CALL,
+        /* A tail call to a function the optimizer knows is called. Same argument and stack as INSTR_CALL_FUNCTION. */
+        INSTR_TAIL_CALL_FUNCTION,
 
         INSTR_EXIT
     };
@@ -130,6 +156,18 @@ namespace Intermediate {
 
     typedef std::string label_index_t;
 
+    /* A field whose slot was worked out at compile time */
+    struct field_reference_t {
+        uint struct_index;
+        uint field_index;
+    };
+    /* A call to a native that was worked out at compile time */
+    struct native_call_t {
+        /* Index of the native function in the IR */
+        uint native_index;
+        uint num_arguments;
+    };
+
     union ir_instruction_arg_t {
         /* For jump commands */
         label_index_t* label;
@@ -141,6 +179,10 @@ namespace Intermediate {
         uint num_arguments;
         uint function_index;
         uint array_element_count;
+        uint constant_array_index;
+        uint struct_index;
+        field_reference_t field;
+        native_call_t native_call;
 
         Variable *variable;
     };
@@ -159,6 +201,8 @@ namespace Intermediate {
         explicit Instruction(InstrCode code, Operations::UnaryOpType unary_op);
         explicit Instruction(InstrCode code, Variable *variable);
         explicit Instruction(InstrCode code, uint argument);
+        explicit Instruction(InstrCode code, field_reference_t field);
+        explicit Instruction(InstrCode code, native_call_t native_call);
         /* There is only one instruction that takes this number. */
         explicit Instruction(Values::number_t number);
 
@@ -170,6 +214,12 @@ namespace Intermediate {
             return this->code == InstrCode::INSTR_GOTO ||
                 this->code == InstrCode::INSTR_POP_JIZ ||
                 this->code == InstrCode::INSTR_POP_JNZ; };
+        inline bool is_call() const {
+            return this->code == InstrCode::INSTR_CALL ||
+                this->code == InstrCode::INSTR_CALL_FUNCTION ||
+                this->code == InstrCode::INSTR_CALL_NATIVE ||
+                this->code == InstrCode::INSTR_TAIL_CALL ||
+                this->code == InstrCode::INSTR_TAIL_CALL_FUNCTION; };
         
         inline bool has_number_payload() const { return this->code == InstrCode::INSTR_NUMBER; };
         // inline bool has_string_payload() const { return this->code == InstrCode::INSTR_STRING; };
@@ -201,13 +251,14 @@ namespace Intermediate {
         }
         inline uint get_argument_count() const {
             #ifdef DEBUG
-            assert(this->code == InstrCode::INSTR_CALL);
+            assert(this->code == InstrCode::INSTR_CALL || this->code == InstrCode::INSTR_TAIL_CALL);
             #endif
             return this->payload.num_arguments;
         }
         inline uint get_function_index() const {
             #ifdef DEBUG
-            assert(this->code == InstrCode::INSTR_GET_FUNCTION_REFERENCE);
+            assert(this->code == InstrCode::INSTR_GET_FUNCTION_REFERENCE || this->code == InstrCode::INSTR_CALL_FUNCTION ||
+                this->code == InstrCode::INSTR_TAIL_CALL_FUNCTION);
             #endif
             return this->payload.function_index;
         }
@@ -217,6 +268,30 @@ namespace Intermediate {
             #endif
             return this->payload.array_element_count;
         }
+        inline uint get_constant_array_index() const {
+            #ifdef DEBUG
+            assert(this->code == InstrCode::INSTR_CONSTANT_ARRAY);
+            #endif
+            return this->payload.constant_array_index;
+        }
+        inline uint get_struct_index() const {
+            #ifdef DEBUG
+            assert(this->code == InstrCode::INSTR_MAKE_RECORD);
+            #endif
+            return this->payload.struct_index;
+        }
+        inline field_reference_t get_field() const {
+            #ifdef DEBUG
+            assert(this->code == InstrCode::INSTR_GET_FIELD || this->code == InstrCode::INSTR_SET_FIELD);
+            #endif
+            return this->payload.field;
+        }
+        inline native_call_t get_native_call() const {
+            #ifdef DEBUG
+            assert(this->code == InstrCode::INSTR_CALL_NATIVE);
+            #endif
+            return this->payload.native_call;
+        }
         inline Variable *get_variable() const {
             #ifdef DEBUG
             assert(this->code == InstrCode::INSTR_LOAD || this->code == InstrCode::INSTR_STORE);
@@ -239,6 +314,8 @@ namespace Intermediate {
 
         /* If it's a string, free the payload */
         void free_payload();
+        /* Copy the instruction, along with the string it owns */
+        Instruction copy() const;
 
         /* Convert a value to an instruction that loads it onto the stack. */
         static Instruction value_to_instruction(Values::Value value);
@@ -278,6 +355,9 @@ namespace Intermediate {
             label_index_t* new_label();
             /* Generate a new label with a given index. */
             void new_label(label_index_t* index);
+            /* Insert an empty label before the label at the given numerical index. Nothing falls
+                into it, so whatever jumps to it has to be added too. */
+            Label &insert_label(uint index, label_index_t* name);
             /* Get the label in the vector at the specified numerical index.
                 NOT the label index. */
             Label &get_label_at_numerical_index(uint index);
@@ -305,6 +385,13 @@ namespace Intermediate {
             // NOT RESPONSIBLE for variable management
             std::vector<Intermediate::Variable*> arguments = std::vector<Intermediate::Variable*>();
             std::string name;
+            /* What calling the function does, as the flags of a native. Set by the optimizer. */
+            Values::native_flags_t flags = 0;
+            /* Whether the results of calls are cached by their arguments. The program asks for it
+                with @memo, and the optimizer turns it off if the function isn't pure. */
+            bool memoized = false;
+            /* Where the function is declared, for warnings about it */
+            Position::TokenPosition position = Position::null_token_position;
         public:
             Function(Block *block, const std::string &name);
 
@@ -315,12 +402,30 @@ namespace Intermediate {
             inline auto     get_argument(uint index) const { return this->arguments.at(index); };
 
             inline const std::string &get_name() const { return this->name; };
+
+            inline Values::native_flags_t get_flags() const { return this->flags; };
+            inline void set_flags(Values::native_flags_t flags) { this->flags = flags; };
+
+            inline bool is_memoized() const { return this->memoized; };
+            inline void set_memoized(bool memoized) { this->memoized = memoized; };
+
+            inline Position::TokenPosition get_position() const { return this->position; };
+            inline void set_position(Position::TokenPosition position) { this->position = position; };
     };
     class LabelIR {
         private:
             Function main;
 
             std::vector<Function*> functions = std::vector<Function*>();
+            /* The struct layouts the program declared. Copied into the runtime
+                when the program is transpiled. */
+            std::vector<Values::record_shape_t> structs = std::vector<Values::record_shape_t>();
+            /* The elements of each constant array, as the constant loads the compiler made for them */
+            std::vector<intermediate_set_t> constant_arrays = std::vector<intermediate_set_t>();
+            /* The natives that calls were resolved to */
+            std::vector<Values::native_method_t> natives = std::vector<Values::native_method_t>();
+            /* Variables the optimizer made, which the IR is responsible for */
+            std::vector<Variable*> temporaries = std::vector<Variable*>();
         public:
             LabelIR();
 
@@ -328,7 +433,31 @@ namespace Intermediate {
             int   last_function_index() const;
 
             Function *new_function(const std::string &name);
-            inline Function *get_function(int index) { return this->functions.at(index); };
+            inline Function *get_function(int index) const { return this->functions.at(index); };
+
+            // Returns the index of the struct
+            uint add_struct(const Values::record_shape_t &shape);
+            inline const Values::record_shape_t &get_struct(uint index) const { return this->structs.at(index); };
+            inline size_t struct_count() const { return this->structs.size(); };
+
+            // Returns the index of the array
+            uint add_constant_array(const intermediate_set_t &elements);
+            inline const intermediate_set_t &get_constant_array(uint index) const { return this->constant_arrays.at(index); };
+            inline size_t constant_array_count() const { return this->constant_arrays.size(); };
+
+            // Returns the index of the native. A native that was already added keeps its index.
+            uint add_native(const Values::native_method_t &method);
+            inline const Values::native_method_t &get_native(uint index) const { return this->natives.at(index); };
+            inline size_t native_count() const { return this->natives.size(); };
+
+            /* Make a variable that can't clash with one the program declared.
+                The type decides whether it's a global or local to the function. */
+            Variable *new_temporary(VariableType type, int function_ind);
+
+            /* Values an instruction pops off the stack and pushes onto it */
+            void stack_effect(const Instruction &instr, size_t &pops, size_t &pushes) const;
+            /* The flags of what a call to a known function or native does, or 0 for anything else */
+            Values::native_flags_t call_flags(const Instruction &instr) const;
 
             void log_ir() const;
 
@@ -1,5 +1,6 @@
 #include "transpiler.hpp"
 #include "../natives/natives.hpp"
+#include "../memory.hpp"
 
 using Intermediate::Instruction, Intermediate::InstrCode, Intermediate::Label, Intermediate::label_index_t, Bytecode::address_t;
 
@@ -53,7 +54,8 @@ void Transpiler::transpile_variable_instruction(Instruction instr) {
                 index = index_pair->second;
             }
             else {
-                index = info.hash.size();
+                // Locals go after the arguments in the frame
+                index = info.func->argument_count() + info.hash.size();
                 // Add it to the hashmap
                 info.hash.emplace(variable, index);
             }
@@ -79,6 +81,7 @@ void Transpiler::transpile_ir_instruction(Instruction instr) {
     switch (instr.code) {
         // 0 argument instructions
         case InstrCode::INSTR_POP: chunk->push_opcode(OpCode::OP_POP); break;
+        case InstrCode::INSTR_DUP: chunk->push_opcode(OpCode::OP_DUP); break;
         case InstrCode::INSTR_RETURN: chunk->push_opcode(OpCode::OP_RETURN); break;
         case InstrCode::INSTR_EXIT: chunk->push_opcode(OpCode::OP_EXIT); break;
 
@@ -92,9 +95,20 @@ void Transpiler::transpile_ir_instruction(Instruction instr) {
             chunk->push_unary_op_type(instr.get_unary_op());
             break;
         case InstrCode::INSTR_CALL:
-            chunk->push_opcode(OpCode::OP_CALL);
+        case InstrCode::INSTR_TAIL_CALL:
+            chunk->push_opcode(instr.code == InstrCode::INSTR_CALL ? OpCode::OP_CALL : OpCode::OP_TAIL_CALL);
             chunk->push_value<Bytecode::call_arguments_t>(instr.get_argument_count());
             break;
+        case InstrCode::INSTR_CALL_FUNCTION:
+        case InstrCode::INSTR_TAIL_CALL_FUNCTION:
+            chunk->push_opcode(instr.code == InstrCode::INSTR_CALL_FUNCTION ? OpCode::OP_CALL_FUNCTION : OpCode::OP_TAIL_CALL_FUNCTION);
+            chunk->push_value<Bytecode::constant_index_t>(instr.get_function_index());
+            break;
+        case InstrCode::INSTR_CALL_NATIVE:
+            chunk->push_opcode(OpCode::OP_CALL_NATIVE);
+            chunk->push_value<Bytecode::constant_index_t>(this->natives.at(instr.get_native_call().native_index));
+            chunk->push_value<Bytecode::call_arguments_t>(instr.get_native_call().num_arguments);
+            break;
 
         // Push constant instructions
         case InstrCode::INSTR_TRUE: chunk->push_opcode(OpCode::OP_TRUE); break;
@@ -117,6 +131,10 @@ void Transpiler::transpile_ir_instruction(Instruction instr) {
             chunk->push_opcode(OpCode::OP_MAKE_ARRAY);
             chunk->push_value<Bytecode::variable_index_t>(instr.get_array_element_count());
             break;
+        case InstrCode::INSTR_CONSTANT_ARRAY:
+            chunk->push_opcode(OpCode::OP_LOAD_CONST_ARRAY);
+            chunk->push_value<Bytecode::constant_index_t>(this->constant_arrays.at(instr.get_constant_array_index()));
+            break;
         case InstrCode::INSTR_CONSTANT_PROPERTY_ACCESS:
         {
             Values::Value prop_value = instr.payload_to_value();
@@ -126,6 +144,20 @@ void Transpiler::transpile_ir_instruction(Instruction instr) {
         }
             break;
 
+        case InstrCode::INSTR_MAKE_RECORD:
+            chunk->push_opcode(OpCode::OP_MAKE_RECORD);
+            chunk->push_value<const Values::record_shape_t*>(this->shapes.at(instr.get_struct_index()));
+            break;
+        case InstrCode::INSTR_GET_FIELD:
+        case InstrCode::INSTR_SET_FIELD:
+        {
+            Intermediate::field_reference_t field = instr.get_field();
+            chunk->push_opcode(instr.code == InstrCode::INSTR_GET_FIELD ? OpCode::OP_GET_FIELD : OpCode::OP_SET_FIELD);
+            chunk->push_value<const Values::record_shape_t*>(this->shapes.at(field.struct_index));
+            chunk->push_value<Bytecode::field_index_t>(static_cast<Bytecode::field_index_t>(field.field_index));
+        }
+            break;
+
         case InstrCode::INSTR_GOTO:
         case InstrCode::INSTR_POP_JIZ:
         case InstrCode::INSTR_POP_JNZ:
@@ -197,6 +229,28 @@ void Transpiler::transpile_single_block(Intermediate::Function *func) {
     this->jump_arguments.clear();
 };
 void Transpiler::transpile_ir_to_bytecode(Intermediate::LabelIR &ir) {
+    for (uint struct_index = 0; struct_index < ir.struct_count(); struct_index += 1) {
+        this->shapes.push_back(this->runtime.add_shape(ir.get_struct(struct_index)));
+    }
+    for (uint array_index = 0; array_index < ir.constant_array_count(); array_index += 1) {
+        std::vector<Values::Value> *elements = Allocate<std::vector<Values::Value>>::create();
+        for (Instruction element : ir.get_constant_array(array_index)) {
+            Values::Value value = element.payload_to_value();
+            // The pool frees its constants, so give it the element strings too
+            if (Values::get_value_type(value) == Values::ValueType::OBJ) this->runtime.new_constant(value);
+            elements->push_back(value);
+
+            element.free_payload();
+        }
+
+        Values::Object *array = Allocate<Values::Object>::create(elements);
+        array->is_constant = true;
+        this->constant_arrays.push_back(this->runtime.new_constant(Values::Value(array)));
+    }
+    for (uint native_index = 0; native_index < ir.native_count(); native_index += 1) {
+        this->natives.push_back(this->runtime.new_constant(Values::Value(ir.get_native(native_index))));
+    }
+
     this->chunk = runtime.get_main();
     this->transpile_single_block(ir.get_main());
 
@@ -211,9 +265,10 @@ void Transpiler::transpile_ir_to_bytecode(Intermediate::LabelIR &ir) {
         this->transpile_single_block(func);
 
         Bytecode::call_arguments_t num_arguments = static_cast<Bytecode::call_arguments_t>(func->argument_count());
-        Bytecode::variable_index_t total_variables = num_arguments + this->func_variables.back().func->argument_count();
+        Bytecode::variable_index_t total_variables = num_arguments + this->func_variables.back().hash.size();
 
         RuntimeFunction runtime_func = RuntimeFunction(chunk, num_arguments, total_variables, func->get_name());
+        runtime_func.memoized = func->is_memoized();
         this->runtime.add_function(runtime_func);
     }
 }
\ No newline at end of file
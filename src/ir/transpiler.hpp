@@ -36,6 +36,12 @@ class Transpiler {
         var_hash_t variables = var_hash_t();
         /* A map of IR variables to the function variable at every function. */
         std::vector<func_var_info_t> func_variables = std::vector<func_var_info_t>();
+        /* The runtime's copy of each struct in the IR, at the same index */
+        std::vector<const Values::record_shape_t*> shapes = std::vector<const Values::record_shape_t*>();
+        /* Where each of the IR's constant arrays went in the constant pool, at the same index */
+        std::vector<Bytecode::constant_index_t> constant_arrays = std::vector<Bytecode::constant_index_t>();
+        /* Where each of the IR's resolved natives went in the constant pool, at the same index */
+        std::vector<Bytecode::constant_index_t> natives = std::vector<Bytecode::constant_index_t>();
 
         void transpile_variable_instruction(Intermediate::Instruction instr);
         void transpile_ir_instruction(Intermediate::Instruction instr);
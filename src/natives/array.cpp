@@ -1,6 +1,17 @@
 #include "array.hpp"
 #include "natives.hpp"
+#include "number-arrays.hpp"
 #include "../memory.hpp"
+#include "../pdqsort.hpp"
+#include "../vector-math.hpp"
+
+#include "../runtime/runtime.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
 
 using namespace Values;
 
@@ -11,12 +22,12 @@ using namespace Values;
  * @return {Object*} - Pointer if success, nullptr if error message was shown 
  */
 static Object *check_array(const char *process, std::string &error_message, Values::Value &value) {
-    Object *obj = get_value_object(value);
-    if (obj == nullptr || obj->type != ObjectType::ARRAY) {
+    Object *obj = safe_get_value_object(value);
+    if (obj == nullptr || !object_is_array(obj)) {
         error_message = "Cannot ";
         error_message += process;
         error_message += " value ";
-        error_message += object_to_string(obj);
+        error_message += value_to_string(value);
         error_message += " -- it is not an array";
         return nullptr;
     }
@@ -30,7 +41,12 @@ static bool append NATIVE_FUNCTION_HEADERS() {
     Object *obj = check_array("append to", error_message, appendee);
     if (!obj) return false;
 
-    get_value_array(appendee)->push_back(added_type);
+    runtime.make_writable(obj);
+    std::vector<Value> *array = obj->memory.array;
+    // Grow through the runtime, so the GC knows about the new capacity
+    if (array->size() == array->capacity()) runtime.reserve_array(obj, std::max<size_t>(8, array->capacity() * 2));
+    array->push_back(added_type);
+    record_array_element(obj, added_type);
     return true;
 }
 static bool includes NATIVE_FUNCTION_HEADERS() {
@@ -40,35 +56,836 @@ static bool includes NATIVE_FUNCTION_HEADERS() {
     Object *obj = check_array("check include in", error_message, array_value);
     if (!obj) return false;
 
-    std::vector<Value> *array = obj->memory.array;
-    for (Value element : *array) {
-        if (values_are_equal(value, element)) {
+    const Value *elements = array_elements(obj);
+    for (size_t index = 0; index < array_length(obj); index += 1) {
+        if (values_are_equal(value, elements[index])) {
             result = Value(ValueType::TRUE);
             return true;
         }
     }
     result = Value(ValueType::FALSE);
-    return false;
+    return true;
 }
+// length(arr) -- also works on typed arrays
 static bool length NATIVE_FUNCTION_HEADERS() {
     Value array = stack[0];
+    Object *typed = safe_get_value_object(array);
+    if (typed != nullptr && typed->type == ObjectType::TYPED_ARRAY) {
+        result = value_from_number(static_cast<Values::number_t>(typed->memory.typed_array->length));
+        return true;
+    }
+
     Object *obj = check_array("get length of", error_message, array);
     if (!obj) return false;
 
-    result = Values::Value(Values::NUMBER, get_value_array(array)->size());
+    result = value_from_number(static_cast<Values::number_t>(array_length(obj)));
+    return true;
+}
+
+static bool sum NATIVE_FUNCTION_HEADERS() {
+    std::vector<double> storage;
+    const double *numbers;
+    size_t count;
+    if (!Natives::get_numbers("sum", error_message, stack[0], storage, numbers, count)) return false;
+
+    result = value_from_number(VectorMath::sum(numbers, count));
+    return true;
+}
+// min(arr) -- Infinity if arr is empty, NaN if any element is NaN
+static bool min NATIVE_FUNCTION_HEADERS() {
+    std::vector<double> storage;
+    const double *numbers;
+    size_t count;
+    if (!Natives::get_numbers("get minimum of", error_message, stack[0], storage, numbers, count)) return false;
+
+    result = value_from_number(VectorMath::min(numbers, count));
+    return true;
+}
+// max(arr) -- -Infinity if arr is empty, NaN if any element is NaN
+static bool max NATIVE_FUNCTION_HEADERS() {
+    std::vector<double> storage;
+    const double *numbers;
+    size_t count;
+    if (!Natives::get_numbers("get maximum of", error_message, stack[0], storage, numbers, count)) return false;
+
+    result = value_from_number(VectorMath::max(numbers, count));
+    return true;
+}
+// mean(arr) -- NaN if arr is empty
+static bool mean NATIVE_FUNCTION_HEADERS() {
+    std::vector<double> storage;
+    const double *numbers;
+    size_t count;
+    if (!Natives::get_numbers("get mean of", error_message, stack[0], storage, numbers, count)) return false;
+
+    result = value_from_number(VectorMath::sum(numbers, count) / static_cast<double>(count));
+    return true;
+}
+/* variance(arr) -- population variance, NaN if arr is empty.
+    Two passes (the mean, then the squared distances from it) avoid the cancellation
+    of the sum of squares minus the squared sum. */
+static bool variance NATIVE_FUNCTION_HEADERS() {
+    std::vector<double> storage;
+    const double *numbers;
+    size_t count;
+    if (!Natives::get_numbers("get variance of", error_message, stack[0], storage, numbers, count)) return false;
+
+    double average = VectorMath::sum(numbers, count) / static_cast<double>(count);
+    result = value_from_number(VectorMath::sum_squared_deviations(numbers, count, average) / static_cast<double>(count));
+    return true;
+}
+static bool dot NATIVE_FUNCTION_HEADERS() {
+    std::vector<double> left_storage, right_storage;
+    const double *left, *right;
+    size_t left_count, right_count;
+    if (!Natives::get_numbers("take dot product of", error_message, stack[0], left_storage, left, left_count)) return false;
+    if (!Natives::get_numbers("take dot product of", error_message, stack[1], right_storage, right, right_count)) return false;
+
+    if (left_count != right_count) {
+        error_message = "Cannot take dot product of arrays with different lengths (";
+        error_message += std::to_string(left_count);
+        error_message += " and ";
+        error_message += std::to_string(right_count);
+        error_message += ")";
+        return false;
+    }
+
+    result = value_from_number(VectorMath::dot(left, right, left_count));
+    return true;
+}
+
+/* Sorting and searching order numbers with NaN after everything else, so that NaN
+    has a place to go. Otherwise, numbers compare with <, and strings by their bytes. */
+static inline bool number_less(double left, double right) {
+    return !std::isnan(left) && (std::isnan(right) || left < right);
+}
+/* The first 8 bytes as a big-endian integer, padded with 0s, so that comparing
+    two prefixes orders the same way as comparing the bytes */
+static inline uint64_t string_prefix(std::string_view chars) {
+    unsigned char bytes[8] = { 0 };
+    memcpy(bytes, chars.data(), std::min(chars.size(), sizeof(bytes)));
+
+    uint64_t prefix = 0;
+    for (unsigned char byte : bytes) prefix = (prefix << 8) | byte;
+    return prefix;
+}
+/* Most comparisons are decided by the prefix, without following the pointer to the characters */
+struct string_key_t {
+    uint64_t prefix;
+    std::string_view chars;
+    // Position of the element before sorting. Used as a tie break by sortBy.
+    size_t index;
+
+    inline bool operator<(const string_key_t &other) const {
+        if (this->prefix != other.prefix) return this->prefix < other.prefix;
+        return this->chars < other.chars;
+    }
+};
+struct number_key_t {
+    double number;
+    size_t index;
+};
+
+/* NaN can't be compared with <, so it's moved out of the way first */
+static void sort_doubles(double *begin, double *end) {
+    double *numbers_end = std::partition(begin, end, [](double number) { return !std::isnan(number); });
+    Sort::pdqsort_branchless(begin, numbers_end, [](double left, double right) { return left < right; });
+}
+template <typename T>
+static void sort_integers(T *begin, T *end) {
+    Sort::pdqsort_branchless(begin, end, [](T left, T right) { return left < right; });
+}
+
+enum class SortKind {
+    NUMBERS,
+    STRINGS
+};
+/**
+ * Sorting needs every element to be a number, or every element to be a string.
+ * @param {const char*} process - Process to describe in the error message
+ * @param {const char*} element_name - What to call the values in the error message
+ * @param {std::string&} error_message - Error to update
+ * @param {const std::vector<Value>&} values - Values to check
+ * @param {SortKind&} kind - Set to what the values are
+ * @return {bool} - True if okay, false if error message was set
+ */
+static bool get_sort_kind(
+    const char *process, const char *element_name, std::string &error_message,
+    const std::vector<Value> &values, SortKind &kind
+) {
+    kind = SortKind::NUMBERS;
+    if (values.size() > 0 && get_value_type(values[0]) != ValueType::NUMBER) {
+        Object *first = safe_get_value_object(values[0]);
+        if (first != nullptr && object_is_string(first)) kind = SortKind::STRINGS;
+    }
+
+    for (size_t index = 0; index < values.size(); index += 1) {
+        const Value &value = values[index];
+        bool valid;
+        if (kind == SortKind::NUMBERS) valid = get_value_type(value) == ValueType::NUMBER;
+        else {
+            Object *obj = safe_get_value_object(value);
+            valid = obj != nullptr && object_is_string(obj);
+        }
+        if (valid) continue;
+
+        error_message = "Cannot ";
+        error_message += process;
+        error_message += " -- ";
+        error_message += element_name;
+        error_message += " ";
+        error_message += std::to_string(index);
+        error_message += " (";
+        error_message += value_to_string(value);
+        error_message += kind == SortKind::NUMBERS ? ") is not a number" : ") is not a string";
+        // Everything before the culprit was a number, so it didn't have to be one
+        if (index == 0) error_message += " or a string";
+        return false;
+    }
+    return true;
+}
+
+/* sort(arr) -- sorts an array of numbers, an array of strings, or a typed array in place,
+    and returns it. Not stable, but equal numbers and equal strings can't be told apart anyway. */
+static bool sort NATIVE_FUNCTION_HEADERS() {
+    Value array_value = stack[0];
+    Object *obj = safe_get_value_object(array_value);
+
+    if (obj != nullptr && obj->type == ObjectType::TYPED_ARRAY) {
+        // Views are sorted in a copy of their own, like any other write
+        runtime.make_writable(obj);
+        typed_array_t *typed = obj->memory.typed_array;
+        switch (typed->kind) {
+            case TypedArrayKind::FLOAT64_ARRAY: {
+                double *data = static_cast<double*>(typed->data);
+                sort_doubles(data, data + typed->length);
+                break;
+            }
+            case TypedArrayKind::INT32_ARRAY: {
+                int32_t *data = static_cast<int32_t*>(typed->data);
+                sort_integers(data, data + typed->length);
+                break;
+            }
+            case TypedArrayKind::UINT8_ARRAY: {
+                uint8_t *data = static_cast<uint8_t*>(typed->data);
+                sort_integers(data, data + typed->length);
+                break;
+            }
+        }
+        result = array_value;
+        return true;
+    }
+
+    obj = check_array("sort", error_message, array_value);
+    if (!obj) return false;
+    runtime.make_writable(obj);
+    std::vector<Value> *array = obj->memory.array;
+
+    SortKind kind = SortKind::NUMBERS;
+    if (!array_holds_only_numbers(obj) && !get_sort_kind("sort array", "element", error_message, *array, kind)) return false;
+
+    // Sorting raw numbers and prefixes moves much less memory than sorting Values
+    if (kind == SortKind::NUMBERS) {
+        std::vector<double> numbers(array->size());
+        for (size_t index = 0; index < numbers.size(); index += 1) numbers[index] = get_value_number((*array)[index]);
+
+        sort_doubles(numbers.data(), numbers.data() + numbers.size());
+        for (size_t index = 0; index < numbers.size(); index += 1) (*array)[index] = value_from_number(numbers[index]);
+    }
+    else {
+        std::vector<string_key_t> keys(array->size());
+        for (size_t index = 0; index < keys.size(); index += 1) {
+            std::string_view chars = object_to_string_view(get_value_object((*array)[index]));
+            keys[index] = string_key_t{ string_prefix(chars), chars, index };
+        }
+
+        Sort::pdqsort(keys.begin(), keys.end(), std::less<string_key_t>());
+
+        std::vector<Value> sorted(keys.size());
+        for (size_t index = 0; index < keys.size(); index += 1) sorted[index] = (*array)[keys[index].index];
+        array->swap(sorted);
+    }
+
+    result = array_value;
+    return true;
+}
+/* sortBy(arr, key) -- calls key once on each element, then sorts the elements by the results,
+    which must be all numbers or all strings. Stable, so elements with equal keys stay in order. */
+static bool sort_by NATIVE_FUNCTION_HEADERS() {
+    // Calling back into the program can move the stack, so copy the arguments out first
+    Value array_value = stack[0];
+    Value key_func = stack[1];
+
+    Object *obj = check_array("sort", error_message, array_value);
+    if (!obj) return false;
+    runtime.make_writable(obj);
+    std::vector<Value> *array = obj->memory.array;
+    size_t length = array->size();
+
+    // The keys live in an array on the stack, so that the GC keeps them while the key function runs
+    std::vector<Value> *keys = runtime.create<std::vector<Value>>();
+    keys->reserve(length);
+    Object *keys_obj = runtime.create<Object>(keys);
+    runtime.add_object(keys_obj);
+    runtime.push_root(value_from_object(keys_obj));
+
+    for (size_t index = 0; index < length; index += 1) {
+        if (array->size() != length) break;
+
+        Value element = (*array)[index];
+        Value key;
+        if (!runtime.call_function(key_func, &element, 1, key)) {
+            runtime.pop_root();
+            return false;
+        }
+        keys->push_back(key);
+        record_array_element(keys_obj, key);
+    }
+
+    if (array->size() != length) {
+        runtime.pop_root();
+        error_message = "Cannot sort array by key -- its length changed while the keys were computed";
+        return false;
+    }
+
+    SortKind kind = SortKind::NUMBERS;
+    if (!array_holds_only_numbers(keys_obj) && !get_sort_kind("sort array by key", "key", error_message, *keys, kind)) {
+        runtime.pop_root();
+        return false;
+    }
+
+    // Ties are broken by the original position, which makes the sort stable
+    std::vector<size_t> order(length);
+    if (kind == SortKind::NUMBERS) {
+        std::vector<number_key_t> sort_keys(length);
+        for (size_t index = 0; index < length; index += 1) {
+            sort_keys[index] = number_key_t{ get_value_number((*keys)[index]), index };
+        }
+
+        // A stable partition keeps the NaN keys in their original order
+        auto numbers_end = std::stable_partition(sort_keys.begin(), sort_keys.end(),
+            [](const number_key_t &key) { return !std::isnan(key.number); });
+        Sort::pdqsort_branchless(sort_keys.begin(), numbers_end, [](const number_key_t &left, const number_key_t &right) {
+            return left.number < right.number || (left.number == right.number && left.index < right.index);
+        });
+
+        for (size_t index = 0; index < length; index += 1) order[index] = sort_keys[index].index;
+    }
+    else {
+        std::vector<string_key_t> sort_keys(length);
+        for (size_t index = 0; index < length; index += 1) {
+            std::string_view chars = object_to_string_view(get_value_object((*keys)[index]));
+            sort_keys[index] = string_key_t{ string_prefix(chars), chars, index };
+        }
+
+        Sort::pdqsort(sort_keys.begin(), sort_keys.end(), [](const string_key_t &left, const string_key_t &right) {
+            if (left < right) return true;
+            if (right < left) return false;
+            return left.index < right.index;
+        });
+
+        for (size_t index = 0; index < length; index += 1) order[index] = sort_keys[index].index;
+    }
+
+    std::vector<Value> sorted(length);
+    for (size_t index = 0; index < length; index += 1) sorted[index] = (*array)[order[index]];
+    array->swap(sorted);
+
+    runtime.pop_root();
+    result = array_value;
+    return true;
+}
+/* binarySearch(arr, value) -- arr must be sorted the way sort sorts it.
+    Returns the index of an element equal to value, or -(insertion point) - 1 if there is none. */
+static bool binary_search NATIVE_FUNCTION_HEADERS() {
+    Value array_value = stack[0];
+    Value needle = stack[1];
+
+    Object *needle_obj = safe_get_value_object(needle);
+    bool search_strings = needle_obj != nullptr && object_is_string(needle_obj);
+    if (!search_strings && get_value_type(needle) != ValueType::NUMBER) {
+        error_message = "Cannot binary search for value ";
+        error_message += value_to_string(needle);
+        error_message += " -- it is not a number or a string";
+        return false;
+    }
+
+    size_t low = 0, high;
+    Object *obj = safe_get_value_object(array_value);
+    if (obj != nullptr && obj->type == ObjectType::TYPED_ARRAY) {
+        typed_array_t *typed = obj->memory.typed_array;
+        if (search_strings) {
+            error_message = "Cannot binary search typed array for string ";
+            error_message += value_to_string(needle);
+            return false;
+        }
+
+        double number = get_value_number(needle);
+        high = typed->length;
+        while (low < high) {
+            size_t middle = low + (high - low) / 2;
+            if (number_less(typed->get(middle), number)) low = middle + 1;
+            else high = middle;
+        }
+
+        bool found = low < typed->length && !number_less(number, typed->get(low));
+        result = value_from_number(found ? static_cast<double>(low) : -static_cast<double>(low) - 1);
+        return true;
+    }
+
+    obj = check_array("binary search", error_message, array_value);
+    if (!obj) return false;
+    const Value *elements = array_elements(obj);
+    size_t length = array_length(obj);
+
+    /* Only the elements that get looked at are checked, so that the search stays O(log n) */
+    auto check_element = [&](size_t index) {
+        const Value &element = elements[index];
+        Object *element_obj = safe_get_value_object(element);
+        bool valid = search_strings ?
+            element_obj != nullptr && object_is_string(element_obj) :
+            get_value_type(element) == ValueType::NUMBER;
+        if (valid) return true;
+
+        error_message = "Cannot binary search array -- element ";
+        error_message += std::to_string(index);
+        error_message += " (";
+        error_message += value_to_string(element);
+        error_message += search_strings ? ") is not a string" : ") is not a number";
+        return false;
+    };
+    // Negative if the element comes before the needle, 0 if they're equal
+    auto compare = [&](size_t index) {
+        const Value &element = elements[index];
+        if (search_strings) {
+            return object_to_string_view(get_value_object(element)).compare(object_to_string_view(needle_obj));
+        }
+
+        double number = get_value_number(element), needle_number = get_value_number(needle);
+        if (number_less(number, needle_number)) return -1;
+        return number_less(needle_number, number) ? 1 : 0;
+    };
+
+    high = length;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (!check_element(middle)) return false;
+        if (compare(middle) < 0) low = middle + 1;
+        else high = middle;
+    }
+
+    bool found = false;
+    if (low < length) {
+        if (!check_element(low)) return false;
+        found = compare(low) == 0;
+    }
+    result = value_from_number(found ? static_cast<double>(low) : -static_cast<double>(low) - 1);
+    return true;
+}
+
+/**
+ * Reads a position argument and clamps it to [0, length]. Negative positions count back from the end.
+ * @return {bool} - False if the position was not an integer
+ */
+static bool check_position(const char *process, std::string &error_message, const Value &value, size_t length, size_t &position) {
+    if (get_value_type(value) != ValueType::NUMBER || get_value_number(value) != floor(get_value_number(value))) {
+        error_message = "Cannot ";
+        error_message += process;
+        error_message += " with non-integer position ";
+        error_message += value_to_string(value);
+        return false;
+    }
+
+    Values::number_t number = get_value_number(value);
+    if (number < 0) number += static_cast<Values::number_t>(length);
+
+    if (number < 0) position = 0;
+    else if (number > static_cast<Values::number_t>(length)) position = length;
+    else position = static_cast<size_t>(number);
+    return true;
+}
+/* slice(arr, start, end) -- a view of [start, end) that shares the elements instead of copying them.
+    Works on arrays, slices and typed arrays. */
+static bool slice NATIVE_FUNCTION_HEADERS() {
+    Value array_value = stack[0];
+    Object *obj = safe_get_value_object(array_value);
+    bool typed = obj != nullptr && obj->type == ObjectType::TYPED_ARRAY;
+    if (!typed) {
+        obj = check_array("slice", error_message, array_value);
+        if (!obj) return false;
+    }
+
+    size_t length = typed ? obj->memory.typed_array->length : array_length(obj);
+    size_t start, end;
+    if (!check_position("slice array", error_message, stack[1], length, start)) return false;
+    if (!check_position("slice array", error_message, stack[2], length, end)) return false;
+    if (end < start) end = start;
+
+    Object *view_obj;
+    if (typed) {
+        typed_array_t *source = obj->memory.typed_array;
+        // Never chain views. Point at the array that owns the buffer instead.
+        Object *owner = source->is_view() ? source->owner : obj;
+        void *data = static_cast<char*>(source->data) + start * source->element_size();
+
+        typed_array_t *view = runtime.create<typed_array_t>(source->kind, data, end - start, owner);
+        view_obj = runtime.create<Object>(view);
+    }
+    else {
+        // A view of a constant literal wouldn't see writes to it, since those copy the literal first
+        if (obj->type == ObjectType::ARRAY_SLICE && obj->memory.array_slice->parent->is_constant) {
+            runtime.make_writable(obj);
+        }
+
+        Object *parent = obj;
+        if (obj->type == ObjectType::ARRAY_SLICE) {
+            parent = obj->memory.array_slice->parent;
+            start += obj->memory.array_slice->offset;
+            end += obj->memory.array_slice->offset;
+        }
+
+        array_slice_t *view = runtime.create<array_slice_t>(array_slice_t{
+            .parent = parent,
+            .offset = start,
+            .length = end - start
+        });
+        view_obj = runtime.create<Object>(view);
+    }
+
+    runtime.add_object(view_obj);
+    result = value_from_object(view_obj);
+    return true;
+}
+/* copy(arr) -- a shallow copy that owns its elements. Copying a slice lets the GC collect its parent. */
+static bool copy NATIVE_FUNCTION_HEADERS() {
+    Value array_value = stack[0];
+    Object *obj = safe_get_value_object(array_value);
+
+    Object *copy_obj;
+    if (obj != nullptr && obj->type == ObjectType::TYPED_ARRAY) {
+        typed_array_t *source = obj->memory.typed_array;
+        typed_array_t *copied = runtime.create<typed_array_t>(source->kind, source->length);
+        memcpy(copied->data, source->data, source->length * source->element_size());
+        copy_obj = runtime.create<Object>(copied);
+    }
+    else {
+        obj = check_array("copy", error_message, array_value);
+        if (!obj) return false;
+
+        const Value *elements = array_elements(obj);
+        std::vector<Value> *copied = runtime.create<std::vector<Value>>(elements, elements + array_length(obj));
+        copy_obj = runtime.create<Object>(copied);
+    }
+
+    runtime.add_object(copy_obj);
+    result = value_from_object(copy_obj);
+    return true;
+}
+
+static bool is_typed_array(const Value &value) {
+    Object *obj = safe_get_value_object(value);
+    return obj != nullptr && obj->type == ObjectType::TYPED_ARRAY;
+}
+/* add(a, b, destination?) -- elementwise sum. A Float64Array if a or b is a typed array,
+    otherwise an array, unless a destination of the same length is given to write into. */
+static bool add NATIVE_FUNCTION_HEADERS() {
+    if (!Natives::check_argument_count("Array.add", error_message, stack_size, 2, 3)) return false;
+
+    std::vector<double> left_storage, right_storage;
+    const double *left, *right;
+    size_t left_count, right_count;
+    if (!Natives::get_numbers("add", error_message, stack[0], left_storage, left, left_count)) return false;
+    if (!Natives::get_numbers("add", error_message, stack[1], right_storage, right, right_count)) return false;
+
+    if (left_count != right_count) {
+        error_message = "Cannot add arrays with different lengths (";
+        error_message += std::to_string(left_count);
+        error_message += " and ";
+        error_message += std::to_string(right_count);
+        error_message += ")";
+        return false;
+    }
+
+    Natives::number_output_t output;
+    const Value *destination = stack_size == 3 ? &stack[2] : nullptr;
+    bool typed = is_typed_array(stack[0]) || is_typed_array(stack[1]);
+    if (!Natives::start_number_output("Array.add", error_message, runtime, destination, typed, left_count, { left, right }, output)) {
+        return false;
+    }
+
+    VectorMath::add(left, right, output.numbers, left_count);
+    Natives::finish_number_output(runtime, output, left_count);
+    result = output.result;
+    return true;
+}
+// scale(arr, factor, destination?) -- every element times factor, returned like add
+static bool scale NATIVE_FUNCTION_HEADERS() {
+    if (!Natives::check_argument_count("Array.scale", error_message, stack_size, 2, 3)) return false;
+
+    std::vector<double> storage;
+    const double *numbers;
+    size_t count;
+    if (!Natives::get_numbers("scale", error_message, stack[0], storage, numbers, count)) return false;
+    if (get_value_type(stack[1]) != ValueType::NUMBER) {
+        error_message = "Cannot scale array by non-number value ";
+        error_message += value_to_string(stack[1]);
+        return false;
+    }
+
+    Natives::number_output_t output;
+    const Value *destination = stack_size == 3 ? &stack[2] : nullptr;
+    if (!Natives::start_number_output("Array.scale", error_message, runtime, destination, is_typed_array(stack[0]), count, { numbers }, output)) {
+        return false;
+    }
+
+    VectorMath::scale(numbers, get_value_number(stack[1]), output.numbers, count);
+    Natives::finish_number_output(runtime, output, count);
+    result = output.result;
+    return true;
+}
+/* The kind of an array holding the elements of arrays of both kinds */
+static ArrayElementKind combine_element_kinds(ArrayElementKind left, ArrayElementKind right) {
+    if (left == ArrayElementKind::NO_ELEMENTS) return right;
+    if (right == ArrayElementKind::NO_ELEMENTS || left == right) return left;
+    return ArrayElementKind::MIXED_ELEMENTS;
+}
+/* Slices don't keep a kind of their own, so go by the parent's */
+static ArrayElementKind get_element_kind(const Object *obj) {
+    if (obj->type == ObjectType::ARRAY_SLICE) return obj->memory.array_slice->parent->element_kind;
+    return obj->element_kind;
+}
+/**
+ * Reads a number of elements for the natives that allocate ahead of time.
+ * @return {bool} - False if the count was not a non-negative integer that fits in memory
+ */
+static bool check_count(const char *process, std::string &error_message, const Value &value, size_t &count) {
+    if (
+        get_value_type(value) != ValueType::NUMBER ||
+        get_value_number(value) < 0 ||
+        get_value_number(value) != floor(get_value_number(value)) ||
+        get_value_number(value) > static_cast<Values::number_t>(std::vector<Value>().max_size())
+    ) {
+        error_message = "Cannot ";
+        error_message += process;
+        error_message += " with length ";
+        error_message += value_to_string(value);
+        error_message += " -- it must be a non-negative integer no larger than the memory allows";
+        return false;
+    }
+
+    count = static_cast<size_t>(get_value_number(value));
+    return true;
+}
+
+// create(length, fill) -- an array with every element set to fill
+static bool create NATIVE_FUNCTION_HEADERS() {
+    size_t count;
+    if (!check_count("create array", error_message, stack[0], count)) return false;
+
+    std::vector<Value> *array = runtime.create<std::vector<Value>>(count, stack[1]);
+    Object *obj = runtime.create<Object>(array);
+    runtime.add_object(obj);
+    result = value_from_object(obj);
+    return true;
+}
+// reserve(arr, capacity) -- make room for capacity elements, so appending up to it never copies. Returns arr.
+static bool reserve NATIVE_FUNCTION_HEADERS() {
+    Value array_value = stack[0];
+    Object *obj = check_array("reserve space in", error_message, array_value);
+    if (!obj) return false;
+
+    size_t capacity;
+    if (!check_count("reserve space in array", error_message, stack[1], capacity)) return false;
+
+    runtime.make_writable(obj);
+    runtime.reserve_array(obj, capacity);
+    result = array_value;
+    return true;
+}
+// fill(arr, value) -- set every element to value, and return arr. Also works on typed arrays.
+static bool fill NATIVE_FUNCTION_HEADERS() {
+    Value array_value = stack[0];
+    Value value = stack[1];
+    Object *obj = safe_get_value_object(array_value);
+
+    if (obj != nullptr && obj->type == ObjectType::TYPED_ARRAY) {
+        if (get_value_type(value) != ValueType::NUMBER) {
+            error_message = "Typed arrays can only hold numbers, but was given ";
+            error_message += value_to_string(value);
+            return false;
+        }
+
+        runtime.make_writable(obj);
+        typed_array_t *typed = obj->memory.typed_array;
+        if (typed->length == 0) {
+            result = array_value;
+            return true;
+        }
+
+        // Convert the number once, then copy its bytes into every element
+        typed->set(0, get_value_number(value));
+        size_t element_size = typed->element_size();
+        char *data = static_cast<char*>(typed->data);
+        for (size_t index = 1; index < typed->length; index += 1) {
+            memcpy(data + index * element_size, data, element_size);
+        }
+
+        result = array_value;
+        return true;
+    }
+
+    obj = check_array("fill", error_message, array_value);
+    if (!obj) return false;
+
+    runtime.make_writable(obj);
+    std::vector<Value> *array = obj->memory.array;
+    std::fill(array->begin(), array->end(), value);
+    // Every element is the same now, so the kind can be exact again
+    if (array->size() > 0) obj->element_kind = array_element_kind_with(ArrayElementKind::NO_ELEMENTS, value);
+
+    result = array_value;
+    return true;
+}
+// concat(a, b) -- a new array with the elements of a, then b. Typed arrays of the same kind give a typed array.
+static bool concat NATIVE_FUNCTION_HEADERS() {
+    Value left_value = stack[0];
+    Value right_value = stack[1];
+    Object *left = safe_get_value_object(left_value);
+    Object *right = safe_get_value_object(right_value);
+
+    if (
+        left != nullptr && right != nullptr &&
+        left->type == ObjectType::TYPED_ARRAY && right->type == ObjectType::TYPED_ARRAY
+    ) {
+        typed_array_t *left_typed = left->memory.typed_array;
+        typed_array_t *right_typed = right->memory.typed_array;
+        if (left_typed->kind != right_typed->kind) {
+            error_message = "Cannot concatenate ";
+            error_message += typed_array_kind_to_string(left_typed->kind);
+            error_message += " and ";
+            error_message += typed_array_kind_to_string(right_typed->kind);
+            return false;
+        }
+
+        typed_array_t *joined = runtime.create<typed_array_t>(left_typed->kind, left_typed->length + right_typed->length);
+        size_t left_bytes = left_typed->length * left_typed->element_size();
+        memcpy(joined->data, left_typed->data, left_bytes);
+        memcpy(static_cast<char*>(joined->data) + left_bytes, right_typed->data, right_typed->length * right_typed->element_size());
+
+        Object *joined_obj = runtime.create<Object>(joined);
+        runtime.add_object(joined_obj);
+        result = value_from_object(joined_obj);
+        return true;
+    }
+
+    left = check_array("concatenate", error_message, left_value);
+    if (!left) return false;
+    right = check_array("concatenate", error_message, right_value);
+    if (!right) return false;
+
+    size_t left_length = array_length(left), right_length = array_length(right);
+    std::vector<Value> *joined = runtime.create<std::vector<Value>>();
+    Object *joined_obj = runtime.create<Object>(joined);
+    runtime.add_object(joined_obj);
+    runtime.reserve_array(joined_obj, left_length + right_length);
+
+    joined->insert(joined->end(), array_elements(left), array_elements(left) + left_length);
+    joined->insert(joined->end(), array_elements(right), array_elements(right) + right_length);
+    joined_obj->element_kind = combine_element_kinds(get_element_kind(left), get_element_kind(right));
+
+    result = value_from_object(joined_obj);
+    return true;
+}
+// extend(arr, other) -- append the elements of other to arr, growing it at most once. Returns arr.
+static bool extend NATIVE_FUNCTION_HEADERS() {
+    Value array_value = stack[0];
+    Value other_value = stack[1];
+
+    Object *obj = check_array("extend", error_message, array_value);
+    if (!obj) return false;
+    Object *other = check_array("extend array with", error_message, other_value);
+    if (!other) return false;
+
+    runtime.make_writable(obj);
+    std::vector<Value> *array = obj->memory.array;
+    size_t other_length = array_length(other);
+    ArrayElementKind other_kind = get_element_kind(other);
+    runtime.reserve_array(obj, array->size() + other_length);
+
+    /* Only look the elements up after reserving, since other may be arr or a slice of it.
+        Nothing moves while appending into the reserved space. */
+    const Value *elements = array_elements(other);
+    for (size_t index = 0; index < other_length; index += 1) array->push_back(elements[index]);
+    obj->element_kind = combine_element_kinds(obj->element_kind, other_kind);
+
+    result = array_value;
     return true;
 }
 
 Value Natives::create_array_namespace() {
     std::unordered_map<std::string, Value> *Array = new std::unordered_map<std::string, Value>({
             { "append", Values::Value(
-                Values::native_method_t{ .func = append, .number_arguments = 2 }
+                Values::native_method_t{ .func = append, .number_arguments = 2, .flags = NATIVE_MAY_FAIL }
+            ) },
+            { "binarySearch", Values::Value(
+                Values::native_method_t{ .func = binary_search, .number_arguments = 2, .flags = NATIVE_MAY_FAIL | NATIVE_RETURNS_NUMBER }
+            ) },
+            { "concat", Values::Value(
+                Values::native_method_t{ .func = concat, .number_arguments = 2, .flags = NATIVE_ALLOCATES | NATIVE_MAY_FAIL }
+            ) },
+            { "copy", Values::Value(
+                Values::native_method_t{ .func = copy, .number_arguments = 1, .flags = NATIVE_ALLOCATES | NATIVE_MAY_FAIL }
+            ) },
+            { "create", Values::Value(
+                Values::native_method_t{ .func = create, .number_arguments = 2, .flags = NATIVE_ALLOCATES | NATIVE_MAY_FAIL }
+            ) },
+            { "dot", Values::Value(
+                Values::native_method_t{ .func = dot, .number_arguments = 2, .flags = NATIVE_MAY_FAIL | NATIVE_RETURNS_NUMBER }
+            ) },
+            { "add", Values::Value(
+                Values::native_method_t{ .func = add, .number_arguments = VARIADIC_ARGUMENTS, .flags = NATIVE_ALLOCATES | NATIVE_MAY_FAIL }
+            ) },
+            { "scale", Values::Value(
+                Values::native_method_t{ .func = scale, .number_arguments = VARIADIC_ARGUMENTS, .flags = NATIVE_ALLOCATES | NATIVE_MAY_FAIL }
+            ) },
+            { "extend", Values::Value(
+                Values::native_method_t{ .func = extend, .number_arguments = 2, .flags = NATIVE_MAY_FAIL }
+            ) },
+            { "fill", Values::Value(
+                Values::native_method_t{ .func = fill, .number_arguments = 2, .flags = NATIVE_MAY_FAIL }
             ) },
             { "includes", Values::Value(
-                Values::native_method_t{ .func = includes, .number_arguments = 2 }
+                Values::native_method_t{ .func = includes, .number_arguments = 2, .flags = NATIVE_MAY_FAIL }
             ) },
             { "length", Values::Value(
-                Values::native_method_t{ .func = length, .number_arguments = 1 }
+                Values::native_method_t{ .func = length, .number_arguments = 1, .flags = NATIVE_MAY_FAIL | NATIVE_RETURNS_NUMBER }
+            ) },
+            { "max", Values::Value(
+                Values::native_method_t{ .func = max, .number_arguments = 1, .flags = NATIVE_MAY_FAIL | NATIVE_RETURNS_NUMBER }
+            ) },
+            { "mean", Values::Value(
+                Values::native_method_t{ .func = mean, .number_arguments = 1, .flags = NATIVE_MAY_FAIL | NATIVE_RETURNS_NUMBER }
+            ) },
+            { "min", Values::Value(
+                Values::native_method_t{ .func = min, .number_arguments = 1, .flags = NATIVE_MAY_FAIL | NATIVE_RETURNS_NUMBER }
+            ) },
+            { "reserve", Values::Value(
+                Values::native_method_t{ .func = reserve, .number_arguments = 2, .flags = NATIVE_MAY_FAIL }
+            ) },
+            { "slice", Values::Value(
+                Values::native_method_t{ .func = slice, .number_arguments = 3, .flags = NATIVE_ALLOCATES | NATIVE_MAY_FAIL }
+            ) },
+            { "sort", Values::Value(
+                Values::native_method_t{ .func = sort, .number_arguments = 1, .flags = NATIVE_MAY_FAIL }
+            ) },
+            { "sortBy", Values::Value(
+                Values::native_method_t{ .func = sort_by, .number_arguments = 2, .flags = NATIVE_ALLOCATES | NATIVE_MAY_FAIL }
+            ) },
+            { "sum", Values::Value(
+                Values::native_method_t{ .func = sum, .number_arguments = 1, .flags = NATIVE_MAY_FAIL | NATIVE_RETURNS_NUMBER }
+            ) },
+            { "variance", Values::Value(
+                Values::native_method_t{ .func = variance, .number_arguments = 1, .flags = NATIVE_MAY_FAIL | NATIVE_RETURNS_NUMBER }
             ) }
         });
     Object *array_obj = Allocate<Object>::create(Array);
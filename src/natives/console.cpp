@@ -1,22 +1,273 @@
 #include "console.hpp"
 #include "natives.hpp"
 #include "../memory.hpp"
+#include "../utf8.hpp"
+
+#include <cstring>
+#include <iostream>
+#include <math.h>
+#include <unistd.h>
 
 using namespace Values;
 
+/* Output is collected here instead of going straight to std::cout, so printing
+    a line doesn't cost a write. It's written out once it passes the limit, on
+    Console.flush(), when the program exits, or after every call if stdout is
+    a terminal, where someone is waiting for each line. */
+class ConsoleBuffer {
+    public:
+        static const size_t FLUSH_SIZE = 1 << 16;
+
+        std::string output;
+        const bool interactive;
+
+        ConsoleBuffer() : interactive(isatty(STDOUT_FILENO)) {
+            this->output.reserve(FLUSH_SIZE);
+        }
+        // Flush whatever is left if the runtime never reached the exit instruction
+        ~ConsoleBuffer() { this->flush(); }
+
+        void flush() {
+            if (this->output.size() == 0) return;
+            std::cout.write(this->output.data(), this->output.size());
+            std::cout.flush();
+            this->output.clear();
+        }
+        // Call after every write
+        inline void written() {
+            if (this->interactive || this->output.size() >= FLUSH_SIZE) this->flush();
+        }
+};
+static ConsoleBuffer console;
+
+void Natives::flush_console() {
+    console.flush();
+}
+
 static bool print NATIVE_FUNCTION_HEADERS() {
-    std::cout << Values::value_to_string(stack[0]);
+    append_value_to_string(console.output, stack[0]);
+    console.written();
 
     return true;
 }
 static bool println NATIVE_FUNCTION_HEADERS() {
-    std::cout << Values::value_to_string(stack[0]) << std::endl;
+    append_value_to_string(console.output, stack[0]);
+    console.output += '\n';
+    console.written();
+
+    return true;
+}
+static bool flush NATIVE_FUNCTION_HEADERS() {
+    console.flush();
+
+    return true;
+}
+
+/* The width and precision of a conversion like %-8.3s, which only holds flags and digits */
+struct conversion_size_t {
+    size_t width = 0;
+    bool has_precision = false;
+    size_t precision = 0;
+};
+static conversion_size_t get_conversion_size(std::string_view spec) {
+    conversion_size_t size;
+    size_t digit = spec.find_first_not_of("%-+ #0");
+    for (; digit < spec.size() && isdigit(spec[digit]); digit += 1) {
+        size.width = size.width * 10 + (spec[digit] - '0');
+    }
+    if (digit < spec.size() && spec[digit] == '.') {
+        size.has_precision = true;
+        for (digit += 1; digit < spec.size() && isdigit(spec[digit]); digit += 1) {
+            size.precision = size.precision * 10 + (spec[digit] - '0');
+        }
+    }
+    return size;
+}
+/**
+ * Pad a formatted string argument to the width of its conversion, in characters
+ * @param {size_t} start - Where the argument begins in the output
+ */
+static void pad_argument(std::string &output, size_t start, size_t width, bool left_align) {
+    size_t length = Utf8::count_code_points(std::string_view(output).substr(start));
+    if (length >= width) return;
+
+    if (left_align) output.append(width - length, ' ');
+    else output.insert(start, width - length, ' ');
+}
+/**
+ * Append a number formatted by snprintf, however long it comes out.
+ * Returns false if snprintf can't format it.
+ */
+template <typename number_type>
+static bool append_formatted(std::string &output, const char *c_format, number_type number) {
+    char buffer[512];
+    int length = snprintf(buffer, sizeof(buffer), c_format, number);
+    if (length < 0) return false;
+    if (static_cast<size_t>(length) < sizeof(buffer)) {
+        output.append(buffer, length);
+        return true;
+    }
+
+    // Too long for the buffer, so format it again straight into the output
+    size_t start = output.size();
+    output.resize(start + length + 1);
+    snprintf(output.data() + start, length + 1, c_format, number);
+    output.resize(start + length);
+    return true;
+}
+/* printf(format, ...) -- %s formats any value, %d an integer, %f, %e, %g and %x a number.
+    Flags, width and precision work like they do in C, and %% is a percent sign. The precision
+    of %s is the most characters it prints. NaN and infinities print like %s prints them, and
+    integers too big for %d and %x print like %.0f. */
+// Named with an underscore so it doesn't clash with the C library printf
+static bool printf_ NATIVE_FUNCTION_HEADERS() {
+    if (stack_size == 0) {
+        error_message = "Console.printf expects a format string";
+        return false;
+    }
+    Object *format_obj = safe_get_value_object(stack[0]);
+    if (format_obj == nullptr || !object_is_string(format_obj)) {
+        error_message = "Console.printf expects a format string, but was given ";
+        error_message += value_to_string(stack[0]);
+        return false;
+    }
+
+    std::string_view format = object_to_string_view(format_obj);
+    // Format into the buffer, but take it back out if the format turns out to be bad
+    size_t output_start = console.output.size();
+    uint argument = 1;
+
+    size_t index = 0;
+    while (index < format.size()) {
+        size_t percent = format.find('%', index);
+        if (percent == std::string_view::npos) {
+            console.output.append(format.substr(index));
+            break;
+        }
+        console.output.append(format.substr(index, percent - index));
+
+        // Find the end of the flags, width and precision
+        size_t conversion = percent + 1;
+        while (conversion < format.size() && strchr("-+ #0123456789.", format[conversion]) != nullptr) {
+            conversion += 1;
+        }
+        if (conversion >= format.size()) {
+            error_message = "Console.printf format ends in the middle of a conversion";
+            console.output.resize(output_start);
+            return false;
+        }
+
+        char type = format[conversion];
+        std::string_view spec = format.substr(percent, conversion - percent + 1);
+        index = conversion + 1;
+
+        if (type == '%') {
+            console.output += '%';
+            continue;
+        }
+        if (strchr("sdfegx", type) == nullptr) {
+            error_message = "Unknown Console.printf conversion ";
+            error_message += spec;
+            console.output.resize(output_start);
+            return false;
+        }
+        if (argument >= stack_size) {
+            error_message = "Not enough arguments for Console.printf format ";
+            error_message += format;
+            console.output.resize(output_start);
+            return false;
+        }
 
+        const Value &value = stack[argument];
+        argument += 1;
+
+        conversion_size_t size = get_conversion_size(spec);
+        bool left_align = spec.find('-') != std::string_view::npos;
+        if (type == 's') {
+            size_t argument_start = console.output.size();
+            append_value_to_string(console.output, value);
+
+            // Cut after the last character that fits
+            if (size.has_precision) {
+                size_t end = argument_start;
+                for (size_t characters = 0; end < console.output.size() && characters < size.precision; characters += 1) {
+                    end += 1;
+                    while (end < console.output.size() && Utf8::is_continuation_byte(console.output[end])) end += 1;
+                }
+                console.output.resize(end);
+            }
+            pad_argument(console.output, argument_start, size.width, left_align);
+            continue;
+        }
+
+        if (get_value_type(value) != ValueType::NUMBER) {
+            error_message = "Console.printf conversion ";
+            error_message += spec;
+            error_message += " expects a number, but was given ";
+            error_message += value_to_string(value);
+            console.output.resize(output_start);
+            return false;
+        }
+
+        Values::number_t number = get_value_number(value);
+        if (!std::isfinite(number)) {
+            size_t argument_start = console.output.size();
+            append_value_to_string(console.output, value);
+            pad_argument(console.output, argument_start, size.width, left_align);
+            continue;
+        }
+
+        // Hand numeric conversions to snprintf. Integers are passed as long long, if they fit.
+        char c_format[32];
+        bool formatted;
+        if (spec.size() + 3 >= sizeof(c_format)) {
+            error_message = "Console.printf conversion is too long";
+            console.output.resize(output_start);
+            return false;
+        }
+        bool fits_integer = number >= -9223372036854775808.0 && number < 9223372036854775808.0;
+        if ((type == 'd' || type == 'x') && !fits_integer) {
+            // Keep the flags and width, but not the precision, which means digits for integers
+            size_t flags_and_width = std::min(spec.find('.'), spec.size() - 1);
+            memcpy(c_format, spec.data(), flags_and_width);
+            memcpy(c_format + flags_and_width, ".0f", 4);
+            formatted = append_formatted(console.output, c_format, number);
+        }
+        else if (type == 'd' || type == 'x') {
+            memcpy(c_format, spec.data(), spec.size() - 1);
+            c_format[spec.size() - 1] = 'l';
+            c_format[spec.size()] = 'l';
+            c_format[spec.size() + 1] = type;
+            c_format[spec.size() + 2] = '\0';
+            formatted = append_formatted(console.output, c_format, static_cast<long long>(trunc(number)));
+        }
+        else {
+            memcpy(c_format, spec.data(), spec.size());
+            c_format[spec.size()] = '\0';
+            formatted = append_formatted(console.output, c_format, number);
+        }
+        if (!formatted) {
+            error_message = "Console.printf conversion ";
+            error_message += spec;
+            error_message += " is too wide";
+            console.output.resize(output_start);
+            return false;
+        }
+    }
+
+    if (argument < stack_size) {
+        error_message = "Too many arguments for Console.printf format ";
+        error_message += format;
+        console.output.resize(output_start);
+        return false;
+    }
+
+    console.written();
     return true;
 }
 
 Values::Value create_string_value(const char *str) {
-    std::string *str_val = Allocate<std::string>::create(str);
+    string_t *str_val = Allocate<string_t>::create(std::string_view(str));
     Object *obj = Allocate<Object>::create(str_val);
     return value_from_object(obj);
 }
@@ -48,10 +299,16 @@ Value Natives::create_console_namespace() {
 
     std::unordered_map<std::string, Value> *Console = new std::unordered_map<std::string, Value>({
         { "print", Values::Value(
-            Values::native_method_t{ .func = print, .number_arguments = 1 }
+            Values::native_method_t{ .func = print, .number_arguments = 1, .flags = 0 }
         ) },
         { "println", Values::Value(
-            Values::native_method_t{ .func = println, .number_arguments = 1 }
+            Values::native_method_t{ .func = println, .number_arguments = 1, .flags = 0 }
+        ) },
+        { "printf", Values::Value(
+            Values::native_method_t{ .func = printf_, .number_arguments = VARIADIC_ARGUMENTS, .flags = NATIVE_MAY_FAIL }
+        ) },
+        { "flush", Values::Value(
+            Values::native_method_t{ .func = flush, .number_arguments = 0, .flags = 0 }
         ) },
 
         { "fg", value_from_object(fg_obj) },
@@ -5,6 +5,8 @@
 
 namespace Natives {
     Values::Value create_console_namespace();
+    /* Write out everything buffered by Console.print, println and printf */
+    void flush_console();
 };
 
 #endif
\ No newline at end of file
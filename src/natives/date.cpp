@@ -8,7 +8,7 @@
 using namespace Values;
 
 bool timezoneName NATIVE_FUNCTION_HEADERS() {
-    std::string *name_container = runtime.create<std::string>(get_timezone_name());
+    string_t *name_container = runtime.create<string_t>(get_timezone_name());
     Object *obj = runtime.create<Object>(name_container);
     runtime.add_object(obj);
     result = value_from_object(obj);
@@ -18,7 +18,7 @@ bool timezoneName NATIVE_FUNCTION_HEADERS() {
 Value Natives::create_date_namespace() {
     std::unordered_map<std::string, Value> *Date = new std::unordered_map<std::string, Value>({
         { "timezoneName", Values::Value(
-            Values::native_method_t{ .func = timezoneName, .number_arguments = 0 }
+            Values::native_method_t{ .func = timezoneName, .number_arguments = 0, .flags = NATIVE_ALLOCATES }
         ) }
     });
     Object *array_obj = Allocate<Object>::create(Date);
@@ -0,0 +1,139 @@
+#include "map.hpp"
+#include "natives.hpp"
+#include "../memory.hpp"
+#include "../value-table.hpp"
+
+#include "../runtime/runtime.hpp"
+
+using namespace Values;
+
+/**
+ * @param {const char*} process - Process to describe in the error message
+ * @param {std::string&} error_message - Error to update
+ * @param {const Values::Value&} value - Value to check for being a map
+ * @return {value_table_t*} - The map's table if success, nullptr if error message was shown
+ */
+static value_table_t *check_map(const char *process, std::string &error_message, const Value &value) {
+    Object *obj = safe_get_value_object(value);
+    if (obj == nullptr || obj->type != ObjectType::MAP) {
+        error_message = "Cannot ";
+        error_message += process;
+        error_message += " value ";
+        error_message += value_to_string(value);
+        error_message += " -- it is not a map";
+        return nullptr;
+    }
+    return obj->memory.table;
+}
+
+static bool create NATIVE_FUNCTION_HEADERS() {
+    value_table_t *table = runtime.create<value_table_t>();
+    Object *obj = runtime.create<Object>(table, ObjectType::MAP);
+    runtime.add_object(obj);
+    result = value_from_object(obj);
+    return true;
+}
+// get(map, key) -- null if the key is not in the map
+static bool get NATIVE_FUNCTION_HEADERS() {
+    value_table_t *table = check_map("get from", error_message, stack[0]);
+    if (!table) return false;
+
+    Value *found = table->find(stack[1]);
+    result = found == nullptr ? Value(ValueType::NULL_VALUE) : *found;
+    return true;
+}
+// set(map, key, value) -- returns the map
+static bool set NATIVE_FUNCTION_HEADERS() {
+    value_table_t *table = check_map("set key in", error_message, stack[0]);
+    if (!table) return false;
+
+    table->insert(stack[1], stack[2]);
+    result = stack[0];
+    return true;
+}
+static bool has NATIVE_FUNCTION_HEADERS() {
+    value_table_t *table = check_map("check key in", error_message, stack[0]);
+    if (!table) return false;
+
+    result = Value(table->find(stack[1]) != nullptr ? ValueType::TRUE : ValueType::FALSE);
+    return true;
+}
+// delete(map, key) -- false if the key was not in the map
+static bool delete_ NATIVE_FUNCTION_HEADERS() {
+    value_table_t *table = check_map("delete key from", error_message, stack[0]);
+    if (!table) return false;
+
+    result = Value(table->erase(stack[1]) ? ValueType::TRUE : ValueType::FALSE);
+    return true;
+}
+static bool size NATIVE_FUNCTION_HEADERS() {
+    value_table_t *table = check_map("get size of", error_message, stack[0]);
+    if (!table) return false;
+
+    result = value_from_number(static_cast<number_t>(table->size()));
+    return true;
+}
+/**
+ * @param {Runtime&} runtime
+ * @param {value_table_t*} table - Map to read
+ * @param {bool} keys - Whether to collect the keys or the values
+ * @return {Value} - New array of the keys or values
+ */
+static Value collect_entries(Runtime &runtime, value_table_t *table, bool keys) {
+    std::vector<Value> *array = runtime.create<std::vector<Value>>();
+    array->reserve(table->size());
+    table->for_each([array, keys](const value_table_t::entry_t &entry) {
+        array->push_back(keys ? entry.key : entry.value);
+    });
+
+    Object *obj = runtime.create<Object>(array);
+    runtime.add_object(obj);
+    return value_from_object(obj);
+}
+// keys(map) -- array of the keys, in no particular order
+static bool keys NATIVE_FUNCTION_HEADERS() {
+    value_table_t *table = check_map("get keys of", error_message, stack[0]);
+    if (!table) return false;
+
+    result = collect_entries(runtime, table, true);
+    return true;
+}
+// values(map) -- array of the values, in the same order as keys
+static bool values NATIVE_FUNCTION_HEADERS() {
+    value_table_t *table = check_map("get values of", error_message, stack[0]);
+    if (!table) return false;
+
+    result = collect_entries(runtime, table, false);
+    return true;
+}
+
+Value Natives::create_map_namespace() {
+    std::unordered_map<std::string, Value> *Map = new std::unordered_map<std::string, Value>({
+            { "create", Values::Value(
+                Values::native_method_t{ .func = create, .number_arguments = 0, .flags = NATIVE_ALLOCATES }
+            ) },
+            { "delete", Values::Value(
+                Values::native_method_t{ .func = delete_, .number_arguments = 2, .flags = NATIVE_MAY_FAIL }
+            ) },
+            { "get", Values::Value(
+                Values::native_method_t{ .func = get, .number_arguments = 2, .flags = NATIVE_MAY_FAIL }
+            ) },
+            { "has", Values::Value(
+                Values::native_method_t{ .func = has, .number_arguments = 2, .flags = NATIVE_MAY_FAIL }
+            ) },
+            { "keys", Values::Value(
+                Values::native_method_t{ .func = keys, .number_arguments = 1, .flags = NATIVE_ALLOCATES | NATIVE_MAY_FAIL }
+            ) },
+            { "set", Values::Value(
+                Values::native_method_t{ .func = set, .number_arguments = 3, .flags = NATIVE_MAY_FAIL }
+            ) },
+            { "size", Values::Value(
+                Values::native_method_t{ .func = size, .number_arguments = 1, .flags = NATIVE_MAY_FAIL | NATIVE_RETURNS_NUMBER }
+            ) },
+            { "values", Values::Value(
+                Values::native_method_t{ .func = values, .number_arguments = 1, .flags = NATIVE_ALLOCATES | NATIVE_MAY_FAIL }
+            ) }
+        });
+    Object *map_obj = Allocate<Object>::create(Map);
+    return Value(map_obj);
+};
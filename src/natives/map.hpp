@@ -0,0 +1,10 @@
+#ifndef _SG_CPP_NATIVES_MAP_HPP
+#define _SG_CPP_NATIVES_MAP_HPP
+
+#include "../value.hpp"
+
+namespace Natives {
+    Values::Value create_map_namespace();
+};
+
+#endif
@@ -1,7 +1,9 @@
 #include "math.hpp"
 #include "natives.hpp"
+#include "number-arrays.hpp"
 #include "../memory.hpp"
 #include "../utils.hpp"
+#include "../vector-math.hpp"
 
 #include <math.h>
 #include <stdio.h>
@@ -274,68 +276,159 @@ static bool sg_sqrt NATIVE_FUNCTION_HEADERS() {
     );
 }
 
+/* > Math.map, elementwise versions of the functions over an array of numbers or a typed array.
+    Each takes an optional destination array or typed array of the same length as its last argument. */
+using elementwise_t = void(*)(const double *data, double *out, size_t length);
+
+static bool is_typed_array(const Value &value) {
+    Object *obj = safe_get_value_object(value);
+    return obj != nullptr && obj->type == ObjectType::TYPED_ARRAY;
+}
+static inline bool map_one_param(
+    const char *name,
+    const char *process,
+    const Value * const stack,
+    uint stack_size,
+    Value &result,
+    Runtime &runtime,
+    std::string &error_message,
+    elementwise_t func
+) {
+    if (!Natives::check_argument_count(name, error_message, stack_size, 1, 2)) return false;
+
+    std::vector<double> storage;
+    const double *numbers;
+    size_t count;
+    if (!Natives::get_numbers(process, error_message, stack[0], storage, numbers, count)) return false;
+
+    Natives::number_output_t output;
+    const Value *destination = stack_size == 2 ? &stack[1] : nullptr;
+    if (!Natives::start_number_output(name, error_message, runtime, destination, is_typed_array(stack[0]), count, { numbers }, output)) {
+        return false;
+    }
+
+    func(numbers, output.numbers, count);
+    Natives::finish_number_output(runtime, output, count);
+    result = output.result;
+    return true;
+}
+
+static bool sg_map_sin NATIVE_FUNCTION_HEADERS() {
+    return map_one_param("Math.map.sin", "map sin over", stack, stack_size, result, runtime, error_message, VectorMath::sin);
+}
+static bool sg_map_cos NATIVE_FUNCTION_HEADERS() {
+    return map_one_param("Math.map.cos", "map cos over", stack, stack_size, result, runtime, error_message, VectorMath::cos);
+}
+static bool sg_map_sqrt NATIVE_FUNCTION_HEADERS() {
+    return map_one_param("Math.map.sqrt", "map sqrt over", stack, stack_size, result, runtime, error_message, VectorMath::sqrt);
+}
+// pow(arr, exponent, destination?) -- every element to the same power
+static bool sg_map_pow NATIVE_FUNCTION_HEADERS() {
+    if (!Natives::check_argument_count("Math.map.pow", error_message, stack_size, 2, 3)) return false;
+
+    std::vector<double> storage;
+    const double *numbers;
+    size_t count;
+    if (!Natives::get_numbers("map pow over", error_message, stack[0], storage, numbers, count)) return false;
+    Values::number_t exponent;
+    if (!check_number("pow", error_message, stack[1], exponent, REAL)) return false;
+
+    Natives::number_output_t output;
+    const Value *destination = stack_size == 3 ? &stack[2] : nullptr;
+    if (!Natives::start_number_output("Math.map.pow", error_message, runtime, destination, is_typed_array(stack[0]), count, { numbers }, output)) {
+        return false;
+    }
+
+    VectorMath::pow(numbers, exponent, output.numbers, count);
+    Natives::finish_number_output(runtime, output, count);
+    result = output.result;
+    return true;
+}
+
+static Value create_elementwise_namespace() {
+    std::unordered_map<std::string, Value> *map = new std::unordered_map<std::string, Value>({
+        { "cos", Values::Value(
+            Values::native_method_t{ .func = sg_map_cos, .number_arguments = VARIADIC_ARGUMENTS, .flags = NATIVE_ALLOCATES | NATIVE_MAY_FAIL }
+        ) },
+        { "sin", Values::Value(
+            Values::native_method_t{ .func = sg_map_sin, .number_arguments = VARIADIC_ARGUMENTS, .flags = NATIVE_ALLOCATES | NATIVE_MAY_FAIL }
+        ) },
+        { "sqrt", Values::Value(
+            Values::native_method_t{ .func = sg_map_sqrt, .number_arguments = VARIADIC_ARGUMENTS, .flags = NATIVE_ALLOCATES | NATIVE_MAY_FAIL }
+        ) },
+        { "pow", Values::Value(
+            Values::native_method_t{ .func = sg_map_pow, .number_arguments = VARIADIC_ARGUMENTS, .flags = NATIVE_ALLOCATES | NATIVE_MAY_FAIL }
+        ) }
+    });
+    Object *map_obj = Allocate<Object>::create(map);
+    return Value(map_obj);
+}
+/* < Math.map */
+
 Value Natives::create_math_namespace() {
     std::unordered_map<std::string, Value> *Math = new std::unordered_map<std::string, Value>({
         { "abs", Values::Value(
-            Values::native_method_t{ .func = sg_abs, .number_arguments = 1 }
+            Values::native_method_t{ .func = sg_abs, .number_arguments = 1, .flags = NATIVE_PURE | NATIVE_MAY_FAIL | NATIVE_RETURNS_NUMBER }
         ) },
         { "ceil", Values::Value(
-            Values::native_method_t{ .func = sg_ceil, .number_arguments = 1 }
+            Values::native_method_t{ .func = sg_ceil, .number_arguments = 1, .flags = NATIVE_PURE | NATIVE_MAY_FAIL | NATIVE_RETURNS_NUMBER }
         ) },
         { "floor", Values::Value(
-            Values::native_method_t{ .func = sg_floor, .number_arguments = 1 }
+            Values::native_method_t{ .func = sg_floor, .number_arguments = 1, .flags = NATIVE_PURE | NATIVE_MAY_FAIL | NATIVE_RETURNS_NUMBER }
         ) },
         { "max", Values::Value(
-            Values::native_method_t{ .func = sg_max, .number_arguments = 2 }
+            Values::native_method_t{ .func = sg_max, .number_arguments = 2, .flags = NATIVE_PURE | NATIVE_MAY_FAIL | NATIVE_RETURNS_NUMBER }
         ) },
         { "min", Values::Value(
-            Values::native_method_t{ .func = sg_min, .number_arguments = 2 }
+            Values::native_method_t{ .func = sg_min, .number_arguments = 2, .flags = NATIVE_PURE | NATIVE_MAY_FAIL | NATIVE_RETURNS_NUMBER }
         ) },
 
         { "random", Values::Value(
-            Values::native_method_t{ .func = sg_random, .number_arguments = 0 }
+            Values::native_method_t{ .func = sg_random, .number_arguments = 0, .flags = NATIVE_RETURNS_NUMBER }
         ) },
         
         { "acos", Values::Value(
-            Values::native_method_t{ .func = sg_acos, .number_arguments = 1 }
+            Values::native_method_t{ .func = sg_acos, .number_arguments = 1, .flags = NATIVE_PURE | NATIVE_MAY_FAIL | NATIVE_RETURNS_NUMBER }
         ) },
         { "asin", Values::Value(
-            Values::native_method_t{ .func = sg_asin, .number_arguments = 1 }
+            Values::native_method_t{ .func = sg_asin, .number_arguments = 1, .flags = NATIVE_PURE | NATIVE_MAY_FAIL | NATIVE_RETURNS_NUMBER }
         ) },
         { "atan", Values::Value(
-            Values::native_method_t{ .func = sg_atan, .number_arguments = 1 }
+            Values::native_method_t{ .func = sg_atan, .number_arguments = 1, .flags = NATIVE_PURE | NATIVE_MAY_FAIL | NATIVE_RETURNS_NUMBER }
         ) },
 
         { "cos", Values::Value(
-            Values::native_method_t{ .func = sg_cos, .number_arguments = 1 }
+            Values::native_method_t{ .func = sg_cos, .number_arguments = 1, .flags = NATIVE_PURE | NATIVE_MAY_FAIL | NATIVE_RETURNS_NUMBER }
         ) },
         { "sin", Values::Value(
-            Values::native_method_t{ .func = sg_sin, .number_arguments = 1 }
+            Values::native_method_t{ .func = sg_sin, .number_arguments = 1, .flags = NATIVE_PURE | NATIVE_MAY_FAIL | NATIVE_RETURNS_NUMBER }
         ) },
         { "tan", Values::Value(
-            Values::native_method_t{ .func = sg_tan, .number_arguments = 1 }
+            Values::native_method_t{ .func = sg_tan, .number_arguments = 1, .flags = NATIVE_PURE | NATIVE_MAY_FAIL | NATIVE_RETURNS_NUMBER }
         ) },
 
         { "log10", Values::Value(
-            Values::native_method_t{ .func = sg_log10, .number_arguments = 1 }
+            Values::native_method_t{ .func = sg_log10, .number_arguments = 1, .flags = NATIVE_PURE | NATIVE_MAY_FAIL | NATIVE_RETURNS_NUMBER }
         ) },
         { "logE", Values::Value(
-            Values::native_method_t{ .func = sg_logE, .number_arguments = 1 }
+            Values::native_method_t{ .func = sg_logE, .number_arguments = 1, .flags = NATIVE_PURE | NATIVE_MAY_FAIL | NATIVE_RETURNS_NUMBER }
         ) },
         { "log2", Values::Value(
-            Values::native_method_t{ .func = sg_log2, .number_arguments = 1 }
+            Values::native_method_t{ .func = sg_log2, .number_arguments = 1, .flags = NATIVE_PURE | NATIVE_MAY_FAIL | NATIVE_RETURNS_NUMBER }
         ) },
         { "log2ff", Values::Value(
-            Values::native_method_t{ .func = sg_log2ff, .number_arguments = 1 }
+            Values::native_method_t{ .func = sg_log2ff, .number_arguments = 1, .flags = NATIVE_PURE | NATIVE_MAY_FAIL | NATIVE_RETURNS_NUMBER }
         ) },
 
         { "sqrt", Values::Value(
-            Values::native_method_t{ .func = sg_sqrt, .number_arguments = 1 }
+            Values::native_method_t{ .func = sg_sqrt, .number_arguments = 1, .flags = NATIVE_PURE | NATIVE_MAY_FAIL | NATIVE_RETURNS_NUMBER }
         ) },
         { "pow", Values::Value(
-            Values::native_method_t{ .func = sg_pow, .number_arguments = 2 }
+            Values::native_method_t{ .func = sg_pow, .number_arguments = 2, .flags = NATIVE_PURE | NATIVE_MAY_FAIL | NATIVE_RETURNS_NUMBER }
         ) },
 
+        { "map", create_elementwise_namespace() },
+
         { "E", Values::Value(ValueType::NUMBER, 2.7182818284590452353602874713527) },
         { "PI", Values::Value(ValueType::NUMBER, 3.141592653589793238462643383279 ) }
     });
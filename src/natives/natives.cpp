@@ -15,7 +15,13 @@ bool clock NATIVE_FUNCTION_HEADERS() {
 #include "array.hpp"
 #include "console.hpp"
 #include "date.hpp"
+#include "map.hpp"
 #include "math.hpp"
+#include "number.hpp"
+#include "set.hpp"
+#include "string.hpp"
+#include "string-builder.hpp"
+#include "typed-array.hpp"
 
 Native::Native(const char *name, Values::Value value) :
     native_name(name), value(value) {};
@@ -23,21 +29,57 @@ Native::Native(const char *name, Values::Value value) :
 uint Natives::get_native_index(std::string native_name) {
     return name_to_native_index[native_name];
 };
+bool Natives::is_namespace(uint native_index) {
+    // Only clock is a function
+    return native_index != 1;
+}
+bool Natives::get_member(const Values::Value &native, const std::string &name, Values::Value &member) {
+    Object *obj = safe_get_value_object(native);
+    if (obj == nullptr || obj->type != ObjectType::NAMESPACE_CONSTANT) return false;
+
+    auto found = obj->memory.namespace_->find(name);
+    if (found == obj->memory.namespace_->end()) return false;
+    member = found->second;
+    return true;
+}
+bool Natives::get_method(const Values::Value &native, const std::string &name, Values::native_method_t &method) {
+    Value member;
+    if (!get_member(native, name, member) || get_value_type(member) != ValueType::NATIVE_FUNCTION) return false;
+
+    method = get_value_native_function(member);
+    return true;
+}
 std::unordered_map<std::string, uint> Natives::name_to_native_index = {
     { "Console", 0 },
     { "clock", 1 },
     { "Array", 2 },
     { "Date", 3 },
-    { "Math", 4 }
+    { "Math", 4 },
+    { "String", 5 },
+    { "StringBuilder", 6 },
+    { "Number", 7 },
+    { "Float64Array", 8 },
+    { "Int32Array", 9 },
+    { "Uint8Array", 10 },
+    { "Map", 11 },
+    { "Set", 12 }
 };
 
 void Natives::create_natives(std::array<Value, native_count> &natives) {
     natives[0] = Natives::create_console_namespace();
     natives[1] = Values::Value(
-        Values::native_method_t{ .func = clock, .number_arguments = 0 }
+        Values::native_method_t{ .func = clock, .number_arguments = 0, .flags = NATIVE_RETURNS_NUMBER }
     );
 
     natives[2] = Natives::create_array_namespace();
     natives[3] = Natives::create_date_namespace();
     natives[4] = Natives::create_math_namespace();
+    natives[5] = Natives::create_string_namespace();
+    natives[6] = Natives::create_string_builder_namespace();
+    natives[7] = Natives::create_number_namespace();
+    natives[8] = Natives::create_float64_array_namespace();
+    natives[9] = Natives::create_int32_array_namespace();
+    natives[10] = Natives::create_uint8_array_namespace();
+    natives[11] = Natives::create_map_namespace();
+    natives[12] = Natives::create_set_namespace();
 };
@@ -14,7 +14,7 @@
     [[maybe_unused]] std::string &error_message)
 
 namespace Natives {
-    const int native_count = 5;
+    const int native_count = 13;
 
     struct Native {
         const char *native_name;
@@ -28,6 +28,13 @@ namespace Natives {
     extern std::unordered_map<std::string, uint> name_to_native_index;
 
     uint get_native_index(std::string native_name);
+    /* Whether the native is a namespace. Their members never change, and
+        reading a member is never an error. */
+    bool is_namespace(uint native_index);
+    /* A member of a native namespace. False if it has no member by that name. */
+    bool get_member(const Values::Value &native, const std::string &name, Values::Value &member);
+    /* The function a member of a native namespace holds. False if there is no such member, or it isn't a function. */
+    bool get_method(const Values::Value &native, const std::string &name, Values::native_method_t &method);
     void create_natives(std::array<Values::Value, native_count> &natives);
 };
 
@@ -0,0 +1,168 @@
+#include "number-arrays.hpp"
+#include "../memory.hpp"
+
+#include "../runtime/runtime.hpp"
+
+using namespace Values;
+
+bool Natives::get_numbers(
+    const char *process, std::string &error_message, Value value,
+    std::vector<double> &storage, const double *&numbers, size_t &count
+) {
+    Object *obj = safe_get_value_object(value);
+    if (obj != nullptr && obj->type == ObjectType::TYPED_ARRAY) {
+        typed_array_t *typed = obj->memory.typed_array;
+        count = typed->length;
+        if (typed->kind == TypedArrayKind::FLOAT64_ARRAY) {
+            numbers = static_cast<const double*>(typed->data);
+            return true;
+        }
+
+        storage.resize(count);
+        for (size_t index = 0; index < count; index += 1) storage[index] = typed->get(index);
+        numbers = storage.data();
+        return true;
+    }
+
+    if (obj == nullptr || !object_is_array(obj)) {
+        error_message = "Cannot ";
+        error_message += process;
+        error_message += " value ";
+        error_message += value_to_string(value);
+        error_message += " -- it is not an array";
+        return false;
+    }
+
+    const Value *elements = array_elements(obj);
+    count = array_length(obj);
+    storage.resize(count);
+    numbers = storage.data();
+
+    if (array_holds_only_numbers(obj)) {
+        for (size_t index = 0; index < count; index += 1) storage[index] = get_value_number(elements[index]);
+        return true;
+    }
+
+    // The kind doesn't go back when a non-number is overwritten, so look for the culprit
+    for (size_t index = 0; index < count; index += 1) {
+        const Value &element = elements[index];
+        if (get_value_type(element) != ValueType::NUMBER) {
+            error_message = "Cannot ";
+            error_message += process;
+            error_message += " array -- element ";
+            error_message += std::to_string(index);
+            error_message += " (";
+            error_message += value_to_string(element);
+            error_message += ") is not a number";
+            return false;
+        }
+        storage[index] = get_value_number(element);
+    }
+    return true;
+}
+
+bool Natives::check_argument_count(const char *name, std::string &error_message, uint stack_size, uint minimum, uint maximum) {
+    if (stack_size >= minimum && stack_size <= maximum) return true;
+
+    error_message = std::to_string(stack_size);
+    error_message += " argument(s) passed to ";
+    error_message += name;
+    error_message += ", which expects ";
+    error_message += std::to_string(minimum);
+    error_message += " or ";
+    error_message += std::to_string(maximum);
+    return false;
+}
+
+bool Natives::start_number_output(
+    const char *process, std::string &error_message, Runtime &runtime,
+    const Value *destination, bool typed, size_t count,
+    std::initializer_list<const double*> inputs, number_output_t &output
+) {
+    if (destination == nullptr) {
+        if (typed) {
+            typed_array_t *array = runtime.create<typed_array_t>(TypedArrayKind::FLOAT64_ARRAY, count);
+            Object *obj = runtime.create<Object>(array);
+            runtime.add_object(obj);
+            output.result = value_from_object(obj);
+            output.numbers = static_cast<double*>(array->data);
+            return true;
+        }
+
+        // The array is made once the results are in
+        output.result = Value(ValueType::NULL_VALUE);
+        output.storage.resize(count);
+        output.numbers = output.storage.data();
+        output.buffered = true;
+        return true;
+    }
+
+    Object *obj = safe_get_value_object(*destination);
+    if (obj == nullptr || (obj->type != ObjectType::TYPED_ARRAY && !object_is_array(obj))) {
+        error_message = "Cannot write results of ";
+        error_message += process;
+        error_message += " into value ";
+        error_message += value_to_string(*destination);
+        error_message += " -- it is not an array";
+        return false;
+    }
+
+    size_t length = obj->type == ObjectType::TYPED_ARRAY ? obj->memory.typed_array->length : array_length(obj);
+    if (length != count) {
+        error_message = "Cannot write ";
+        error_message += std::to_string(count);
+        error_message += " results of ";
+        error_message += process;
+        error_message += " into an array of length ";
+        error_message += std::to_string(length);
+        return false;
+    }
+
+    runtime.make_writable(obj);
+    output.result = *destination;
+
+    if (obj->type == ObjectType::TYPED_ARRAY && obj->memory.typed_array->kind == TypedArrayKind::FLOAT64_ARRAY) {
+        double *data = static_cast<double*>(obj->memory.typed_array->data);
+
+        // Writing over the input itself is fine, since each result only depends on its own element
+        bool overlaps = false;
+        for (const double *input : inputs) {
+            if (input != data && input < data + count && data < input + count) overlaps = true;
+        }
+        if (!overlaps) {
+            output.numbers = data;
+            return true;
+        }
+    }
+
+    output.storage.resize(count);
+    output.numbers = output.storage.data();
+    output.buffered = true;
+    return true;
+}
+void Natives::finish_number_output(Runtime &runtime, number_output_t &output, size_t count) {
+    if (!output.buffered) return;
+
+    Object *obj = safe_get_value_object(output.result);
+    if (obj == nullptr) {
+        // Filled in before it becomes an object, since it only holds numbers
+        std::vector<Value> *array = runtime.create<std::vector<Value>>(count, value_from_number(0));
+        for (size_t index = 0; index < count; index += 1) (*array)[index] = value_from_number(output.numbers[index]);
+
+        Object *array_obj = runtime.create<Object>(array);
+        runtime.add_object(array_obj);
+        output.result = value_from_object(array_obj);
+        return;
+    }
+
+    if (obj->type == ObjectType::TYPED_ARRAY) {
+        typed_array_t *typed = obj->memory.typed_array;
+        for (size_t index = 0; index < count; index += 1) typed->set(index, output.numbers[index]);
+        return;
+    }
+
+    // start_number_output made the destination writable, so it is a plain array now
+    Value *elements = obj->memory.array->data();
+    for (size_t index = 0; index < count; index += 1) elements[index] = value_from_number(output.numbers[index]);
+    if (count > 0) obj->element_kind = ArrayElementKind::NUMBER_ELEMENTS;
+}
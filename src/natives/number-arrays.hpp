@@ -0,0 +1,59 @@
+/* Helpers for the natives that work on whole arrays of numbers at once,
+    like the Array reductions and Math.map */
+
+#ifndef _SG_CPP_NATIVES_NUMBER_ARRAYS_HPP
+#define _SG_CPP_NATIVES_NUMBER_ARRAYS_HPP
+
+#include "../value.hpp"
+
+#include <initializer_list>
+#include <vector>
+
+namespace Natives {
+    /**
+     * Gets contiguous numbers from an array of numbers or a typed array. Float64Arrays are read in place,
+     * while arrays and the integer typed arrays are copied into storage.
+     * @param {const char*} process - Process to describe in the error message
+     * @param {std::string&} error_message - Error to update
+     * @param {Values::Value} value - Array of numbers, or typed array
+     * @param {std::vector<double>&} storage - Buffer that owns the numbers if they had to be copied
+     * @param {const double*&} numbers - Set to the start of the numbers
+     * @param {size_t&} count - Set to the number of elements
+     * @return {bool} - True if okay, false if error message was set
+     */
+    bool get_numbers(
+        const char *process, std::string &error_message, Values::Value value,
+        std::vector<double> &storage, const double *&numbers, size_t &count
+    );
+
+    /* For natives that take an optional last argument, like a destination array */
+    bool check_argument_count(const char *name, std::string &error_message, uint stack_size, uint minimum, uint maximum);
+
+    /* Where an elementwise native writes its results. A Float64Array is written in place,
+        and anything else goes through the storage, which finish_number_output copies out. */
+    struct number_output_t {
+        Values::Value result;
+        double *numbers = nullptr;
+        std::vector<double> storage;
+        bool buffered = false;
+    };
+    /**
+     * Gets ready to write count results. Call it after reading the inputs, since a destination
+     * that is a view gets its own copy of the elements first.
+     * @param {const Values::Value*} destination - Array or typed array of exactly count elements to
+     *  write into, or nullptr to make a new one
+     * @param {bool} typed - Whether a new result is a Float64Array instead of an array
+     * @param {std::initializer_list<const double*>} inputs - What the kernel reads, so that a
+     *  destination partly overlapping one of them is written through the storage instead
+     * @return {bool} - True if okay, false if error message was set
+     */
+    bool start_number_output(
+        const char *process, std::string &error_message, Runtime &runtime,
+        const Values::Value *destination, bool typed, size_t count,
+        std::initializer_list<const double*> inputs, number_output_t &output
+    );
+    // Copies buffered results into their destination, making the result array if there wasn't one
+    void finish_number_output(Runtime &runtime, number_output_t &output, size_t count);
+};
+
+#endif
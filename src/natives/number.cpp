@@ -0,0 +1,49 @@
+#include "number.hpp"
+#include "natives.hpp"
+#include "../memory.hpp"
+#include "../number-parse.hpp"
+
+#include <limits>
+#include <math.h>
+
+using namespace Values;
+
+// parse(str) -- the number the string holds, or NaN if it isn't a number.
+// Accepts the same '_' separators as number literals, and exponents like 1.5e-3.
+static bool parse NATIVE_FUNCTION_HEADERS() {
+    Object *obj = safe_get_value_object(stack[0]);
+    if (obj == nullptr || !object_is_string(obj)) {
+        error_message = "Cannot parse value ";
+        error_message += value_to_string(stack[0]);
+        error_message += " as a number -- it is not a string";
+        return false;
+    }
+
+    Values::number_t number;
+    if (!NumberParse::parse(object_to_string_view(obj), number, true)) {
+        number = std::numeric_limits<Values::number_t>::quiet_NaN();
+    }
+    result = value_from_number(number);
+    return true;
+}
+// isNaN(value) -- NaN is not equal to itself, so this is the only way to check for it
+static bool isNaN NATIVE_FUNCTION_HEADERS() {
+    bool nan = get_value_type(stack[0]) == ValueType::NUMBER && isnan(get_value_number(stack[0]));
+    result = Value(nan ? ValueType::TRUE : ValueType::FALSE);
+    return true;
+}
+
+Value Natives::create_number_namespace() {
+    std::unordered_map<std::string, Value> *Number = new std::unordered_map<std::string, Value>({
+            { "isNaN", Values::Value(
+                Values::native_method_t{ .func = isNaN, .number_arguments = 1, .flags = NATIVE_PURE }
+            ) },
+            { "parse", Values::Value(
+                Values::native_method_t{ .func = parse, .number_arguments = 1, .flags = NATIVE_PURE | NATIVE_MAY_FAIL | NATIVE_RETURNS_NUMBER }
+            ) },
+            { "NaN", value_from_number(std::numeric_limits<Values::number_t>::quiet_NaN()) },
+            { "Infinity", value_from_number(std::numeric_limits<Values::number_t>::infinity()) }
+        });
+    Object *number_obj = Allocate<Object>::create(Number);
+    return Value(number_obj);
+};
@@ -0,0 +1,10 @@
+#ifndef _SG_CPP_NATIVES_NUMBER_HPP
+#define _SG_CPP_NATIVES_NUMBER_HPP
+
+#include "../value.hpp"
+
+namespace Natives {
+    Values::Value create_number_namespace();
+};
+
+#endif
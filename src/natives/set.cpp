@@ -0,0 +1,132 @@
+#include "set.hpp"
+#include "natives.hpp"
+#include "../memory.hpp"
+#include "../value-table.hpp"
+
+#include "../runtime/runtime.hpp"
+
+using namespace Values;
+
+/**
+ * @param {const char*} process - Process to describe in the error message
+ * @param {std::string&} error_message - Error to update
+ * @param {const Values::Value&} value - Value to check for being a set
+ * @return {value_table_t*} - The set's table if success, nullptr if error message was shown
+ */
+static value_table_t *check_set(const char *process, std::string &error_message, const Value &value) {
+    Object *obj = safe_get_value_object(value);
+    if (obj == nullptr || obj->type != ObjectType::SET) {
+        error_message = "Cannot ";
+        error_message += process;
+        error_message += " value ";
+        error_message += value_to_string(value);
+        error_message += " -- it is not a set";
+        return nullptr;
+    }
+    return obj->memory.table;
+}
+
+static Value make_set(Runtime &runtime) {
+    value_table_t *table = runtime.create<value_table_t>();
+    Object *obj = runtime.create<Object>(table, ObjectType::SET);
+    runtime.add_object(obj);
+    return value_from_object(obj);
+}
+
+static bool create NATIVE_FUNCTION_HEADERS() {
+    result = make_set(runtime);
+    return true;
+}
+// from(arr) -- set of the array's elements, without duplicates
+static bool from NATIVE_FUNCTION_HEADERS() {
+    Object *array_obj = safe_get_value_object(stack[0]);
+    if (array_obj == nullptr || !object_is_array(array_obj)) {
+        error_message = "Cannot create set from value ";
+        error_message += value_to_string(stack[0]);
+        error_message += " -- it is not an array";
+        return false;
+    }
+
+    result = make_set(runtime);
+    value_table_t *table = get_value_object(result)->memory.table;
+    const Value *elements = array_elements(array_obj);
+    for (size_t index = 0; index < array_length(array_obj); index += 1) {
+        table->insert(elements[index], Value());
+    }
+    return true;
+}
+// add(set, value) -- returns the set
+static bool add NATIVE_FUNCTION_HEADERS() {
+    value_table_t *table = check_set("add to", error_message, stack[0]);
+    if (!table) return false;
+
+    table->insert(stack[1], Value());
+    result = stack[0];
+    return true;
+}
+static bool has NATIVE_FUNCTION_HEADERS() {
+    value_table_t *table = check_set("check value in", error_message, stack[0]);
+    if (!table) return false;
+
+    result = Value(table->find(stack[1]) != nullptr ? ValueType::TRUE : ValueType::FALSE);
+    return true;
+}
+// delete(set, value) -- false if the value was not in the set
+static bool delete_ NATIVE_FUNCTION_HEADERS() {
+    value_table_t *table = check_set("delete value from", error_message, stack[0]);
+    if (!table) return false;
+
+    result = Value(table->erase(stack[1]) ? ValueType::TRUE : ValueType::FALSE);
+    return true;
+}
+static bool size NATIVE_FUNCTION_HEADERS() {
+    value_table_t *table = check_set("get size of", error_message, stack[0]);
+    if (!table) return false;
+
+    result = value_from_number(static_cast<number_t>(table->size()));
+    return true;
+}
+// values(set) -- array of the values, in no particular order
+static bool values NATIVE_FUNCTION_HEADERS() {
+    value_table_t *table = check_set("get values of", error_message, stack[0]);
+    if (!table) return false;
+
+    std::vector<Value> *array = runtime.create<std::vector<Value>>();
+    array->reserve(table->size());
+    table->for_each([array](const value_table_t::entry_t &entry) {
+        array->push_back(entry.key);
+    });
+
+    Object *obj = runtime.create<Object>(array);
+    runtime.add_object(obj);
+    result = value_from_object(obj);
+    return true;
+}
+
+Value Natives::create_set_namespace() {
+    std::unordered_map<std::string, Value> *Set = new std::unordered_map<std::string, Value>({
+            { "add", Values::Value(
+                Values::native_method_t{ .func = add, .number_arguments = 2, .flags = NATIVE_MAY_FAIL }
+            ) },
+            { "create", Values::Value(
+                Values::native_method_t{ .func = create, .number_arguments = 0, .flags = NATIVE_ALLOCATES }
+            ) },
+            { "delete", Values::Value(
+                Values::native_method_t{ .func = delete_, .number_arguments = 2, .flags = NATIVE_MAY_FAIL }
+            ) },
+            { "from", Values::Value(
+                Values::native_method_t{ .func = from, .number_arguments = 1, .flags = NATIVE_ALLOCATES | NATIVE_MAY_FAIL }
+            ) },
+            { "has", Values::Value(
+                Values::native_method_t{ .func = has, .number_arguments = 2, .flags = NATIVE_MAY_FAIL }
+            ) },
+            { "size", Values::Value(
+                Values::native_method_t{ .func = size, .number_arguments = 1, .flags = NATIVE_MAY_FAIL | NATIVE_RETURNS_NUMBER }
+            ) },
+            { "values", Values::Value(
+                Values::native_method_t{ .func = values, .number_arguments = 1, .flags = NATIVE_ALLOCATES | NATIVE_MAY_FAIL }
+            ) }
+        });
+    Object *set_obj = Allocate<Object>::create(Set);
+    return Value(set_obj);
+};
@@ -0,0 +1,10 @@
+#ifndef _SG_CPP_NATIVES_SET_HPP
+#define _SG_CPP_NATIVES_SET_HPP
+
+#include "../value.hpp"
+
+namespace Natives {
+    Values::Value create_set_namespace();
+};
+
+#endif
@@ -0,0 +1,109 @@
+#include "string-builder.hpp"
+#include "natives.hpp"
+#include "../memory.hpp"
+
+#include "../runtime/runtime.hpp"
+
+using namespace Values;
+
+/**
+ * @param {const char*} process - Process to describe in the error message
+ * @param {std::string&} error_message - Error to update
+ * @param {const Values::Value&} value - Value to check for being a string builder
+ * @return {std::string*} - The builder's buffer if success, nullptr if error message was shown
+ */
+static std::string *check_builder(const char *process, std::string &error_message, const Value &value) {
+    Object *obj = safe_get_value_object(value);
+    if (obj == nullptr || obj->type != ObjectType::STRING_BUILDER) {
+        error_message = "Cannot ";
+        error_message += process;
+        error_message += " value ";
+        error_message += value_to_string(value);
+        error_message += " -- it is not a string builder";
+        return nullptr;
+    }
+    return obj->memory.builder;
+}
+
+static bool create NATIVE_FUNCTION_HEADERS() {
+    std::string *buffer = runtime.create<std::string>();
+    Object *obj = runtime.create<Object>(buffer);
+    runtime.add_object(obj);
+    result = value_from_object(obj);
+    return true;
+}
+// append(builder, value) -- formats the value onto the end of the builder.
+// Returns the builder.
+static bool append NATIVE_FUNCTION_HEADERS() {
+    std::string *buffer = check_builder("append to", error_message, stack[0]);
+    if (!buffer) return false;
+
+    append_value_to_string(*buffer, stack[1]);
+    result = stack[0];
+    return true;
+}
+static bool appendNumber NATIVE_FUNCTION_HEADERS() {
+    std::string *buffer = check_builder("append to", error_message, stack[0]);
+    if (!buffer) return false;
+
+    if (get_value_type(stack[1]) != ValueType::NUMBER) {
+        error_message = "Cannot append non-number value ";
+        error_message += value_to_string(stack[1]);
+        error_message += " with appendNumber";
+        return false;
+    }
+
+    append_number_to_string(*buffer, get_value_number(stack[1]));
+    result = stack[0];
+    return true;
+}
+// length(builder) -- in bytes, not code points
+static bool length NATIVE_FUNCTION_HEADERS() {
+    std::string *buffer = check_builder("get length of", error_message, stack[0]);
+    if (!buffer) return false;
+
+    result = value_from_number(static_cast<Values::number_t>(buffer->size()));
+    return true;
+}
+// toString(builder) -- the builder's contents as a string. The builder is empty afterwards.
+static bool toString NATIVE_FUNCTION_HEADERS() {
+    std::string *buffer = check_builder("convert to string", error_message, stack[0]);
+    if (!buffer) return false;
+
+    string_t *str;
+    // Hand the buffer over, unless most of it would be wasted space
+    if (buffer->capacity() <= buffer->size() * 2) {
+        str = runtime.create<string_t>(std::move(*buffer));
+    }
+    else {
+        str = runtime.create<string_t>(std::string_view(*buffer));
+    }
+    buffer->clear();
+
+    Object *obj = runtime.create<Object>(str);
+    runtime.add_object(obj);
+    result = value_from_object(obj);
+    return true;
+}
+
+Value Natives::create_string_builder_namespace() {
+    std::unordered_map<std::string, Value> *StringBuilder = new std::unordered_map<std::string, Value>({
+            { "append", Values::Value(
+                Values::native_method_t{ .func = append, .number_arguments = 2, .flags = NATIVE_MAY_FAIL }
+            ) },
+            { "appendNumber", Values::Value(
+                Values::native_method_t{ .func = appendNumber, .number_arguments = 2, .flags = NATIVE_MAY_FAIL }
+            ) },
+            { "create", Values::Value(
+                Values::native_method_t{ .func = create, .number_arguments = 0, .flags = NATIVE_ALLOCATES }
+            ) },
+            { "length", Values::Value(
+                Values::native_method_t{ .func = length, .number_arguments = 1, .flags = NATIVE_MAY_FAIL | NATIVE_RETURNS_NUMBER }
+            ) },
+            { "toString", Values::Value(
+                Values::native_method_t{ .func = toString, .number_arguments = 1, .flags = NATIVE_ALLOCATES | NATIVE_MAY_FAIL }
+            ) }
+        });
+    Object *builder_obj = Allocate<Object>::create(StringBuilder);
+    return Value(builder_obj);
+};
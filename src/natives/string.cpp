@@ -0,0 +1,325 @@
+#include "string.hpp"
+#include "natives.hpp"
+#include "../memory.hpp"
+
+#include "../runtime/runtime.hpp"
+#include "../string-search.hpp"
+
+#include <math.h>
+
+using namespace Values;
+
+/**
+ * @param {const char*} process - Process to describe in the error message
+ * @param {std::string&} error_message - Error to update
+ * @param {const Values::Value&} value - Value to check for being a string or a string slice
+ * @return {Object*} - Pointer if success, nullptr if error message was shown
+ */
+static Object *check_string(const char *process, std::string &error_message, const Value &value) {
+    Object *obj = safe_get_value_object(value);
+    if (obj == nullptr || !object_is_string(obj)) {
+        error_message = "Cannot ";
+        error_message += process;
+        error_message += " value ";
+        error_message += value_to_string(value);
+        error_message += " -- it is not a string";
+        return nullptr;
+    }
+    return obj;
+}
+/**
+ * Reads a position argument and clamps it to [0, length].
+ * @param {bool} from_end - If true, negative positions count backwards from the end of the string
+ * @return {bool} - False if the position was not an integer
+ */
+static bool check_position(
+    const char *process,
+    std::string &error_message,
+    const Value &value,
+    size_t length,
+    bool from_end,
+    size_t &position
+) {
+    if (get_value_type(value) != ValueType::NUMBER || get_value_number(value) != floor(get_value_number(value))) {
+        error_message = "Cannot ";
+        error_message += process;
+        error_message += " with non-integer position ";
+        error_message += value_to_string(value);
+        return false;
+    }
+
+    Values::number_t number = get_value_number(value);
+    if (number < 0 && from_end) number += static_cast<Values::number_t>(length);
+
+    if (number < 0) position = 0;
+    else if (number > static_cast<Values::number_t>(length)) position = length;
+    else position = static_cast<size_t>(number);
+
+    return true;
+}
+
+/* Make a slice of the given string object that shares its characters.
+    The offset and length are in bytes. */
+static Value make_slice(Runtime &runtime, Object *str, size_t offset, size_t length) {
+    Object *parent = str;
+    // Never chain slices. Point at the string that owns the characters instead.
+    if (str->type == ObjectType::STRING_SLICE) {
+        parent = str->memory.slice->parent;
+        offset += str->memory.slice->offset;
+    }
+
+    size_t code_point_offset = string_byte_to_code_point(parent, offset);
+    size_t code_point_end = string_byte_to_code_point(parent, offset + length);
+
+    string_slice_t *slice = runtime.create<string_slice_t>(string_slice_t{
+        .parent = parent,
+        .offset = offset,
+        .length = length,
+        .code_point_offset = code_point_offset,
+        .code_point_length = code_point_end - code_point_offset
+    });
+    Object *obj = runtime.create<Object>(slice);
+    runtime.add_object(obj);
+    return value_from_object(obj);
+}
+
+static inline bool is_whitespace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+
+/* Make a slice between two code point positions */
+static Value make_code_point_slice(Runtime &runtime, Object *str, size_t start, size_t end) {
+    size_t start_byte = string_code_point_offset(str, start);
+    size_t end_byte = string_code_point_offset(str, end);
+    return make_slice(runtime, str, start_byte, end_byte - start_byte);
+}
+
+// substring(str, start, end) -- [start, end). Negative positions become 0, and
+// if start > end, they are swapped. Positions are in code points.
+static bool substring NATIVE_FUNCTION_HEADERS() {
+    Object *obj = check_string("take substring of", error_message, stack[0]);
+    if (!obj) return false;
+
+    size_t length = string_length(obj);
+    size_t start, end;
+    if (!check_position("take substring", error_message, stack[1], length, false, start)) return false;
+    if (!check_position("take substring", error_message, stack[2], length, false, end)) return false;
+
+    if (start > end) std::swap(start, end);
+
+    result = make_code_point_slice(runtime, obj, start, end);
+    return true;
+}
+// slice(str, start, end) -- [start, end). Negative positions count from the end.
+static bool slice NATIVE_FUNCTION_HEADERS() {
+    Object *obj = check_string("slice", error_message, stack[0]);
+    if (!obj) return false;
+
+    size_t length = string_length(obj);
+    size_t start, end;
+    if (!check_position("slice string", error_message, stack[1], length, true, start)) return false;
+    if (!check_position("slice string", error_message, stack[2], length, true, end)) return false;
+
+    result = make_code_point_slice(runtime, obj, start, end > start ? end : start);
+    return true;
+}
+// length(str) -- number of code points. Cached when the string is created.
+static bool length NATIVE_FUNCTION_HEADERS() {
+    Object *obj = check_string("get length of", error_message, stack[0]);
+    if (!obj) return false;
+
+    result = value_from_number(static_cast<Values::number_t>(string_length(obj)));
+    return true;
+}
+static bool trimStart NATIVE_FUNCTION_HEADERS() {
+    Object *obj = check_string("trim", error_message, stack[0]);
+    if (!obj) return false;
+
+    std::string_view view = object_to_string_view(obj);
+    size_t start = 0;
+    while (start < view.size() && is_whitespace(view[start])) start += 1;
+
+    result = make_slice(runtime, obj, start, view.size() - start);
+    return true;
+}
+static bool trimEnd NATIVE_FUNCTION_HEADERS() {
+    Object *obj = check_string("trim", error_message, stack[0]);
+    if (!obj) return false;
+
+    std::string_view view = object_to_string_view(obj);
+    size_t end = view.size();
+    while (end > 0 && is_whitespace(view[end - 1])) end -= 1;
+
+    result = make_slice(runtime, obj, 0, end);
+    return true;
+}
+// split(str, separator) -- array of slices between each separator.
+// An empty separator splits the string into single characters.
+static bool split NATIVE_FUNCTION_HEADERS() {
+    Object *obj = check_string("split", error_message, stack[0]);
+    if (!obj) return false;
+    Object *separator_obj = check_string("split with separator", error_message, stack[1]);
+    if (!separator_obj) return false;
+
+    std::string_view view = object_to_string_view(obj);
+    std::string_view separator = object_to_string_view(separator_obj);
+
+    // The slices go in an array on the stack, so that the GC keeps them while the next ones are made
+    std::vector<Value> *parts = runtime.create<std::vector<Value>>();
+    Object *array_obj = runtime.create<Object>(parts);
+    runtime.add_object(array_obj);
+    runtime.push_root(value_from_object(array_obj));
+    auto push_part = [&](size_t offset, size_t length) {
+        Value part = make_slice(runtime, obj, offset, length);
+        if (parts->size() == parts->capacity()) runtime.reserve_array(array_obj, std::max<size_t>(8, parts->capacity() * 2));
+        parts->push_back(part);
+        record_array_element(array_obj, part);
+    };
+
+    if (separator.size() == 0) {
+        size_t length = string_length(obj);
+        runtime.reserve_array(array_obj, length);
+        for (size_t index = 0; index < length; index += 1) {
+            std::string_view character = string_code_point_at(obj, index);
+            push_part(character.data() - view.data(), character.size());
+        }
+    }
+    else {
+        size_t start = 0;
+        while (true) {
+            size_t found = StringSearch::find(view, separator, start);
+            if (found == StringSearch::npos) {
+                push_part(start, view.size() - start);
+                break;
+            }
+
+            push_part(start, found - start);
+            start = found + separator.size();
+        }
+    }
+
+    runtime.pop_root();
+    result = value_from_object(array_obj);
+    return true;
+}
+/* Checks both arguments of a search native, e.g. indexOf(str, needle) */
+static bool check_search_arguments(
+    const char *process,
+    std::string &error_message,
+    const Value * const stack,
+    std::string_view &haystack,
+    std::string_view &needle,
+    Object **haystack_object = nullptr
+) {
+    Object *haystack_obj = check_string(process, error_message, stack[0]);
+    if (!haystack_obj) return false;
+    if (haystack_object != nullptr) *haystack_object = haystack_obj;
+    Object *needle_obj = check_string(process, error_message, stack[1]);
+    if (!needle_obj) return false;
+
+    haystack = object_to_string_view(haystack_obj);
+    needle = object_to_string_view(needle_obj);
+    return true;
+}
+// indexOf(str, needle) -- index of the first occurrence, or -1
+static bool indexOf NATIVE_FUNCTION_HEADERS() {
+    std::string_view haystack, needle;
+    Object *haystack_obj;
+    if (!check_search_arguments("search in", error_message, stack, haystack, needle, &haystack_obj)) return false;
+
+    size_t found = StringSearch::find(haystack, needle);
+    if (found == StringSearch::npos) result = value_from_number(-1);
+    else result = value_from_number(static_cast<Values::number_t>(string_byte_to_code_point(haystack_obj, found)));
+    return true;
+}
+// lastIndexOf(str, needle) -- index of the last occurrence, or -1
+static bool lastIndexOf NATIVE_FUNCTION_HEADERS() {
+    std::string_view haystack, needle;
+    Object *haystack_obj;
+    if (!check_search_arguments("search in", error_message, stack, haystack, needle, &haystack_obj)) return false;
+
+    size_t found = StringSearch::rfind(haystack, needle);
+    if (found == StringSearch::npos) result = value_from_number(-1);
+    else result = value_from_number(static_cast<Values::number_t>(string_byte_to_code_point(haystack_obj, found)));
+    return true;
+}
+static bool includes NATIVE_FUNCTION_HEADERS() {
+    std::string_view haystack, needle;
+    if (!check_search_arguments("search in", error_message, stack, haystack, needle)) return false;
+
+    result = Value(StringSearch::find(haystack, needle) != StringSearch::npos ? ValueType::TRUE : ValueType::FALSE);
+    return true;
+}
+// count(str, needle) -- number of non-overlapping occurrences
+static bool count NATIVE_FUNCTION_HEADERS() {
+    std::string_view haystack, needle;
+    Object *haystack_obj;
+    if (!check_search_arguments("search in", error_message, stack, haystack, needle, &haystack_obj)) return false;
+
+    // The empty string appears between every character, and at both ends
+    if (needle.empty()) {
+        result = value_from_number(static_cast<Values::number_t>(string_length(haystack_obj) + 1));
+        return true;
+    }
+
+    result = value_from_number(static_cast<Values::number_t>(StringSearch::count(haystack, needle)));
+    return true;
+}
+
+// copy(str) -- detach a slice from its parent, so the parent can be collected.
+static bool copy NATIVE_FUNCTION_HEADERS() {
+    Object *obj = check_string("copy", error_message, stack[0]);
+    if (!obj) return false;
+
+    // Strings are immutable, so an owning string doesn't need to be copied
+    if (obj->type == ObjectType::STRING) {
+        result = stack[0];
+        return true;
+    }
+
+    string_t *copied = runtime.create<string_t>(object_to_string_view(obj));
+    Object *copy_obj = runtime.create<Object>(copied);
+    runtime.add_object(copy_obj);
+    result = value_from_object(copy_obj);
+    return true;
+}
+
+Value Natives::create_string_namespace() {
+    std::unordered_map<std::string, Value> *String = new std::unordered_map<std::string, Value>({
+            { "copy", Values::Value(
+                Values::native_method_t{ .func = copy, .number_arguments = 1, .flags = NATIVE_PURE | NATIVE_ALLOCATES | NATIVE_MAY_FAIL }
+            ) },
+            { "count", Values::Value(
+                Values::native_method_t{ .func = count, .number_arguments = 2, .flags = NATIVE_PURE | NATIVE_MAY_FAIL | NATIVE_RETURNS_NUMBER }
+            ) },
+            { "includes", Values::Value(
+                Values::native_method_t{ .func = includes, .number_arguments = 2, .flags = NATIVE_PURE | NATIVE_MAY_FAIL }
+            ) },
+            { "indexOf", Values::Value(
+                Values::native_method_t{ .func = indexOf, .number_arguments = 2, .flags = NATIVE_PURE | NATIVE_MAY_FAIL | NATIVE_RETURNS_NUMBER }
+            ) },
+            { "lastIndexOf", Values::Value(
+                Values::native_method_t{ .func = lastIndexOf, .number_arguments = 2, .flags = NATIVE_PURE | NATIVE_MAY_FAIL | NATIVE_RETURNS_NUMBER }
+            ) },
+            { "length", Values::Value(
+                Values::native_method_t{ .func = length, .number_arguments = 1, .flags = NATIVE_PURE | NATIVE_MAY_FAIL | NATIVE_RETURNS_NUMBER }
+            ) },
+            { "slice", Values::Value(
+                Values::native_method_t{ .func = slice, .number_arguments = 3, .flags = NATIVE_PURE | NATIVE_ALLOCATES | NATIVE_MAY_FAIL }
+            ) },
+            { "split", Values::Value(
+                Values::native_method_t{ .func = split, .number_arguments = 2, .flags = NATIVE_ALLOCATES | NATIVE_MAY_FAIL }
+            ) },
+            { "substring", Values::Value(
+                Values::native_method_t{ .func = substring, .number_arguments = 3, .flags = NATIVE_PURE | NATIVE_ALLOCATES | NATIVE_MAY_FAIL }
+            ) },
+            { "trimEnd", Values::Value(
+                Values::native_method_t{ .func = trimEnd, .number_arguments = 1, .flags = NATIVE_PURE | NATIVE_ALLOCATES | NATIVE_MAY_FAIL }
+            ) },
+            { "trimStart", Values::Value(
+                Values::native_method_t{ .func = trimStart, .number_arguments = 1, .flags = NATIVE_PURE | NATIVE_ALLOCATES | NATIVE_MAY_FAIL }
+            ) }
+        });
+    Object *string_obj = Allocate<Object>::create(String);
+    return Value(string_obj);
+};
@@ -0,0 +1,10 @@
+#ifndef _SG_CPP_NATIVES_STRING_HPP
+#define _SG_CPP_NATIVES_STRING_HPP
+
+#include "../value.hpp"
+
+namespace Natives {
+    Values::Value create_string_namespace();
+};
+
+#endif
@@ -0,0 +1,109 @@
+#include "typed-array.hpp"
+#include "natives.hpp"
+#include "../memory.hpp"
+
+#include "../runtime/runtime.hpp"
+
+#include <math.h>
+
+using namespace Values;
+
+static Value make_typed_array(Runtime &runtime, TypedArrayKind kind, size_t length) {
+    typed_array_t *array = runtime.create<typed_array_t>(kind, length);
+    Object *obj = runtime.create<Object>(array);
+    runtime.add_object(obj);
+    return value_from_object(obj);
+}
+
+// create(length) -- every element starts at 0
+template <TypedArrayKind kind>
+static bool create NATIVE_FUNCTION_HEADERS() {
+    if (
+        get_value_type(stack[0]) != ValueType::NUMBER ||
+        get_value_number(stack[0]) < 0 ||
+        get_value_number(stack[0]) != floor(get_value_number(stack[0]))
+    ) {
+        error_message = "Cannot create ";
+        error_message += typed_array_kind_to_string(kind);
+        error_message += " with length ";
+        error_message += value_to_string(stack[0]);
+        error_message += " -- it must be a non-negative integer";
+        return false;
+    }
+
+    result = make_typed_array(runtime, kind, static_cast<size_t>(get_value_number(stack[0])));
+    return true;
+}
+// from(arr) -- copy an array of numbers, or another typed array, converting each element
+template <TypedArrayKind kind>
+static bool from NATIVE_FUNCTION_HEADERS() {
+    Object *source = safe_get_value_object(stack[0]);
+
+    if (source != nullptr && source->type == ObjectType::TYPED_ARRAY) {
+        typed_array_t *source_array = source->memory.typed_array;
+        result = make_typed_array(runtime, kind, source_array->length);
+
+        typed_array_t *array = get_value_object(result)->memory.typed_array;
+        for (size_t index = 0; index < source_array->length; index += 1) {
+            array->set(index, source_array->get(index));
+        }
+        return true;
+    }
+
+    if (source == nullptr || !object_is_array(source)) {
+        error_message = "Cannot create ";
+        error_message += typed_array_kind_to_string(kind);
+        error_message += " from value ";
+        error_message += value_to_string(stack[0]);
+        error_message += " -- it is not an array";
+        return false;
+    }
+
+    size_t length = array_length(source);
+    // Check the elements first, so a failed copy doesn't leave an array behind
+    if (!array_holds_only_numbers(source)) {
+        const Value *elements = array_elements(source);
+        for (size_t index = 0; index < length; index += 1) {
+            const Value &element = elements[index];
+            if (get_value_type(element) != ValueType::NUMBER) {
+                error_message = "Cannot create ";
+                error_message += typed_array_kind_to_string(kind);
+                error_message += " from array with non-number element ";
+                error_message += value_to_string(element);
+                return false;
+            }
+        }
+    }
+
+    result = make_typed_array(runtime, kind, length);
+    typed_array_t *array = get_value_object(result)->memory.typed_array;
+    const Value *elements = array_elements(source);
+    for (size_t index = 0; index < length; index += 1) {
+        array->set(index, get_value_number(elements[index]));
+    }
+    return true;
+}
+
+template <TypedArrayKind kind>
+static Value create_typed_array_namespace() {
+    std::unordered_map<std::string, Value> *TypedArray = new std::unordered_map<std::string, Value>({
+            { "create", Values::Value(
+                Values::native_method_t{ .func = create<kind>, .number_arguments = 1, .flags = NATIVE_ALLOCATES | NATIVE_MAY_FAIL }
+            ) },
+            { "from", Values::Value(
+                Values::native_method_t{ .func = from<kind>, .number_arguments = 1, .flags = NATIVE_ALLOCATES | NATIVE_MAY_FAIL }
+            ) }
+        });
+    Object *typed_array_obj = Allocate<Object>::create(TypedArray);
+    return Value(typed_array_obj);
+}
+
+Value Natives::create_float64_array_namespace() {
+    return create_typed_array_namespace<TypedArrayKind::FLOAT64_ARRAY>();
+};
+Value Natives::create_int32_array_namespace() {
+    return create_typed_array_namespace<TypedArrayKind::INT32_ARRAY>();
+};
+Value Natives::create_uint8_array_namespace() {
+    return create_typed_array_namespace<TypedArrayKind::UINT8_ARRAY>();
+};
@@ -0,0 +1,12 @@
+#ifndef _SG_CPP_NATIVES_TYPED_ARRAY_HPP
+#define _SG_CPP_NATIVES_TYPED_ARRAY_HPP
+
+#include "../value.hpp"
+
+namespace Natives {
+    Values::Value create_float64_array_namespace();
+    Values::Value create_int32_array_namespace();
+    Values::Value create_uint8_array_namespace();
+};
+
+#endif
@@ -0,0 +1,120 @@
+#include "number-format.hpp"
+
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+static const char digit_pairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+/* Two digits at a time, from the end */
+static size_t format_integer(char *buffer, uint64_t value) {
+    char digits[20];
+    size_t start = sizeof(digits);
+
+    while (value >= 100) {
+        size_t pair = (value % 100) * 2;
+        value /= 100;
+        digits[--start] = digit_pairs[pair + 1];
+        digits[--start] = digit_pairs[pair];
+    }
+    if (value >= 10) {
+        digits[--start] = digit_pairs[value * 2 + 1];
+        digits[--start] = digit_pairs[value * 2];
+    }
+    else digits[--start] = static_cast<char>('0' + value);
+
+    memcpy(buffer, digits + start, sizeof(digits) - start);
+    return sizeof(digits) - start;
+}
+
+size_t NumberFormat::format(char *buffer, Values::number_t number) {
+    if (std::isnan(number)) {
+        memcpy(buffer, "NaN", 3);
+        return 3;
+    }
+
+    char *output = buffer;
+    // -0 prints as 0
+    if (number < 0) {
+        *output++ = '-';
+        number = -number;
+    }
+    if (std::isinf(number)) {
+        memcpy(output, "Infinity", 8);
+        return output - buffer + 8;
+    }
+
+    // Integers that a double holds exactly don't need the shortest digit search
+    if (number < 9007199254740992.0 && number == std::floor(number)) {
+        return output - buffer + format_integer(output, static_cast<uint64_t>(number));
+    }
+
+    // std::to_chars finds the shortest round-trip digits (it's Ryu in libstdc++ and MSVC).
+    // Ask for scientific notation, d.ddde±XX, and lay the digits out ourselves.
+    char scientific[MAX_LENGTH];
+    char *scientific_end = std::to_chars(scientific, scientific + sizeof(scientific), number, std::chars_format::scientific).ptr;
+
+    char digits[20];
+    int digit_count = 0;
+    const char *position = scientific;
+    for (; position < scientific_end && *position != 'e'; position += 1) {
+        if (*position != '.') digits[digit_count++] = *position;
+    }
+
+    // Skip the 'e', then read the exponent
+    position += 1;
+    bool negative_exponent = *position == '-';
+    position += 1;
+    int exponent = 0;
+    for (; position < scientific_end; position += 1) exponent = exponent * 10 + (*position - '0');
+    if (negative_exponent) exponent = -exponent;
+
+    // Where the decimal point goes, relative to the first digit
+    int point = exponent + 1;
+
+    if (digit_count <= point && point <= 21) {
+        memcpy(output, digits, digit_count);
+        output += digit_count;
+        memset(output, '0', point - digit_count);
+        output += point - digit_count;
+    }
+    else if (0 < point && point <= 21) {
+        memcpy(output, digits, point);
+        output += point;
+        *output++ = '.';
+        memcpy(output, digits + point, digit_count - point);
+        output += digit_count - point;
+    }
+    else if (-6 < point && point <= 0) {
+        *output++ = '0';
+        *output++ = '.';
+        memset(output, '0', -point);
+        output += -point;
+        memcpy(output, digits, digit_count);
+        output += digit_count;
+    }
+    else {
+        *output++ = digits[0];
+        if (digit_count > 1) {
+            *output++ = '.';
+            memcpy(output, digits + 1, digit_count - 1);
+            output += digit_count - 1;
+        }
+        *output++ = 'e';
+        *output++ = point - 1 < 0 ? '-' : '+';
+        output += format_integer(output, static_cast<uint64_t>(std::abs(point - 1)));
+    }
+
+    return output - buffer;
+}
@@ -0,0 +1,22 @@
+/* Number to string conversion. Prints the shortest decimal that reads back as the
+    same double, laid out the way JavaScript's Number.prototype.toString does:
+    1, 0.1, 123.456, 1e+21, 1.5e-7. Nothing is allocated; the caller passes the buffer. */
+
+#ifndef _SGCPP_NUMBER_FORMAT_HPP
+#define _SGCPP_NUMBER_FORMAT_HPP
+
+#include "globals.hpp"
+
+#include <cstddef>
+
+namespace NumberFormat {
+    // Longest output is something like -1.2345678901234567e-308
+    const size_t MAX_LENGTH = 32;
+
+    /* Writes the number into the buffer, which must have room for MAX_LENGTH characters.
+        The output is not null-terminated.
+        @return {size_t} - Number of characters written */
+    size_t format(char *buffer, Values::number_t number);
+};
+
+#endif
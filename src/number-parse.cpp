@@ -0,0 +1,169 @@
+#include "number-parse.hpp"
+
+#include <charconv>
+#include <cstdint>
+#include <limits>
+#include <string>
+
+// Every power of ten up to 10^22 is exactly representable as a double
+static const double exact_powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+// Largest integer that converts to a double without rounding
+static const uint64_t max_exact_mantissa = uint64_t(1) << 53;
+// Past this many digits, a uint64_t could overflow
+static const int max_mantissa_digits = 19;
+
+static inline bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+/* The decimal digits of a number, without separators, read off the string */
+struct decimal_t {
+    uint64_t mantissa = 0;
+    // mantissa * 10^exponent is the number, except for any truncated digits
+    int64_t exponent = 0;
+    int significant_digits = 0;
+    // Whether digits had to be dropped from the mantissa
+    bool truncated = false;
+    bool has_digits = false;
+    bool has_separators = false;
+};
+
+/**
+ * Reads a run of digits and separators into the decimal
+ * @param {bool} fraction - Whether the digits are after the decimal point
+ * @return {bool} - False if a separator was in the wrong place
+ */
+static bool read_digits(const char *&position, const char *end, decimal_t &decimal, bool fraction, bool allow_separators) {
+    bool last_was_digit = false;
+
+    while (position < end) {
+        char c = *position;
+        if (c == '_' && allow_separators) {
+            if (!last_was_digit || position + 1 >= end || !is_digit(position[1])) return false;
+            decimal.has_separators = true;
+            last_was_digit = false;
+            position += 1;
+            continue;
+        }
+        if (!is_digit(c)) break;
+
+        decimal.has_digits = true;
+        last_was_digit = true;
+        position += 1;
+
+        uint64_t digit = c - '0';
+        // Leading zeros don't count towards the significant digits
+        if (decimal.mantissa == 0 && digit == 0) {
+            if (fraction) decimal.exponent -= 1;
+            continue;
+        }
+        if (decimal.significant_digits < max_mantissa_digits) {
+            decimal.mantissa = decimal.mantissa * 10 + digit;
+            decimal.significant_digits += 1;
+            if (fraction) decimal.exponent -= 1;
+        }
+        else {
+            if (digit != 0) decimal.truncated = true;
+            if (!fraction) decimal.exponent += 1;
+        }
+    }
+
+    return true;
+}
+
+bool NumberParse::parse(std::string_view str, Values::number_t &result, bool allow_separators) {
+    const char *position = str.data();
+    const char *end = str.data() + str.size();
+
+    bool negative = false;
+    if (position < end && (*position == '-' || *position == '+')) {
+        negative = *position == '-';
+        position += 1;
+    }
+    // from_chars doesn't take a leading '+', so start after the sign
+    const char *unsigned_start = position;
+
+    std::string_view unsigned_str = std::string_view(position, end - position);
+    if (unsigned_str == "Infinity") {
+        result = negative ? -std::numeric_limits<double>::infinity() : std::numeric_limits<double>::infinity();
+        return true;
+    }
+    if (unsigned_str == "NaN") {
+        result = std::numeric_limits<double>::quiet_NaN();
+        return true;
+    }
+
+    decimal_t decimal;
+    if (!read_digits(position, end, decimal, false, allow_separators)) return false;
+    if (position < end && *position == '.') {
+        position += 1;
+        // A separator can't start the fraction
+        if (position < end && *position == '_') return false;
+        if (!read_digits(position, end, decimal, true, allow_separators)) return false;
+    }
+    if (!decimal.has_digits) return false;
+
+    if (position < end && (*position == 'e' || *position == 'E')) {
+        position += 1;
+        bool negative_exponent = false;
+        if (position < end && (*position == '-' || *position == '+')) {
+            negative_exponent = *position == '-';
+            position += 1;
+        }
+        if (position >= end || !is_digit(*position)) return false;
+
+        int64_t written_exponent = 0;
+        for (; position < end && is_digit(*position); position += 1) {
+            // Anything this big is already infinity or zero
+            if (written_exponent < 100'000) written_exponent = written_exponent * 10 + (*position - '0');
+        }
+        decimal.exponent += negative_exponent ? -written_exponent : written_exponent;
+    }
+    if (position != end) return false;
+
+    if (decimal.mantissa == 0 && !decimal.truncated) {
+        result = negative ? -0.0 : 0.0;
+        return true;
+    }
+
+    // Clinger's fast path: both the mantissa and the power of ten are exact doubles,
+    // so one multiplication or division rounds correctly
+    if (
+        !decimal.truncated &&
+        decimal.mantissa <= max_exact_mantissa &&
+        decimal.exponent >= -22 && decimal.exponent <= 22
+    ) {
+        double value = static_cast<double>(decimal.mantissa);
+        if (decimal.exponent < 0) value /= exact_powers_of_ten[-decimal.exponent];
+        else value *= exact_powers_of_ten[decimal.exponent];
+
+        result = negative ? -value : value;
+        return true;
+    }
+
+    // from_chars can't skip separators, so they have to be taken out first
+    std::string cleaned;
+    std::string_view digits = std::string_view(unsigned_start, end - unsigned_start);
+    if (decimal.has_separators) {
+        cleaned.reserve(digits.size());
+        for (char c : digits) {
+            if (c != '_') cleaned += c;
+        }
+        digits = cleaned;
+    }
+
+    double value;
+    std::from_chars_result parsed = std::from_chars(digits.data(), digits.data() + digits.size(), value);
+    if (parsed.ec == std::errc::result_out_of_range) {
+        // Too big becomes infinity, too small becomes zero
+        bool too_big = decimal.exponent + decimal.significant_digits > 0;
+        value = too_big ? std::numeric_limits<double>::infinity() : 0.0;
+    }
+    else if (parsed.ec != std::errc() || parsed.ptr != digits.data() + digits.size()) return false;
+
+    result = negative ? -value : value;
+    return true;
+}
@@ -0,0 +1,23 @@
+/* Decimal string to number conversion that rounds correctly, used by the lexer and Number.parse.
+    Short numbers, up to 19 significant digits with a small exponent, are converted with a
+    single exact floating-point operation (Clinger's fast path). Everything else goes through
+    std::from_chars, which is the Eisel-Lemire algorithm (fast_float) in libstdc++. */
+
+#ifndef _SGCPP_NUMBER_PARSE_HPP
+#define _SGCPP_NUMBER_PARSE_HPP
+
+#include "globals.hpp"
+
+#include <string_view>
+
+namespace NumberParse {
+    /**
+     * Parses [+-]digits[.digits][(e|E)[+-]digits], as well as Infinity and NaN.
+     * Either side of the decimal point may be empty, but not both.
+     * @param {bool} allow_separators - Allow single '_' characters between digits, e.g. 1_000_000
+     * @return {bool} - False if the whole string is not a number
+     */
+    bool parse(std::string_view str, Values::number_t &result, bool allow_separators);
+};
+
+#endif
@@ -0,0 +1,240 @@
+#include "inliner.hpp"
+
+#include <unordered_map>
+
+using Intermediate::Instruction, Intermediate::InstrCode, Intermediate::Variable, Intermediate::Label, Intermediate::label_index_t;
+
+namespace {
+    /* Maximum number of instructions in a function's body for it to be inlined */
+    const size_t MAX_INLINE_SIZE = 32;
+    /* Maximum number of instructions inlining can add to one function */
+    const size_t MAX_INLINE_GROWTH = 256;
+
+    /* A call that will be replaced by the function's body */
+    struct call_site_t {
+        uint label;
+        /* Index of the direct call */
+        uint index;
+        uint function_index;
+    };
+
+    enum visit_state_t {
+        NOT_VISITED,
+        VISITING,
+        VISITED
+    };
+
+    class Inliner {
+        private:
+            Intermediate::LabelIR &ir;
+
+            std::vector<visit_state_t> states;
+            std::vector<bool> recursive;
+            /* The functions being visited, the innermost last */
+            std::vector<uint> visiting = std::vector<uint>();
+
+            inline Intermediate::Block *get_block(int function_ind) {
+                return function_ind == Intermediate::global_function_ind ?
+                    this->ir.get_main()->get_block() : this->ir.get_function(function_ind)->get_block();
+            }
+            /* The number of instructions that are copied to inline the function. If its first label returns
+                before any jump, only the instructions before that return are, and straight_line is set. */
+            size_t body_size(uint function_index, bool &straight_line);
+            bool can_inline(uint function_index);
+            void inline_call(int function_ind, const call_site_t &site);
+        public:
+            Inliner(Intermediate::LabelIR &ir);
+
+            /* Inlines the calls in a function, after inlining into the functions it calls */
+            void visit(int function_ind);
+    };
+}
+
+Inliner::Inliner(Intermediate::LabelIR &ir) : ir(ir) {
+    size_t function_count = ir.last_function_index() + 1;
+    this->states = std::vector<visit_state_t>(function_count, NOT_VISITED);
+    this->recursive = std::vector<bool>(function_count, false);
+}
+
+size_t Inliner::body_size(uint function_index, bool &straight_line) {
+    Intermediate::Block *body = this->ir.get_function(function_index)->get_block();
+
+    straight_line = false;
+    if (body->label_count() == 0) return 0;
+
+    const Intermediate::intermediate_set_t &first = body->get_label_at_numerical_index(0).instructions;
+    for (uint index = 0; index < first.size(); index += 1) {
+        if (first[index].is_jump()) break;
+        if (first[index].code == InstrCode::INSTR_RETURN) {
+            straight_line = true;
+            return index;
+        }
+    }
+
+    size_t size = 0;
+    for (const Label &label : *body) size += label.instructions.size();
+    return size;
+}
+
+bool Inliner::can_inline(uint function_index) {
+    if (this->states[function_index] != VISITED || this->recursive[function_index]) return false;
+
+    // Inlining would skip the cache
+    Intermediate::Function *function = this->ir.get_function(function_index);
+    if (function->is_memoized() || function->get_block()->label_count() == 0) return false;
+
+    for (const Label &label : *function->get_block()) {
+        for (const Instruction &instr : label.instructions) {
+            if (instr.code == InstrCode::INSTR_MAKE_FUNCTION || instr.code == InstrCode::INSTR_EXIT) return false;
+        }
+    }
+
+    bool straight_line;
+    return this->body_size(function_index, straight_line) <= MAX_INLINE_SIZE;
+}
+
+void Inliner::inline_call(int function_ind, const call_site_t &site) {
+    Intermediate::Block *block = this->get_block(function_ind);
+    Intermediate::Function *function = this->ir.get_function(site.function_index);
+    Intermediate::Block *body = function->get_block();
+
+    // The function's arguments and variables become temporaries of the caller
+    Intermediate::VariableType temporary_type = function_ind == Intermediate::global_function_ind ?
+        Intermediate::GLOBAL_MUTABLE : Intermediate::FUNCTION_MUTABLE;
+    std::unordered_map<Variable, Variable*, Intermediate::VariableHasher> locals = std::unordered_map<Variable, Variable*, Intermediate::VariableHasher>();
+    auto local = [&](Variable *variable) {
+        auto found = locals.find(*variable);
+        if (found != locals.end()) return found->second;
+
+        Variable *temporary = this->ir.new_temporary(temporary_type, function_ind);
+        locals[*variable] = temporary;
+        return temporary;
+    };
+    auto copy = [&](const Instruction &instr) {
+        Instruction copied = instr.copy();
+        if ((instr.code == InstrCode::INSTR_LOAD || instr.code == InstrCode::INSTR_STORE) && instr.get_variable()->is_local_function_var()) {
+            copied.payload.variable = local(instr.get_variable());
+        }
+        return copied;
+    };
+
+    // The arguments are on the stack, the last one on top
+    Intermediate::intermediate_set_t inlined = Intermediate::intermediate_set_t();
+    for (uint argument = function->argument_count(); argument > 0; argument -= 1) {
+        inlined.push_back(Instruction(InstrCode::INSTR_STORE, local(function->get_argument(argument - 1))));
+    }
+
+    Intermediate::intermediate_set_t &instructions = block->get_label_at_numerical_index(site.label).instructions;
+
+    bool straight_line;
+    size_t size = this->body_size(site.function_index, straight_line);
+    if (straight_line) {
+        const Intermediate::intermediate_set_t &first = body->get_label_at_numerical_index(0).instructions;
+        for (uint index = 0; index < size; index += 1) inlined.push_back(copy(first[index]));
+
+        // Replace the call
+        instructions.erase(instructions.begin() + site.index);
+        instructions.insert(instructions.begin() + site.index, inlined.begin(), inlined.end());
+        return;
+    }
+
+    // Returns go to a label with the rest of the caller's label
+    std::unordered_map<label_index_t, label_index_t*> names = std::unordered_map<label_index_t, label_index_t*>();
+    for (const Label &label : *body) names[*label.name] = block->gen_label_name();
+    label_index_t *rest = block->gen_label_name();
+
+    Intermediate::intermediate_set_t after = Intermediate::intermediate_set_t(instructions.begin() + site.index + 1, instructions.end());
+    instructions.erase(instructions.begin() + site.index, instructions.end());
+    instructions.insert(instructions.end(), inlined.begin(), inlined.end());
+    instructions.push_back(Instruction(InstrCode::INSTR_GOTO, names.at(*body->get_label_at_numerical_index(0).name)));
+
+    // Inserting labels moves the caller's labels, so its label can't be used after this
+    for (uint label_ind = 0; label_ind < body->label_count(); label_ind += 1) {
+        const Label &label = body->get_label_at_numerical_index(label_ind);
+        Label &copied = block->insert_label(site.label + 1 + label_ind, names.at(*label.name));
+
+        bool terminated = false;
+        for (const Instruction &instr : label.instructions) {
+            if (instr.code == InstrCode::INSTR_RETURN) {
+                copied.instructions.push_back(Instruction(InstrCode::INSTR_GOTO, rest));
+                terminated = true;
+                break;
+            }
+
+            Instruction copied_instr = copy(instr);
+            if (instr.is_jump()) copied_instr.payload.label = names.at(*instr.get_address());
+            copied.instructions.push_back(copied_instr);
+
+            if (instr.code == InstrCode::INSTR_GOTO) {
+                terminated = true;
+                break;
+            }
+        }
+
+        // A label that doesn't end in a goto falls into the next one
+        if (!terminated) {
+            label_index_t *next = label_ind + 1 < body->label_count() ?
+                names.at(*body->get_label_at_numerical_index(label_ind + 1).name) : rest;
+            copied.instructions.push_back(Instruction(InstrCode::INSTR_GOTO, next));
+        }
+    }
+    block->insert_label(site.label + 1 + body->label_count(), rest).instructions = after;
+}
+
+void Inliner::visit(int function_ind) {
+    if (function_ind != Intermediate::global_function_ind) {
+        if (this->states[function_ind] == VISITING) {
+            // Every function visited since this one calls back into it
+            for (auto caller = this->visiting.rbegin(); caller != this->visiting.rend(); caller++) {
+                this->recursive[*caller] = true;
+                if (static_cast<int>(*caller) == function_ind) break;
+            }
+            return;
+        }
+        if (this->states[function_ind] == VISITED) return;
+
+        this->states[function_ind] = VISITING;
+        this->visiting.push_back(function_ind);
+    }
+
+    Intermediate::Block *block = this->get_block(function_ind);
+    std::vector<call_site_t> sites = std::vector<call_site_t>();
+    size_t growth = 0;
+    for (uint label_ind = 0; label_ind < block->label_count(); label_ind += 1) {
+        const Intermediate::intermediate_set_t &instructions = block->get_label_at_numerical_index(label_ind).instructions;
+
+        for (uint index = 0; index < instructions.size(); index += 1) {
+            if (instructions[index].code != InstrCode::INSTR_CALL_FUNCTION) continue;
+            uint function_index = instructions[index].get_function_index();
+
+            this->visit(function_index);
+            if (!this->can_inline(function_index)) continue;
+
+            bool straight_line;
+            size_t size = this->body_size(function_index, straight_line);
+            if (growth + size > MAX_INLINE_GROWTH) continue;
+
+            growth += size;
+            sites.push_back({ label_ind, index, function_index });
+        }
+    }
+
+    // Last first, so inlining a call doesn't move the calls before it
+    for (auto site = sites.rbegin(); site != sites.rend(); site++) {
+        this->inline_call(function_ind, *site);
+    }
+
+    if (function_ind != Intermediate::global_function_ind) {
+        this->states[function_ind] = VISITED;
+        this->visiting.pop_back();
+    }
+}
+
+void inline_functions(Intermediate::LabelIR &ir) {
+    Inliner inliner = Inliner(ir);
+
+    for (int func_index = 0; func_index < ir.last_function_index() + 1; func_index += 1) {
+        inliner.visit(func_index);
+    }
+    inliner.visit(Intermediate::global_function_ind);
+}
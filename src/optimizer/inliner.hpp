@@ -0,0 +1,19 @@
+/* Inlining of small functions */
+
+#ifndef _SGCPP_INLINER_HPP
+#define _SGCPP_INLINER_HPP
+
+#include "../ir/intermediate.hpp"
+
+/* Replaces direct calls to small functions with a copy of the function's body. A call is only
+    inlined if analyze_program resolved it to the function, and the function isn't recursive,
+    directly or through other functions.
+    The function's arguments and variables become temporaries of the caller, and its returns become
+    gotos to a label with the rest of the caller's label. A function whose body is one label that
+    returns at its end is copied in place, without any new labels.
+    Functions are inlined into before they are inlined anywhere, so small functions that call small
+    functions are inlined all the way down. Each body is kept under a size, and so is the total
+    growth of each function. */
+void inline_functions(Intermediate::LabelIR &ir);
+
+#endif
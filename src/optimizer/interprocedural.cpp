@@ -0,0 +1,315 @@
+#include "interprocedural.hpp"
+#include "../natives/natives.hpp"
+
+#include <unordered_map>
+
+using Intermediate::Instruction, Intermediate::InstrCode, Intermediate::Variable, Intermediate::Label, Intermediate::label_index_t;
+
+namespace {
+    // A function whose reference isn't stored to a constant global in the first label
+    const uint NOT_DECLARED = static_cast<uint>(-1);
+
+    /* A global that always holds a constant, and where the main block stores it */
+    struct constant_global_t {
+        /* Index of the constant in the first label of the main block */
+        uint constant;
+        /* Index of the store of the global in the same label */
+        uint store;
+        /* Nothing is called before the store, so no function can load the global before it */
+        bool before_calls;
+    };
+    typedef std::unordered_map<Variable, constant_global_t, Intermediate::VariableHasher> constant_map_t;
+
+    class ProgramAnalyzer {
+        private:
+            Intermediate::LabelIR &ir;
+            const Runtime &runtime;
+            Output &output;
+            constant_map_t constants = constant_map_t();
+            /* Where the main block stores each function's reference to the global named after it,
+                in the first label. A function can only run after that store. */
+            std::vector<uint> declarations;
+
+            inline Intermediate::Block *get_block(int function_ind) {
+                return function_ind == Intermediate::global_function_ind ?
+                    this->ir.get_main()->get_block() : this->ir.get_function(function_ind)->get_block();
+            }
+            /* The native a chain of a native load and namespace member reads ending before the
+                index is. Sets where the chain starts. */
+            bool resolve_native(const Intermediate::intermediate_set_t &instructions, uint index, uint &start, Values::native_method_t &method) const;
+            /* Whether the function only does pure work, given which functions are pure so far */
+            bool is_pure(uint function_index, const std::vector<bool> &pure) const;
+        public:
+            ProgramAnalyzer(Intermediate::LabelIR &ir, const Runtime &runtime, Output &output);
+
+            void find_constant_globals();
+            void replace_constant_loads(int function_ind);
+            void resolve_calls(int function_ind);
+            void find_pure_functions();
+    };
+}
+
+ProgramAnalyzer::ProgramAnalyzer(Intermediate::LabelIR &ir, const Runtime &runtime, Output &output) :
+    ir(ir), runtime(runtime), output(output), declarations(ir.last_function_index() + 1, NOT_DECLARED) {}
+
+void ProgramAnalyzer::find_constant_globals() {
+    Intermediate::Block *main = this->ir.get_main()->get_block();
+    if (main->label_count() == 0) return;
+    const label_index_t &entry = *main->get_label_at_numerical_index(0).name;
+
+    // A global is only constant if nothing else stores to it
+    std::unordered_map<Variable, uint, Intermediate::VariableHasher> stores = std::unordered_map<Variable, uint, Intermediate::VariableHasher>();
+    for (int function_ind = Intermediate::global_function_ind; function_ind < this->ir.last_function_index() + 1; function_ind += 1) {
+        for (const Label &label : *this->get_block(function_ind)) {
+            for (const Instruction &instr : label.instructions) {
+                // Running the first label again would store the globals again
+                if (instr.is_jump() && function_ind == Intermediate::global_function_ind && *instr.get_address() == entry) return;
+
+                if (instr.code == InstrCode::INSTR_STORE && instr.get_variable()->is_global()) {
+                    stores[*instr.get_variable()] += 1;
+                }
+            }
+        }
+    }
+
+    // Stores before the first jump always run, and before anything after them
+    const Intermediate::intermediate_set_t &first = main->get_label_at_numerical_index(0).instructions;
+    bool called = false;
+    for (uint index = 0; index + 1 < first.size(); index += 1) {
+        const Instruction &instr = first[index];
+        if (instr.is_jump() || instr.code == InstrCode::INSTR_RETURN || instr.code == InstrCode::INSTR_EXIT) break;
+        if (instr.is_call()) called = true;
+
+        // A global given the value of a constant global, like var f = sqrt, holds the same constant
+        uint constant = index;
+        if (instr.code == InstrCode::INSTR_LOAD) {
+            auto found = instr.get_variable()->is_global() ? this->constants.find(*instr.get_variable()) : this->constants.end();
+            if (found == this->constants.end()) continue;
+            constant = found->second.constant;
+        }
+        else if (!instr.is_constant()) continue;
+
+        const Instruction &store = first[index + 1];
+        if (store.code != InstrCode::INSTR_STORE || !store.get_variable()->is_global()) continue;
+        if (stores[*store.get_variable()] != 1) continue;
+
+        this->constants[*store.get_variable()] = { constant, index + 1, !called };
+        if (first[constant].code == InstrCode::INSTR_GET_FUNCTION_REFERENCE) {
+            uint &declaration = this->declarations[first[constant].get_function_index()];
+            if (declaration == NOT_DECLARED) declaration = index + 1;
+        }
+    }
+}
+
+void ProgramAnalyzer::replace_constant_loads(int function_ind) {
+    if (this->constants.empty()) return;
+
+    const Intermediate::intermediate_set_t &first = this->ir.get_main()->get_block()->get_label_at_numerical_index(0).instructions;
+    Intermediate::Block *block = this->get_block(function_ind);
+    for (uint label_ind = 0; label_ind < block->label_count(); label_ind += 1) {
+        Intermediate::intermediate_set_t &instructions = block->get_label_at_numerical_index(label_ind).instructions;
+
+        for (uint index = 0; index < instructions.size(); index += 1) {
+            Instruction &instr = instructions[index];
+            if (instr.code != InstrCode::INSTR_LOAD || !instr.get_variable()->is_global()) continue;
+
+            auto found = this->constants.find(*instr.get_variable());
+            if (found == this->constants.end()) continue;
+
+            // The global has to be stored by the time the load runs. A function runs after its own
+            // declaration, so it can always load itself, and the globals stored before it.
+            bool stored = function_ind == Intermediate::global_function_ind ?
+                label_ind > 0 || index > found->second.store :
+                found->second.before_calls || (
+                    this->declarations[function_ind] != NOT_DECLARED && this->declarations[function_ind] >= found->second.store
+                );
+            if (!stored) continue;
+
+            instr = first[found->second.constant].copy();
+        }
+    }
+}
+
+bool ProgramAnalyzer::resolve_native(const Intermediate::intermediate_set_t &instructions, uint index, uint &start, Values::native_method_t &method) const {
+    start = index;
+    while (start > 0 && instructions[start - 1].code == InstrCode::INSTR_CONSTANT_PROPERTY_ACCESS) start -= 1;
+    if (start == 0) return false;
+
+    start -= 1;
+    const Instruction &load = instructions[start];
+    if (load.code != InstrCode::INSTR_LOAD || load.get_variable()->type != Intermediate::NATIVE) return false;
+
+    Values::Value value = this->runtime.get_native(Natives::get_native_index(*load.get_variable()->name));
+    for (uint member = start + 1; member < index; member += 1) {
+        if (!Natives::get_member(value, *instructions[member].payload.str, value)) return false;
+    }
+    if (Values::get_value_type(value) != Values::ValueType::NATIVE_FUNCTION) return false;
+
+    method = Values::get_value_native_function(value);
+    return true;
+}
+
+void ProgramAnalyzer::resolve_calls(int function_ind) {
+    Intermediate::Block *block = this->get_block(function_ind);
+    for (uint label_ind = 0; label_ind < block->label_count(); label_ind += 1) {
+        Intermediate::intermediate_set_t &instructions = block->get_label_at_numerical_index(label_ind).instructions;
+
+        for (uint index = 1; index < instructions.size(); index += 1) {
+            if (instructions[index].code != InstrCode::INSTR_CALL) continue;
+            uint argument_count = instructions[index].get_argument_count();
+
+            // The compiler rejects calls with the wrong number of arguments, but only rewrite the ones that match
+            const Instruction &callee = instructions[index - 1];
+            if (callee.code == InstrCode::INSTR_GET_FUNCTION_REFERENCE) {
+                uint function_index = callee.get_function_index();
+                if (this->ir.get_function(function_index)->argument_count() != argument_count) continue;
+
+                instructions[index] = Instruction(InstrCode::INSTR_CALL_FUNCTION, function_index);
+                instructions.erase(instructions.begin() + index - 1);
+                index -= 1;
+                continue;
+            }
+
+            uint start;
+            Values::native_method_t method;
+            if (!this->resolve_native(instructions, index, start, method)) continue;
+            if (method.number_arguments != Values::VARIADIC_ARGUMENTS && method.number_arguments != static_cast<int>(argument_count)) continue;
+
+            instructions[index] = Instruction(InstrCode::INSTR_CALL_NATIVE, Intermediate::native_call_t{ this->ir.add_native(method), argument_count });
+            for (uint member = start; member < index; member += 1) instructions[member].free_payload();
+            instructions.erase(instructions.begin() + start, instructions.begin() + index);
+            index = start;
+        }
+    }
+}
+
+bool ProgramAnalyzer::is_pure(uint function_index, const std::vector<bool> &pure) const {
+    for (const Label &label : *this->ir.get_function(function_index)->get_block()) {
+        // Whether the top of the stack is a native namespace, or a member of one
+        bool in_namespace = false;
+
+        for (const Instruction &instr : label.instructions) {
+            bool was_in_namespace = in_namespace;
+            in_namespace = false;
+
+            switch (instr.code) {
+                case InstrCode::INSTR_TRUE:
+                case InstrCode::INSTR_FALSE:
+                case InstrCode::INSTR_NULL:
+                case InstrCode::INSTR_NUMBER:
+                case InstrCode::INSTR_STRING:
+                case InstrCode::INSTR_GET_FUNCTION_REFERENCE:
+                case InstrCode::INSTR_POP:
+                case InstrCode::INSTR_DUP:
+                case InstrCode::INSTR_GOTO:
+                case InstrCode::INSTR_POP_JIZ:
+                case InstrCode::INSTR_POP_JNZ:
+                case InstrCode::INSTR_BIN_OP:
+                case InstrCode::INSTR_UNARY_OP:
+                case InstrCode::INSTR_RETURN:
+                    break;
+                case InstrCode::INSTR_LOAD:
+                    if (instr.get_variable()->type == Intermediate::NATIVE) {
+                        in_namespace = Natives::is_namespace(Natives::get_native_index(*instr.get_variable()->name));
+                        break;
+                    }
+                    if (!instr.get_variable()->is_local_function_var()) return false;
+                    break;
+                case InstrCode::INSTR_STORE:
+                    if (!instr.get_variable()->is_local_function_var()) return false;
+                    break;
+                // Namespaces never change, but records and arrays can
+                case InstrCode::INSTR_CONSTANT_PROPERTY_ACCESS:
+                    if (!was_in_namespace) return false;
+                    in_namespace = true;
+                    break;
+                case InstrCode::INSTR_CALL_NATIVE:
+                    if (!(this->ir.call_flags(instr) & Values::NATIVE_PURE)) return false;
+                    break;
+                case InstrCode::INSTR_CALL_FUNCTION:
+                    if (!pure[instr.get_function_index()]) return false;
+                    break;
+                default:
+                    return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+void ProgramAnalyzer::find_pure_functions() {
+    size_t function_count = this->ir.last_function_index() + 1;
+
+    // Every function is pure until it does something that isn't, so recursive functions can be pure
+    std::vector<bool> pure = std::vector<bool>(function_count, true);
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (uint function_index = 0; function_index < function_count; function_index += 1) {
+            if (pure[function_index] && !this->is_pure(function_index, pure)) {
+                pure[function_index] = false;
+                changed = true;
+            }
+        }
+    }
+
+    // Adding strings makes a new string, and so does calling anything that does
+    std::vector<bool> allocates = std::vector<bool>(function_count, false);
+    changed = true;
+    while (changed) {
+        changed = false;
+        for (uint function_index = 0; function_index < function_count; function_index += 1) {
+            if (!pure[function_index] || allocates[function_index]) continue;
+
+            for (const Label &label : *this->ir.get_function(function_index)->get_block()) {
+                for (const Instruction &instr : label.instructions) {
+                    bool allocating = (instr.code == InstrCode::INSTR_BIN_OP && instr.get_bin_op() == Operations::BINOP_ADD) ||
+                        (instr.code == InstrCode::INSTR_CALL_NATIVE && (this->ir.call_flags(instr) & Values::NATIVE_ALLOCATES)) ||
+                        (instr.code == InstrCode::INSTR_CALL_FUNCTION && allocates[instr.get_function_index()]);
+                    if (allocating) {
+                        allocates[function_index] = true;
+                        changed = true;
+                    }
+                }
+            }
+        }
+    }
+
+    // Any op can be given the wrong types, and any call can overflow the stack
+    for (uint function_index = 0; function_index < function_count; function_index += 1) {
+        // Only a pure function gives the same result for the same arguments, so only its results can be cached
+        Intermediate::Function *function = this->ir.get_function(function_index);
+        if (!pure[function_index]) {
+            if (function->is_memoized()) {
+                std::string name;
+                truncate_string(name, 30, function->get_name());
+                this->output.warning(function->get_position(), "@memo has no effect on \"" + name +
+                    "\", since it isn't pure. Its results can depend on more than its arguments, so calls to it aren't cached.");
+                function->set_memoized(false);
+            }
+            continue;
+        }
+
+        Values::native_flags_t flags = Values::NATIVE_PURE | Values::NATIVE_MAY_FAIL;
+        if (allocates[function_index]) flags |= Values::NATIVE_ALLOCATES;
+        function->set_flags(flags);
+    }
+}
+
+void analyze_program(Intermediate::LabelIR &ir, const Runtime &runtime, Output &output) {
+    ProgramAnalyzer analyzer = ProgramAnalyzer(ir, runtime, output);
+
+    analyzer.find_constant_globals();
+    analyzer.replace_constant_loads(Intermediate::global_function_ind);
+    for (int func_index = 0; func_index < ir.last_function_index() + 1; func_index += 1) {
+        analyzer.replace_constant_loads(func_index);
+    }
+
+    analyzer.resolve_calls(Intermediate::global_function_ind);
+    for (int func_index = 0; func_index < ir.last_function_index() + 1; func_index += 1) {
+        analyzer.resolve_calls(func_index);
+    }
+
+    analyzer.find_pure_functions();
+}
@@ -0,0 +1,23 @@
+/* Analysis of the whole program, across functions */
+
+#ifndef _SGCPP_INTERPROCEDURAL_HPP
+#define _SGCPP_INTERPROCEDURAL_HPP
+
+#include "../ir/intermediate.hpp"
+#include "../runtime/runtime.hpp"
+
+/* Works out what the program can only ever do, before the passes that look at one function at a time:
+        A global stored once, to a constant, before any jump in the first label of the main block,
+        always holds that constant by the time it is loaded. Its loads become the constant, in
+        functions too if nothing is called before the store, or the function is declared there
+        after the store.
+        A call to a function reference with as many arguments as the function takes calls it
+        directly, without loading it or checking it when the program runs.
+        So does a call to a native, or a member of native namespaces, like Math.sqrt.
+        A function that only does pure work on its locals, and only calls pure natives and pure
+        functions, is pure. Its flags say so, like the flags of a native, for the passes after.
+        Only pure functions keep @memo, since other functions can give different results for
+        the same arguments. The others are warned about. */
+void analyze_program(Intermediate::LabelIR &ir, const Runtime &runtime, Output &output);
+
+#endif
@@ -1,11 +1,61 @@
 #include "label-intermediate.hpp"
+#include "inliner.hpp"
+#include "interprocedural.hpp"
+#include "licm.hpp"
+#include "ssa.hpp"
+#include "value-numbering.hpp"
 #include "../memory.hpp"
+#include "../natives/natives.hpp"
 
 #include <unordered_map>
 
 using Intermediate::intermediate_set_t, Intermediate::Instruction, Intermediate::InstrCode;
 
-static void optimize_block(Intermediate::Block * const old, Intermediate::Block * const optimized) {
+/* Is the instruction a load of a native namespace? Sets its index if it is. */
+static bool is_namespace_load(const Instruction &instr, uint &native_index) {
+    if (instr.code != InstrCode::INSTR_LOAD || instr.get_variable()->type != Intermediate::NATIVE) return false;
+
+    native_index = Natives::get_native_index(*instr.get_variable()->name);
+    return Natives::is_namespace(native_index);
+}
+
+/* A call whose result the function returns right away, after a goto or at the end of its
+    label, becomes a tail call. Only functions return, so this is never done to the main block. */
+static void mark_tail_calls(Intermediate::Block *block) {
+    std::unordered_map<Intermediate::label_index_t, uint> positions = std::unordered_map<Intermediate::label_index_t, uint>();
+    for (uint label_ind = 0; label_ind < block->label_count(); label_ind += 1) {
+        positions[*block->get_label_at_numerical_index(label_ind).name] = label_ind;
+    }
+
+    for (uint label_ind = 0; label_ind < block->label_count(); label_ind += 1) {
+        intermediate_set_t &instructions = block->get_label_at_numerical_index(label_ind).instructions;
+
+        for (uint index = 0; index < instructions.size(); index += 1) {
+            if (instructions[index].code != InstrCode::INSTR_CALL && instructions[index].code != InstrCode::INSTR_CALL_FUNCTION) continue;
+
+            // A label that doesn't end in a goto falls into the next one
+            uint next_label = label_ind + 1;
+            uint next = index + 1;
+            if (next < instructions.size() && instructions[next].code == InstrCode::INSTR_GOTO) {
+                next_label = positions.at(*instructions[next].get_address());
+                next = instructions.size();
+            }
+            const intermediate_set_t *following = &instructions;
+            if (next == instructions.size()) {
+                if (next_label >= block->label_count()) continue;
+                following = &block->get_label_at_numerical_index(next_label).instructions;
+                next = 0;
+            }
+
+            if (next < following->size() && following->at(next).code == InstrCode::INSTR_RETURN) {
+                instructions[index].code = instructions[index].code == InstrCode::INSTR_CALL ?
+                    InstrCode::INSTR_TAIL_CALL : InstrCode::INSTR_TAIL_CALL_FUNCTION;
+            }
+        }
+    }
+}
+
+static void optimize_block(Intermediate::Block * const old, Intermediate::Block * const optimized, Intermediate::LabelIR &ir, Runtime &runtime) {
     using Intermediate::Label, Intermediate::label_index_t;
 
     /* Maximum size of a label to be unrolled */
@@ -30,6 +80,23 @@ static void optimize_block(Intermediate::Block * const old, Intermediate::Block
             // The last instruction in the optimized set
             Instruction last = label.at(label.size() - 1);
 
+            /* Constant array folding. If every element is a constant, the array is built once
+                before the program runs, and each evaluation only makes a copy-on-write view of it. */
+            if (instr.code == InstrCode::INSTR_MAKE_ARRAY) {
+                uint element_count = instr.get_array_element_count();
+                bool all_constant = element_count > 0 && label.size() >= element_count;
+                for (uint element = label.size() - element_count; all_constant && element < label.size(); element += 1) {
+                    all_constant = label.at(element).is_constant();
+                }
+
+                if (all_constant) {
+                    intermediate_set_t elements = intermediate_set_t(label.end() - element_count, label.end());
+                    label.erase(label.end() - element_count, label.end());
+                    label.push_back(Instruction(InstrCode::INSTR_CONSTANT_ARRAY, ir.add_constant_array(elements)));
+                    continue;
+                }
+            }
+
             /* Jump folding */
             if (last.is_constant() && (instr.code == InstrCode::INSTR_POP_JIZ || instr.code == InstrCode::INSTR_POP_JNZ)) {
                 // Remove the constant load, since we'll pop it anyway.
@@ -76,6 +143,7 @@ static void optimize_block(Intermediate::Block * const old, Intermediate::Block
                 // Push the result
                 Instruction value = Instruction::value_to_instruction(result);
                 label.push_back(value);
+                free_value_if_object(result);
 
                 continue;
             }
@@ -98,6 +166,51 @@ static void optimize_block(Intermediate::Block * const old, Intermediate::Block
 
                 continue;
             }
+            /* Namespace constant folding. Namespaces never change, so members like Math.PI are constants. */
+            uint native_index;
+            if (instr.code == InstrCode::INSTR_CONSTANT_PROPERTY_ACCESS && is_namespace_load(last, native_index)) {
+                Values::Value member;
+                if (Natives::get_member(runtime.get_native(native_index), *instr.payload.str, member) &&
+                    Values::get_value_type(member) == Values::ValueType::NUMBER) {
+                    label.pop_back();
+                    instr.free_payload();
+                    label.push_back(Instruction::value_to_instruction(member));
+
+                    continue;
+                }
+            }
+            /* Pure native call folding. A pure native that doesn't allocate is called now, if its arguments are constants. */
+            if (instr.code == InstrCode::INSTR_CALL_NATIVE && label.size() >= instr.get_native_call().num_arguments) {
+                uint argument_count = instr.get_native_call().num_arguments;
+                size_t first_argument = label.size() - argument_count;
+                const Values::native_method_t &method = ir.get_native(instr.get_native_call().native_index);
+
+                bool foldable = (method.flags & Values::NATIVE_PURE) && !(method.flags & Values::NATIVE_ALLOCATES);
+                for (size_t argument = first_argument; foldable && argument < first_argument + argument_count; argument += 1) {
+                    foldable = label.at(argument).is_constant();
+                }
+
+                if (foldable) {
+                    std::vector<Values::Value> arguments = std::vector<Values::Value>();
+                    for (size_t argument = first_argument; argument < first_argument + argument_count; argument += 1) {
+                        arguments.push_back(label.at(argument).payload_to_value());
+                    }
+
+                    // Errors are left for the program to run into
+                    Values::Value result;
+                    std::string error = "";
+                    bool valid = method.func(arguments.data(), argument_count, result, runtime, error) && error.size() == 0;
+                    for (Values::Value argument : arguments) free_value_if_object(argument);
+
+                    if (valid) {
+                        for (size_t folded = first_argument; folded < label.size(); folded += 1) label.at(folded).free_payload();
+                        label.erase(label.begin() + first_argument, label.end());
+                        label.push_back(Instruction::value_to_instruction(result));
+
+                        continue;
+                    }
+                }
+            }
             /* Unnecessary constant folding */
             if (last.is_static_flow_load() && instr.code == InstrCode::INSTR_POP) {
                 last.free_payload();
@@ -218,8 +331,39 @@ static void optimize_block(Intermediate::Block * const old, Intermediate::Block
     }
 }
 
-void optimize_labels(Intermediate::LabelIR &old, Intermediate::LabelIR &optimized) {
-    optimize_block(old.get_main()->get_block(), optimized.get_main()->get_block());
+void optimize_labels(Intermediate::LabelIR &old, Intermediate::LabelIR &optimized, Runtime &runtime, Output &output) {
+    // Resolve calls first, so inlining and the passes after it see through them
+    analyze_program(old, runtime, output);
+    inline_functions(old);
+
+    // Constants found across labels become loads that the peephole pass can fold
+    function_globals_t globals = find_function_globals(old);
+    propagate_constants(old.get_main()->get_block(), old, globals, true);
+    for (int func_index = 0; func_index < old.last_function_index() + 1; func_index += 1) {
+        propagate_constants(old.get_function(func_index)->get_block(), old, globals, false);
+    }
+
+    hoist_loop_invariants(old.get_main()->get_block(), old, globals, runtime, Intermediate::global_function_ind);
+    for (int func_index = 0; func_index < old.last_function_index() + 1; func_index += 1) {
+        hoist_loop_invariants(old.get_function(func_index)->get_block(), old, globals, runtime, func_index);
+    }
+
+    number_values(old.get_main()->get_block(), old, globals, runtime, Intermediate::global_function_ind);
+    for (int func_index = 0; func_index < old.last_function_index() + 1; func_index += 1) {
+        number_values(old.get_function(func_index)->get_block(), old, globals, runtime, func_index);
+    }
+
+    // Transfer natives, keeping their indices for the calls to them
+    for (uint native_index = 0; native_index < old.native_count(); native_index += 1) {
+        optimized.add_native(old.get_native(native_index));
+    }
+
+    optimize_block(old.get_main()->get_block(), optimized.get_main()->get_block(), optimized, runtime);
+
+    // Transfer structs
+    for (uint struct_index = 0; struct_index < old.struct_count(); struct_index += 1) {
+        optimized.add_struct(old.get_struct(struct_index));
+    }
 
     // Transfer functions
     for (int func_index = 0; func_index < old.last_function_index() + 1; func_index += 1) {
@@ -229,7 +373,10 @@ void optimize_labels(Intermediate::LabelIR &old, Intermediate::LabelIR &optimize
         for (uint arg_ind = 0; arg_ind < function->argument_count(); arg_ind += 1) {
             new_func->add_argument(function->get_argument(arg_ind));
         }
+        new_func->set_flags(function->get_flags());
+        new_func->set_memoized(function->is_memoized());
 
-        optimize_block(function->get_block(), new_func->get_block());
+        optimize_block(function->get_block(), new_func->get_block(), optimized, runtime);
+        mark_tail_calls(new_func->get_block());
     }
 }
\ No newline at end of file
@@ -4,9 +4,11 @@
 #define _SGCPP_LABEL_INTERMEDIATE_HPP
 
 #include "../ir/intermediate.hpp"
+#include "../runtime/runtime.hpp"
 
 /* Optimizes label IR. After optimization is done, assume that the old optimization block
-    CANNOT be used nor copied anymore. */
-void optimize_labels(Intermediate::LabelIR &old, Intermediate::LabelIR &optimized);
+    CANNOT be used nor copied anymore. The runtime's natives are called to fold pure native calls.
+    Warnings about the program, like @memo on a function that can't be memoized, go to the output. */
+void optimize_labels(Intermediate::LabelIR &old, Intermediate::LabelIR &optimized, Runtime &runtime, Output &output);
 
 #endif
\ No newline at end of file
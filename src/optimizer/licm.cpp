@@ -0,0 +1,379 @@
+#include "licm.hpp"
+#include "../natives/natives.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+using Intermediate::Instruction, Intermediate::InstrCode, Intermediate::Variable, Intermediate::Label, Intermediate::label_index_t;
+
+namespace {
+    /* A loop is the labels from its condition to the label that jumps back to it.
+        The loop's end label comes right after. */
+    struct loop_t {
+        uint condition;
+        uint last;
+    };
+
+    /* A run of instructions in a label that pushes one value */
+    struct expression_t {
+        bool invariant;
+        uint start;
+        uint end;
+        /* Doing it once saves something, so it isn't just a load or a constant the peephole pass folds */
+        bool worth_hoisting;
+        bool has_load;
+        bool may_fail;
+        /* Nothing before the expression in the loop's first iteration could fail or call anything */
+        bool anticipated;
+        /* A lone load of a native namespace */
+        bool is_namespace;
+    };
+    /* Anything that isn't invariant */
+    const expression_t VARIANT = { false, 0, 0, false, false, false, false, false };
+
+    /* Can't fail and doesn't call anything */
+    bool is_quiet(const Instruction &instr) {
+        switch (instr.code) {
+            case InstrCode::INSTR_POP:
+            case InstrCode::INSTR_DUP:
+            case InstrCode::INSTR_GOTO:
+            case InstrCode::INSTR_LOAD:
+            case InstrCode::INSTR_STORE:
+            case InstrCode::INSTR_MAKE_ARRAY:
+            case InstrCode::INSTR_CONSTANT_ARRAY:
+            case InstrCode::INSTR_MAKE_RECORD:
+            case InstrCode::INSTR_MAKE_FUNCTION:
+                return true;
+            default: return instr.is_constant();
+        }
+    }
+
+    /* A key that is the same for two runs of instructions that compute the same thing */
+    std::string expression_key(const Intermediate::intermediate_set_t &instructions, uint start, uint end) {
+        std::string key;
+        for (uint index = start; index < end; index += 1) {
+            const Instruction &instr = instructions[index];
+            key += std::to_string(instr.code);
+            key += ':';
+            switch (instr.code) {
+                case InstrCode::INSTR_STRING:
+                case InstrCode::INSTR_CONSTANT_PROPERTY_ACCESS:
+                    key += std::to_string(instr.payload.str->size());
+                    key += ':';
+                    key += *instr.payload.str;
+                    break;
+                case InstrCode::INSTR_LOAD: {
+                    const Variable *variable = instr.get_variable();
+                    key += std::to_string(variable->type) + ':' + std::to_string(variable->scope) + ':';
+                    key += std::to_string(variable->name->size()) + ':' + *variable->name;
+                }
+                    break;
+                default: {
+                    char payload[sizeof(Intermediate::ir_instruction_arg_t)];
+                    std::memcpy(payload, &instr.payload, sizeof(payload));
+                    key.append(payload, sizeof(payload));
+                }
+                    break;
+            }
+            key += ';';
+        }
+        return key;
+    }
+
+    class LoopHoister {
+        private:
+            Intermediate::Block *block;
+            Intermediate::LabelIR &ir;
+            const function_globals_t &globals;
+            const Runtime &runtime;
+            int function_ind;
+
+            std::unordered_map<label_index_t, uint> label_indices() const {
+                std::unordered_map<label_index_t, uint> indices = std::unordered_map<label_index_t, uint>();
+                for (uint label_ind = 0; label_ind < this->block->label_count(); label_ind += 1) {
+                    indices[*this->block->get_label_at_numerical_index(label_ind).name] = label_ind;
+                }
+                return indices;
+            }
+            bool is_invariant(const Variable *variable, const variable_set_t &stored, bool has_call) const;
+        public:
+            LoopHoister(Intermediate::Block *block, Intermediate::LabelIR &ir, const function_globals_t &globals, const Runtime &runtime, int function_ind) :
+                block(block), ir(ir), globals(globals), runtime(runtime), function_ind(function_ind) {};
+
+            /* The loop whose condition has the name, if it still has a shape that can be hoisted from */
+            bool find_loop(const label_index_t &condition, loop_t &loop) const;
+            std::vector<label_index_t> loop_conditions() const;
+            void hoist(const loop_t &loop);
+    };
+}
+
+bool LoopHoister::find_loop(const label_index_t &name, loop_t &loop) const {
+    std::unordered_map<label_index_t, uint> indices = this->label_indices();
+    auto found_condition = indices.find(name);
+    if (found_condition == indices.end()) return false;
+    loop.condition = found_condition->second;
+
+    // The goto at the end of the body is the last jump back to the condition
+    bool found = false;
+    for (uint label_ind = loop.condition + 1; label_ind < this->block->label_count(); label_ind += 1) {
+        for (const Instruction &instr : this->block->get_label_at_numerical_index(label_ind).instructions) {
+            if (instr.is_jump() && *instr.get_address() == name) {
+                loop.last = label_ind;
+                found = true;
+            }
+        }
+    }
+    if (!found || loop.last + 1 >= this->block->label_count()) return false;
+
+    // The condition is the only way in
+    for (uint label_ind = 0; label_ind < this->block->label_count(); label_ind += 1) {
+        if (label_ind >= loop.condition && label_ind <= loop.last) continue;
+
+        for (const Instruction &instr : this->block->get_label_at_numerical_index(label_ind).instructions) {
+            if (!instr.is_jump()) continue;
+
+            auto target = indices.find(*instr.get_address());
+            if (target != indices.end() && target->second > loop.condition && target->second <= loop.last) return false;
+        }
+    }
+
+    /* The preheader runs a copy of the condition, so it has to be straight line code
+        that can only leave for the end label, then go to the body */
+    const Label &condition = this->block->get_label_at_numerical_index(loop.condition);
+    const label_index_t &end = *this->block->get_label_at_numerical_index(loop.last + 1).name;
+    const label_index_t &body = *this->block->get_label_at_numerical_index(loop.condition + 1).name;
+    if (condition.instructions.size() == 0) return false;
+
+    for (uint index = 0; index < condition.instructions.size(); index += 1) {
+        const Instruction &instr = condition.instructions[index];
+        if (index == condition.instructions.size() - 1) {
+            return instr.code == InstrCode::INSTR_GOTO && *instr.get_address() == body;
+        }
+        if (instr.code == InstrCode::INSTR_GOTO || instr.code == InstrCode::INSTR_RETURN || instr.code == InstrCode::INSTR_EXIT) return false;
+        if (instr.is_jump() && *instr.get_address() != end) return false;
+    }
+    return false;
+}
+
+std::vector<label_index_t> LoopHoister::loop_conditions() const {
+    std::vector<std::pair<uint, label_index_t>> loops = std::vector<std::pair<uint, label_index_t>>();
+
+    // Only the condition of a loop is jumped back to
+    std::unordered_map<label_index_t, uint> indices = this->label_indices();
+    std::vector<bool> jumped_back = std::vector<bool>(this->block->label_count(), false);
+    for (uint label_ind = 0; label_ind < this->block->label_count(); label_ind += 1) {
+        for (const Instruction &instr : this->block->get_label_at_numerical_index(label_ind).instructions) {
+            if (!instr.is_jump()) continue;
+
+            auto target = indices.find(*instr.get_address());
+            if (target != indices.end() && target->second <= label_ind) jumped_back[target->second] = true;
+        }
+    }
+
+    for (uint label_ind = 0; label_ind < this->block->label_count(); label_ind += 1) {
+        if (!jumped_back[label_ind]) continue;
+
+        const label_index_t &name = *this->block->get_label_at_numerical_index(label_ind).name;
+        loop_t loop;
+        if (this->find_loop(name, loop)) loops.push_back({ loop.last - loop.condition, name });
+    }
+
+    // Smallest first, so inner loops come before the loops around them
+    std::stable_sort(loops.begin(), loops.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+
+    std::vector<label_index_t> conditions = std::vector<label_index_t>();
+    for (auto &[size, name] : loops) conditions.push_back(name);
+    return conditions;
+}
+
+bool LoopHoister::is_invariant(const Variable *variable, const variable_set_t &stored, bool has_call) const {
+    if (variable->type == Intermediate::NATIVE) return true;
+    if (!variable->is_global() && !variable->is_local_function_var()) return false;
+    if (stored.count(*variable) > 0) return false;
+
+    // A function the loop calls may store to the global
+    return !(has_call && variable->is_global() && this->globals.stored.count(*variable) > 0);
+}
+
+void LoopHoister::hoist(const loop_t &loop) {
+    /* What the loop changes */
+    variable_set_t stored = variable_set_t();
+    bool has_call = false;
+    for (uint label_ind = loop.condition; label_ind <= loop.last; label_ind += 1) {
+        for (const Instruction &instr : this->block->get_label_at_numerical_index(label_ind).instructions) {
+            if (instr.code == InstrCode::INSTR_STORE) stored.insert(*instr.get_variable());
+            if (instr.is_call() && !(this->ir.call_flags(instr) & Values::NATIVE_PURE)) has_call = true;
+        }
+    }
+
+    /* The preheader. Copy the condition before anything in it is replaced. */
+    Intermediate::intermediate_set_t preheader = Intermediate::intermediate_set_t();
+    for (const Instruction &instr : this->block->get_label_at_numerical_index(loop.condition).instructions) {
+        preheader.push_back(instr.copy());
+    }
+    Instruction enter_body = preheader.back();
+    preheader.pop_back();
+
+    // The temporary that holds each hoisted expression
+    std::unordered_map<std::string, Variable*> temporaries = std::unordered_map<std::string, Variable*>();
+    Intermediate::VariableType temporary_type = this->function_ind == Intermediate::global_function_ind ?
+        Intermediate::GLOBAL_MUTABLE : Intermediate::FUNCTION_MUTABLE;
+
+    for (uint label_ind = loop.condition; label_ind <= loop.last; label_ind += 1) {
+        Label &label = this->block->get_label_at_numerical_index(label_ind);
+
+        /* The condition runs in the preheader before anything hoisted, and so does
+            the first label of the body up to the first thing that could fail. */
+        bool anticipated = label_ind == loop.condition || label_ind == loop.condition + 1;
+
+        std::vector<expression_t> stack = std::vector<expression_t>();
+        std::vector<expression_t> hoisted = std::vector<expression_t>();
+
+        auto finish = [&hoisted](const expression_t &expression) {
+            if (expression.invariant && expression.worth_hoisting && expression.has_load &&
+                (!expression.may_fail || expression.anticipated)) hoisted.push_back(expression);
+        };
+        auto pop = [&stack]() {
+            if (stack.size() == 0) return VARIANT;
+            expression_t top = stack.back();
+            stack.pop_back();
+            return top;
+        };
+
+        for (uint index = 0; index < label.instructions.size(); index += 1) {
+            const Instruction &instr = label.instructions[index];
+
+            if (instr.is_constant()) {
+                stack.push_back(expression_t{ true, index, index + 1, false, false, false, anticipated, false });
+                continue;
+            }
+            if (instr.code == InstrCode::INSTR_LOAD && this->is_invariant(instr.get_variable(), stored, has_call)) {
+                const Variable *variable = instr.get_variable();
+                bool is_namespace = variable->type == Intermediate::NATIVE && Natives::is_namespace(Natives::get_native_index(*variable->name));
+                stack.push_back(expression_t{ true, index, index + 1, false, true, false, anticipated, is_namespace });
+                continue;
+            }
+            if (instr.code == InstrCode::INSTR_CONSTANT_PROPERTY_ACCESS) {
+                expression_t object = pop();
+                if (object.invariant && object.is_namespace && object.end == index) {
+                    stack.push_back(expression_t{ true, object.start, index + 1, true, true, false, object.anticipated, false });
+                    continue;
+                }
+                finish(object);
+                anticipated = false;
+                stack.push_back(VARIANT);
+                continue;
+            }
+            if (instr.code == InstrCode::INSTR_BIN_OP || instr.code == InstrCode::INSTR_UNARY_OP) {
+                expression_t b = pop();
+                expression_t a = instr.code == InstrCode::INSTR_BIN_OP ? pop() : b;
+                bool contiguous = instr.code == InstrCode::INSTR_UNARY_OP || a.end == b.start;
+
+                if (a.invariant && b.invariant && contiguous && b.end == index) {
+                    stack.push_back(expression_t{
+                        true, a.start, index + 1, true, a.has_load || b.has_load, true, a.anticipated && b.anticipated, false });
+                    continue;
+                }
+                if (instr.code == InstrCode::INSTR_BIN_OP) finish(a);
+                finish(b);
+                anticipated = false;
+                stack.push_back(VARIANT);
+                continue;
+            }
+
+            /* A pure native or function called on invariants gives the same result on every iteration.
+                Native calls on constants alone are left for the peephole pass to fold, unless they make an object. */
+            Values::native_flags_t flags = this->ir.call_flags(instr);
+            size_t pops, pushes;
+            this->ir.stack_effect(instr, pops, pushes);
+            if ((flags & Values::NATIVE_PURE) && stack.size() >= pops) {
+                std::vector<expression_t> arguments = std::vector<expression_t>(stack.end() - pops, stack.end());
+                stack.erase(stack.end() - pops, stack.end());
+
+                bool invariant = true;
+                bool has_load = instr.code == InstrCode::INSTR_CALL_FUNCTION || (flags & Values::NATIVE_ALLOCATES);
+                expression_t call = expression_t{ true, index, index + 1, true, has_load,
+                    (flags & Values::NATIVE_MAY_FAIL) != 0, anticipated, false };
+                for (auto argument = arguments.rbegin(); argument != arguments.rend(); argument++) {
+                    invariant = invariant && argument->invariant && argument->end == call.start;
+                    call.start = argument->start;
+                    call.has_load = call.has_load || argument->has_load;
+                    call.anticipated = call.anticipated && argument->anticipated;
+                }
+
+                if (invariant) {
+                    stack.push_back(call);
+                    continue;
+                }
+                for (const expression_t &argument : arguments) finish(argument);
+                anticipated = false;
+                stack.push_back(VARIANT);
+                continue;
+            }
+
+            for (size_t operand = 0; operand < pops; operand += 1) finish(pop());
+            for (size_t result = 0; result < pushes; result += 1) stack.push_back(VARIANT);
+
+            if (!is_quiet(instr)) anticipated = false;
+        }
+        // Values left on the stack for the next label
+        for (const expression_t &expression : stack) finish(expression);
+
+        if (hoisted.size() == 0) continue;
+
+        /* Move each expression into the preheader and load its temporary instead */
+        std::sort(hoisted.begin(), hoisted.end(), [](const expression_t &a, const expression_t &b) { return a.start < b.start; });
+
+        Intermediate::intermediate_set_t rewritten = Intermediate::intermediate_set_t();
+        uint copied = 0;
+        for (const expression_t &expression : hoisted) {
+            rewritten.insert(rewritten.end(), label.instructions.begin() + copied, label.instructions.begin() + expression.start);
+            copied = expression.end;
+
+            std::string key = expression_key(label.instructions, expression.start, expression.end);
+            auto temporary = temporaries.find(key);
+            if (temporary == temporaries.end()) {
+                temporary = temporaries.emplace(key, this->ir.new_temporary(temporary_type, this->function_ind)).first;
+                for (uint index = expression.start; index < expression.end; index += 1) {
+                    preheader.push_back(label.instructions[index].copy());
+                }
+                preheader.push_back(Instruction(InstrCode::INSTR_STORE, temporary->second));
+            }
+
+            for (uint index = expression.start; index < expression.end; index += 1) {
+                label.instructions[index].free_payload();
+            }
+            rewritten.push_back(Instruction(InstrCode::INSTR_LOAD, temporary->second));
+        }
+        rewritten.insert(rewritten.end(), label.instructions.begin() + copied, label.instructions.end());
+        label.instructions = rewritten;
+    }
+
+    if (temporaries.size() == 0) {
+        for (Instruction &instr : preheader) instr.free_payload();
+        return;
+    }
+    preheader.push_back(enter_body);
+
+    /* Put the preheader before the loop, and send everything that entered the loop to it */
+    label_index_t *condition = this->block->get_label_at_numerical_index(loop.condition).name;
+    label_index_t *name = this->block->gen_label_name();
+    for (uint label_ind = 0; label_ind < this->block->label_count(); label_ind += 1) {
+        if (label_ind >= loop.condition && label_ind <= loop.last) continue;
+
+        for (Instruction &instr : this->block->get_label_at_numerical_index(label_ind).instructions) {
+            if (instr.is_jump() && *instr.get_address() == *condition) instr.payload.label = name;
+        }
+    }
+    this->block->insert_label(loop.condition, name).instructions = preheader;
+}
+
+void hoist_loop_invariants(Intermediate::Block *block, Intermediate::LabelIR &ir, const function_globals_t &globals, const Runtime &runtime, int function_ind) {
+    LoopHoister hoister = LoopHoister(block, ir, globals, runtime, function_ind);
+
+    for (const label_index_t &condition : hoister.loop_conditions()) {
+        loop_t loop;
+        if (hoister.find_loop(condition, loop)) hoister.hoist(loop);
+    }
+}
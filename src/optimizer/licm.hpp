@@ -0,0 +1,23 @@
+/* Loop invariant code motion */
+
+#ifndef _SGCPP_LICM_HPP
+#define _SGCPP_LICM_HPP
+
+#include "../ir/intermediate.hpp"
+#include "../runtime/runtime.hpp"
+#include "ssa.hpp"
+
+/* Finds the while loops in a block by their labels. Compiler::compile_while_loop puts the condition
+    in its own label, the body after it, and a goto back to the condition at the end of the body.
+    Work that is the same on every iteration is moved into a preheader label and kept in a
+    temporary the loop loads instead:
+        Members of native namespaces, like Math.sin
+        Bin and unary ops of constants and variables the loop never stores to
+        Calls to pure natives, like Math.sqrt, and pure functions, on those
+    The preheader checks the loop condition once before running the hoisted work, so an op that
+    could fail only runs when the loop would have run it first anyway. Ops in the body are only
+    hoisted if nothing before them in the first label of the body can fail or call anything.
+    Inner loops are done first, so their invariants can keep moving outwards. */
+void hoist_loop_invariants(Intermediate::Block *block, Intermediate::LabelIR &ir, const function_globals_t &globals, const Runtime &runtime, int function_ind);
+
+#endif
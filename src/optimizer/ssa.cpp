@@ -0,0 +1,721 @@
+#include "ssa.hpp"
+#include "../memory.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+using Intermediate::Instruction, Intermediate::InstrCode, Intermediate::Variable, Intermediate::Label, Intermediate::label_index_t;
+
+namespace {
+    const uint NONE = static_cast<uint>(-1);
+
+    enum class ValueKind {
+        CONSTANT,
+        /* Merges the values coming into a node from each of its predecessors */
+        PHI,
+        /* A bin or unary op of other values */
+        OPERATION,
+        /* A value the pass can't reason about, like a call result or a variable on entry */
+        UNKNOWN
+    };
+    /* TOP has no value yet, BOTTOM may hold more than one value */
+    enum class Lattice { TOP, CONSTANT, BOTTOM };
+
+    struct ssa_value_t {
+        ValueKind kind;
+        /* The node the value is made in */
+        uint node;
+        /* The bin or unary op, for an operation */
+        Instruction op = Instruction(InstrCode::INSTR_POP);
+        /* A phi has one operand for each predecessor of its node, in the same order */
+        std::vector<uint> operands = std::vector<uint>();
+        /* Phis and operations that take this value */
+        std::vector<uint> users = std::vector<uint>();
+        /* Nodes whose conditional jump tests this value */
+        std::vector<uint> branches = std::vector<uint>();
+        /* The variable the value was first stored in. A load of any other variable that
+            holds the value can load this one instead, as long as it still holds it. */
+        uint home = NONE;
+
+        Lattice lattice;
+        Values::Value constant;
+
+        ssa_value_t(ValueKind kind, uint node) : kind(kind), node(node),
+            lattice(kind == ValueKind::UNKNOWN ? Lattice::BOTTOM : Lattice::TOP) {};
+    };
+
+    /* A basic block. Labels are split after each conditional jump, so every node
+        runs from start to end. */
+    struct cfg_node_t {
+        uint label;
+        uint begin;
+        /* One past the terminator */
+        uint end;
+        /* A conditional jump's target comes before the node it falls through to */
+        std::vector<uint> successors = std::vector<uint>();
+        std::vector<uint> predecessors = std::vector<uint>();
+        /* Whether each edge from a predecessor can be taken. Same order as predecessors. */
+        std::vector<bool> executable_edges = std::vector<bool>();
+        bool reachable = false;
+        bool executable = false;
+
+        /* The value the node's conditional jump tests, or NONE */
+        uint condition = NONE;
+        /* Variable phis, then stack slot phis */
+        std::vector<uint> phis = std::vector<uint>();
+        std::vector<uint> operations = std::vector<uint>();
+
+        bool simulated = false;
+        std::vector<uint> exit_variables = std::vector<uint>();
+        std::vector<uint> exit_stack = std::vector<uint>();
+
+        cfg_node_t(uint label, uint begin, uint end) : label(label), begin(begin), end(end) {};
+    };
+
+    /* A load of a tracked variable, to rewrite once the lattice is known */
+    struct load_site_t {
+        uint label;
+        uint index;
+        uint node;
+        uint value;
+        /* A variable holding the same value that can be loaded instead, or NONE */
+        uint copy_of;
+    };
+
+    bool is_tracked(const Variable *variable) {
+        return variable->is_global() || variable->is_local_function_var();
+    }
+
+    /* Can the constant go back into the IR as an instruction? */
+    bool is_representable(const Values::Value &value) {
+        switch (Values::get_value_type(value)) {
+            case Values::ValueType::NUMBER:
+            case Values::ValueType::TRUE:
+            case Values::ValueType::FALSE:
+            case Values::ValueType::NULL_VALUE:
+            case Values::ValueType::PROGRAM_FUNCTION:
+                return true;
+            case Values::ValueType::OBJ:
+                return Values::get_value_object(value)->type == Values::ObjectType::STRING;
+            default: return false;
+        }
+    }
+    bool same_constant(const Values::Value &a, const Values::Value &b) {
+        if (Values::get_value_type(a) != Values::get_value_type(b)) return false;
+
+        switch (Values::get_value_type(a)) {
+            // Compare the bits, so 0 and -0 stay apart and a NaN is the same as itself
+            case Values::ValueType::NUMBER: {
+                Values::number_t x = Values::get_value_number(a), y = Values::get_value_number(b);
+                return std::memcmp(&x, &y, sizeof(Values::number_t)) == 0;
+            }
+            case Values::ValueType::PROGRAM_FUNCTION:
+                return Values::get_value_program_function(a) == Values::get_value_program_function(b);
+            case Values::ValueType::OBJ:
+                return *Values::get_value_string(a) == *Values::get_value_string(b);
+            default: return true;
+        }
+    }
+    /* Whether a constant is truthy. False if it isn't known until the program runs. */
+    bool constant_truth(const Values::Value &value, bool &truth) {
+        if (Values::get_value_type(value) == Values::ValueType::PROGRAM_FUNCTION) return false;
+
+        truth = Values::value_is_truthy(value);
+        return true;
+    }
+
+    class ConstantPropagation {
+        private:
+            Intermediate::Block *block;
+            const Intermediate::LabelIR &ir;
+
+            std::vector<cfg_node_t> nodes = std::vector<cfg_node_t>();
+            /* The first node of each label */
+            std::vector<uint> label_nodes = std::vector<uint>();
+            /* Reachable nodes in reverse postorder */
+            std::vector<uint> order = std::vector<uint>();
+
+            std::vector<ssa_value_t> values = std::vector<ssa_value_t>();
+            std::vector<Variable*> variables = std::vector<Variable*>();
+            std::unordered_map<Variable, uint, Intermediate::VariableHasher> variable_indices =
+                std::unordered_map<Variable, uint, Intermediate::VariableHasher>();
+            /* Variables a call may change */
+            std::vector<bool> clobbered = std::vector<bool>();
+            std::vector<load_site_t> loads = std::vector<load_site_t>();
+            /* Constants made while propagating, freed at the end */
+            std::vector<Values::Value> owned = std::vector<Values::Value>();
+
+            std::vector<uint> flow_worklist = std::vector<uint>();
+            std::vector<uint> ssa_worklist = std::vector<uint>();
+
+            inline Label &label_of(const cfg_node_t &node) { return this->block->get_label_at_numerical_index(node.label); };
+            inline const Instruction &terminator(const cfg_node_t &node) { return this->label_of(node).instructions.at(node.end - 1); };
+
+            uint new_value(ValueKind kind, uint node) {
+                this->values.push_back(ssa_value_t(kind, node));
+                return this->values.size() - 1;
+            }
+            void add_user(uint value, uint user) {
+                this->values[value].users.push_back(user);
+            }
+            uint variable_index(const Variable *variable) {
+                if (!is_tracked(variable)) return NONE;
+                return this->variable_indices.at(*variable);
+            }
+
+            bool simulate(uint node_index, std::vector<uint> &variables, std::vector<uint> &stack);
+
+            void lower(uint value, Lattice lattice, Values::Value constant);
+            void evaluate(uint value);
+            void evaluate_branch(uint node_index);
+            void mark_edge(uint from, uint to);
+            void visit_node(uint node_index);
+        public:
+            ConstantPropagation(Intermediate::Block *block, const Intermediate::LabelIR &ir) : block(block), ir(ir) {};
+            ~ConstantPropagation() {
+                for (Values::Value &value : this->owned) free_value_if_object(value);
+            }
+
+            bool build_graph();
+            bool build_ssa(const function_globals_t &globals);
+            void propagate();
+            void write_back(const function_globals_t &globals, bool is_main);
+    };
+}
+
+bool ConstantPropagation::build_graph() {
+    /* Split labels into nodes */
+    std::unordered_map<label_index_t, uint> label_starts = std::unordered_map<label_index_t, uint>();
+    for (uint label_ind = 0; label_ind < this->block->label_count(); label_ind += 1) {
+        Label &label = this->block->get_label_at_numerical_index(label_ind);
+        label_starts[*label.name] = this->nodes.size();
+        this->label_nodes.push_back(this->nodes.size());
+
+        uint begin = 0;
+        bool terminated = false;
+        for (uint index = 0; index < label.instructions.size() && !terminated; index += 1) {
+            InstrCode code = label.instructions[index].code;
+            terminated = code == InstrCode::INSTR_GOTO || code == InstrCode::INSTR_RETURN || code == InstrCode::INSTR_EXIT;
+
+            if (terminated || code == InstrCode::INSTR_POP_JIZ || code == InstrCode::INSTR_POP_JNZ) {
+                this->nodes.push_back(cfg_node_t(label_ind, begin, index + 1));
+                begin = index + 1;
+            }
+        }
+        // Falls through into the next label
+        if (!terminated && (begin < label.instructions.size() || label.instructions.size() == 0)) {
+            this->nodes.push_back(cfg_node_t(label_ind, begin, label.instructions.size()));
+        }
+    }
+
+    /* Connect them */
+    for (uint node_ind = 0; node_ind < this->nodes.size(); node_ind += 1) {
+        cfg_node_t &node = this->nodes[node_ind];
+        bool falls_through = true;
+
+        if (node.end > node.begin) {
+            const Instruction &last = this->terminator(node);
+            if (last.is_jump()) {
+                auto target = label_starts.find(*last.get_address());
+                if (target == label_starts.end()) return false;
+
+                node.successors.push_back(target->second);
+                falls_through = last.code != InstrCode::INSTR_GOTO;
+            }
+            else if (last.code == InstrCode::INSTR_RETURN || last.code == InstrCode::INSTR_EXIT) {
+                falls_through = false;
+            }
+        }
+
+        if (falls_through) {
+            // Running off the end of the block
+            if (node_ind + 1 >= this->nodes.size()) return false;
+            node.successors.push_back(node_ind + 1);
+        }
+    }
+    if (this->nodes.size() == 0) return false;
+
+    /* Depth first search from the entry for the reverse postorder */
+    std::vector<std::pair<uint, uint>> search = { { 0, 0 } };
+    this->nodes[0].reachable = true;
+    while (search.size() > 0) {
+        auto &[node_ind, successor] = search.back();
+        if (successor == this->nodes[node_ind].successors.size()) {
+            this->order.push_back(node_ind);
+            search.pop_back();
+            continue;
+        }
+
+        uint next = this->nodes[node_ind].successors[successor];
+        successor += 1;
+        if (!this->nodes[next].reachable) {
+            this->nodes[next].reachable = true;
+            search.push_back({ next, 0 });
+        }
+    }
+    std::reverse(this->order.begin(), this->order.end());
+
+    for (uint node_ind : this->order) {
+        for (uint successor : this->nodes[node_ind].successors) {
+            this->nodes[successor].predecessors.push_back(node_ind);
+            this->nodes[successor].executable_edges.push_back(false);
+        }
+    }
+    // Variables on entry aren't phis, so nothing may jump back to the entry
+    return this->nodes[0].predecessors.size() == 0;
+}
+
+bool ConstantPropagation::simulate(uint node_ind, std::vector<uint> &variables, std::vector<uint> &stack) {
+    const cfg_node_t &node = this->nodes[node_ind];
+    Label &label = this->label_of(node);
+
+    for (uint index = node.begin; index < node.end; index += 1) {
+        const Instruction &instr = label.instructions[index];
+
+        switch (instr.code) {
+            case InstrCode::INSTR_LOAD: {
+                uint variable = this->variable_index(instr.get_variable());
+                if (variable == NONE) {
+                    stack.push_back(this->new_value(ValueKind::UNKNOWN, node_ind));
+                    break;
+                }
+
+                uint value = variables[variable];
+                uint home = this->values[value].home;
+                uint copy_of = home != NONE && home != variable && variables[home] == value ? home : NONE;
+                this->loads.push_back(load_site_t{ node.label, index, node_ind, value, copy_of });
+                stack.push_back(value);
+            }
+                break;
+            case InstrCode::INSTR_STORE: {
+                if (stack.size() < 1) return false;
+                uint value = stack.back();
+                stack.pop_back();
+
+                uint variable = this->variable_index(instr.get_variable());
+                if (variable == NONE) break;
+                variables[variable] = value;
+                if (this->values[value].home == NONE) this->values[value].home = variable;
+            }
+                break;
+
+            case InstrCode::INSTR_POP:
+            case InstrCode::INSTR_RETURN:
+                if (stack.size() < 1) return false;
+                stack.pop_back();
+                break;
+            case InstrCode::INSTR_DUP:
+                if (stack.size() < 1) return false;
+                stack.push_back(stack.back());
+                break;
+            case InstrCode::INSTR_POP_JIZ:
+            case InstrCode::INSTR_POP_JNZ:
+                if (stack.size() < 1) return false;
+                this->nodes[node_ind].condition = stack.back();
+                this->values[stack.back()].branches.push_back(node_ind);
+                stack.pop_back();
+                break;
+            case InstrCode::INSTR_GOTO:
+            case InstrCode::INSTR_EXIT:
+            case InstrCode::INSTR_MAKE_FUNCTION:
+                break;
+
+            case InstrCode::INSTR_BIN_OP:
+            case InstrCode::INSTR_UNARY_OP: {
+                uint operand_count = instr.code == InstrCode::INSTR_BIN_OP ? 2 : 1;
+                if (stack.size() < operand_count) return false;
+
+                uint value = this->new_value(ValueKind::OPERATION, node_ind);
+                this->values[value].op = instr;
+                this->values[value].operands = std::vector<uint>(stack.end() - operand_count, stack.end());
+                stack.erase(stack.end() - operand_count, stack.end());
+
+                for (uint operand : this->values[value].operands) this->add_user(operand, value);
+                this->nodes[node_ind].operations.push_back(value);
+                stack.push_back(value);
+            }
+                break;
+
+            case InstrCode::INSTR_TRUE:
+            case InstrCode::INSTR_FALSE:
+            case InstrCode::INSTR_NULL:
+            case InstrCode::INSTR_NUMBER:
+            case InstrCode::INSTR_STRING:
+            case InstrCode::INSTR_GET_FUNCTION_REFERENCE: {
+                uint value = this->new_value(ValueKind::CONSTANT, node_ind);
+                this->values[value].lattice = Lattice::CONSTANT;
+                this->values[value].constant = instr.payload_to_value();
+                this->owned.push_back(this->values[value].constant);
+                stack.push_back(value);
+            }
+                break;
+
+            /* Instructions whose result is only known at runtime */
+            case InstrCode::INSTR_MAKE_ARRAY:
+            case InstrCode::INSTR_CONSTANT_ARRAY:
+            case InstrCode::INSTR_GET_ARRAY_VALUE:
+            case InstrCode::INSTR_CONSTANT_PROPERTY_ACCESS:
+            case InstrCode::INSTR_GET_FIELD:
+            case InstrCode::INSTR_MAKE_RECORD:
+            case InstrCode::INSTR_CALL:
+            case InstrCode::INSTR_CALL_FUNCTION:
+            case InstrCode::INSTR_CALL_NATIVE:
+            case InstrCode::INSTR_TAIL_CALL:
+            case InstrCode::INSTR_TAIL_CALL_FUNCTION: {
+                size_t operand_count = 0;
+                switch (instr.code) {
+                    case InstrCode::INSTR_MAKE_ARRAY: operand_count = instr.get_array_element_count(); break;
+                    case InstrCode::INSTR_GET_ARRAY_VALUE: operand_count = 2; break;
+                    case InstrCode::INSTR_CONSTANT_PROPERTY_ACCESS:
+                    case InstrCode::INSTR_GET_FIELD: operand_count = 1; break;
+                    case InstrCode::INSTR_MAKE_RECORD: operand_count = this->ir.get_struct(instr.get_struct_index()).fields.size(); break;
+                    case InstrCode::INSTR_CALL:
+                    case InstrCode::INSTR_TAIL_CALL:
+                        operand_count = instr.get_argument_count() + 1; break;
+                    case InstrCode::INSTR_CALL_FUNCTION:
+                    case InstrCode::INSTR_TAIL_CALL_FUNCTION:
+                        operand_count = this->ir.get_function(instr.get_function_index())->argument_count(); break;
+                    case InstrCode::INSTR_CALL_NATIVE: operand_count = instr.get_native_call().num_arguments; break;
+                    default: break;
+                }
+                if (stack.size() < operand_count) return false;
+                stack.erase(stack.end() - operand_count, stack.end());
+
+                // The called function may store to globals, unless it is pure
+                if (instr.is_call() && !(this->ir.call_flags(instr) & Values::NATIVE_PURE)) {
+                    for (uint variable = 0; variable < variables.size(); variable += 1) {
+                        if (!this->clobbered[variable]) continue;
+                        variables[variable] = this->new_value(ValueKind::UNKNOWN, node_ind);
+                        this->values[variables[variable]].home = variable;
+                    }
+                }
+
+                stack.push_back(this->new_value(ValueKind::UNKNOWN, node_ind));
+            }
+                break;
+            /* Setting leaves the value that was set on the stack */
+            case InstrCode::INSTR_SET_ARRAY_VALUE:
+            case InstrCode::INSTR_SET_FIELD: {
+                size_t operand_count = instr.code == InstrCode::INSTR_SET_ARRAY_VALUE ? 3 : 2;
+                if (stack.size() < operand_count) return false;
+
+                uint value = stack.back();
+                stack.erase(stack.end() - operand_count, stack.end());
+                stack.push_back(value);
+            }
+                break;
+        }
+    }
+
+    return true;
+}
+
+bool ConstantPropagation::build_ssa(const function_globals_t &globals) {
+    /* Number the variables the block uses */
+    for (uint label_ind = 0; label_ind < this->block->label_count(); label_ind += 1) {
+        for (const Instruction &instr : this->block->get_label_at_numerical_index(label_ind).instructions) {
+            if (instr.code != InstrCode::INSTR_LOAD && instr.code != InstrCode::INSTR_STORE) continue;
+
+            Variable *variable = instr.get_variable();
+            if (!is_tracked(variable) || this->variable_indices.count(*variable) > 0) continue;
+
+            this->variable_indices.emplace(*variable, this->variables.size());
+            this->variables.push_back(variable);
+            this->clobbered.push_back(variable->is_global() && globals.stored.count(*variable) > 0);
+        }
+    }
+
+    /* Walk the nodes in reverse postorder, so a node's first predecessor is always done */
+    for (uint node_ind : this->order) {
+        std::vector<uint> variables, stack;
+
+        if (node_ind == 0) {
+            for (uint variable = 0; variable < this->variables.size(); variable += 1) {
+                variables.push_back(this->new_value(ValueKind::UNKNOWN, node_ind));
+                this->values.back().home = variable;
+            }
+        }
+        else if (this->nodes[node_ind].predecessors.size() == 1) {
+            const cfg_node_t &predecessor = this->nodes[this->nodes[node_ind].predecessors[0]];
+            if (!predecessor.simulated) return false;
+
+            variables = predecessor.exit_variables;
+            stack = predecessor.exit_stack;
+        }
+        else {
+            size_t depth = NONE;
+            for (uint predecessor : this->nodes[node_ind].predecessors) {
+                if (this->nodes[predecessor].simulated) {
+                    depth = this->nodes[predecessor].exit_stack.size();
+                    break;
+                }
+            }
+            if (depth == NONE) return false;
+
+            for (uint variable = 0; variable < this->variables.size(); variable += 1) {
+                variables.push_back(this->new_value(ValueKind::PHI, node_ind));
+                this->values.back().home = variable;
+                this->nodes[node_ind].phis.push_back(variables.back());
+            }
+            for (size_t slot = 0; slot < depth; slot += 1) {
+                stack.push_back(this->new_value(ValueKind::PHI, node_ind));
+                this->nodes[node_ind].phis.push_back(stack.back());
+            }
+        }
+
+        if (!this->simulate(node_ind, variables, stack)) return false;
+
+        cfg_node_t &node = this->nodes[node_ind];
+        node.exit_variables = variables;
+        node.exit_stack = stack;
+        node.simulated = true;
+    }
+
+    /* Fill in the phis now that every predecessor is done */
+    for (uint node_ind : this->order) {
+        const cfg_node_t &node = this->nodes[node_ind];
+        if (node.phis.size() == 0) continue;
+
+        size_t depth = node.phis.size() - this->variables.size();
+        for (uint predecessor : node.predecessors) {
+            const cfg_node_t &from = this->nodes[predecessor];
+            if (from.exit_stack.size() != depth) return false;
+
+            for (uint phi = 0; phi < node.phis.size(); phi += 1) {
+                uint operand = phi < this->variables.size() ?
+                    from.exit_variables[phi] : from.exit_stack[phi - this->variables.size()];
+                this->values[node.phis[phi]].operands.push_back(operand);
+                this->add_user(operand, node.phis[phi]);
+            }
+        }
+    }
+    return true;
+}
+
+void ConstantPropagation::lower(uint value_ind, Lattice lattice, Values::Value constant) {
+    ssa_value_t &value = this->values[value_ind];
+    // Values only ever move down the lattice
+    if (lattice == Lattice::TOP || value.lattice == Lattice::BOTTOM) return;
+    if (lattice == Lattice::CONSTANT && value.lattice == Lattice::CONSTANT) {
+        if (same_constant(value.constant, constant)) return;
+        lattice = Lattice::BOTTOM;
+    }
+
+    value.lattice = lattice;
+    value.constant = constant;
+    this->ssa_worklist.push_back(value_ind);
+}
+void ConstantPropagation::evaluate(uint value_ind) {
+    const ssa_value_t &value = this->values[value_ind];
+
+    if (value.kind == ValueKind::PHI) {
+        const cfg_node_t &node = this->nodes[value.node];
+        Lattice lattice = Lattice::TOP;
+        Values::Value constant;
+
+        for (uint edge = 0; edge < value.operands.size() && lattice != Lattice::BOTTOM; edge += 1) {
+            if (!node.executable_edges[edge]) continue;
+
+            const ssa_value_t &operand = this->values[value.operands[edge]];
+            if (operand.lattice == Lattice::TOP) continue;
+            if (operand.lattice == Lattice::BOTTOM) lattice = Lattice::BOTTOM;
+            else if (lattice == Lattice::TOP) {
+                lattice = Lattice::CONSTANT;
+                constant = operand.constant;
+            }
+            else if (!same_constant(constant, operand.constant)) lattice = Lattice::BOTTOM;
+        }
+
+        this->lower(value_ind, lattice, constant);
+        return;
+    }
+    if (value.kind != ValueKind::OPERATION) return;
+
+    for (uint operand : value.operands) {
+        if (this->values[operand].lattice == Lattice::BOTTOM) {
+            this->lower(value_ind, Lattice::BOTTOM, Values::Value());
+            return;
+        }
+        if (this->values[operand].lattice == Lattice::TOP) return;
+    }
+
+    Values::Value result;
+    bool valid = value.op.code == InstrCode::INSTR_BIN_OP ?
+        Values::bin_op(value.op.get_bin_op(), this->values[value.operands[0]].constant, this->values[value.operands[1]].constant, &result, nullptr) :
+        Values::unary_op(value.op.get_unary_op(), this->values[value.operands[0]].constant, &result, nullptr);
+
+    // An op that fails is left for the runtime to report
+    if (!valid || !is_representable(result)) {
+        if (valid) free_value_if_object(result);
+        this->lower(value_ind, Lattice::BOTTOM, Values::Value());
+        return;
+    }
+
+    this->owned.push_back(result);
+    this->lower(value_ind, Lattice::CONSTANT, result);
+}
+void ConstantPropagation::mark_edge(uint from, uint to) {
+    cfg_node_t &target = this->nodes[to];
+    bool marked = false;
+
+    for (uint edge = 0; edge < target.predecessors.size(); edge += 1) {
+        if (target.predecessors[edge] != from || target.executable_edges[edge]) continue;
+        target.executable_edges[edge] = true;
+        marked = true;
+    }
+
+    if (marked) this->flow_worklist.push_back(to);
+}
+void ConstantPropagation::evaluate_branch(uint node_ind) {
+    const cfg_node_t &node = this->nodes[node_ind];
+    if (node.condition == NONE) {
+        for (uint successor : node.successors) this->mark_edge(node_ind, successor);
+        return;
+    }
+
+    const ssa_value_t &condition = this->values[node.condition];
+    if (condition.lattice == Lattice::TOP) return;
+
+    bool truth;
+    if (condition.lattice == Lattice::CONSTANT && constant_truth(condition.constant, truth)) {
+        bool jumps = truth == (this->terminator(node).code == InstrCode::INSTR_POP_JNZ);
+        this->mark_edge(node_ind, node.successors[jumps ? 0 : 1]);
+        return;
+    }
+
+    for (uint successor : node.successors) this->mark_edge(node_ind, successor);
+}
+void ConstantPropagation::visit_node(uint node_ind) {
+    // A new edge only changes the phis
+    for (uint phi : this->nodes[node_ind].phis) this->evaluate(phi);
+    if (this->nodes[node_ind].executable) return;
+
+    this->nodes[node_ind].executable = true;
+    for (uint operation : this->nodes[node_ind].operations) this->evaluate(operation);
+    this->evaluate_branch(node_ind);
+}
+
+void ConstantPropagation::propagate() {
+    this->visit_node(0);
+
+    while (this->flow_worklist.size() > 0 || this->ssa_worklist.size() > 0) {
+        if (this->flow_worklist.size() > 0) {
+            uint node_ind = this->flow_worklist.back();
+            this->flow_worklist.pop_back();
+            this->visit_node(node_ind);
+            continue;
+        }
+
+        uint value_ind = this->ssa_worklist.back();
+        this->ssa_worklist.pop_back();
+
+        for (uint user : this->values[value_ind].users) {
+            if (this->nodes[this->values[user].node].executable) this->evaluate(user);
+        }
+        for (uint branch : this->values[value_ind].branches) {
+            if (this->nodes[branch].executable) this->evaluate_branch(branch);
+        }
+    }
+}
+
+void ConstantPropagation::write_back(const function_globals_t &globals, bool is_main) {
+    /* Constant and copy propagation */
+    for (const load_site_t &load : this->loads) {
+        if (!this->nodes[load.node].executable) continue;
+
+        const ssa_value_t &value = this->values[load.value];
+        Instruction &instr = this->block->get_label_at_numerical_index(load.label).instructions[load.index];
+        if (value.lattice == Lattice::CONSTANT) {
+            instr = Instruction::value_to_instruction(value.constant);
+        }
+        else if (load.copy_of != NONE) {
+            instr = Instruction(InstrCode::INSTR_LOAD, this->variables[load.copy_of]);
+        }
+    }
+
+    /* Dead branch elimination */
+    for (uint label_ind = 0; label_ind < this->block->label_count(); label_ind += 1) {
+        Label &label = this->block->get_label_at_numerical_index(label_ind);
+        Intermediate::intermediate_set_t rewritten = Intermediate::intermediate_set_t();
+        uint kept = 0;
+
+        for (uint node_ind = this->label_nodes[label_ind]; node_ind < this->nodes.size() && this->nodes[node_ind].label == label_ind; node_ind += 1) {
+            const cfg_node_t &node = this->nodes[node_ind];
+            if (!node.executable) break;
+
+            kept = node.end;
+            rewritten.insert(rewritten.end(), label.instructions.begin() + node.begin, label.instructions.begin() + node.end);
+            if (node.condition == NONE) continue;
+
+            const ssa_value_t &condition = this->values[node.condition];
+            bool truth;
+            if (condition.lattice != Lattice::CONSTANT || !constant_truth(condition.constant, truth)) continue;
+
+            // The condition is still computed, but only popped
+            Instruction jump = rewritten.back();
+            rewritten.back() = Instruction(InstrCode::INSTR_POP);
+            if (truth == (jump.code == InstrCode::INSTR_POP_JNZ)) {
+                rewritten.push_back(Instruction(InstrCode::INSTR_GOTO, jump.get_address()));
+                break;
+            }
+        }
+
+        // Anything after the last node that can run is dead
+        for (uint index = kept; index < label.instructions.size(); index += 1) {
+            label.instructions[index].free_payload();
+        }
+        label.instructions = rewritten;
+    }
+
+    /* Dead store elimination */
+    std::vector<uint> load_counts = std::vector<uint>(this->variables.size(), 0);
+    for (uint label_ind = 0; label_ind < this->block->label_count(); label_ind += 1) {
+        for (const Instruction &instr : this->block->get_label_at_numerical_index(label_ind).instructions) {
+            if (instr.code != InstrCode::INSTR_LOAD) continue;
+
+            uint variable = this->variable_index(instr.get_variable());
+            if (variable != NONE) load_counts[variable] += 1;
+        }
+    }
+    for (uint label_ind = 0; label_ind < this->block->label_count(); label_ind += 1) {
+        for (Instruction &instr : this->block->get_label_at_numerical_index(label_ind).instructions) {
+            if (instr.code != InstrCode::INSTR_STORE) continue;
+
+            uint variable = this->variable_index(instr.get_variable());
+            if (variable == NONE || load_counts[variable] > 0) continue;
+
+            // Functions can read globals, but only main's globals are known to be unread
+            const Variable *stored = this->variables[variable];
+            if (stored->is_local_function_var() || (is_main && globals.loaded.count(*stored) == 0)) {
+                instr = Instruction(InstrCode::INSTR_POP);
+            }
+        }
+    }
+}
+
+function_globals_t find_function_globals(Intermediate::LabelIR &ir) {
+    function_globals_t globals = function_globals_t();
+
+    for (int func_index = 0; func_index < ir.last_function_index() + 1; func_index += 1) {
+        for (const Label &label : *ir.get_function(func_index)->get_block()) {
+            for (const Instruction &instr : label.instructions) {
+                if (instr.code != InstrCode::INSTR_LOAD && instr.code != InstrCode::INSTR_STORE) continue;
+                if (!instr.get_variable()->is_global()) continue;
+
+                if (instr.code == InstrCode::INSTR_LOAD) globals.loaded.insert(*instr.get_variable());
+                else globals.stored.insert(*instr.get_variable());
+            }
+        }
+    }
+
+    return globals;
+}
+
+void propagate_constants(Intermediate::Block *block, const Intermediate::LabelIR &ir, const function_globals_t &globals, bool is_main) {
+    ConstantPropagation propagation = ConstantPropagation(block, ir);
+
+    if (!propagation.build_graph() || !propagation.build_ssa(globals)) return;
+    propagation.propagate();
+    propagation.write_back(globals, is_main);
+}
@@ -0,0 +1,32 @@
+/* Constant propagation across the labels of a block, through an SSA form of its variables */
+
+#ifndef _SGCPP_SSA_HPP
+#define _SGCPP_SSA_HPP
+
+#include "../ir/intermediate.hpp"
+
+#include <unordered_set>
+
+typedef std::unordered_set<Intermediate::Variable, Intermediate::VariableHasher> variable_set_t;
+
+/* What the functions of a program do with globals. Any call can run any function,
+    so these are the globals a call may change, and the globals that must keep their stores. */
+struct function_globals_t {
+    variable_set_t stored;
+    variable_set_t loaded;
+};
+
+function_globals_t find_function_globals(Intermediate::LabelIR &ir);
+
+/* Builds the control flow graph of a block's labels, puts its variables and stack slots into
+    SSA form, and runs sparse conditional constant propagation over it. The results are written
+    back to the stack-based instructions in place:
+        Loads of variables that always hold the same constant become that constant.
+        Loads of a variable that holds a copy of another variable load the original instead.
+        Conditional jumps on a constant become a pop, and a goto if the jump is taken.
+        Labels that can never run are emptied, so label DCE removes them.
+        Stores to variables that are never loaded become pops.
+    If the block has a shape the pass doesn't understand, it is left as is. */
+void propagate_constants(Intermediate::Block *block, const Intermediate::LabelIR &ir, const function_globals_t &globals, bool is_main);
+
+#endif
@@ -0,0 +1,423 @@
+#include "value-numbering.hpp"
+#include "../natives/natives.hpp"
+#include "../runtime/runtime.hpp"
+
+#include <cstring>
+#include <unordered_map>
+
+using Intermediate::Instruction, Intermediate::InstrCode, Intermediate::Variable, Intermediate::Label, Intermediate::label_index_t;
+
+namespace {
+    const uint NONE = static_cast<uint>(-1);
+
+    /* A value on the stack */
+    struct entry_t {
+        uint value;
+        /* The run of instructions in the label that pushed it. NONE if it wasn't pushed by
+            loads, constants and ops alone, since only those runs can be replaced. */
+        uint start;
+        uint end;
+        /* Runs of constants alone are left for constant folding */
+        bool has_load;
+    };
+    /* What is known at a point in the block */
+    struct state_t {
+        std::unordered_map<Variable, uint, Intermediate::VariableHasher> variables;
+        /* Constants and the ops that were computed, by what they are and their operands' numbers */
+        std::unordered_map<std::string, uint> expressions;
+        std::vector<entry_t> stack;
+    };
+
+    struct value_t {
+        /* The op that first computed the value, or NONE */
+        uint site = NONE;
+        /* The last variable the value was stored in. It only holds the value while the
+            variable's number is still the same. */
+        Variable *holder = nullptr;
+        /* The index of the native namespace the value is, or NONE */
+        uint native = NONE;
+    };
+    /* Where an op first ran. If anything reuses it, it is kept in a temporary. */
+    struct site_t {
+        uint label;
+        uint index;
+        uint uses;
+        Variable *temporary;
+    };
+    /* A later run of instructions that computes the same value, to load instead */
+    struct reuse_t {
+        uint start;
+        uint end;
+        /* The site whose temporary is loaded, or NONE to load the holder */
+        uint site;
+        Variable *holder;
+    };
+
+    bool is_tracked(const Variable *variable) {
+        return variable->is_global() || variable->is_local_function_var() || variable->type == Intermediate::NATIVE;
+    }
+
+    std::string constant_key(const Instruction &instr) {
+        std::string key = "c";
+        key += std::to_string(instr.code);
+        key += ':';
+        switch (instr.code) {
+            case InstrCode::INSTR_NUMBER: {
+                Values::number_t number = instr.get_number();
+                char bytes[sizeof(Values::number_t)];
+                std::memcpy(bytes, &number, sizeof(bytes));
+                key.append(bytes, sizeof(bytes));
+            }
+                break;
+            case InstrCode::INSTR_STRING: key += *instr.payload.str; break;
+            case InstrCode::INSTR_GET_FUNCTION_REFERENCE: key += std::to_string(instr.payload.function_index); break;
+            default: break;
+        }
+        return key;
+    }
+
+    class ValueNumbering {
+        private:
+            Intermediate::Block *block;
+            Intermediate::LabelIR &ir;
+            const function_globals_t &globals;
+            const Runtime &runtime;
+            int function_ind;
+
+            std::vector<value_t> values = std::vector<value_t>();
+            std::vector<site_t> sites = std::vector<site_t>();
+            /* The reuses in each label, in order. They never overlap. */
+            std::vector<std::vector<reuse_t>> reuses = std::vector<std::vector<reuse_t>>();
+            /* Number of jumps to each label */
+            std::unordered_map<label_index_t, uint> jumps = std::unordered_map<label_index_t, uint>();
+            /* The state a label starts in, if it can only be jumped to from one place */
+            std::unordered_map<label_index_t, state_t> entry_states = std::unordered_map<label_index_t, state_t>();
+
+            inline uint new_value() {
+                this->values.push_back(value_t());
+                return this->values.size() - 1;
+            }
+            entry_t pop(state_t &state);
+            void jump(const state_t &state, const label_index_t &target);
+            /* Push the value of an op, and reuse an earlier one with the same key if there is one */
+            void number_op(state_t &state, const std::string &key, uint label_ind, uint index, uint start, bool has_load);
+            /* Drop the reuses in a label from start on, since the run they are in is kept or replaced whole */
+            void drop_reuses(uint label_ind, uint start);
+
+            /* Push new numbers for the results of an instruction the pass knows nothing about */
+            void number_unknown(state_t &state, const Instruction &instr);
+            void number_label(uint label_ind, state_t &state);
+            void rewrite_label(uint label_ind, const std::vector<uint> &label_sites);
+        public:
+            ValueNumbering(Intermediate::Block *block, Intermediate::LabelIR &ir, const function_globals_t &globals, const Runtime &runtime, int function_ind) :
+                block(block), ir(ir), globals(globals), runtime(runtime), function_ind(function_ind) {};
+
+            void run();
+    };
+}
+
+entry_t ValueNumbering::pop(state_t &state) {
+    // A value from before the label started
+    if (state.stack.size() == 0) return entry_t{ this->new_value(), NONE, NONE, false };
+
+    entry_t top = state.stack.back();
+    state.stack.pop_back();
+    return top;
+}
+
+void ValueNumbering::jump(const state_t &state, const label_index_t &target) {
+    if (this->jumps[target] != 1) return;
+
+    state_t &entry = this->entry_states[target] = state;
+    // The values left on the stack don't come from instructions in the target
+    for (entry_t &value : entry.stack) value.start = value.end = NONE;
+}
+
+void ValueNumbering::drop_reuses(uint label_ind, uint start) {
+    std::vector<reuse_t> &label_reuses = this->reuses[label_ind];
+    while (label_reuses.size() > 0 && label_reuses.back().start >= start) {
+        if (label_reuses.back().site != NONE) this->sites[label_reuses.back().site].uses -= 1;
+        label_reuses.pop_back();
+    }
+}
+
+void ValueNumbering::number_op(state_t &state, const std::string &key, uint label_ind, uint index, uint start, bool has_load) {
+    uint end = start == NONE ? NONE : index + 1;
+    // Constant folding needs the whole run, like Math.sqrt(2), so nothing in it is replaced
+    if (start != NONE && !has_load) this->drop_reuses(label_ind, start);
+
+    auto found = state.expressions.find(key);
+    if (found == state.expressions.end()) {
+        uint value = this->new_value();
+        this->values[value].site = this->sites.size();
+        this->sites.push_back(site_t{ label_ind, index, 0, nullptr });
+        state.expressions.emplace(key, value);
+        state.stack.push_back(entry_t{ value, start, end, has_load });
+        return;
+    }
+
+    uint value = found->second;
+    state.stack.push_back(entry_t{ value, start, end, has_load });
+    if (start == NONE || !has_load) return;
+
+    Variable *holder = this->values[value].holder;
+    auto held = holder == nullptr ? state.variables.end() : state.variables.find(*holder);
+    bool is_held = held != state.variables.end() && held->second == value;
+
+    // Reuses inside this run go away with it
+    this->drop_reuses(label_ind, start);
+    std::vector<reuse_t> &label_reuses = this->reuses[label_ind];
+    if (is_held) {
+        label_reuses.push_back(reuse_t{ start, end, NONE, holder });
+    }
+    else {
+        label_reuses.push_back(reuse_t{ start, end, this->values[value].site, nullptr });
+        this->sites[this->values[value].site].uses += 1;
+    }
+}
+
+void ValueNumbering::number_label(uint label_ind, state_t &state) {
+    const Label &label = this->block->get_label_at_numerical_index(label_ind);
+
+    for (uint index = 0; index < label.instructions.size(); index += 1) {
+        const Instruction &instr = label.instructions[index];
+
+        if (instr.is_constant()) {
+            std::string key = constant_key(instr);
+            auto found = state.expressions.find(key);
+            uint value = found == state.expressions.end() ? state.expressions[key] = this->new_value() : found->second;
+            state.stack.push_back(entry_t{ value, index, index + 1, false });
+            continue;
+        }
+
+        switch (instr.code) {
+            case InstrCode::INSTR_LOAD: {
+                Variable *variable = instr.get_variable();
+                uint value;
+                if (!is_tracked(variable)) value = this->new_value();
+                else {
+                    auto found = state.variables.find(*variable);
+                    if (found != state.variables.end()) value = found->second;
+                    else {
+                        value = state.variables[*variable] = this->new_value();
+                        if (variable->type == Intermediate::NATIVE && Natives::is_namespace(Natives::get_native_index(*variable->name))) {
+                            this->values[value].native = Natives::get_native_index(*variable->name);
+                        }
+                    }
+                }
+                state.stack.push_back(entry_t{ value, index, index + 1, true });
+            }
+                break;
+            case InstrCode::INSTR_STORE: {
+                Variable *variable = instr.get_variable();
+                entry_t stored = this->pop(state);
+                if (!is_tracked(variable)) break;
+
+                state.variables[*variable] = stored.value;
+                this->values[stored.value].holder = variable;
+            }
+                break;
+            case InstrCode::INSTR_DUP: {
+                entry_t top = this->pop(state);
+                state.stack.push_back(top);
+                state.stack.push_back(entry_t{ top.value, NONE, NONE, false });
+            }
+                break;
+
+            case InstrCode::INSTR_BIN_OP: {
+                entry_t b = this->pop(state);
+                entry_t a = this->pop(state);
+                std::string key = "b";
+                key += std::to_string(instr.get_bin_op());
+                key += ':';
+                key += std::to_string(a.value);
+                key += ',';
+                key += std::to_string(b.value);
+                bool contiguous = a.start != NONE && b.start != NONE && a.end == b.start && b.end == index;
+                this->number_op(state, key, label_ind, index, contiguous ? a.start : NONE, a.has_load || b.has_load);
+            }
+                break;
+            case InstrCode::INSTR_UNARY_OP: {
+                entry_t a = this->pop(state);
+                std::string key = "u";
+                key += std::to_string(instr.get_unary_op());
+                key += ':';
+                key += std::to_string(a.value);
+                this->number_op(state, key, label_ind, index, a.start != NONE && a.end == index ? a.start : NONE, a.has_load);
+            }
+                break;
+            case InstrCode::INSTR_CONSTANT_PROPERTY_ACCESS: {
+                entry_t object = this->pop(state);
+                uint native = this->values[object.value].native;
+                if (native == NONE) {
+                    state.stack.push_back(entry_t{ this->new_value(), NONE, NONE, false });
+                    break;
+                }
+                // Members that are numbers, like Math.PI, are folded into constants
+                Values::Value member;
+                bool is_number = Natives::get_member(this->runtime.get_native(native), *instr.payload.str, member) &&
+                    Values::get_value_type(member) == Values::ValueType::NUMBER;
+
+                std::string key = "p";
+                key += std::to_string(object.value);
+                key += ':';
+                key += *instr.payload.str;
+                this->number_op(state, key, label_ind, index, object.start != NONE && object.end == index ? object.start : NONE, !is_number);
+            }
+                break;
+            /* A pure native or function gives the same result for the same arguments, and can't call anything that changes variables */
+            case InstrCode::INSTR_CALL_NATIVE:
+            case InstrCode::INSTR_CALL_FUNCTION: {
+                size_t pops, pushes;
+                this->ir.stack_effect(instr, pops, pushes);
+                Values::native_flags_t flags = this->ir.call_flags(instr);
+                if (state.stack.size() < pops || !(flags & Values::NATIVE_PURE)) {
+                    this->number_unknown(state, instr);
+                    break;
+                }
+                std::vector<entry_t> arguments = std::vector<entry_t>(state.stack.end() - pops, state.stack.end());
+                state.stack.erase(state.stack.end() - pops, state.stack.end());
+
+                bool is_native = instr.code == InstrCode::INSTR_CALL_NATIVE;
+                std::string key = is_native ? "n" : "f";
+                key += std::to_string(is_native ? instr.get_native_call().native_index : instr.get_function_index());
+                key += ':';
+                bool contiguous = true;
+                uint start = index;
+                // Native calls on constants are folded, unless they make an object. Function calls never are.
+                bool has_load = !is_native || (flags & Values::NATIVE_ALLOCATES);
+                for (auto argument = arguments.rbegin(); argument != arguments.rend(); argument++) {
+                    key += std::to_string(argument->value);
+                    key += ',';
+                    contiguous = contiguous && argument->start != NONE && argument->end == start;
+                    start = argument->start;
+                    has_load = has_load || argument->has_load;
+                }
+                this->number_op(state, key, label_ind, index, contiguous ? start : NONE, has_load);
+            }
+                break;
+
+            case InstrCode::INSTR_POP_JIZ:
+            case InstrCode::INSTR_POP_JNZ:
+                this->pop(state);
+                this->jump(state, *instr.get_address());
+                break;
+            case InstrCode::INSTR_GOTO:
+                this->jump(state, *instr.get_address());
+                return;
+            case InstrCode::INSTR_RETURN:
+            case InstrCode::INSTR_EXIT:
+                return;
+
+            default:
+                this->number_unknown(state, instr);
+                break;
+        }
+    }
+}
+
+void ValueNumbering::number_unknown(state_t &state, const Instruction &instr) {
+    size_t pops, pushes;
+    this->ir.stack_effect(instr, pops, pushes);
+    for (size_t operand = 0; operand < pops; operand += 1) this->pop(state);
+
+    // The called function may store to globals
+    if (instr.is_call()) {
+        for (auto &[variable, value] : state.variables) {
+            if (variable.is_global() && this->globals.stored.count(variable) > 0) value = this->new_value();
+        }
+    }
+
+    for (size_t result = 0; result < pushes; result += 1) state.stack.push_back(entry_t{ this->new_value(), NONE, NONE, false });
+}
+
+void ValueNumbering::rewrite_label(uint label_ind, const std::vector<uint> &label_sites) {
+    Label &label = this->block->get_label_at_numerical_index(label_ind);
+    const std::vector<reuse_t> &label_reuses = this->reuses[label_ind];
+
+    Intermediate::intermediate_set_t rewritten = Intermediate::intermediate_set_t();
+    // The variable whose value was just loaded, so loading it again can duplicate it
+    Variable *loaded = nullptr;
+    auto load = [&rewritten, &loaded](Variable *variable) {
+        if (loaded != nullptr && *loaded == *variable) rewritten.push_back(Instruction(InstrCode::INSTR_DUP));
+        else rewritten.push_back(Instruction(InstrCode::INSTR_LOAD, variable));
+        loaded = variable;
+    };
+
+    uint next_reuse = 0, next_site = 0;
+    for (uint index = 0; index < label.instructions.size();) {
+        if (next_reuse < label_reuses.size() && label_reuses[next_reuse].start == index) {
+            const reuse_t &reuse = label_reuses[next_reuse];
+            for (uint replaced = reuse.start; replaced < reuse.end; replaced += 1) {
+                label.instructions[replaced].free_payload();
+            }
+            load(reuse.site == NONE ? reuse.holder : this->sites[reuse.site].temporary);
+
+            index = reuse.end;
+            next_reuse += 1;
+            continue;
+        }
+
+        Instruction &instr = label.instructions[index];
+        if (instr.code == InstrCode::INSTR_LOAD) load(instr.get_variable());
+        else {
+            rewritten.push_back(instr);
+            loaded = nullptr;
+        }
+
+        // Keep the first computation for the reuses
+        if (next_site < label_sites.size() && this->sites[label_sites[next_site]].index == index) {
+            Variable *temporary = this->sites[label_sites[next_site]].temporary;
+            rewritten.push_back(Instruction(InstrCode::INSTR_DUP));
+            rewritten.push_back(Instruction(InstrCode::INSTR_STORE, temporary));
+            // The value is still on top, so a reuse right after can duplicate it
+            loaded = temporary;
+            next_site += 1;
+        }
+        index += 1;
+    }
+    label.instructions = rewritten;
+}
+
+void ValueNumbering::run() {
+    for (uint label_ind = 0; label_ind < this->block->label_count(); label_ind += 1) {
+        for (const Instruction &instr : this->block->get_label_at_numerical_index(label_ind).instructions) {
+            if (instr.is_jump()) this->jumps[*instr.get_address()] += 1;
+        }
+    }
+
+    this->reuses.resize(this->block->label_count());
+    for (uint label_ind = 0; label_ind < this->block->label_count(); label_ind += 1) {
+        const label_index_t &name = *this->block->get_label_at_numerical_index(label_ind).name;
+
+        // The first label is also entered when the block starts
+        auto entry = this->entry_states.find(name);
+        if (label_ind == 0 || entry == this->entry_states.end()) {
+            state_t state = state_t();
+            this->number_label(label_ind, state);
+            continue;
+        }
+        state_t state = std::move(entry->second);
+        this->entry_states.erase(entry);
+        this->number_label(label_ind, state);
+    }
+
+    /* Give each site that is reused a temporary */
+    Intermediate::VariableType temporary_type = this->function_ind == Intermediate::global_function_ind ?
+        Intermediate::GLOBAL_MUTABLE : Intermediate::FUNCTION_MUTABLE;
+    std::vector<std::vector<uint>> label_sites = std::vector<std::vector<uint>>(this->block->label_count());
+    for (uint site = 0; site < this->sites.size(); site += 1) {
+        if (this->sites[site].uses == 0) continue;
+
+        this->sites[site].temporary = this->ir.new_temporary(temporary_type, this->function_ind);
+        label_sites[this->sites[site].label].push_back(site);
+    }
+
+    for (uint label_ind = 0; label_ind < this->block->label_count(); label_ind += 1) {
+        this->rewrite_label(label_ind, label_sites[label_ind]);
+    }
+}
+
+void number_values(Intermediate::Block *block, Intermediate::LabelIR &ir, const function_globals_t &globals, const Runtime &runtime, int function_ind) {
+    ValueNumbering(block, ir, globals, runtime, function_ind).run();
+}
@@ -0,0 +1,20 @@
+/* Value numbering, to reuse values a block already computed */
+
+#ifndef _SGCPP_VALUE_NUMBERING_HPP
+#define _SGCPP_VALUE_NUMBERING_HPP
+
+#include "../ir/intermediate.hpp"
+#include "../runtime/runtime.hpp"
+#include "ssa.hpp"
+
+/* Gives every value on the stack a number, so values that must be the same get the same number.
+    Bin and unary ops only look at their operands, and native namespaces never change, so an op
+    or a namespace member whose operands have the same numbers as an earlier one is the same value.
+    So is a call to a pure native, like Math.sqrt, or a pure function, with the same arguments.
+    Numbering runs through a label, and on into any label that can only be jumped to from it.
+        An expression that was already computed loads a variable that still holds it, or a
+        temporary the first one is stored in.
+        Loading the same variable twice in a row duplicates the first load instead. */
+void number_values(Intermediate::Block *block, Intermediate::LabelIR &ir, const function_globals_t &globals, const Runtime &runtime, int function_ind);
+
+#endif
@@ -0,0 +1,391 @@
+/* Pattern-defeating quicksort, after Orson Peters' pdqsort.
+    It is an introsort whose pivot is a median of 3 (or a ninther for large ranges), with
+    three additions: ranges that turn out to be already partitioned are finished with an
+    insertion sort that gives up quickly, ranges full of a repeated pivot are split off in one
+    pass, and unbalanced partitions shuffle a few elements so that patterns can't force the
+    quadratic case. If too many partitions are unbalanced anyway, it falls back to heapsort.
+    The sort is not stable. */
+
+#ifndef _SGCPP_PDQSORT_HPP
+#define _SGCPP_PDQSORT_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <utility>
+
+namespace Sort {
+    namespace Detail {
+        // Ranges smaller than this are insertion sorted
+        const std::ptrdiff_t INSERTION_SORT_THRESHOLD = 24;
+        // Ranges larger than this use a pseudo median of 9 as the pivot
+        const std::ptrdiff_t NINTHER_THRESHOLD = 128;
+        // Number of elements partial_insertion_sort may move before it gives up
+        const std::size_t PARTIAL_INSERTION_SORT_LIMIT = 8;
+        // Elements compared at a time by the branchless partition. Offsets have to fit in a byte.
+        const std::size_t BLOCK_SIZE = 64;
+        const std::size_t CACHELINE_SIZE = 64;
+
+        template <typename T>
+        inline int log2(T number) {
+            int log = 0;
+            while (number >>= 1) log += 1;
+            return log;
+        }
+
+        template <typename Iter, typename Compare>
+        inline void insertion_sort(Iter begin, Iter end, Compare compare) {
+            typedef typename std::iterator_traits<Iter>::value_type T;
+            if (begin == end) return;
+
+            for (Iter current = begin + 1; current != end; ++current) {
+                Iter sift = current;
+                Iter sift_1 = current - 1;
+
+                if (compare(*sift, *sift_1)) {
+                    T moving = std::move(*sift);
+                    do { *sift-- = std::move(*sift_1); }
+                    while (sift != begin && compare(moving, *--sift_1));
+                    *sift = std::move(moving);
+                }
+            }
+        }
+        /* Only for ranges that have an element to their left that is less than or equal to
+            everything in them, which stops the sift without a bounds check */
+        template <typename Iter, typename Compare>
+        inline void unguarded_insertion_sort(Iter begin, Iter end, Compare compare) {
+            typedef typename std::iterator_traits<Iter>::value_type T;
+            if (begin == end) return;
+
+            for (Iter current = begin + 1; current != end; ++current) {
+                Iter sift = current;
+                Iter sift_1 = current - 1;
+
+                if (compare(*sift, *sift_1)) {
+                    T moving = std::move(*sift);
+                    do { *sift-- = std::move(*sift_1); }
+                    while (compare(moving, *--sift_1));
+                    *sift = std::move(moving);
+                }
+            }
+        }
+        /* Insertion sort that gives up once it has moved too many elements.
+            Returns true if the range got sorted. */
+        template <typename Iter, typename Compare>
+        inline bool partial_insertion_sort(Iter begin, Iter end, Compare compare) {
+            typedef typename std::iterator_traits<Iter>::value_type T;
+            if (begin == end) return true;
+
+            std::size_t moved = 0;
+            for (Iter current = begin + 1; current != end; ++current) {
+                Iter sift = current;
+                Iter sift_1 = current - 1;
+
+                if (compare(*sift, *sift_1)) {
+                    T moving = std::move(*sift);
+                    do { *sift-- = std::move(*sift_1); }
+                    while (sift != begin && compare(moving, *--sift_1));
+                    *sift = std::move(moving);
+                    moved += current - sift;
+                }
+
+                if (moved > PARTIAL_INSERTION_SORT_LIMIT) return false;
+            }
+            return true;
+        }
+
+        template <typename Iter, typename Compare>
+        inline void sort2(Iter a, Iter b, Compare compare) {
+            if (compare(*b, *a)) std::iter_swap(a, b);
+        }
+        template <typename Iter, typename Compare>
+        inline void sort3(Iter a, Iter b, Iter c, Compare compare) {
+            sort2(a, b, compare);
+            sort2(b, c, compare);
+            sort2(a, b, compare);
+        }
+
+        template <typename T>
+        inline T *align_cacheline(T *pointer) {
+            std::uintptr_t address = reinterpret_cast<std::uintptr_t>(pointer);
+            address = (address + CACHELINE_SIZE - 1) & ~static_cast<std::uintptr_t>(CACHELINE_SIZE - 1);
+            return reinterpret_cast<T*>(address);
+        }
+        /* Swap the elements at the offsets from first and last. When the counts on each side differ,
+            a cyclic permutation does it with one move per element instead of a swap. */
+        template <typename Iter>
+        inline void swap_offsets(
+            Iter first, Iter last,
+            const unsigned char *offsets_left, const unsigned char *offsets_right,
+            std::size_t count, bool use_swaps
+        ) {
+            typedef typename std::iterator_traits<Iter>::value_type T;
+            if (use_swaps) {
+                for (std::size_t index = 0; index < count; index += 1) {
+                    std::iter_swap(first + offsets_left[index], last - offsets_right[index]);
+                }
+            }
+            else if (count > 0) {
+                Iter left = first + offsets_left[0];
+                Iter right = last - offsets_right[0];
+                T moving(std::move(*left));
+                *left = std::move(*right);
+                for (std::size_t index = 1; index < count; index += 1) {
+                    left = first + offsets_left[index];
+                    *right = std::move(*left);
+                    right = last - offsets_right[index];
+                    *left = std::move(*right);
+                }
+                *right = std::move(moving);
+            }
+        }
+
+        /* Partition around *begin. Elements equal to the pivot go to the right.
+            Returns the pivot's final position, and whether nothing had to be swapped. */
+        template <typename Iter, typename Compare>
+        inline std::pair<Iter, bool> partition_right(Iter begin, Iter end, Compare compare) {
+            typedef typename std::iterator_traits<Iter>::value_type T;
+            T pivot(std::move(*begin));
+            Iter first = begin;
+            Iter last = end;
+
+            // The median of 3 guarantees an element >= the pivot exists, so this can't overrun
+            while (compare(*++first, pivot));
+            // If the first element was already in place, nothing stops the scan from the right
+            if (first - 1 == begin) while (first < last && !compare(*--last, pivot));
+            else while (!compare(*--last, pivot));
+
+            bool already_partitioned = first >= last;
+            while (first < last) {
+                std::iter_swap(first, last);
+                while (compare(*++first, pivot));
+                while (!compare(*--last, pivot));
+            }
+
+            Iter pivot_position = first - 1;
+            *begin = std::move(*pivot_position);
+            *pivot_position = std::move(pivot);
+            return std::make_pair(pivot_position, already_partitioned);
+        }
+        /* Same as partition_right, but the comparisons go into offset buffers instead of
+            branches, so a comparison the CPU can't predict doesn't cost a misprediction.
+            Only worth it when comparing is cheap, e.g. for numbers. */
+        template <typename Iter, typename Compare>
+        inline std::pair<Iter, bool> partition_right_branchless(Iter begin, Iter end, Compare compare) {
+            typedef typename std::iterator_traits<Iter>::value_type T;
+            T pivot(std::move(*begin));
+            Iter first = begin;
+            Iter last = end;
+
+            while (compare(*++first, pivot));
+            if (first - 1 == begin) while (first < last && !compare(*--last, pivot));
+            else while (!compare(*--last, pivot));
+
+            bool already_partitioned = first >= last;
+            if (!already_partitioned) {
+                std::iter_swap(first, last);
+                ++first;
+
+                unsigned char offsets_left_storage[BLOCK_SIZE + CACHELINE_SIZE];
+                unsigned char offsets_right_storage[BLOCK_SIZE + CACHELINE_SIZE];
+                unsigned char *offsets_left = align_cacheline(offsets_left_storage);
+                unsigned char *offsets_right = align_cacheline(offsets_right_storage);
+
+                Iter offsets_left_base = first;
+                Iter offsets_right_base = last;
+                std::size_t count_left = 0, count_right = 0, start_left = 0, start_right = 0;
+
+                while (first < last) {
+                    // Fill whichever buffer is empty. If both are, split what's left between them.
+                    std::size_t unknown = last - first;
+                    std::size_t left_split = count_left == 0 ? (count_right == 0 ? unknown / 2 : unknown) : 0;
+                    std::size_t right_split = count_right == 0 ? (unknown - left_split) : 0;
+
+                    // Offsets of elements on the left that belong on the right
+                    std::size_t left_block = std::min(left_split, BLOCK_SIZE);
+                    for (std::size_t index = 0; index < left_block; index += 1) {
+                        offsets_left[count_left] = static_cast<unsigned char>(index);
+                        count_left += !compare(*first, pivot);
+                        ++first;
+                    }
+                    // Offsets of elements on the right that belong on the left
+                    std::size_t right_block = std::min(right_split, BLOCK_SIZE);
+                    for (std::size_t index = 0; index < right_block; index += 1) {
+                        offsets_right[count_right] = static_cast<unsigned char>(index + 1);
+                        count_right += compare(*--last, pivot);
+                    }
+
+                    std::size_t count = std::min(count_left, count_right);
+                    swap_offsets(
+                        offsets_left_base, offsets_right_base,
+                        offsets_left + start_left, offsets_right + start_right,
+                        count, count_left == count_right);
+                    count_left -= count;
+                    count_right -= count;
+                    start_left += count;
+                    start_right += count;
+
+                    if (count_left == 0) {
+                        start_left = 0;
+                        offsets_left_base = first;
+                    }
+                    if (count_right == 0) {
+                        start_right = 0;
+                        offsets_right_base = last;
+                    }
+                }
+
+                // One of the buffers may still have misplaced elements. Move them to the boundary.
+                if (count_left > 0) {
+                    offsets_left += start_left;
+                    while (count_left-- > 0) std::iter_swap(offsets_left_base + offsets_left[count_left], --last);
+                    first = last;
+                }
+                if (count_right > 0) {
+                    offsets_right += start_right;
+                    while (count_right-- > 0) {
+                        std::iter_swap(offsets_right_base - offsets_right[count_right], first);
+                        ++first;
+                    }
+                    last = first;
+                }
+            }
+
+            Iter pivot_position = first - 1;
+            *begin = std::move(*pivot_position);
+            *pivot_position = std::move(pivot);
+            return std::make_pair(pivot_position, already_partitioned);
+        }
+        /* Partition around *begin with elements equal to the pivot on the left.
+            Used when the pivot equals the element before the range, in which case
+            everything equal to it is already in its final place. */
+        template <typename Iter, typename Compare>
+        inline Iter partition_left(Iter begin, Iter end, Compare compare) {
+            typedef typename std::iterator_traits<Iter>::value_type T;
+            T pivot(std::move(*begin));
+            Iter first = begin;
+            Iter last = end;
+
+            while (compare(pivot, *--last));
+            if (last + 1 == end) while (first < last && !compare(pivot, *++first));
+            else while (!compare(pivot, *++first));
+
+            while (first < last) {
+                std::iter_swap(first, last);
+                while (compare(pivot, *--last));
+                while (!compare(pivot, *++first));
+            }
+
+            Iter pivot_position = last;
+            *begin = std::move(*pivot_position);
+            *pivot_position = std::move(pivot);
+            return pivot_position;
+        }
+
+        /* Sorts [begin, end). Leftmost is false if there's an element before begin that
+            is less than or equal to everything in the range. */
+        template <bool Branchless, typename Iter, typename Compare>
+        void pdqsort_loop(Iter begin, Iter end, Compare compare, int bad_allowed, bool leftmost = true) {
+            typedef typename std::iterator_traits<Iter>::difference_type difference_t;
+
+            // Recurse into the smaller side and loop on the other
+            while (true) {
+                difference_t size = end - begin;
+
+                if (size < INSERTION_SORT_THRESHOLD) {
+                    if (leftmost) insertion_sort(begin, end, compare);
+                    else unguarded_insertion_sort(begin, end, compare);
+                    return;
+                }
+
+                // Put the pivot at begin
+                difference_t half = size / 2;
+                if (size > NINTHER_THRESHOLD) {
+                    sort3(begin, begin + half, end - 1, compare);
+                    sort3(begin + 1, begin + (half - 1), end - 2, compare);
+                    sort3(begin + 2, begin + (half + 1), end - 3, compare);
+                    sort3(begin + (half - 1), begin + half, begin + (half + 1), compare);
+                    std::iter_swap(begin, begin + half);
+                }
+                else sort3(begin + half, begin, end - 1, compare);
+
+                /* If the pivot equals the element before the range, the range has a lot of that
+                    value. Put all of them on the left, where they're done, and only sort the rest. */
+                if (!leftmost && !compare(*(begin - 1), *begin)) {
+                    begin = partition_left(begin, end, compare) + 1;
+                    continue;
+                }
+
+                std::pair<Iter, bool> partition = Branchless ?
+                    partition_right_branchless(begin, end, compare) :
+                    partition_right(begin, end, compare);
+                Iter pivot_position = partition.first;
+                bool already_partitioned = partition.second;
+
+                difference_t left_size = pivot_position - begin;
+                difference_t right_size = end - (pivot_position + 1);
+                bool highly_unbalanced = left_size < size / 8 || right_size < size / 8;
+
+                if (highly_unbalanced) {
+                    // Too many bad pivots. Heapsort keeps the worst case at n log n.
+                    bad_allowed -= 1;
+                    if (bad_allowed == 0) {
+                        std::make_heap(begin, end, compare);
+                        std::sort_heap(begin, end, compare);
+                        return;
+                    }
+
+                    // Break up whatever pattern caused the bad pivot
+                    if (left_size >= INSERTION_SORT_THRESHOLD) {
+                        std::iter_swap(begin, begin + left_size / 4);
+                        std::iter_swap(pivot_position - 1, pivot_position - left_size / 4);
+
+                        if (left_size > NINTHER_THRESHOLD) {
+                            std::iter_swap(begin + 1, begin + (left_size / 4 + 1));
+                            std::iter_swap(begin + 2, begin + (left_size / 4 + 2));
+                            std::iter_swap(pivot_position - 2, pivot_position - (left_size / 4 + 1));
+                            std::iter_swap(pivot_position - 3, pivot_position - (left_size / 4 + 2));
+                        }
+                    }
+                    if (right_size >= INSERTION_SORT_THRESHOLD) {
+                        std::iter_swap(pivot_position + 1, pivot_position + (1 + right_size / 4));
+                        std::iter_swap(end - 1, end - right_size / 4);
+
+                        if (right_size > NINTHER_THRESHOLD) {
+                            std::iter_swap(pivot_position + 2, pivot_position + (2 + right_size / 4));
+                            std::iter_swap(pivot_position + 3, pivot_position + (3 + right_size / 4));
+                            std::iter_swap(end - 2, end - (1 + right_size / 4));
+                            std::iter_swap(end - 3, end - (2 + right_size / 4));
+                        }
+                    }
+                }
+                // A partition that needed no swaps is probably part of a sorted run
+                else if (
+                    already_partitioned &&
+                    partial_insertion_sort(begin, pivot_position, compare) &&
+                    partial_insertion_sort(pivot_position + 1, end, compare)
+                ) return;
+
+                pdqsort_loop<Branchless>(begin, pivot_position, compare, bad_allowed, leftmost);
+                begin = pivot_position + 1;
+                leftmost = false;
+            }
+        }
+    };
+
+    /* compare(a, b) must be a strict weak ordering, like std::sort's */
+    template <typename Iter, typename Compare>
+    void pdqsort(Iter begin, Iter end, Compare compare) {
+        if (end - begin < 2) return;
+        Detail::pdqsort_loop<false>(begin, end, compare, Detail::log2(end - begin));
+    }
+    /* For comparisons that are cheap and hard to predict, like < on numbers */
+    template <typename Iter, typename Compare>
+    void pdqsort_branchless(Iter begin, Iter end, Compare compare) {
+        if (end - begin < 2) return;
+        Detail::pdqsort_loop<true>(begin, end, compare, Detail::log2(end - begin));
+    }
+};
+
+#endif
@@ -1,6 +1,9 @@
 #include "runtime.hpp"
+#include "../natives/console.hpp"
+#include "../value-table.hpp"
 
 #include <array>
+#include <cstring>
 #include <unordered_map>
 
 #include <math.h>
@@ -26,6 +29,36 @@ RuntimeCallFrame::RuntimeCallFrame(
         }
     };
 
+bool memo_key_t::operator==(const memo_key_t &key) const {
+    if (this->count != key.count) return false;
+    for (uint arg = 0; arg < this->count; arg += 1) {
+        // Compare the bits, so 0 and -0 stay apart
+        if (this->types[arg] != key.types[arg] || std::memcmp(&this->numbers[arg], &key.numbers[arg], sizeof(number_t)) != 0) return false;
+    }
+    return true;
+}
+size_t MemoKeyHasher::operator()(const memo_key_t &key) const {
+    size_t hash = key.count;
+    for (uint arg = 0; arg < key.count; arg += 1) {
+        uint64_t bits;
+        std::memcpy(&bits, &key.numbers[arg], sizeof(bits));
+        hash ^= std::hash<uint64_t>()(bits ^ key.types[arg]) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    }
+    return hash;
+}
+/* The key of a call, if every argument can be part of one */
+static bool make_memo_key(const Value *args, uint arg_count, memo_key_t &key) {
+    key.count = arg_count;
+    for (uint arg = 0; arg < arg_count; arg += 1) {
+        ValueType type = get_value_type(args[arg]);
+        if (type != ValueType::NUMBER && type != ValueType::TRUE && type != ValueType::FALSE && type != ValueType::NULL_VALUE) return false;
+
+        key.types[arg] = type;
+        key.numbers[arg] = type == ValueType::NUMBER ? get_value_number(args[arg]) : 0;
+    }
+    return true;
+}
+
 Runtime::Runtime(Bytecode::Chunk &main) : main(main) {
     Natives::create_natives(this->natives);
     this->running_blocks.push_back(&this->main);
@@ -41,28 +74,71 @@ Bytecode::variable_index_t Runtime::new_constant(Values::Value value) {
 }
 void Runtime::add_function(RuntimeFunction &func) {
     this->functions.push_back(func);
+    this->memo_tables.push_back(memo_table_t());
+}
+const Values::record_shape_t *Runtime::add_shape(const Values::record_shape_t &shape) {
+    this->shapes.push_back(std::make_unique<Values::record_shape_t>(shape));
+    return this->shapes.back().get();
 }
 
 
-void Runtime::add_object(Object *obj) {
-    #ifdef DEBUG_STRESS_GC
-        std::cout << "GC: Allocating value (" << obj << ") " <<
-            object_to_debug_string(obj) << " on heap\n";
-        this->run_gc();
-    #endif
-
-    this->gc_size += sizeof(Object*);
+/* The memory an object holds, as gc_size counts it */
+static size_t object_size(const Object *obj) {
+    size_t size = sizeof(Object) + sizeof(Object*);
     switch (obj->type) {
+        // Growth through reserve_array is counted as it happens, and the rest when the GC runs
         case ObjectType::ARRAY:
-            this->gc_size += sizeof(obj_mem_t::array) + sizeof(*obj_mem_t::array);
+            size += sizeof(obj_mem_t::array) + sizeof(*obj_mem_t::array) +
+                obj->memory.array->capacity() * sizeof(Value);
             break;
         case ObjectType::STRING:
-            this->gc_size += sizeof(obj_mem_t::str) + sizeof(*obj_mem_t::str) + obj->memory.str->size();;
+            size += sizeof(obj_mem_t::str) + sizeof(*obj_mem_t::str) + obj->memory.str->chars.size();
+            break;
+        // Slices share the parent's characters, so only the view counts
+        case ObjectType::STRING_SLICE:
+            size += sizeof(obj_mem_t::slice) + sizeof(*obj_mem_t::slice);
+            break;
+        // Builders and tables grow without being counted, until the GC runs
+        case ObjectType::STRING_BUILDER:
+            size += sizeof(obj_mem_t::builder) + sizeof(*obj_mem_t::builder) + obj->memory.builder->capacity();
+            break;
+        case ObjectType::TYPED_ARRAY:
+            size += sizeof(obj_mem_t::typed_array) + sizeof(*obj_mem_t::typed_array);
+            // Views share their owner's buffer
+            if (!obj->memory.typed_array->is_view()) {
+                size += obj->memory.typed_array->length * obj->memory.typed_array->element_size();
+            }
+            break;
+        case ObjectType::ARRAY_SLICE:
+            size += sizeof(obj_mem_t::array_slice) + sizeof(*obj_mem_t::array_slice);
+            break;
+        case ObjectType::MAP:
+        case ObjectType::SET:
+            size += sizeof(obj_mem_t::table) + sizeof(*obj_mem_t::table) +
+                obj->memory.table->capacity() * (sizeof(value_table_t::entry_t) + 1);
+            break;
+        case ObjectType::RECORD:
+            size += sizeof(obj_mem_t::record) + sizeof(*obj_mem_t::record) +
+                obj->memory.record->field_count() * sizeof(Value);
             break;
         // Constant namespaces are allocated at compile time
-        case ObjectType::NAMESPACE_CONSTANT: throw sg_assert_error("Tried to allocate at runtime a compile-time constant namespace");
+        case ObjectType::NAMESPACE_CONSTANT: break;
     }
 
+    return size;
+}
+
+void Runtime::add_object(Object *obj) {
+    #ifdef DEBUG_STRESS_GC
+        std::cout << "GC: Allocating value (" << obj << ") " <<
+            object_to_debug_string(obj) << " on heap\n";
+        this->run_gc();
+    #endif
+
+    // Constant namespaces are allocated at compile time
+    if (obj->type == ObjectType::NAMESPACE_CONSTANT) throw sg_assert_error("Tried to allocate at runtime a compile-time constant namespace");
+    this->gc_size += object_size(obj);
+
     #ifdef DEBUG_GC
     std::cout << "gc_size=" << this->gc_size << std::endl;
     #endif
@@ -71,13 +147,79 @@ void Runtime::add_object(Object *obj) {
     this->runtime_values = obj;
 };
 
+record_t *Runtime::create_record(const record_shape_t *shape) {
+    try {
+        return record_t::allocate(shape);
+    } catch (const std::bad_alloc&) {
+        this->run_gc();
+        try {
+            return record_t::allocate(shape);
+        } catch (const std::bad_alloc&) {
+            throw memory_error();
+        }
+    }
+}
+
+void Runtime::make_writable(Object *obj) {
+    if (obj->type == ObjectType::TYPED_ARRAY) {
+        typed_array_t *typed = obj->memory.typed_array;
+        if (!typed->is_view()) return;
+
+        try {
+            typed->detach();
+        } catch (const std::bad_alloc&) {
+            this->run_gc();
+            try {
+                typed->detach();
+            } catch (const std::bad_alloc&) {
+                throw memory_error();
+            }
+        }
+        this->gc_size += typed->length * typed->element_size();
+        return;
+    }
+    if (obj->type != ObjectType::ARRAY_SLICE) return;
+
+    array_slice_t *slice = obj->memory.array_slice;
+    const Value *elements = array_elements(obj);
+    std::vector<Value> *array = this->create<std::vector<Value>>(elements, elements + slice->length);
+    delete slice;
+
+    // The object keeps its identity, so every reference to the slice sees the copy
+    obj->type = ObjectType::ARRAY;
+    obj->memory.array = array;
+    obj->element_kind = ArrayElementKind::NO_ELEMENTS;
+    for (const Value &element : *array) record_array_element(obj, element);
+
+    this->gc_size += sizeof(*obj_mem_t::array) + array->size() * sizeof(Value);
+}
+
+void Runtime::reserve_array(Object *obj, size_t capacity) {
+    std::vector<Value> *array = obj->memory.array;
+    size_t old_capacity = array->capacity();
+    if (capacity <= old_capacity) return;
+
+    try {
+        array->reserve(capacity);
+    } catch (const std::bad_alloc&) {
+        this->run_gc();
+        try {
+            array->reserve(capacity);
+        } catch (const std::bad_alloc&) {
+            throw memory_error();
+        }
+    }
+    this->gc_size += (array->capacity() - old_capacity) * sizeof(Value);
+}
+
 void Runtime::push_stack_value(Values::Value value) {
     this->stack.push_back(value);
 };
 
 void Runtime::mark_object(Values::Value value) {
     Object *obj = safe_get_value_object(value);
-    if (obj == nullptr) return;
+    // Already marked objects have had their children marked too. This also stops cycles.
+    if (obj == nullptr || obj->marked_for_save) return;
 
     #ifdef DEBUG_GC
     std::cout << "GC: Marking value " << value_to_debug_string(value) <<
@@ -86,12 +228,37 @@ void Runtime::mark_object(Values::Value value) {
 
     obj->marked_for_save = true;
 
-    // If it's array, get all of ITS values as well
-    if (obj->type == ObjectType::ARRAY) {
+    // If it's array, get all of ITS values as well. Numbers have nothing to mark.
+    if (obj->type == ObjectType::ARRAY && !array_holds_only_numbers(obj)) {
         for (Values::Value &value : *get_value_array(value)) {
             mark_object(value);
         }
     }
+    else if (obj->type == ObjectType::MAP || obj->type == ObjectType::SET) {
+        obj->memory.table->for_each([this](const value_table_t::entry_t &entry) {
+            this->mark_object(entry.key);
+            this->mark_object(entry.value);
+        });
+    }
+    // Only the fields can hold references. The shape belongs to the runtime.
+    else if (obj->type == ObjectType::RECORD) {
+        record_t *record = obj->memory.record;
+        Value *fields = record->fields();
+        for (size_t index = 0; index < record->field_count(); index += 1) {
+            mark_object(fields[index]);
+        }
+    }
+    // A slice has to keep the string it views alive
+    else if (obj->type == ObjectType::STRING_SLICE) {
+        obj->memory.slice->parent->marked_for_save = true;
+    }
+    // Array slices keep the whole parent, and with it, the elements outside the slice
+    else if (obj->type == ObjectType::ARRAY_SLICE) {
+        mark_object(value_from_object(obj->memory.array_slice->parent));
+    }
+    else if (obj->type == ObjectType::TYPED_ARRAY && obj->memory.typed_array->is_view()) {
+        obj->memory.typed_array->owner->marked_for_save = true;
+    }
 };
 void Runtime::mark_values() {
     // Mark every value referenced by variables
@@ -118,13 +285,17 @@ void Runtime::mark_values() {
 
     // Next, everything on the stack
     for (Values::Value &value : this->stack) {
+        #ifdef DEBUG_GC
         std::cout << "GC: Moving to mark stack value " << value_to_debug_string(value) << std::endl;
+        #endif
         mark_object(value);
     }
 }
 void Runtime::delete_values() {
     Object *current = this->runtime_values;
     this->runtime_values = nullptr;
+    // Only what's saved counts after this, at its size now, since arrays and tables can have grown or shrunk
+    size_t live_size = 0;
 
     while (current != nullptr) {
         Object *next = current->next;
@@ -138,7 +309,6 @@ void Runtime::delete_values() {
             std::cout << "GC: Deleting value @ " << current << std::endl;
             #endif
 
-            this->gc_size -= sizeof(Object) + sizeof(Object*);
             delete current;
         }
         else {
@@ -148,12 +318,24 @@ void Runtime::delete_values() {
 
             current->next = this->runtime_values;
             this->runtime_values = current;
+            live_size += object_size(current);
         }
 
         current = next;
     }
+
+    this->gc_size = live_size;
+}
+void Runtime::evict_memoized_objects() {
+    for (memo_table_t &table : this->memo_tables) {
+        for (auto entry = table.begin(); entry != table.end();) {
+            if (get_value_type(entry->second) == ValueType::OBJ) entry = table.erase(entry);
+            else entry++;
+        }
+    }
 }
 void Runtime::run_gc() {
+    this->evict_memoized_objects();
     this->mark_values();
     this->delete_values();
 }
@@ -168,6 +350,62 @@ Values::Value Runtime::stack_pop() {
     return back;
 }
 
+bool Runtime::get_property(const Value &object, const std::string &name, Value &result) {
+    Object *obj = safe_get_value_object(object);
+
+    if (obj != nullptr && obj->type == ObjectType::RECORD) {
+        record_t *record = obj->memory.record;
+        int index = record->shape->field_index(name);
+        if (index < 0) {
+            this->error = "Struct ";
+            this->error += record->shape->name;
+            this->error += " has no field ";
+            this->error += name;
+            return false;
+        }
+        result = record->fields()[index];
+        return true;
+    }
+
+    if (obj == nullptr || obj->type != ObjectType::NAMESPACE_CONSTANT) {
+        this->error = "Cannot access property ";
+        this->error += name;
+        this->error += " of non-object value ";
+        this->error += value_to_string(object);
+        return false;
+    }
+
+    auto namespace_ = obj->memory.namespace_;
+    auto property = namespace_->find(name);
+    if (property == namespace_->end()) result = Value(ValueType::NULL_VALUE);
+    else result = property->second;
+    return true;
+}
+bool Runtime::set_property(const Value &object, const std::string &name, const Value &value) {
+    Object *obj = safe_get_value_object(object);
+
+    if (obj == nullptr || obj->type != ObjectType::RECORD) {
+        this->error = "Cannot set property ";
+        this->error += name;
+        this->error += " of value ";
+        this->error += value_to_string(object);
+        this->error += ". Only the fields of a struct can be set.";
+        return false;
+    }
+
+    record_t *record = obj->memory.record;
+    int index = record->shape->field_index(name);
+    if (index < 0) {
+        this->error = "Struct ";
+        this->error += record->shape->name;
+        this->error += " has no field ";
+        this->error += name;
+        return false;
+    }
+    record->fields()[index] = value;
+    return true;
+}
+
 void Runtime::log_call_frame(RuntimeCallFrame &frame, std::ostream &out) {
     RuntimeFunction func = this->functions.at(frame.func_index);
     out << func.name << "(...)" << std::endl;
@@ -190,7 +428,9 @@ void Runtime::log_stack_trace(std::ostream &out) {
         log_call_frame(this->call_stack.at(ind), out);
     }
 }
-void Runtime::exit() {}
+void Runtime::exit() {
+    Natives::flush_console();
+}
 
 void Runtime::log_instructions() {
     this->main.print_code(this);
@@ -204,13 +444,186 @@ void Runtime::log_instructions() {
     }
 };
 
+bool Runtime::enter_function(constant_index_t func_ind) {
+    const RuntimeFunction &function = this->functions.at(func_ind);
+    Bytecode::variable_index_t total_variables = function.total_variables;
+    size_t necessary_space = this->variable_stack_size + total_variables;
+
+    if (this->global_variables.capacity() < necessary_space) {
+        // Growing past the capacity moves the slots, so the frames have to point into the new ones
+        std::vector<size_t> offsets = std::vector<size_t>();
+        for (const RuntimeCallFrame &frame : this->call_stack) offsets.push_back(frame.variables_start - this->global_variables.begin());
+
+        this->global_variables.resize(necessary_space);
+        for (size_t frame = 0; frame < offsets.size(); frame += 1) {
+            this->call_stack[frame].variables_start = this->global_variables.begin() + offsets[frame];
+        }
+    }
+    else if (this->global_variables.size() < necessary_space) {
+        this->global_variables.resize(necessary_space);
+    }
+    this->call_stack.push_back(
+        RuntimeCallFrame(func_ind, function.num_arguments, this->stack, this->global_variables.begin() + this->variable_stack_size)
+    );
+    this->variable_stack_size += total_variables;
+    this->running_blocks.push_back(&this->functions.at(func_ind).chunk);
+
+    uint stack_size = total_variables * sizeof(Value) + sizeof(RuntimeCallFrame);
+    this->call_stack_size += stack_size;
+
+    if (this->call_stack_size > MAX_CALL_STACK_SIZE) {
+        this->error = "Stack error: Maximum call stack size exceeded. ";
+        double size = this->call_stack_size / 1024.0;
+        char num[20];
+        snprintf(num, 20, "%.2lf", size);
+        this->error += num;
+        this->error += " KB necessary, but maximum is ";
+        this->error += std::to_string(MAX_CALL_STACK_SIZE / 1024);
+        this->error += " KB";
+        return false;
+    }
+    return true;
+}
+void Runtime::leave_function() {
+    uint total_variables = this->functions.at(this->call_stack.back().func_index).total_variables;
+    this->call_stack_size -= total_variables * sizeof(Value) + sizeof(RuntimeCallFrame);
+    this->variable_stack_size -= total_variables;
+    this->call_stack.pop_back();
+    this->running_blocks.pop_back();
+}
+bool Runtime::call_program_function(constant_index_t func_ind) {
+    const RuntimeFunction &function = this->functions[func_ind];
+    memo_key_t key;
+    if (!function.memoized || !make_memo_key(this->stack.data() + this->stack.size() - function.num_arguments, function.num_arguments, key)) {
+        return this->enter_function(func_ind);
+    }
+
+    memo_table_t &table = this->memo_tables[func_ind];
+    auto found = table.find(key);
+    if (found != table.end()) {
+        this->stack.resize(this->stack.size() - function.num_arguments);
+        this->stack.push_back(found->second);
+        return true;
+    }
+
+    if (!this->enter_function(func_ind)) return false;
+    this->call_stack.back().memoize = true;
+    this->memo_keys.push_back(key);
+    return true;
+}
+void Runtime::call_value(call_arguments_t num_args) {
+    Value func = this->stack_pop();
+
+    if (get_value_type(func) == Values::NATIVE_FUNCTION) {
+        Values::native_method_t native = get_value_native_function(func);
+        if (native.number_arguments != Values::VARIADIC_ARGUMENTS && num_args != native.number_arguments) {
+            this->error = std::to_string(num_args);
+            this->error += " argument(s) passed to function expecting ";
+            this->error += std::to_string(native.number_arguments);
+            return;
+        }
+
+        Values::Value result;
+        native.func(
+            (this->stack.begin() + (this->stack.size() - num_args)).base(),
+            num_args,
+            result, *this, this->error);
+
+        // Pop arguments
+        for (int pop = 0; pop < num_args; pop += 1) {
+            this->stack.pop_back();
+        }
+
+        this->push_stack_value(result);
+    }
+    else if (get_value_type(func) == Values::PROGRAM_FUNCTION) {
+        Bytecode::constant_index_t func_ind = get_value_program_function(func);
+        uint expected = this->functions[func_ind].num_arguments;
+        if (num_args != expected) {
+            this->error = std::to_string(num_args);
+            this->error += " argument(s) passed to function expecting ";
+            this->error += std::to_string(expected);
+            return;
+        }
+
+        this->call_program_function(func_ind);
+    }
+    else {
+        this->error = "Cannot call non-function value ";
+        this->error += value_to_string(func);
+    }
+}
+void Runtime::memoize_result(constant_index_t func_ind, const Value &result) {
+    memo_table_t &table = this->memo_tables[func_ind];
+    if (table.size() >= MAX_MEMO_ENTRIES) table.clear();
+
+    table.emplace(this->memo_keys.back(), result);
+    this->memo_keys.pop_back();
+}
+bool Runtime::call_function(const Value &func, const Value *args, uint arg_count, Value &result) {
+    size_t stack_base = this->stack.size();
+    for (uint arg = 0; arg < arg_count; arg += 1) {
+        this->stack.push_back(args[arg]);
+    }
+
+    if (get_value_type(func) == Values::NATIVE_FUNCTION) {
+        Values::native_method_t native = get_value_native_function(func);
+        if (native.number_arguments != Values::VARIADIC_ARGUMENTS && static_cast<int>(arg_count) != native.number_arguments) {
+            this->error = std::to_string(arg_count);
+            this->error += " argument(s) passed to function expecting ";
+            this->error += std::to_string(native.number_arguments);
+            this->stack.resize(stack_base);
+            return false;
+        }
+
+        native.func(this->stack.data() + stack_base, arg_count, result, *this, this->error);
+        this->stack.resize(stack_base);
+        return this->error.size() == 0;
+    }
+    else if (get_value_type(func) == Values::PROGRAM_FUNCTION) {
+        Bytecode::constant_index_t func_ind = get_value_program_function(func);
+        uint expected = this->functions.at(func_ind).num_arguments;
+        if (arg_count != expected) {
+            this->error = std::to_string(arg_count);
+            this->error += " argument(s) passed to function expecting ";
+            this->error += std::to_string(expected);
+            this->stack.resize(stack_base);
+            return false;
+        }
+
+        size_t return_depth = this->call_stack.size();
+        if (!this->call_program_function(func_ind)) return false;
+        // A cached result is already on the stack
+        if (this->call_stack.size() > return_depth && this->execute(return_depth) != 0) return false;
+
+        // The function left its return value on the stack
+        result = this->stack_pop();
+        return true;
+    }
+
+    this->error = "Cannot call non-function value ";
+    this->error += value_to_string(func);
+    this->stack.resize(stack_base);
+    return false;
+}
+
 int Runtime::run() {
     #ifdef DEBUG
     assert("Runtime global variable pool must be initialized before running");
     #endif
 
     main_ip = 0;
+    if (this->execute(NOT_NESTED) == 0) return 0;
+
+    // Keep the program's output in order with the error
+    Natives::flush_console();
+    std::cerr << rang::fg::red << "runtime error: " << rang::style::reset << this->error << std::endl;
+
+    this->log_stack_trace(std::cerr);
 
+    return -1;
+}
+int Runtime::execute(size_t return_depth) {
     while (this->call_stack.size() > 0 || this->main_ip < this->main.code_byte_count()) {
         Bytecode::address_t &prog_ip = 
             this->call_stack.size() > 0 ? this->call_stack.back().ip : this->main_ip;
@@ -233,77 +646,84 @@ int Runtime::run() {
 
             case OpCode::OP_CALL:
             {
-                Value func = this->stack_pop();
                 call_arguments_t num_args = this->read_value<call_arguments_t>(prog_ip);
+                this->call_value(num_args);
+            }
+                break;
+            case OpCode::OP_TAIL_CALL:
+            {
+                call_arguments_t num_args = this->read_value<call_arguments_t>(prog_ip);
+                Value func = this->stack.back();
+                // Anything that can't take over the frame is called like OP_CALL, and the following return returns its result
+                if (
+                    get_value_type(func) != Values::PROGRAM_FUNCTION ||
+                    this->functions[get_value_program_function(func)].num_arguments != num_args ||
+                    this->call_stack.back().memoize
+                ) {
+                    this->call_value(num_args);
+                    break;
+                }
 
-                if (get_value_type(func) == Values::NATIVE_FUNCTION) {
-                    Values::native_method_t native = get_value_native_function(func);
-                    if (num_args != native.number_arguments) {
-                        this->error = std::to_string(num_args);
-                        this->error += " argument(s) passed to function expecting ";
-                        this->error += std::to_string(native.number_arguments);
-                        break;
-                    }
+                this->stack.pop_back();
+                this->leave_function();
+                if (!this->call_program_function(get_value_program_function(func))) break;
 
-                    Values::Value result;
-                    native.func(
-                        (this->stack.begin() + (this->stack.size() - num_args)).base(),
-                        this->stack.size(),
-                        result, *this, this->error);
+                // The callee had a cached result, so it's returned like the caller would have
+                if (this->call_stack.size() == return_depth) return 0;
+            }
+                break;
+            /* The callee and its arguments were checked when the program was compiled */
+            case OpCode::OP_CALL_FUNCTION:
+            {
+                constant_index_t func_ind = this->read_value<constant_index_t>(prog_ip);
+                this->call_program_function(func_ind);
+            }
+                break;
+            case OpCode::OP_TAIL_CALL_FUNCTION:
+            {
+                constant_index_t func_ind = this->read_value<constant_index_t>(prog_ip);
+                // A memoized call has to come back to cache its result, so the following return does
+                if (this->call_stack.back().memoize) {
+                    this->call_program_function(func_ind);
+                    break;
+                }
 
-                    // Pop arguments
-                    for (int pop = 0; pop < native.number_arguments; pop += 1) {
-                        this->stack.pop_back();
-                    }
+                // The arguments are on the stack, so the callee's variables can go where the caller's were
+                this->leave_function();
+                if (!this->call_program_function(func_ind)) break;
 
-                    this->push_stack_value(result);
-                }
-                else if (get_value_type(func) == Values::PROGRAM_FUNCTION) {
-                    Bytecode::constant_index_t func_ind = get_value_program_function(func);
-                    Bytecode::call_arguments_t num_args = this->functions.at(func_ind).num_arguments;
-
-                    Bytecode::variable_index_t total_variables = this->functions.at(func_ind).total_variables;
-                    size_t necessary_space = this->variable_stack_size + total_variables;
-                    
-                    if (this->global_variables.size() < necessary_space) {
-                        this->global_variables.resize(necessary_space);
-                    }
-                    this->call_stack.push_back(
-                        RuntimeCallFrame(func_ind, num_args, this->stack, this->global_variables.begin() + this->variable_stack_size)
-                    );
-                    this->variable_stack_size += total_variables;
-                    this->running_blocks.push_back(&this->functions.at(func_ind).chunk);
-
-                    uint stack_size = total_variables * sizeof(Value) + sizeof(RuntimeCallFrame);
-                    this->call_stack_size += stack_size;
-
-                    if (this->call_stack_size > MAX_CALL_STACK_SIZE) {
-                        this->error = "Stack error: Maximum call stack size exceeded. ";
-                        double size = this->call_stack_size / 1024.0;
-                        char num[20];
-                        snprintf(num, 20, "%.2lf", size);
-                        this->error += num;
-                        this->error += " KB necessary, but maximum is ";
-                        this->error += std::to_string(MAX_CALL_STACK_SIZE / 1024);
-                        this->error += " KB";
-                        break;
-                    }
-                }
-                else {
-                    this->error = "Cannot call non-function value ";
-                    this->error += value_to_string(func);
-                    break;
+                // The callee had a cached result, so it's returned like the caller would have
+                if (this->call_stack.size() == return_depth) return 0;
+            }
+                break;
+            case OpCode::OP_CALL_NATIVE:
+            {
+                Values::native_method_t native = get_value_native_function(this->constants[this->read_value<constant_index_t>(prog_ip)]);
+                call_arguments_t num_args = this->read_value<call_arguments_t>(prog_ip);
+
+                Values::Value result;
+                native.func(
+                    (this->stack.begin() + (this->stack.size() - num_args)).base(),
+                    num_args,
+                    result, *this, this->error);
+
+                // Pop arguments
+                for (int pop = 0; pop < num_args; pop += 1) {
+                    this->stack.pop_back();
                 }
+
+                this->push_stack_value(result);
             }
                 break;
 
             case OpCode::OP_RETURN:
             {
-                uint total_variables = this->functions.at(this->call_stack.back().func_index).total_variables;
-                this->call_stack_size -= total_variables * sizeof(Value) + sizeof(RuntimeCallFrame);
-                this->variable_stack_size -= total_variables;
-                this->call_stack.pop_back();
-                this->running_blocks.pop_back();
+                // The return value is on top of the stack
+                if (this->call_stack.back().memoize) this->memoize_result(this->call_stack.back().func_index, this->stack.back());
+                this->leave_function();
+
+                // A call made by a native is done, so give control back to it
+                if (this->call_stack.size() == return_depth) return 0;
             }
                 break;
 
@@ -312,6 +732,13 @@ int Runtime::run() {
                 this->stack_pop();
             }
                 break;
+            case OpCode::OP_DUP:
+            {
+                // Copy first, pushing may move the stack
+                Value top = this->stack.back();
+                this->push_stack_value(top);
+            }
+                break;
             case OpCode::OP_GOTO:
             {
                 address_t address = this->get_running_block()->read_address(prog_ip);
@@ -367,23 +794,32 @@ int Runtime::run() {
             case OpCode::OP_MAKE_ARRAY:
             {
                 variable_index_t element_count = this->read_value<variable_index_t>(prog_ip);
-                std::vector<Value> *array = this->create<std::vector<Value>>(element_count);
-
-                // Add the elements to the array
-                for (uint value_index = this->stack.size() - element_count; value_index < this->stack.size(); value_index += 1) {
-                    (*array)[value_index] = this->stack.at(value_index);
-                }
-                // Now pop the results from the stack
-                for (uint pop = 0; pop < element_count; pop += 1) {
-                    this->stack.pop_back();
-                }
+                std::vector<Value> *array = this->create<std::vector<Value>>(
+                    this->stack.end() - element_count, this->stack.end());
 
+                // The elements stay on the stack until the array is known to the GC
                 Object *obj = this->create<Object>(array);
                 this->add_object(obj);
 
+                this->stack.resize(this->stack.size() - element_count);
                 this->stack.push_back(Values::Value(obj));
             }
                 break;
+            case OpCode::OP_LOAD_CONST_ARRAY:
+            {
+                constant_index_t index = this->read_value<constant_index_t>(prog_ip);
+                Object *constant = get_value_object(this->constants.at(index));
+
+                array_slice_t *slice = this->create<array_slice_t>(array_slice_t{
+                    .parent = constant,
+                    .offset = 0,
+                    .length = constant->memory.array->size()
+                });
+                Object *obj = this->create<Object>(slice);
+                this->add_object(obj);
+                this->stack.push_back(value_from_object(obj));
+            }
+                break;
             // Automatically push a copy of the push value if we're setting a value, e.g. arr[ind] = 3;
             case OpCode::OP_GET_ARRAY_VALUE:
             case OpCode::OP_SET_ARRAY_VALUE:
@@ -404,7 +840,11 @@ int Runtime::run() {
                 Object *array_obj = safe_get_value_object(array_value);;
                 if (
                     array_obj == nullptr ||
-                    (array_obj->type != ObjectType::ARRAY && array_obj->type != ObjectType::STRING)
+                    (
+                        !object_is_array(array_obj) &&
+                        array_obj->type != ObjectType::TYPED_ARRAY &&
+                        !object_is_string(array_obj)
+                    )
                 ) {
                     this->error = "Cannot index value ";
                     this->error += value_to_string(array_value);
@@ -413,35 +853,60 @@ int Runtime::run() {
 
                 Values::number_t index = get_value_number(index_value);
 
-                if (array_obj->type == ObjectType::ARRAY) {
-                    std::vector<Value> *array = array_obj->memory.array;
-                    if (index > static_cast<Values::number_t>(array->size()) || index < 0 || index != floor(index)) {
+                if (object_is_array(array_obj)) {
+                    if (index >= static_cast<Values::number_t>(array_length(array_obj)) || index < 0 || index != floor(index)) {
                         this->error = "Array index must be an integer within the range of array's values, but index was ";
                         this->error += value_to_string(index_value);
                         break;
                     }
 
                     if (code == OpCode::OP_GET_ARRAY_VALUE) {
-                        this->stack.push_back(array->at(floor(index)));
+                        this->stack.push_back(array_elements(array_obj)[static_cast<size_t>(index)]);
                     }
                     else {
-                        (*array)[static_cast<uint>(floor(index))] = set_value;
+                        // Slices are copied before the first write, so the parent is left alone
+                        this->make_writable(array_obj);
+                        (*array_obj->memory.array)[static_cast<size_t>(index)] = set_value;
+                        record_array_element(array_obj, set_value);
                         this->stack.push_back(set_value);
                     }
                 }
-                else if (array_obj->type == ObjectType::STRING) {
+                else if (array_obj->type == ObjectType::TYPED_ARRAY) {
+                    typed_array_t *array = array_obj->memory.typed_array;
+                    if (index >= static_cast<Values::number_t>(array->length) || index < 0 || index != floor(index)) {
+                        this->error = "Array index must be an integer within the range of array's values, but index was ";
+                        this->error += value_to_string(index_value);
+                        break;
+                    }
+
+                    if (code == OpCode::OP_GET_ARRAY_VALUE) {
+                        this->push_stack_value(value_from_number(array->get(static_cast<size_t>(index))));
+                    }
+                    else {
+                        if (get_value_type(set_value) != ValueType::NUMBER) {
+                            this->error = "Typed arrays can only hold numbers, but was given ";
+                            this->error += value_to_string(set_value);
+                            break;
+                        }
+                        this->make_writable(array_obj);
+                        array->set(static_cast<size_t>(index), get_value_number(set_value));
+                        this->push_stack_value(set_value);
+                    }
+                }
+                else {
                     if (code == OpCode::OP_SET_ARRAY_VALUE) {
                         this->error = "Strings are immutable. Cannot update string ";
                         this->error += value_to_string(array_value);
                     }
-                    std::string *str = array_obj->memory.str;
-                    if (index > static_cast<Values::number_t>(str->size()) || index < 0 || index != floor(index)) {
+                    // Strings are indexed by code point
+                    if (index >= static_cast<Values::number_t>(string_length(array_obj)) || index < 0 || index != floor(index)) {
                         this->error = "String index must be an integer within the range of array's values, but index was ";
                         this->error += value_to_string(index_value);
                         break;
                     }
 
-                    std::string *character = this->create<std::string>(1, (*str)[index]);
+                    string_t *character = this->create<string_t>(
+                        string_code_point_at(array_obj, static_cast<size_t>(index)));
                     Object *obj = this->create<Object>(character);
                     this->add_object(obj);
                     this->push_stack_value(Value(obj));
@@ -453,26 +918,69 @@ int Runtime::run() {
             case OpCode::OP_CONSTANT_PROPERTY_ACCESS:
             {
                 Value left = this->stack_pop();
-                Object *obj = safe_get_value_object(left);
-
                 std::string *property_name = this->read_value<std::string*>(prog_ip);
 
-                if (obj == nullptr || obj->type != ObjectType::NAMESPACE_CONSTANT) {
-                    this->error = "Cannot access property ";
-                    this->error += *property_name;
-                    this->error += " of non-object value ";
-                    this->error += value_to_string(left);
-                    break;
+                Value property;
+                if (!this->get_property(left, *property_name, property)) break;
+                this->push_stack_value(property);
+            }
+                break;
+
+            case OpCode::OP_MAKE_RECORD:
+            {
+                const record_shape_t *shape = this->read_value<const record_shape_t*>(prog_ip);
+                size_t field_count = shape->fields.size();
+
+                // The fields stay on the stack until the record is in the GC's list, so they can't be collected
+                record_t *record = this->create_record(shape);
+                size_t first_field = this->stack.size() - field_count;
+                std::copy(this->stack.begin() + first_field, this->stack.end(), record->fields());
+
+                Object *obj;
+                try {
+                    obj = this->create<Object>(record);
+                } catch (...) {
+                    record_t::free(record);
+                    throw;
                 }
+                this->add_object(obj);
 
-                auto namespace_ = obj->memory.namespace_;
-                auto property = namespace_->find(*property_name);
-                if (property == namespace_->end()) {
-                    this->push_stack_value(Value(ValueType::NULL_VALUE));
+                this->stack.resize(first_field);
+                this->push_stack_value(Value(obj));
+            }
+                break;
+            case OpCode::OP_GET_FIELD:
+            {
+                const record_shape_t *shape = this->read_value<const record_shape_t*>(prog_ip);
+                field_index_t field = this->read_value<field_index_t>(prog_ip);
+
+                Value &target = this->stack.back();
+                Object *obj = safe_get_value_object(target);
+                // The compiler guessed the struct right, so the slot is already known
+                if (obj != nullptr && obj->type == ObjectType::RECORD && obj->memory.record->shape == shape) {
+                    target = obj->memory.record->fields()[field];
+                    break;
                 }
-                else {
-                    this->push_stack_value(property->second);
+
+                Value property;
+                if (!this->get_property(target, shape->fields[field], property)) break;
+                target = property;
+            }
+                break;
+            case OpCode::OP_SET_FIELD:
+            {
+                const record_shape_t *shape = this->read_value<const record_shape_t*>(prog_ip);
+                field_index_t field = this->read_value<field_index_t>(prog_ip);
+
+                Value value = this->stack_pop();
+                Value target = this->stack_pop();
+                Object *obj = safe_get_value_object(target);
+                if (obj != nullptr && obj->type == ObjectType::RECORD && obj->memory.record->shape == shape) {
+                    obj->memory.record->fields()[field] = value;
                 }
+                else if (!this->set_property(target, shape->fields[field], value)) break;
+
+                this->push_stack_value(value);
             }
                 break;
             
@@ -511,13 +1019,7 @@ int Runtime::run() {
                 return 0;
             default: std::cerr << "unhandled " << instruction_to_string(code) << std::endl; break;
         }
-        if (this->error.size() > 0) {
-            std::cerr << rang::fg::red << "runtime error: " << rang::style::reset << this->error << std::endl;
-            
-            this->log_stack_trace(std::cerr);
-            
-            return -1;
-        }
+        if (this->error.size() > 0) return -1;
     }
 
     throw std::runtime_error("Reached end of runtime loop, but the exit command completely returns. Logic error");
@@ -6,6 +6,8 @@
 #include "../value.hpp"
 
 #include <array>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 
 struct RuntimeFunction {
@@ -15,6 +17,8 @@ struct RuntimeFunction {
     Bytecode::variable_index_t total_variables;
     // Debug info
     const std::string name;
+    // Calls whose arguments are all numbers, booleans or null are cached by their arguments
+    bool memoized = false;
 
     RuntimeFunction(
         Bytecode::Chunk chunk,
@@ -26,6 +30,8 @@ struct RuntimeCallFrame {
     Bytecode::constant_index_t func_index;
     std::vector<Values::Value>::iterator variables_start;
     uint ip = 0;
+    // The result goes in the function's cache when it returns
+    bool memoize = false;
 
     inline Values::Value get_variable(Bytecode::variable_index_t index) const { 
         return *(this->variables_start + index).base();
@@ -42,6 +48,22 @@ struct RuntimeCallFrame {
         std::vector<Values::Value>::iterator variables);
 };
 
+// Functions with more arguments than this aren't memoized
+const uint MAX_MEMO_ARGUMENTS = 4;
+/* The arguments of a call to a memoized function. Only numbers, booleans and null are
+    used, since they can't change and keep nothing alive. */
+struct memo_key_t {
+    uint count;
+    std::array<Values::ValueType, MAX_MEMO_ARGUMENTS> types;
+    std::array<Values::number_t, MAX_MEMO_ARGUMENTS> numbers;
+
+    bool operator==(const memo_key_t &key) const;
+};
+struct MemoKeyHasher {
+    size_t operator()(const memo_key_t &key) const;
+};
+typedef std::unordered_map<memo_key_t, Values::Value, MemoKeyHasher> memo_table_t;
+
 class Runtime {
 public:
     template <typename T, typename... Args>
@@ -71,6 +93,8 @@ private:
     Values::Value stack_pop();
 
     std::vector<Values::Value> constants = std::vector<Values::Value>();
+    /* Struct layouts. Bytecode and records point straight at them, so they are never moved. */
+    std::vector<std::unique_ptr<Values::record_shape_t>> shapes = std::vector<std::unique_ptr<Values::record_shape_t>>();
     std::vector<Values::Value> global_variables;
     size_t variable_stack_size;
 
@@ -89,6 +113,38 @@ private:
     Bytecode::address_t main_ip;
     std::string error = "";
 
+    /* Dot access when the slot isn't known. Records are searched by field name,
+        and constant namespaces give null for a missing property.
+        Returns false, with the error set, if the value has no such field. */
+    bool get_property(const Values::Value &object, const std::string &name, Values::Value &result);
+    bool set_property(const Values::Value &object, const std::string &name, const Values::Value &value);
+
+    /* Pops the arguments into a new call frame and starts running the function.
+        False, with the error set, if the call stack got too big. */
+    bool enter_function(Bytecode::constant_index_t func_ind);
+    /* Pops the current call frame. Its variables are left for the next frame to overwrite. */
+    void leave_function();
+
+    // Most results a memoized function keeps. A full cache starts over.
+    static const size_t MAX_MEMO_ENTRIES = 1 << 16;
+    /* The cached results of each memoized function, at the function's index */
+    std::vector<memo_table_t> memo_tables = std::vector<memo_table_t>();
+    /* The arguments of each memoized call that is running, the innermost last */
+    std::vector<memo_key_t> memo_keys = std::vector<memo_key_t>();
+    /* Like enter_function, but a memoized function with a cached result for the arguments
+        isn't entered. The arguments are replaced by the result instead. */
+    bool call_program_function(Bytecode::constant_index_t func_ind);
+    /* Calls the function on top of the stack, with the arguments under it, for OP_CALL.
+        Sets the error if it isn't a function, or doesn't take that many arguments. */
+    void call_value(Bytecode::call_arguments_t num_args);
+    /* Caches the result of the innermost memoized call */
+    void memoize_result(Bytecode::constant_index_t func_ind, const Values::Value &result);
+    // Return depth of the main program, which only stops at OP_EXIT
+    static const size_t NOT_NESTED = static_cast<size_t>(-1);
+    /* Runs instructions until a return brings the call stack back down to return_depth.
+        Returns -1 on a runtime error, with the error set. */
+    int execute(size_t return_depth);
+
     void log_call_frame(RuntimeCallFrame &frame, std::ostream &out);
     void log_stack_trace(std::ostream &out);
     void exit();
@@ -96,14 +152,26 @@ private:
     // GC
 public:
     void add_object(Values::Object *obj);
+    /* Copy-on-write for array slices and typed array views: gives them their own copy
+        of the elements before they're changed. A slice turns into an ARRAY in place.
+        Does nothing to arrays that already own their elements. */
+    void make_writable(Values::Object *obj);
+    /* Grow an ARRAY's storage to hold at least capacity elements in one allocation,
+        and count the growth towards the GC size */
+    void reserve_array(Values::Object *obj, size_t capacity);
+    /* Like create, but for records, whose fields are part of the same allocation */
+    Values::record_t *create_record(const Values::record_shape_t *shape);
 private:
     void mark_object(Values::Value value);
+    /* Drops cached results that are objects, so the caches never keep anything alive */
+    void evict_memoized_objects();
     void mark_values();
     void delete_values();
     void run_gc();
     // Queue a GC run when the stack is emptied
     bool gc_queue = false;
-    int gc_size = 0;
+    // Memory held by runtime objects. Counted as it is allocated, and recounted from what the GC keeps.
+    size_t gc_size = 0;
 public:
     Runtime(Bytecode::Chunk &main);
 
@@ -113,9 +181,21 @@ public:
     Bytecode::variable_index_t new_constant(Values::Value value);
     // Add a function to the function list
     void add_function(RuntimeFunction &chunk);
+    // Keep a copy of a struct's layout for as long as the runtime exists
+    const Values::record_shape_t *add_shape(const Values::record_shape_t &shape);
 
     inline Bytecode::Chunk * get_main() { return &this->main; };
     inline Values::Value     get_constant(Bytecode::constant_index_t index) const { return this->constants.at(index); };
+    inline Values::Value     get_native(uint index) const { return this->natives.at(index); };
+
+    /* Lets natives call back into the program. Program functions run to completion
+        before this returns. False, with the error set, if the call failed.
+        The stack may grow while the function runs, so args must not point into it:
+        natives have to copy their own arguments out first. */
+    bool call_function(const Values::Value &func, const Values::Value *args, uint arg_count, Values::Value &result);
+    /* Keep a value alive across calls back into the program. Pops have to match pushes. */
+    inline void push_root(Values::Value value) { this->stack.push_back(value); }
+    inline void pop_root() { this->stack.pop_back(); }
 
     void log_instructions();
     int run();
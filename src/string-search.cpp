@@ -0,0 +1,169 @@
+#include "cpu-features.hpp"
+#include "string-search.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+#ifdef SGCPP_X86_SIMD
+#include <immintrin.h>
+#endif
+
+/* Every kernel takes the haystack, the number of positions the needle could start at
+    (haystack length - needle length + 1), and a needle that is at least 1 byte long. */
+typedef size_t (*search_kernel_t)(const char *haystack, size_t candidates, const char *needle, size_t needle_length);
+
+/* The first and last bytes already matched, so compare what's between them */
+static inline bool verify_candidate(const char *candidate, const char *needle, size_t needle_length) {
+    return needle_length <= 2 || memcmp(candidate + 1, needle + 1, needle_length - 2) == 0;
+}
+
+static size_t find_scalar(const char *haystack, size_t candidates, const char *needle, size_t needle_length) {
+    for (size_t index = 0; index < candidates; index += 1) {
+        if (haystack[index] == needle[0] && memcmp(haystack + index, needle, needle_length) == 0) return index;
+    }
+    return StringSearch::npos;
+}
+static size_t rfind_scalar(const char *haystack, size_t candidates, const char *needle, size_t needle_length) {
+    for (size_t index = candidates; index-- > 0;) {
+        if (haystack[index] == needle[0] && memcmp(haystack + index, needle, needle_length) == 0) return index;
+    }
+    return StringSearch::npos;
+}
+
+#ifdef SGCPP_X86_SIMD
+__attribute__((target("sse2")))
+static inline uint32_t candidate_mask_sse2(const char *block, __m128i first, __m128i last, size_t needle_length) {
+    __m128i block_first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+    __m128i block_last = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + needle_length - 1));
+    __m128i matches = _mm_and_si128(_mm_cmpeq_epi8(first, block_first), _mm_cmpeq_epi8(last, block_last));
+    return static_cast<uint32_t>(_mm_movemask_epi8(matches));
+}
+__attribute__((target("sse2")))
+static size_t find_sse2(const char *haystack, size_t candidates, const char *needle, size_t needle_length) {
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[needle_length - 1]);
+
+    size_t index = 0;
+    for (; index + 16 <= candidates; index += 16) {
+        uint32_t mask = candidate_mask_sse2(haystack + index, first, last, needle_length);
+        while (mask != 0) {
+            size_t position = index + __builtin_ctz(mask);
+            if (verify_candidate(haystack + position, needle, needle_length)) return position;
+            mask &= mask - 1;
+        }
+    }
+
+    size_t rest = find_scalar(haystack + index, candidates - index, needle, needle_length);
+    return rest == StringSearch::npos ? rest : index + rest;
+}
+__attribute__((target("sse2")))
+static size_t rfind_sse2(const char *haystack, size_t candidates, const char *needle, size_t needle_length) {
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[needle_length - 1]);
+
+    // Walk blocks backwards from the end, taking the highest match in each block
+    size_t end = candidates;
+    for (; end >= 16; end -= 16) {
+        size_t index = end - 16;
+        uint32_t mask = candidate_mask_sse2(haystack + index, first, last, needle_length);
+        while (mask != 0) {
+            uint32_t bit = 31 - __builtin_clz(mask);
+            if (verify_candidate(haystack + index + bit, needle, needle_length)) return index + bit;
+            mask &= ~(static_cast<uint32_t>(1) << bit);
+        }
+    }
+
+    return rfind_scalar(haystack, end, needle, needle_length);
+}
+
+__attribute__((target("avx2")))
+static inline uint32_t candidate_mask_avx2(const char *block, __m256i first, __m256i last, size_t needle_length) {
+    __m256i block_first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+    __m256i block_last = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + needle_length - 1));
+    __m256i matches = _mm256_and_si256(_mm256_cmpeq_epi8(first, block_first), _mm256_cmpeq_epi8(last, block_last));
+    return static_cast<uint32_t>(_mm256_movemask_epi8(matches));
+}
+__attribute__((target("avx2")))
+static size_t find_avx2(const char *haystack, size_t candidates, const char *needle, size_t needle_length) {
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[needle_length - 1]);
+
+    size_t index = 0;
+    for (; index + 32 <= candidates; index += 32) {
+        uint32_t mask = candidate_mask_avx2(haystack + index, first, last, needle_length);
+        while (mask != 0) {
+            size_t position = index + __builtin_ctz(mask);
+            if (verify_candidate(haystack + position, needle, needle_length)) return position;
+            mask &= mask - 1;
+        }
+    }
+
+    // Finish off with the narrower kernel so short tails stay vectorized
+    size_t rest = find_sse2(haystack + index, candidates - index, needle, needle_length);
+    return rest == StringSearch::npos ? rest : index + rest;
+}
+__attribute__((target("avx2")))
+static size_t rfind_avx2(const char *haystack, size_t candidates, const char *needle, size_t needle_length) {
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[needle_length - 1]);
+
+    size_t end = candidates;
+    for (; end >= 32; end -= 32) {
+        size_t index = end - 32;
+        uint32_t mask = candidate_mask_avx2(haystack + index, first, last, needle_length);
+        while (mask != 0) {
+            uint32_t bit = 31 - __builtin_clz(mask);
+            if (verify_candidate(haystack + index + bit, needle, needle_length)) return index + bit;
+            mask &= ~(static_cast<uint32_t>(1) << bit);
+        }
+    }
+
+    return rfind_sse2(haystack, end, needle, needle_length);
+}
+#endif
+
+static search_kernel_t select_find_kernel() {
+    #ifdef SGCPP_X86_SIMD
+    if (CPU::has_avx2()) return find_avx2;
+    if (CPU::has_sse2()) return find_sse2;
+    #endif
+    return find_scalar;
+}
+static search_kernel_t select_rfind_kernel() {
+    #ifdef SGCPP_X86_SIMD
+    if (CPU::has_avx2()) return rfind_avx2;
+    if (CPU::has_sse2()) return rfind_sse2;
+    #endif
+    return rfind_scalar;
+}
+static const search_kernel_t find_kernel = select_find_kernel();
+static const search_kernel_t rfind_kernel = select_rfind_kernel();
+
+size_t StringSearch::find(std::string_view haystack, std::string_view needle, size_t start) {
+    if (start > haystack.size()) return npos;
+    if (needle.size() == 0) return start;
+    if (needle.size() > haystack.size() - start) return npos;
+
+    size_t candidates = haystack.size() - start - needle.size() + 1;
+    size_t found = find_kernel(haystack.data() + start, candidates, needle.data(), needle.size());
+    return found == npos ? npos : start + found;
+}
+size_t StringSearch::rfind(std::string_view haystack, std::string_view needle) {
+    if (needle.size() == 0) return haystack.size();
+    if (needle.size() > haystack.size()) return npos;
+
+    size_t candidates = haystack.size() - needle.size() + 1;
+    return rfind_kernel(haystack.data(), candidates, needle.data(), needle.size());
+}
+size_t StringSearch::count(std::string_view haystack, std::string_view needle) {
+    // The empty string appears at every byte position, including the end
+    if (needle.size() == 0) return haystack.size() + 1;
+
+    size_t occurrences = 0;
+    size_t position = find(haystack, needle, 0);
+    while (position != npos) {
+        occurrences += 1;
+        position = find(haystack, needle, position + needle.size());
+    }
+    return occurrences;
+}
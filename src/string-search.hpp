@@ -0,0 +1,23 @@
+/* Substring search used by the String natives.
+    On x86, candidate positions are found by comparing the first and last byte
+    of the needle against 16 (SSE2) or 32 (AVX2) haystack positions at once,
+    and only those candidates are verified with memcmp. */
+
+#ifndef _SGCPP_STRING_SEARCH_HPP
+#define _SGCPP_STRING_SEARCH_HPP
+
+#include <string_view>
+
+namespace StringSearch {
+    const size_t npos = std::string_view::npos;
+
+    /* Index of the first occurrence of needle at or after start, or npos */
+    size_t find(std::string_view haystack, std::string_view needle, size_t start = 0);
+    /* Index of the last occurrence of needle, or npos */
+    size_t rfind(std::string_view haystack, std::string_view needle);
+    /* Number of non-overlapping occurrences of needle. The empty needle is
+        counted at every byte position, so callers counting characters handle it themselves. */
+    size_t count(std::string_view haystack, std::string_view needle);
+};
+
+#endif
@@ -0,0 +1,313 @@
+#include "cpu-features.hpp"
+#include "utf8.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+#ifdef SGCPP_X86_SIMD
+#include <immintrin.h>
+#endif
+
+using Utf8::analysis_t;
+
+/* Decode the multibyte sequence at the index. Returns the number of bytes in it,
+    or 0 if it isn't valid UTF-8 (overlong, surrogate, too large or truncated). */
+static size_t validate_sequence(const unsigned char *str, size_t index, size_t size) {
+    unsigned char lead = str[index];
+    size_t length;
+    unsigned char min_second = 0x80, max_second = 0xBF;
+
+    if (lead >= 0xC2 && lead <= 0xDF) length = 2;
+    else if (lead >= 0xE0 && lead <= 0xEF) {
+        length = 3;
+        if (lead == 0xE0) min_second = 0xA0;
+        // Surrogates
+        if (lead == 0xED) max_second = 0x9F;
+    }
+    else if (lead >= 0xF0 && lead <= 0xF4) {
+        length = 4;
+        if (lead == 0xF0) min_second = 0x90;
+        // Past U+10FFFF
+        if (lead == 0xF4) max_second = 0x8F;
+    }
+    else return 0;
+
+    if (index + length > size) return 0;
+    if (str[index + 1] < min_second || str[index + 1] > max_second) return 0;
+    for (size_t byte = 2; byte < length; byte += 1) {
+        if ((str[index + byte] & 0xC0) != 0x80) return 0;
+    }
+    return length;
+}
+
+static analysis_t analyze_scalar(const unsigned char *str, size_t size) {
+    analysis_t analysis = analysis_t{ .code_points = 0, .ascii = true, .valid = true };
+
+    size_t index = 0;
+    while (index < size) {
+        if (str[index] < 0x80) {
+            analysis.code_points += 1;
+            index += 1;
+            continue;
+        }
+
+        analysis.ascii = false;
+        size_t length = validate_sequence(str, index, size);
+        if (length == 0) {
+            // Invalid. Just count the rest of the starting bytes.
+            analysis.valid = false;
+            for (; index < size; index += 1) analysis.code_points += (str[index] & 0xC0) != 0x80;
+            break;
+        }
+        analysis.code_points += 1;
+        index += length;
+    }
+
+    return analysis;
+}
+
+#ifdef SGCPP_X86_SIMD
+/* Same as the scalar validator, but skips over 16 ASCII bytes at a time */
+__attribute__((target("sse2")))
+static analysis_t analyze_sse2(const unsigned char *str, size_t size) {
+    analysis_t analysis = analysis_t{ .code_points = 0, .ascii = true, .valid = true };
+
+    size_t index = 0;
+    while (index < size) {
+        if (index + 16 <= size) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + index));
+            if (_mm_movemask_epi8(block) == 0) {
+                analysis.code_points += 16;
+                index += 16;
+                continue;
+            }
+        }
+
+        if (str[index] < 0x80) {
+            analysis.code_points += 1;
+            index += 1;
+            continue;
+        }
+
+        analysis.ascii = false;
+        size_t length = validate_sequence(str, index, size);
+        if (length == 0) {
+            analysis.valid = false;
+            for (; index < size; index += 1) analysis.code_points += (str[index] & 0xC0) != 0x80;
+            break;
+        }
+        analysis.code_points += 1;
+        index += length;
+    }
+
+    return analysis;
+}
+
+/* Error bits for the lookup tables. Each table classifies one nibble of the two bytes
+    in every byte pair. An error is only real if all three tables agree on a bit.
+    They are chars so the tables can be passed straight to _mm256_setr_epi8. */
+static const char TOO_SHORT = 1 << 0;      // 11______ 0_______  or  11______ 11______
+static const char TOO_LONG = 1 << 1;       // 0_______ 10______
+static const char OVERLONG_3 = 1 << 2;     // 11100000 100_____
+static const char TOO_LARGE = 1 << 3;      // 11110100 1001____ and higher
+static const char SURROGATE = 1 << 4;      // 11101101 101_____
+static const char OVERLONG_2 = 1 << 5;     // 1100000_ 10______
+static const char TOO_LARGE_1000 = 1 << 6; // 11110101 1000____ and higher
+static const char OVERLONG_4 = 1 << 6;     // 11110000 1000____
+static const char TWO_CONTS = static_cast<char>(1 << 7); // 10______ 10______
+static const char CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+#define SG_LOOKUP_TABLE(...) _mm256_setr_epi8(__VA_ARGS__, __VA_ARGS__)
+
+/* The previous N bytes of input, carrying over from the last block */
+template<int N>
+__attribute__((target("avx2")))
+static inline __m256i previous_bytes(__m256i input, __m256i previous_input) {
+    return _mm256_alignr_epi8(input, _mm256_permute2x128_si256(previous_input, input, 0x21), 16 - N);
+}
+__attribute__((target("avx2")))
+static inline __m256i high_nibbles(__m256i input) {
+    return _mm256_and_si256(_mm256_srli_epi16(input, 4), _mm256_set1_epi8(0x0F));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i check_block(__m256i input, __m256i previous_input) {
+    __m256i prev1 = previous_bytes<1>(input, previous_input);
+
+    const __m256i byte_1_high_table = SG_LOOKUP_TABLE(
+        // 0_______ ________ <ASCII in byte 1>
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+        // 10______ ________ <continuation in byte 1>
+        TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+        // 1100____ ________ <two byte lead in byte 1>
+        TOO_SHORT | OVERLONG_2,
+        // 1101____ ________ <two byte lead in byte 1>
+        TOO_SHORT,
+        // 1110____ ________ <three byte lead in byte 1>
+        TOO_SHORT | OVERLONG_3 | SURROGATE,
+        // 1111____ ________ <four+ byte lead in byte 1>
+        TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4
+    );
+    const __m256i byte_1_low_table = SG_LOOKUP_TABLE(
+        // ____0000 ________
+        CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+        // ____0001 ________
+        CARRY | OVERLONG_2,
+        // ____001_ ________
+        CARRY,
+        CARRY,
+        // ____0100 ________
+        CARRY | TOO_LARGE,
+        // ____0101 ________
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        // ____011_ ________
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        // ____1___ ________
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        // ____1101 ________
+        CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000
+    );
+    const __m256i byte_2_high_table = SG_LOOKUP_TABLE(
+        // ________ 0_______ <ASCII in byte 2>
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        // ________ 1000____
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+        // ________ 1001____
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+        // ________ 101_____
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+        // ________ 11______
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT
+    );
+
+    __m256i byte_1_high = _mm256_shuffle_epi8(byte_1_high_table, high_nibbles(prev1));
+    __m256i byte_1_low = _mm256_shuffle_epi8(byte_1_low_table, _mm256_and_si256(prev1, _mm256_set1_epi8(0x0F)));
+    __m256i byte_2_high = _mm256_shuffle_epi8(byte_2_high_table, high_nibbles(input));
+    __m256i special_cases = _mm256_and_si256(_mm256_and_si256(byte_1_high, byte_1_low), byte_2_high);
+
+    // Third and fourth bytes of 3 and 4 byte sequences must be continuations,
+    // which the special cases marked as TWO_CONTS. Flip those bits.
+    __m256i prev2 = previous_bytes<2>(input, previous_input);
+    __m256i prev3 = previous_bytes<3>(input, previous_input);
+    __m256i is_third_byte = _mm256_subs_epu8(prev2, _mm256_set1_epi8(static_cast<char>(0xE0 - 0x80)));
+    __m256i is_fourth_byte = _mm256_subs_epu8(prev3, _mm256_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+    __m256i must_be_continuation = _mm256_and_si256(
+        _mm256_or_si256(is_third_byte, is_fourth_byte), _mm256_set1_epi8(static_cast<char>(0x80)));
+
+    return _mm256_xor_si256(must_be_continuation, special_cases);
+}
+/* Nonzero if the block ends in the middle of a multibyte sequence */
+__attribute__((target("avx2")))
+static inline __m256i block_is_incomplete(__m256i input) {
+    const __m256i max_value = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        static_cast<char>(0xF0 - 1), static_cast<char>(0xE0 - 1), static_cast<char>(0xC0 - 1));
+    return _mm256_subs_epu8(input, max_value);
+}
+/* Count the bytes that start a code point, i.e., that are not 10______ */
+__attribute__((target("avx2")))
+static inline size_t count_block_starts(__m256i input) {
+    __m256i starts = _mm256_cmpgt_epi8(input, _mm256_set1_epi8(-65));
+    return __builtin_popcount(static_cast<uint32_t>(_mm256_movemask_epi8(starts)));
+}
+
+__attribute__((target("avx2")))
+static analysis_t analyze_avx2(const unsigned char *str, size_t size) {
+    __m256i error = _mm256_setzero_si256();
+    __m256i previous_input = _mm256_setzero_si256();
+    __m256i previous_incomplete = _mm256_setzero_si256();
+    __m256i high_bits = _mm256_setzero_si256();
+    size_t code_points = 0;
+
+    size_t index = 0;
+    // Pad the last partial block with zeros, which are ASCII and can't complete a sequence
+    alignas(32) unsigned char padded[32];
+    while (index < size) {
+        __m256i input;
+        if (index + 32 <= size) {
+            input = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(str + index));
+            code_points += count_block_starts(input);
+        }
+        else {
+            size_t remaining = size - index;
+            memset(padded, 0, 32);
+            memcpy(padded, str + index, remaining);
+            input = _mm256_load_si256(reinterpret_cast<const __m256i*>(padded));
+            code_points += count_block_starts(input) - (32 - remaining);
+        }
+
+        if (_mm256_movemask_epi8(input) == 0) {
+            error = _mm256_or_si256(error, previous_incomplete);
+            previous_incomplete = _mm256_setzero_si256();
+        }
+        else {
+            high_bits = _mm256_or_si256(high_bits, input);
+            error = _mm256_or_si256(error, check_block(input, previous_input));
+            previous_incomplete = block_is_incomplete(input);
+        }
+
+        previous_input = input;
+        index += 32;
+    }
+    error = _mm256_or_si256(error, previous_incomplete);
+
+    return analysis_t{
+        .code_points = code_points,
+        .ascii = _mm256_movemask_epi8(high_bits) == 0,
+        .valid = _mm256_testz_si256(error, error) != 0
+    };
+}
+
+#undef SG_LOOKUP_TABLE
+#endif
+
+typedef analysis_t (*analyze_kernel_t)(const unsigned char *str, size_t size);
+static analyze_kernel_t select_analyze_kernel() {
+    #ifdef SGCPP_X86_SIMD
+    if (CPU::has_avx2()) return analyze_avx2;
+    if (CPU::has_sse2()) return analyze_sse2;
+    #endif
+    return analyze_scalar;
+}
+static const analyze_kernel_t analyze_kernel = select_analyze_kernel();
+
+analysis_t Utf8::analyze(std::string_view str) {
+    return analyze_kernel(reinterpret_cast<const unsigned char*>(str.data()), str.size());
+}
+
+#ifdef SGCPP_X86_SIMD
+__attribute__((target("avx2")))
+static size_t count_code_points_avx2(const char *str, size_t size) {
+    size_t count = 0;
+    size_t index = 0;
+    for (; index + 32 <= size; index += 32) {
+        count += count_block_starts(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(str + index)));
+    }
+    for (; index < size; index += 1) count += !Utf8::is_continuation_byte(str[index]);
+    return count;
+}
+#endif
+static size_t count_code_points_scalar(const char *str, size_t size) {
+    size_t count = 0;
+    for (size_t index = 0; index < size; index += 1) count += !Utf8::is_continuation_byte(str[index]);
+    return count;
+}
+
+size_t Utf8::count_code_points(std::string_view str) {
+    #ifdef SGCPP_X86_SIMD
+    // Not worth the dispatch for the handful of bytes the index usually asks for
+    if (str.size() >= 64 && CPU::has_avx2()) return count_code_points_avx2(str.data(), str.size());
+    #endif
+    return count_code_points_scalar(str.data(), str.size());
+}
@@ -0,0 +1,37 @@
+/* UTF-8 validation and code point counting for string objects.
+    On CPUs with AVX2, the validator checks 32 bytes at a time with the
+    lookup-table algorithm from Keiser & Lemire, "Validating UTF-8 In Less Than One
+    Instruction Per Byte". Otherwise, ASCII runs are skipped 16 bytes at a time
+    and only multibyte sequences are decoded one by one. */
+
+#ifndef _SGCPP_UTF8_HPP
+#define _SGCPP_UTF8_HPP
+
+#include <string_view>
+
+namespace Utf8 {
+    struct analysis_t {
+        // Number of bytes that start a code point. For valid UTF-8, the number of code points.
+        size_t code_points;
+        bool ascii;
+        bool valid;
+    };
+
+    analysis_t analyze(std::string_view str);
+    /* Number of bytes that are not continuation bytes */
+    size_t count_code_points(std::string_view str);
+
+    inline bool is_continuation_byte(char c) {
+        return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+    }
+    /* Length of the sequence that starts with this lead byte. Only meaningful for valid UTF-8. */
+    inline size_t sequence_length(char lead) {
+        unsigned char byte = static_cast<unsigned char>(lead);
+        if (byte < 0x80) return 1;
+        if (byte < 0xE0) return 2;
+        if (byte < 0xF0) return 3;
+        return 4;
+    }
+};
+
+#endif
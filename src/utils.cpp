@@ -1,4 +1,5 @@
 #include "time-utils.hpp"
+#include "utf8.hpp"
 #include "utils.hpp"
 
 #ifdef DEBUG
@@ -47,7 +48,7 @@ std::string var_ind_to_subscript(int num) {
     return output;
 };
 
-void truncate_string(std::string &output, uint max_len, std::string &value) {
+void truncate_string(std::string &output, uint max_len, const std::string &value) {
     #ifdef DEBUG_ASSERT
     assert(max_len >= 3);
     #endif
@@ -59,13 +60,9 @@ void truncate_string(std::string &output, uint max_len, std::string &value) {
     }
 };
 
-/* Count code points in a UTF-8 string.
-    Proudly stolen from Marcelo Cantos on https://stackoverflow.com/questions/4063146/getting-the-actual-length-of-a-utf-8-encoded-stdstring. */
-uint get_string_length_as_utf32(std::string str) {
-    const char *s = str.c_str();
-    int len = 0;
-    while (*s) len += (*s++ & 0xc0) != 0x80;
-    return len;
+/* Count code points in a UTF-8 string */
+uint get_string_length_as_utf32(const std::string &str) {
+    return Utf8::count_code_points(str);
 }
 
 Random::RNG Random::rng;
@@ -10,10 +10,10 @@
 uint get_digits(uint number);
 
 std::string var_ind_to_subscript(int num);
-uint get_string_length_as_utf32(std::string str);
+uint get_string_length_as_utf32(const std::string &str);
 
 /* Truncate a string to the maximum length, then add ... if necessary */
-void truncate_string(std::string &output, uint max_len, std::string &value);
+void truncate_string(std::string &output, uint max_len, const std::string &value);
 
 namespace Random {
     typedef std::mt19937 RNG;
@@ -0,0 +1,209 @@
+#include "value-table.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <string_view>
+
+/* Group matching runs on every probe, so it can't go through a function pointer picked at startup
+    the way the other kernels do. SSE2 is part of x86-64, so the compiler flag is enough. */
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace Values;
+
+// Control bytes. Full slots are 0-127, so "is this slot free" is just the sign bit.
+static const int8_t EMPTY = -128;
+static const int8_t DELETED = -2;
+
+static const size_t NOT_FOUND = static_cast<size_t>(-1);
+
+/* Bit i is set if control byte i of the group equals the byte */
+static inline uint32_t match_byte(const int8_t *group, int8_t byte) {
+    #ifdef __SSE2__
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(byte))));
+    #else
+    uint32_t mask = 0;
+    for (size_t index = 0; index < value_table_t::GROUP_SIZE; index += 1) {
+        if (group[index] == byte) mask |= static_cast<uint32_t>(1) << index;
+    }
+    return mask;
+    #endif
+}
+/* Bit i is set if slot i of the group is empty or deleted */
+static inline uint32_t match_free(const int8_t *group) {
+    #ifdef __SSE2__
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+    return static_cast<uint32_t>(_mm_movemask_epi8(bytes));
+    #else
+    uint32_t mask = 0;
+    for (size_t index = 0; index < value_table_t::GROUP_SIZE; index += 1) {
+        if (group[index] < 0) mask |= static_cast<uint32_t>(1) << index;
+    }
+    return mask;
+    #endif
+}
+
+/* The high bits pick the group to start probing at, the low 7 bits go in the control byte */
+static inline size_t hash_group(uint64_t hash, size_t group_mask) {
+    return static_cast<size_t>(hash >> 7) & group_mask;
+}
+static inline int8_t hash_tag(uint64_t hash) {
+    return static_cast<int8_t>(hash & 0x7F);
+}
+
+/* The finalizer from splitmix64, so that every input bit affects the tag and the group */
+static inline uint64_t mix_bits(uint64_t bits) {
+    bits ^= bits >> 30;
+    bits *= 0xBF58476D1CE4E5B9ULL;
+    bits ^= bits >> 27;
+    bits *= 0x94D049BB133111EBULL;
+    return bits ^ (bits >> 31);
+}
+
+uint64_t Values::hash_value(const Value &value) {
+    uint64_t bits = 0;
+    switch (get_value_type(value)) {
+        case ValueType::NUMBER: {
+            number_t number = get_value_number(value);
+            // -0 == 0, and every NaN has to land in the same place
+            if (number == 0) number = 0;
+            if (std::isnan(number)) number = std::numeric_limits<number_t>::quiet_NaN();
+            memcpy(&bits, &number, sizeof(bits));
+            break;
+        }
+        case ValueType::OBJ: {
+            Object *obj = get_value_object(value);
+            // Strings and slices are equal by their characters, everything else by identity
+            if (object_is_string(obj)) bits = std::hash<std::string_view>{}(object_to_string_view(obj));
+            else bits = reinterpret_cast<uintptr_t>(obj);
+            break;
+        }
+        case ValueType::NATIVE_FUNCTION:
+            bits = reinterpret_cast<uintptr_t>(get_value_native_function(value).func);
+            break;
+        case ValueType::PROGRAM_FUNCTION:
+            bits = get_value_program_function(value);
+            break;
+        default: break;
+    }
+    return mix_bits(bits ^ (static_cast<uint64_t>(get_value_type(value)) << 56));
+}
+bool Values::table_keys_are_equal(const Value &a, const Value &b) {
+    if (get_value_type(a) != get_value_type(b)) return false;
+    switch (get_value_type(a)) {
+        case ValueType::NUMBER: {
+            number_t number_a = get_value_number(a), number_b = get_value_number(b);
+            return number_a == number_b || (std::isnan(number_a) && std::isnan(number_b));
+        }
+        case ValueType::PROGRAM_FUNCTION:
+            return get_value_program_function(a) == get_value_program_function(b);
+        default: return values_are_equal(a, b);
+    }
+}
+
+value_table_t::value_table_t() {
+    this->rehash(GROUP_SIZE);
+}
+
+size_t value_table_t::find_index(const Value &key, uint64_t hash) const {
+    size_t group_mask = this->slots.size() / GROUP_SIZE - 1;
+    size_t group = hash_group(hash, group_mask);
+    int8_t tag = hash_tag(hash);
+
+    // Triangular probing visits every group when the group count is a power of 2
+    for (size_t step = 1; ; step += 1) {
+        const int8_t *control = this->control.data() + group * GROUP_SIZE;
+
+        uint32_t matches = match_byte(control, tag);
+        while (matches != 0) {
+            size_t index = group * GROUP_SIZE + __builtin_ctz(matches);
+            if (table_keys_are_equal(this->slots[index].key, key)) return index;
+            matches &= matches - 1;
+        }
+        // The key would have been put in this group if it had a free slot, so it isn't anywhere
+        if (match_byte(control, EMPTY) != 0) return NOT_FOUND;
+
+        group = (group + step) & group_mask;
+    }
+}
+void value_table_t::insert_new(const Value &key, const Value &value, uint64_t hash) {
+    size_t group_mask = this->slots.size() / GROUP_SIZE - 1;
+    size_t group = hash_group(hash, group_mask);
+
+    for (size_t step = 1; ; step += 1) {
+        uint32_t free_slots = match_free(this->control.data() + group * GROUP_SIZE);
+        if (free_slots != 0) {
+            size_t index = group * GROUP_SIZE + __builtin_ctz(free_slots);
+            if (this->control[index] == EMPTY) this->growth_left -= 1;
+
+            this->control[index] = hash_tag(hash);
+            this->slots[index] = entry_t{ key, value };
+            this->count += 1;
+            return;
+        }
+
+        group = (group + step) & group_mask;
+    }
+}
+void value_table_t::rehash(size_t new_capacity) {
+    std::vector<int8_t> old_control = std::move(this->control);
+    std::vector<entry_t> old_slots = std::move(this->slots);
+
+    this->control = std::vector<int8_t>(new_capacity, EMPTY);
+    this->slots = std::vector<entry_t>(new_capacity);
+    this->count = 0;
+    // Keep at least 1/8 of the slots empty, so that lookups of missing keys stop quickly
+    this->growth_left = new_capacity - new_capacity / 8;
+
+    for (size_t index = 0; index < old_control.size(); index += 1) {
+        if (old_control[index] >= 0) {
+            const entry_t &entry = old_slots[index];
+            this->insert_new(entry.key, entry.value, hash_value(entry.key));
+        }
+    }
+}
+
+Value *value_table_t::find(const Value &key) {
+    size_t index = this->find_index(key, hash_value(key));
+    if (index == NOT_FOUND) return nullptr;
+    return &this->slots[index].value;
+}
+void value_table_t::insert(const Value &key, const Value &value) {
+    uint64_t hash = hash_value(key);
+    size_t index = this->find_index(key, hash);
+    if (index != NOT_FOUND) {
+        this->slots[index].value = value;
+        return;
+    }
+
+    if (this->growth_left == 0) {
+        /* Grow if at least half of the usable slots hold keys. Otherwise, most of them are
+            tombstones, and rebuilding at the same size clears those out. */
+        size_t capacity = this->capacity();
+        bool mostly_full = this->count >= (capacity - capacity / 8) / 2;
+        this->rehash(mostly_full ? capacity * 2 : capacity);
+    }
+    this->insert_new(key, value, hash);
+}
+bool value_table_t::erase(const Value &key) {
+    size_t index = this->find_index(key, hash_value(key));
+    if (index == NOT_FOUND) return false;
+
+    /* If the group still has an empty slot, no probe has ever gone past it,
+        so the slot can be emptied instead of leaving a tombstone */
+    const int8_t *group = this->control.data() + index / GROUP_SIZE * GROUP_SIZE;
+    if (match_byte(group, EMPTY) != 0) {
+        this->control[index] = EMPTY;
+        this->growth_left += 1;
+    }
+    else this->control[index] = DELETED;
+
+    // Don't keep the old key and value alive
+    this->slots[index] = entry_t{};
+    this->count -= 1;
+    return true;
+}
@@ -0,0 +1,65 @@
+/* Hash table keyed by Values, used by the Map and Set objects.
+    The layout follows Swiss tables: a byte of control data per slot holds 7 bits of the
+    key's hash, and slots are probed 16 at a time by comparing a whole group of control
+    bytes at once (SSE2 on x86). Only keys whose hash bits match are compared for real. */
+
+#ifndef _SGCPP_VALUE_TABLE_HPP
+#define _SGCPP_VALUE_TABLE_HPP
+
+#include "value.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace Values {
+    /* Keys are equal if values_are_equal says so, except that NaN is equal to NaN,
+        so that it can be found again. Sets store null for every value. */
+    class value_table_t {
+        public:
+            struct entry_t {
+                Value key;
+                Value value;
+            };
+            // Number of slots in a group. Also the smallest capacity.
+            static const size_t GROUP_SIZE = 16;
+
+        private:
+            /* One byte per slot: EMPTY, DELETED, or the low 7 bits of the key's hash if the slot is full */
+            std::vector<int8_t> control;
+            std::vector<entry_t> slots;
+            size_t count = 0;
+            // Number of empty slots that can still be filled before the table has to be rebuilt
+            size_t growth_left = 0;
+
+            size_t find_index(const Value &key, uint64_t hash) const;
+            void rehash(size_t new_capacity);
+            // Put a key that isn't in the table into the first free slot
+            void insert_new(const Value &key, const Value &value, uint64_t hash);
+
+        public:
+            value_table_t();
+
+            // nullptr if the key is not in the table
+            Value *find(const Value &key);
+            // Adds the key, or replaces its value if it is already there
+            void insert(const Value &key, const Value &value);
+            // False if the key was not in the table
+            bool erase(const Value &key);
+
+            inline size_t size() const { return this->count; }
+            inline size_t capacity() const { return this->slots.size(); }
+
+            /* Calls func with every entry, in no particular order */
+            template <typename Func>
+            void for_each(Func func) const {
+                for (size_t index = 0; index < this->control.size(); index += 1) {
+                    if (this->control[index] >= 0) func(this->slots[index]);
+                }
+            }
+    };
+
+    uint64_t hash_value(const Value &value);
+    bool table_keys_are_equal(const Value &a, const Value &b);
+};
+
+#endif
@@ -1,5 +1,9 @@
+#include "memory.hpp"
+#include "number-format.hpp"
 #include "runtime/runtime.hpp"
+#include "utf8.hpp"
 #include "utils.hpp"
+#include "value-table.hpp"
 #include "value.hpp"
 
 #include <bits/stdc++.h>
@@ -15,18 +19,148 @@ namespace Math {
 
 using namespace Values;
 
-Object::Object(std::string *str) :
+string_t::string_t(std::string &&chars) : chars(std::move(chars)) {
+    Utf8::analysis_t analysis = Utf8::analyze(this->chars);
+    this->ascii = analysis.ascii;
+    this->valid_utf8 = analysis.valid;
+    this->length = analysis.valid ? analysis.code_points : this->chars.size();
+}
+string_t::string_t(std::string_view chars) : string_t(std::string(chars)) {}
+string_t::string_t(std::string &&chars, size_t length, bool ascii) :
+    chars(std::move(chars)), length(length), ascii(ascii), valid_utf8(true) {}
+string_t::~string_t() {
+    delete this->code_point_index;
+}
+
+typed_array_t::typed_array_t(TypedArrayKind kind, size_t length) : kind(kind), length(length) {
+    // aligned_alloc needs the size to be a multiple of the alignment
+    size_t bytes = length * this->element_size();
+    bytes = (bytes + TYPED_ARRAY_ALIGNMENT - 1) / TYPED_ARRAY_ALIGNMENT * TYPED_ARRAY_ALIGNMENT;
+    if (bytes == 0) bytes = TYPED_ARRAY_ALIGNMENT;
+
+    this->data = std::aligned_alloc(TYPED_ARRAY_ALIGNMENT, bytes);
+    // So Runtime::create can collect garbage and try again
+    if (this->data == nullptr) throw std::bad_alloc();
+    memset(this->data, 0, bytes);
+}
+typed_array_t::typed_array_t(TypedArrayKind kind, void *data, size_t length, Object *owner) :
+    kind(kind), length(length), data(data), owner(owner) {}
+typed_array_t::~typed_array_t() {
+    // A view's data belongs to its owner
+    if (this->owner == nullptr) std::free(this->data);
+}
+void typed_array_t::detach() {
+    if (this->owner == nullptr) return;
+
+    size_t bytes = this->length * this->element_size();
+    size_t allocated = (bytes + TYPED_ARRAY_ALIGNMENT - 1) / TYPED_ARRAY_ALIGNMENT * TYPED_ARRAY_ALIGNMENT;
+    if (allocated == 0) allocated = TYPED_ARRAY_ALIGNMENT;
+
+    void *copied = std::aligned_alloc(TYPED_ARRAY_ALIGNMENT, allocated);
+    if (copied == nullptr) throw std::bad_alloc();
+    if (bytes > 0) memcpy(copied, this->data, bytes);
+
+    this->data = copied;
+    this->owner = nullptr;
+}
+/* JavaScript's ToInt32 and ToUint8: truncate, then wrap modulo 2^bits */
+static number_t wrap_integer(number_t number, number_t modulus, bool is_signed) {
+    if (!std::isfinite(number)) return 0;
+
+    number_t wrapped = fmod(trunc(number), modulus);
+    if (wrapped < 0) wrapped += modulus;
+    if (is_signed && wrapped >= modulus / 2) wrapped -= modulus;
+    return wrapped;
+}
+void typed_array_t::set(size_t index, number_t number) {
+    switch (this->kind) {
+        case TypedArrayKind::FLOAT64_ARRAY:
+            static_cast<double*>(this->data)[index] = number;
+            break;
+        case TypedArrayKind::INT32_ARRAY:
+            static_cast<int32_t*>(this->data)[index] = static_cast<int32_t>(wrap_integer(number, 4294967296.0, true));
+            break;
+        case TypedArrayKind::UINT8_ARRAY:
+            static_cast<uint8_t*>(this->data)[index] = static_cast<uint8_t>(wrap_integer(number, 256.0, false));
+            break;
+    }
+}
+const char *Values::typed_array_kind_to_string(TypedArrayKind kind) {
+    switch (kind) {
+        case TypedArrayKind::FLOAT64_ARRAY: return "Float64Array";
+        case TypedArrayKind::INT32_ARRAY: return "Int32Array";
+        case TypedArrayKind::UINT8_ARRAY: return "Uint8Array";
+    }
+    throw sg_assert_error("Unknown typed array kind");
+}
+
+int record_shape_t::field_index(std::string_view field) const {
+    for (size_t index = 0; index < this->fields.size(); index += 1) {
+        if (this->fields[index] == field) return static_cast<int>(index);
+    }
+    return -1;
+}
+// The fields are placed right after the record, so they have to stay aligned
+static_assert(sizeof(record_t) % alignof(Value) == 0);
+record_t *record_t::allocate(const record_shape_t *shape) {
+    size_t field_count = shape->fields.size();
+    record_t *record = static_cast<record_t*>(::operator new(sizeof(record_t) + field_count * sizeof(Value)));
+
+    record->shape = shape;
+    Value *fields = record->fields();
+    for (size_t index = 0; index < field_count; index += 1) new (fields + index) Value();
+    return record;
+}
+// Values don't own anything, so the fields don't need to be destroyed one by one
+void record_t::free(record_t *record) {
+    ::operator delete(record);
+}
+
+Object::Object(string_t *str) :
     type(ObjectType::STRING), memory(obj_mem_t{ .str = str }) {};
 Object::Object(std::vector<Value> *array) :
-    type(ObjectType::ARRAY), memory(obj_mem_t{ .array = array }) {};
+    type(ObjectType::ARRAY), memory(obj_mem_t{ .array = array }), element_kind(ArrayElementKind::NO_ELEMENTS)
+{
+    for (const Value &element : *array) {
+        this->element_kind = array_element_kind_with(this->element_kind, element);
+        if (this->element_kind == ArrayElementKind::MIXED_ELEMENTS) break;
+    }
+};
 Object::Object(namespace_t *namespace_) :
     type(ObjectType::NAMESPACE_CONSTANT), memory(obj_mem_t{ .namespace_ = namespace_ }) {}
+Object::Object(string_slice_t *slice) :
+    type(ObjectType::STRING_SLICE), memory(obj_mem_t{ .slice = slice }) {}
+Object::Object(std::string *builder) :
+    type(ObjectType::STRING_BUILDER), memory(obj_mem_t{ .builder = builder }) {}
+Object::Object(typed_array_t *typed_array) :
+    type(ObjectType::TYPED_ARRAY), memory(obj_mem_t{ .typed_array = typed_array }) {}
+Object::Object(value_table_t *table, ObjectType type) :
+    type(type), memory(obj_mem_t{ .table = table })
+{
+    #ifdef DEBUG_ASSERT
+    assert(type == ObjectType::MAP || type == ObjectType::SET);
+    #endif
+}
+Object::Object(record_t *record) :
+    type(ObjectType::RECORD), memory(obj_mem_t{ .record = record }) {}
+Object::Object(array_slice_t *slice) :
+    type(ObjectType::ARRAY_SLICE), memory(obj_mem_t{ .array_slice = slice }) {}
 
 Object::~Object() {
     switch (this->type) {
         case ObjectType::STRING: delete this->memory.str; break;
         case ObjectType::ARRAY: delete this->memory.array; break;
-        case ObjectType::NAMESPACE_CONSTANT: delete this->memory.namespace_;
+        case ObjectType::NAMESPACE_CONSTANT: delete this->memory.namespace_; break;
+        // The parent string belongs to the GC, so only free the view itself
+        case ObjectType::STRING_SLICE: delete this->memory.slice; break;
+        case ObjectType::ARRAY_SLICE: delete this->memory.array_slice; break;
+        case ObjectType::STRING_BUILDER: delete this->memory.builder; break;
+        case ObjectType::TYPED_ARRAY: delete this->memory.typed_array; break;
+        case ObjectType::MAP:
+        case ObjectType::SET:
+            delete this->memory.table;
+            break;
+        case ObjectType::RECORD: record_t::free(this->memory.record); break;
     }
 }
 
@@ -49,7 +183,10 @@ Value::Value() : type(ValueType::NULL_VALUE) {};
 
 std::string Values::value_to_string(const Value &value) {
     switch (get_value_type(value)) {
-        case ValueType::NUMBER: return std::to_string(get_value_number(value));
+        case ValueType::NUMBER: {
+            char buffer[NumberFormat::MAX_LENGTH];
+            return std::string(buffer, NumberFormat::format(buffer, get_value_number(value)));
+        }
         case ValueType::TRUE:   return "true";
         case ValueType::FALSE:  return "false";
         case ValueType::NULL_VALUE: return "null";
@@ -64,40 +201,139 @@ std::string Values::value_to_string(const Value &value) {
 std::string Values::object_to_string(Object *obj) {
     switch (obj->type) {
         case ObjectType::STRING: {
-            return *obj->memory.str;
+            return obj->memory.str->chars;
         }
-        case ObjectType::ARRAY: {
-            std::string str = "[ ";
+        case ObjectType::STRING_SLICE: {
+            return std::string(object_to_string_view(obj));
+        }
+        case ObjectType::STRING_BUILDER: {
+            return *obj->memory.builder;
+        }
+        case ObjectType::ARRAY:
+        case ObjectType::ARRAY_SLICE:
+        case ObjectType::TYPED_ARRAY:
+        case ObjectType::MAP:
+        case ObjectType::SET:
+        case ObjectType::RECORD: {
+            std::string str;
+            append_value_to_string(str, Value(obj));
+            return str;
+        }
+        default: throw sg_assert_error("Unknown object type when making string");
+    }
+};
+void Values::append_number_to_string(std::string &output, number_t number) {
+    char buffer[NumberFormat::MAX_LENGTH];
+    output.append(buffer, NumberFormat::format(buffer, number));
+}
+void Values::append_value_to_string(std::string &output, const Value &value) {
+    switch (get_value_type(value)) {
+        case ValueType::NUMBER:
+            append_number_to_string(output, get_value_number(value));
+            return;
+        case ValueType::OBJ: break;
+        default:
+            output += value_to_string(value);
+            return;
+    }
+
+    Object *obj = get_value_object(value);
+    switch (obj->type) {
+        case ObjectType::STRING:
+        case ObjectType::STRING_SLICE:
+            output.append(object_to_string_view(obj));
+            return;
+        case ObjectType::STRING_BUILDER:
+            output.append(*obj->memory.builder);
+            return;
+        case ObjectType::ARRAY:
+        case ObjectType::ARRAY_SLICE: {
+            output += "[ ";
+            const Value *elements = array_elements(obj);
+            size_t length = array_length(obj);
+            for (size_t index = 0; index < length; index += 1) {
+                if (index > 0) output += ", ";
+                append_value_to_string(output, elements[index]);
+            }
+            output += " ]";
+            return;
+        }
+        case ObjectType::TYPED_ARRAY: {
+            typed_array_t *array = obj->memory.typed_array;
+            output += typed_array_kind_to_string(array->kind);
+            output += "[ ";
+            for (size_t index = 0; index < array->length; index += 1) {
+                if (index > 0) output += ", ";
+                append_number_to_string(output, array->get(index));
+            }
+            output += " ]";
+            return;
+        }
+        // Map{ key: value, ... } and Set{ key, ... }, in no particular order
+        case ObjectType::MAP:
+        case ObjectType::SET: {
+            bool is_map = obj->type == ObjectType::MAP;
+            output += is_map ? "Map{ " : "Set{ ";
             bool found_value = false;
-            for (Value value : *obj->memory.array) {
-                if (found_value) str += ", ";
-                str += value_to_string(value);
+            obj->memory.table->for_each([&](const value_table_t::entry_t &entry) {
+                if (found_value) output += ", ";
+                append_value_to_string(output, entry.key);
+                if (is_map) {
+                    output += ": ";
+                    append_value_to_string(output, entry.value);
+                }
                 found_value = true;
+            });
+            output += " }";
+            return;
+        }
+        // Point{ x: 1, y: 2 }, in the order the fields were declared
+        case ObjectType::RECORD: {
+            record_t *record = obj->memory.record;
+            output += record->shape->name;
+            output += "{ ";
+            for (size_t index = 0; index < record->field_count(); index += 1) {
+                if (index > 0) output += ", ";
+                output += record->shape->fields[index];
+                output += ": ";
+                append_value_to_string(output, record->fields()[index]);
             }
-            str += " ]";
-            return str;
+            output += " }";
+            return;
         }
         default: throw sg_assert_error("Unknown object type when making string");
     }
-};
+}
 std::string Values::object_to_debug_string(Object *obj) {
     switch (obj->type) {
-        case ObjectType::STRING: {
+        case ObjectType::STRING:
+        case ObjectType::STRING_SLICE: {
+            std::string value = std::string(object_to_string_view(obj));
             std::string trimmed;
-            truncate_string(trimmed, 36, *obj->memory.str);
+            truncate_string(trimmed, 36, value);
             return '"' + trimmed + '"';
         }
-        case ObjectType::ARRAY: {
+        case ObjectType::STRING_BUILDER: {
+            std::string trimmed;
+            truncate_string(trimmed, 36, *obj->memory.builder);
+            return "StringBuilder(\"" + trimmed + "\")";
+        }
+        case ObjectType::ARRAY:
+        case ObjectType::ARRAY_SLICE: {
             std::string str = "[ ";
-            bool found_value = false;
-            for (Value value : *obj->memory.array) {
-                if (found_value) str += ", ";
-                str += value_to_debug_string(value);
-                found_value = true;
+            const Value *elements = array_elements(obj);
+            size_t length = array_length(obj);
+            for (size_t index = 0; index < length; index += 1) {
+                if (index > 0) str += ", ";
+                str += value_to_debug_string(elements[index]);
             }
             str += " ]";
             return str;
         }
+        case ObjectType::TYPED_ARRAY: return object_to_string(obj);
+        case ObjectType::MAP: return "Map(" + std::to_string(obj->memory.table->size()) + " entries)";
+        case ObjectType::SET: return "Set(" + std::to_string(obj->memory.table->size()) + " entries)";
+        case ObjectType::RECORD: return obj->memory.record->shape->name + " record";
         default: throw sg_assert_error("Unknown object type when making debug string");
     }
 };
@@ -114,6 +350,73 @@ Object *Values::safe_get_value_object(const Value &value) {
     if (get_value_type(value) != ValueType::OBJ) return nullptr;
     return get_value_object(value);
 }
+bool Values::value_is_string(const Value &value) {
+    Object *obj = safe_get_value_object(value);
+    return obj != nullptr && object_is_string(obj);
+}
+
+/* Only built for valid, non-ASCII strings */
+static std::vector<size_t> *get_code_point_index(string_t *str) {
+    if (str->code_point_index != nullptr) return str->code_point_index;
+
+    std::vector<size_t> *index = Allocate<std::vector<size_t>>::create();
+    index->reserve(str->length / STRING_INDEX_STRIDE + 1);
+
+    size_t code_point = 0;
+    for (size_t byte = 0; byte < str->chars.size(); byte += 1) {
+        if (Utf8::is_continuation_byte(str->chars[byte])) continue;
+        if (code_point % STRING_INDEX_STRIDE == 0) index->push_back(byte);
+        code_point += 1;
+    }
+
+    str->code_point_index = index;
+    return index;
+}
+static size_t owned_code_point_offset(string_t *str, size_t index) {
+    if (str->indexed_by_byte()) return std::min(index, str->chars.size());
+    if (index >= str->length) return str->chars.size();
+
+    // Jump to the closest indexed code point, then walk the rest of the way
+    size_t byte = (*get_code_point_index(str))[index / STRING_INDEX_STRIDE];
+    for (size_t remaining = index % STRING_INDEX_STRIDE; remaining > 0; remaining -= 1) {
+        byte += Utf8::sequence_length(str->chars[byte]);
+    }
+    return byte;
+}
+static size_t owned_byte_to_code_point(string_t *str, size_t offset) {
+    if (str->indexed_by_byte()) return std::min(offset, str->chars.size());
+    if (offset >= str->chars.size()) return str->length;
+
+    std::vector<size_t> *index = get_code_point_index(str);
+    // The last indexed code point at or before the offset. The first entry is always 0.
+    auto entry = std::upper_bound(index->begin(), index->end(), offset) - 1;
+    size_t code_point = (entry - index->begin()) * STRING_INDEX_STRIDE;
+    return code_point + Utf8::count_code_points(std::string_view(str->chars).substr(*entry, offset - *entry));
+}
+
+size_t Values::string_code_point_offset(Object *obj, size_t index) {
+    if (obj->type == ObjectType::STRING) return owned_code_point_offset(obj->memory.str, index);
+
+    string_slice_t *slice = obj->memory.slice;
+    if (index >= slice->code_point_length) return slice->length;
+    return owned_code_point_offset(slice->parent->memory.str, slice->code_point_offset + index) - slice->offset;
+}
+size_t Values::string_byte_to_code_point(Object *obj, size_t offset) {
+    if (obj->type == ObjectType::STRING) return owned_byte_to_code_point(obj->memory.str, offset);
+
+    string_slice_t *slice = obj->memory.slice;
+    if (offset >= slice->length) return slice->code_point_length;
+    return owned_byte_to_code_point(slice->parent->memory.str, slice->offset + offset) - slice->code_point_offset;
+}
+std::string_view Values::string_code_point_at(Object *obj, size_t index) {
+    std::string_view view = object_to_string_view(obj);
+    size_t offset = string_code_point_offset(obj, index);
+
+    string_t *owner = obj->type == ObjectType::STRING ? obj->memory.str : obj->memory.slice->parent->memory.str;
+    if (owner->indexed_by_byte()) return view.substr(offset, 1);
+    // A slice may end in the middle of a code point
+    return view.substr(offset, std::min(Utf8::sequence_length(view[offset]), view.size() - offset));
+}
 
 bool Values::value_is_truthy(const Value &value) {
     switch (get_value_type(value)) {
@@ -125,8 +428,18 @@ bool Values::value_is_truthy(const Value &value) {
         case ValueType::OBJ: {
             Object *obj = get_value_object(value);
             switch (obj->type) {
-                case ObjectType::STRING: return get_value_string(value)->size() > 0;
-                case ObjectType::ARRAY: return get_value_array(value)->size() > 0;
+                case ObjectType::STRING:
+                case ObjectType::STRING_SLICE:
+                    return object_to_string_view(obj).size() > 0;
+                case ObjectType::ARRAY:
+                case ObjectType::ARRAY_SLICE:
+                    return array_length(obj) > 0;
+                case ObjectType::STRING_BUILDER: return true;
+                case ObjectType::TYPED_ARRAY: return obj->memory.typed_array->length > 0;
+                case ObjectType::MAP:
+                case ObjectType::SET:
+                    return obj->memory.table->size() > 0;
+                case ObjectType::RECORD: return true;
                 default: throw sg_assert_error("Unknown object type when determining value truth");
             }
         }
@@ -155,11 +468,21 @@ bool Values::values_are_equal(const Value &a, const Value &b) {
         case ValueType::OBJ: {
             Object *obj_a = get_value_object(a);
             Object *obj_b = get_value_object(b);
+            // A slice is equal to a string with the same characters
+            if (object_is_string(obj_a) && object_is_string(obj_b)) {
+                return object_to_string_view(obj_a) == object_to_string_view(obj_b);
+            }
             if (obj_a->type != obj_b->type) return false;
 
             switch (obj_a->type) {
-                case ObjectType::STRING: return *get_value_string(a) == *get_value_string(b);
                 case ObjectType::ARRAY: return get_value_array(a) == get_value_array(b);
+                case ObjectType::STRING_BUILDER:
+                case ObjectType::TYPED_ARRAY:
+                case ObjectType::MAP:
+                case ObjectType::SET:
+                case ObjectType::RECORD:
+                case ObjectType::ARRAY_SLICE:
+                    return obj_a == obj_b;
                 default: throw sg_assert_error("Unknown object type when determining object equality");
             }
         }
@@ -181,6 +504,38 @@ static Values::number_t mod(Values::number_t a, Values::number_t b) {
     return fmod(a, b);
 }
 
+/* One side of a string concatenation */
+struct concat_operand_t {
+    std::string_view chars;
+    // Whether the encoding is already known, so the result doesn't have to be checked
+    bool known_encoding;
+    size_t length;
+    bool ascii;
+};
+/**
+ * @param {char*} buffer - Where to format the value if it's a number. MAX_LENGTH characters long.
+ * @return {bool} - False if the value can't be concatenated
+ */
+static bool get_concat_operand(const Value &value, char *buffer, concat_operand_t &operand) {
+    if (get_value_type(value) == ValueType::NUMBER) {
+        size_t length = NumberFormat::format(buffer, get_value_number(value));
+        operand = concat_operand_t{
+            .chars = std::string_view(buffer, length), .known_encoding = true, .length = length, .ascii = true };
+        return true;
+    }
+
+    Object *obj = safe_get_value_object(value);
+    if (obj == nullptr || !object_is_string(obj)) return false;
+
+    operand.chars = object_to_string_view(obj);
+    operand.known_encoding = obj->type == ObjectType::STRING && obj->memory.str->valid_utf8;
+    if (operand.known_encoding) {
+        operand.length = obj->memory.str->length;
+        operand.ascii = obj->memory.str->ascii;
+    }
+    return true;
+}
+
 bool Values::bin_op(
     Operations::BinOpType type,
     Value a,
@@ -190,17 +545,29 @@ bool Values::bin_op(
 ) {
     using Operations::BinOpType;
 
-    if (
-        type == BinOpType::BINOP_ADD &&
-        get_value_type(a) == ValueType::OBJ &&
-        get_value_type(b) == ValueType::OBJ
-    ) {
-        Object *obj_a = get_value_object(a);
-        Object *obj_b = get_value_object(b);
-
-        if (obj_a->type == ObjectType::STRING && obj_b->type == ObjectType::STRING) {
-            std::string *concat = new std::string(*get_value_string(a) + *get_value_string(b));
-            Object *obj = new Object(concat);
+    // String concatenation. Either side may also be a number.
+    if (type == BinOpType::BINOP_ADD && (value_is_string(a) || value_is_string(b))) {
+        char buffer_a[NumberFormat::MAX_LENGTH], buffer_b[NumberFormat::MAX_LENGTH];
+        concat_operand_t operand_a, operand_b;
+
+        if (get_concat_operand(a, buffer_a, operand_a) && get_concat_operand(b, buffer_b, operand_b)) {
+            std::string concat;
+            concat.reserve(operand_a.chars.size() + operand_b.chars.size());
+            concat.append(operand_a.chars);
+            concat.append(operand_b.chars);
+
+            // Two valid strings stay valid when joined, so their encoding
+            // doesn't need to be checked again
+            string_t *str;
+            if (operand_a.known_encoding && operand_b.known_encoding) {
+                str = new string_t(
+                    std::move(concat),
+                    operand_a.length + operand_b.length,
+                    operand_a.ascii && operand_b.ascii);
+            }
+            else str = new string_t(std::move(concat));
+
+            Object *obj = new Object(str);
             *result = Value(obj);
             return true;
         }
@@ -8,6 +8,7 @@
 #include <cassert>
 #endif
 
+#include <string_view>
 #include <unordered_map>
 
 class Runtime;
@@ -34,10 +35,25 @@ namespace Values {
     */
     typedef bool (*native_function_t)(const Value * const start, uint arg_count, Value &result, Runtime &runtime, std::string &error_message);
 
+    /* What the optimizer can assume about a native function */
+    typedef uint native_flags_t;
+    /* Only reads its arguments, and only ones that can't change, like numbers and strings.
+        Changes nothing, so the same arguments always give the same result or the same error. */
+    const native_flags_t NATIVE_PURE = 1 << 0;
+    /* May make new objects */
+    const native_flags_t NATIVE_ALLOCATES = 1 << 1;
+    /* May fail with an error, e.g. when an argument is the wrong type */
+    const native_flags_t NATIVE_MAY_FAIL = 1 << 2;
+    /* Always returns a number when it doesn't fail */
+    const native_flags_t NATIVE_RETURNS_NUMBER = 1 << 3;
+
     struct native_method_t {
         native_function_t func;
         int number_arguments;
+        native_flags_t flags;
     };
+    // Number of arguments for natives that take any amount, e.g. Console.printf
+    const int VARIADIC_ARGUMENTS = -1;
 
     class Value;
     class Object;
@@ -86,16 +102,170 @@ namespace Values {
     };
 
     typedef std::unordered_map<std::string, Value> namespace_t;
+
+    // Distance, in code points, between the entries of a string's code point index
+    const size_t STRING_INDEX_STRIDE = 32;
+    /* The characters of a STRING object. The encoding is checked once, when the
+        string is created, so length and indexing never have to rescan it. */
+    struct string_t {
+        std::string chars;
+        // Number of code points. If the string is not valid UTF-8, the number of bytes.
+        size_t length;
+        bool ascii;
+        bool valid_utf8;
+        // Byte offset of every STRING_INDEX_STRIDE-th code point. Only built
+        // the first time a non-ASCII string is indexed.
+        std::vector<size_t> *code_point_index = nullptr;
+
+        string_t(std::string &&chars);
+        string_t(std::string_view chars);
+        /* For strings whose encoding is already known to be valid */
+        string_t(std::string &&chars, size_t length, bool ascii);
+        string_t(const string_t &other) = delete;
+        ~string_t();
+
+        // ASCII strings and strings that aren't valid UTF-8 are indexed by byte
+        inline bool indexed_by_byte() const { return this->ascii || !this->valid_utf8; }
+    };
+    enum TypedArrayKind {
+        FLOAT64_ARRAY,
+        INT32_ARRAY,
+        UINT8_ARRAY
+    };
+    // Typed array buffers are aligned for AVX loads. Views can start anywhere in the buffer.
+    const size_t TYPED_ARRAY_ALIGNMENT = 32;
+    /* Numbers stored back to back, without a Value around each one.
+        The elements can't reference objects, so the GC never looks inside. */
+    struct typed_array_t {
+        TypedArrayKind kind;
+        size_t length;
+        void *data;
+        /* For views, the typed array that owns the buffer, which the GC keeps alive.
+            Never another view. nullptr if this array owns its data. */
+        Object *owner = nullptr;
+
+        // Elements start at 0
+        typed_array_t(TypedArrayKind kind, size_t length);
+        // A view of length elements starting at data, which belongs to owner
+        typed_array_t(TypedArrayKind kind, void *data, size_t length, Object *owner);
+        typed_array_t(const typed_array_t &other) = delete;
+        ~typed_array_t();
+
+        inline bool is_view() const { return this->owner != nullptr; }
+        /* Give a view its own copy of the elements, so that it can be written to without
+            changing the owner. Throws std::bad_alloc, and stays a view, if that fails. */
+        void detach();
+
+        inline size_t element_size() const {
+            switch (this->kind) {
+                case TypedArrayKind::FLOAT64_ARRAY: return sizeof(double);
+                case TypedArrayKind::INT32_ARRAY: return sizeof(int32_t);
+                case TypedArrayKind::UINT8_ARRAY: return sizeof(uint8_t);
+            }
+            return 0;
+        }
+        inline number_t get(size_t index) const {
+            switch (this->kind) {
+                case TypedArrayKind::FLOAT64_ARRAY: return static_cast<double*>(this->data)[index];
+                case TypedArrayKind::INT32_ARRAY: return static_cast<int32_t*>(this->data)[index];
+                case TypedArrayKind::UINT8_ARRAY: return static_cast<uint8_t*>(this->data)[index];
+            }
+            return 0;
+        }
+        /* Integer arrays wrap out of range numbers the way JavaScript does,
+            and store NaN and infinities as 0 */
+        void set(size_t index, number_t number);
+    };
+    const char *typed_array_kind_to_string(TypedArrayKind kind);
+
+    // Defined in value-table.hpp, which needs the full Value class
+    class value_table_t;
+
+    /* A view into the buffer of another string. The slice does not own the
+        characters, it only keeps the parent alive through the GC. */
+    struct string_slice_t {
+        // Always a STRING object, never another slice. Slicing a slice
+        // points at the original parent with the offsets combined.
+        Object *parent;
+        // In bytes
+        size_t offset;
+        size_t length;
+        // The same range in the parent's code points
+        size_t code_point_offset;
+        size_t code_point_length;
+    };
+    /* A view into the elements of an array, made by Array.slice. Reading goes straight
+        to the parent's elements, so writes to the parent show through. Writing to the
+        slice copies the elements first (see Runtime::make_array_writable), so the parent
+        never changes because of the slice. Arrays never shrink, so the range stays valid. */
+    struct array_slice_t {
+        // Always an ARRAY object, never another slice
+        Object *parent;
+        size_t offset;
+        size_t length;
+    };
+    /* The layout of a struct, shared by every record made from it.
+        Shapes are made when the program is compiled, and the runtime owns them. */
+    struct record_shape_t {
+        std::string name;
+        std::vector<std::string> fields;
+
+        // -1 if the struct has no field with the name
+        int field_index(std::string_view field) const;
+    };
+    /* An instance of a struct. The fields are stored right after the record, in the
+        same allocation, so reading a field whose slot is known is a single load. */
+    struct record_t {
+        const record_shape_t *shape;
+
+        inline Value *fields() { return reinterpret_cast<Value*>(this + 1); }
+        inline size_t field_count() const { return this->shape->fields.size(); }
+
+        /* Every field starts as null. Throws std::bad_alloc, like new, so that
+            the runtime can collect garbage and try again. */
+        static record_t *allocate(const record_shape_t *shape);
+        static void free(record_t *record);
+    };
     union obj_mem_t {
-        std::string *str;
+        string_t *str;
         std::vector<Value> *array;
         namespace_t *namespace_;
+        string_slice_t *slice;
+        array_slice_t *array_slice;
+        std::string *builder;
+        typed_array_t *typed_array;
+        // For both maps and sets
+        value_table_t *table;
+        record_t *record;
     };
     enum ObjectType {
         STRING,
         ARRAY,
         // A namespace that cannot be updated
-        NAMESPACE_CONSTANT
+        NAMESPACE_CONSTANT,
+        // A zero-copy substring of a STRING object
+        STRING_SLICE,
+        // A mutable buffer that strings can be appended to
+        STRING_BUILDER,
+        // Float64Array, Int32Array or Uint8Array
+        TYPED_ARRAY,
+        // Hash tables keyed by value. Sets don't use the values.
+        MAP,
+        SET,
+        // An instance of a struct
+        RECORD,
+        // A view into part of an ARRAY object, which becomes an ARRAY when it is written to
+        ARRAY_SLICE
+    };
+    /* What an ARRAY holds, so the GC and the numeric natives can skip looking at every element.
+        Kinds only ever move towards MIXED_ELEMENTS. E.g., overwriting the one string in an
+        array with a number leaves it mixed, so that updating the kind is always O(1). */
+    enum ArrayElementKind : uint8_t {
+        // Nothing has been stored yet
+        NO_ELEMENTS,
+        NUMBER_ELEMENTS,
+        OBJECT_ELEMENTS,
+        MIXED_ELEMENTS
     };
     // For values that need to be allocated on the heap
     // The runtime itself will add the next linked list value, so
@@ -104,15 +274,57 @@ namespace Values {
         ObjectType type;
         obj_mem_t memory;
         bool marked_for_save = false;
+        // Only kept up to date for arrays
+        ArrayElementKind element_kind = ArrayElementKind::MIXED_ELEMENTS;
+        // Set on arrays in the constant pool. Slices of them copy before anything else can view them.
+        bool is_constant = false;
         Object *next;
 
-        Object(std::string *str);
-        Object(std::vector<Value> *str);
+        Object(string_t *str);
+        /* Works out the element kind from the elements already in the array */
+        Object(std::vector<Value> *array);
         Object(namespace_t *namespace_);
+        Object(string_slice_t *slice);
+        /* For string builders. Strings are owned by a string_t, so the
+            two constructors can't be confused. */
+        explicit Object(std::string *builder);
+        Object(typed_array_t *typed_array);
+        /* For maps and sets, which share the table type */
+        Object(value_table_t *table, ObjectType type);
+        Object(record_t *record);
+        Object(array_slice_t *slice);
 
         ~Object();
     };
 
+    /* Strings and string slices can be used interchangeably by the runtime */
+    inline bool object_is_string(const Object *obj) {
+        return obj->type == ObjectType::STRING || obj->type == ObjectType::STRING_SLICE;
+    }
+    inline std::string_view object_to_string_view(const Object *obj) {
+        #ifdef DEBUG
+        assert(object_is_string(obj));
+        #endif
+        if (obj->type == ObjectType::STRING) return std::string_view(obj->memory.str->chars);
+
+        string_slice_t *slice = obj->memory.slice;
+        return std::string_view(slice->parent->memory.str->chars).substr(slice->offset, slice->length);
+    }
+    /* Length of a string or slice, in code points. O(1). */
+    inline size_t string_length(const Object *obj) {
+        #ifdef DEBUG
+        assert(object_is_string(obj));
+        #endif
+        if (obj->type == ObjectType::STRING) return obj->memory.str->length;
+        return obj->memory.slice->code_point_length;
+    }
+    /* Byte offset of a code point in a string or slice. The index may be the length of the string. */
+    size_t string_code_point_offset(Object *obj, size_t index);
+    /* Number of code points that start before the byte offset */
+    size_t string_byte_to_code_point(Object *obj, size_t offset);
+    /* The bytes of one code point in a string or slice */
+    std::string_view string_code_point_at(Object *obj, size_t index);
+
     inline Value value_from_object(Object *obj) __attribute__((__always_inline__));
     inline Value value_from_object(Object *obj) {
         #ifdef NAN_BOXING
@@ -139,6 +351,9 @@ namespace Values {
     std::string value_to_debug_string(const Value &value);
     std::string object_to_string(Object *obj);
     std::string object_to_debug_string(Object *obj);
+    /* Format a value straight onto the end of a string, the same way value_to_string would */
+    void append_value_to_string(std::string &output, const Value &value);
+    void append_number_to_string(std::string &output, number_t number);
 
     // Free value payload if necessary
     void free_value_if_object(Value &value);
@@ -157,7 +372,7 @@ namespace Values {
         assert(get_value_type(value) == ValueType::OBJ &&
             get_value_object(value)->type == ObjectType::STRING);
         #endif
-        return value.value.obj->memory.str;
+        return &value.value.obj->memory.str->chars;
     }
     inline std::vector<Value>* get_value_array(const Value &value) {
         #ifdef DEBUG
@@ -187,6 +402,55 @@ namespace Values {
     // Returns nullptr if the value is not an object
     Object *safe_get_value_object(const Value &value);
 
+    /* The kind of an array after the value is stored in it */
+    inline ArrayElementKind array_element_kind_with(ArrayElementKind kind, const Value &value) {
+        ArrayElementKind value_kind;
+        switch (get_value_type(value)) {
+            case ValueType::NUMBER: value_kind = ArrayElementKind::NUMBER_ELEMENTS; break;
+            case ValueType::OBJ: value_kind = ArrayElementKind::OBJECT_ELEMENTS; break;
+            default: value_kind = ArrayElementKind::MIXED_ELEMENTS; break;
+        }
+
+        if (kind == ArrayElementKind::NO_ELEMENTS || kind == value_kind) return value_kind;
+        return ArrayElementKind::MIXED_ELEMENTS;
+    }
+    /* Must be called whenever a value is stored in an existing array */
+    inline void record_array_element(Object *array_obj, const Value &value) {
+        array_obj->element_kind = array_element_kind_with(array_obj->element_kind, value);
+    }
+    /* True if every element is known to be a number, without looking at them.
+        Slices go by their parent's kind, which also covers elements outside the slice. */
+    inline bool array_holds_only_numbers(const Object *array_obj) {
+        if (array_obj->type == ObjectType::ARRAY_SLICE) array_obj = array_obj->memory.array_slice->parent;
+        return array_obj->element_kind == ArrayElementKind::NUMBER_ELEMENTS ||
+            array_obj->element_kind == ArrayElementKind::NO_ELEMENTS;
+    }
+
+    /* Arrays and array slices can be read the same way */
+    inline bool object_is_array(const Object *obj) {
+        return obj->type == ObjectType::ARRAY || obj->type == ObjectType::ARRAY_SLICE;
+    }
+    inline size_t array_length(const Object *obj) {
+        #ifdef DEBUG
+        assert(object_is_array(obj));
+        #endif
+        if (obj->type == ObjectType::ARRAY) return obj->memory.array->size();
+        return obj->memory.array_slice->length;
+    }
+    /* Pointer to the first element of an array or slice. Writing through it is only
+        allowed for ARRAY objects, and it moves when the array grows. */
+    inline Value *array_elements(const Object *obj) {
+        #ifdef DEBUG
+        assert(object_is_array(obj));
+        #endif
+        if (obj->type == ObjectType::ARRAY) return obj->memory.array->data();
+
+        array_slice_t *slice = obj->memory.array_slice;
+        return slice->parent->memory.array->data() + slice->offset;
+    }
+    // True for both strings and string slices
+    bool value_is_string(const Value &value);
+
     bool value_is_truthy(const Value &value);
     bool value_is_numerical(const Value &value);
     bool values_are_equal(const Value &a, const Value &b);
@@ -0,0 +1,813 @@
+#include "cpu-features.hpp"
+#include "vector-math.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+#ifdef SGCPP_X86_SIMD
+#include <immintrin.h>
+#endif
+
+typedef double (*sum_kernel_t)(const double *data, size_t length);
+typedef double (*deviation_kernel_t)(const double *data, size_t length, double center);
+typedef double (*dot_kernel_t)(const double *left, const double *right, size_t length);
+// Min or max. Returns NaN as soon as it is known that an element is NaN.
+typedef double (*extreme_kernel_t)(const double *data, size_t length);
+
+/* Number of elements a kernel adds up on its own before the pairwise tree takes over.
+    Small enough that the rounding error inside a block stays tiny,
+    big enough that the recursion costs nothing next to the kernel. */
+static const size_t PAIRWISE_BLOCK = 256;
+
+static const double POSITIVE_INFINITY = std::numeric_limits<double>::infinity();
+static const double NEGATIVE_INFINITY = -std::numeric_limits<double>::infinity();
+static const double NOT_A_NUMBER = std::numeric_limits<double>::quiet_NaN();
+
+/* > Scalar kernels */
+// Several accumulators, like the vector kernels, so the loop isn't one long dependency chain
+static double sum_scalar(const double *data, size_t length) {
+    double accumulators[4] = { 0, 0, 0, 0 };
+    size_t index = 0;
+    for (; index + 4 <= length; index += 4) {
+        accumulators[0] += data[index];
+        accumulators[1] += data[index + 1];
+        accumulators[2] += data[index + 2];
+        accumulators[3] += data[index + 3];
+    }
+    double total = (accumulators[0] + accumulators[1]) + (accumulators[2] + accumulators[3]);
+    for (; index < length; index += 1) total += data[index];
+    return total;
+}
+static double deviation_scalar(const double *data, size_t length, double center) {
+    double accumulators[4] = { 0, 0, 0, 0 };
+    size_t index = 0;
+    for (; index + 4 <= length; index += 4) {
+        for (size_t lane = 0; lane < 4; lane += 1) {
+            double deviation = data[index + lane] - center;
+            accumulators[lane] += deviation * deviation;
+        }
+    }
+    double total = (accumulators[0] + accumulators[1]) + (accumulators[2] + accumulators[3]);
+    for (; index < length; index += 1) {
+        double deviation = data[index] - center;
+        total += deviation * deviation;
+    }
+    return total;
+}
+static double dot_scalar(const double *left, const double *right, size_t length) {
+    double accumulators[4] = { 0, 0, 0, 0 };
+    size_t index = 0;
+    for (; index + 4 <= length; index += 4) {
+        accumulators[0] += left[index] * right[index];
+        accumulators[1] += left[index + 1] * right[index + 1];
+        accumulators[2] += left[index + 2] * right[index + 2];
+        accumulators[3] += left[index + 3] * right[index + 3];
+    }
+    double total = (accumulators[0] + accumulators[1]) + (accumulators[2] + accumulators[3]);
+    for (; index < length; index += 1) total += left[index] * right[index];
+    return total;
+}
+static double min_scalar(const double *data, size_t length) {
+    double result = POSITIVE_INFINITY;
+    for (size_t index = 0; index < length; index += 1) {
+        if (std::isnan(data[index])) return NOT_A_NUMBER;
+        if (data[index] < result) result = data[index];
+    }
+    return result;
+}
+static double max_scalar(const double *data, size_t length) {
+    double result = NEGATIVE_INFINITY;
+    for (size_t index = 0; index < length; index += 1) {
+        if (std::isnan(data[index])) return NOT_A_NUMBER;
+        if (data[index] > result) result = data[index];
+    }
+    return result;
+}
+/* < Scalar kernels */
+
+#ifdef SGCPP_X86_SIMD
+/* > SSE2 kernels */
+__attribute__((target("sse2")))
+static inline double horizontal_sum_sse2(__m128d vector) {
+    return _mm_cvtsd_f64(_mm_add_sd(vector, _mm_unpackhi_pd(vector, vector)));
+}
+__attribute__((target("sse2")))
+static double sum_sse2(const double *data, size_t length) {
+    __m128d first = _mm_setzero_pd(), second = _mm_setzero_pd();
+    __m128d third = _mm_setzero_pd(), fourth = _mm_setzero_pd();
+    size_t index = 0;
+    for (; index + 8 <= length; index += 8) {
+        first = _mm_add_pd(first, _mm_loadu_pd(data + index));
+        second = _mm_add_pd(second, _mm_loadu_pd(data + index + 2));
+        third = _mm_add_pd(third, _mm_loadu_pd(data + index + 4));
+        fourth = _mm_add_pd(fourth, _mm_loadu_pd(data + index + 6));
+    }
+    __m128d combined = _mm_add_pd(_mm_add_pd(first, second), _mm_add_pd(third, fourth));
+    return horizontal_sum_sse2(combined) + sum_scalar(data + index, length - index);
+}
+__attribute__((target("sse2")))
+static double deviation_sse2(const double *data, size_t length, double center) {
+    const __m128d centers = _mm_set1_pd(center);
+    __m128d first = _mm_setzero_pd(), second = _mm_setzero_pd();
+    size_t index = 0;
+    for (; index + 4 <= length; index += 4) {
+        __m128d first_deviation = _mm_sub_pd(_mm_loadu_pd(data + index), centers);
+        __m128d second_deviation = _mm_sub_pd(_mm_loadu_pd(data + index + 2), centers);
+        first = _mm_add_pd(first, _mm_mul_pd(first_deviation, first_deviation));
+        second = _mm_add_pd(second, _mm_mul_pd(second_deviation, second_deviation));
+    }
+    return horizontal_sum_sse2(_mm_add_pd(first, second)) + deviation_scalar(data + index, length - index, center);
+}
+__attribute__((target("sse2")))
+static double dot_sse2(const double *left, const double *right, size_t length) {
+    __m128d first = _mm_setzero_pd(), second = _mm_setzero_pd();
+    size_t index = 0;
+    for (; index + 4 <= length; index += 4) {
+        first = _mm_add_pd(first, _mm_mul_pd(_mm_loadu_pd(left + index), _mm_loadu_pd(right + index)));
+        second = _mm_add_pd(second, _mm_mul_pd(_mm_loadu_pd(left + index + 2), _mm_loadu_pd(right + index + 2)));
+    }
+    return horizontal_sum_sse2(_mm_add_pd(first, second)) + dot_scalar(left + index, right + index, length - index);
+}
+/* minpd and maxpd return the second operand when either one is NaN,
+    so NaNs are tracked in a separate mask instead */
+__attribute__((target("sse2")))
+static double min_sse2(const double *data, size_t length) {
+    __m128d result = _mm_set1_pd(POSITIVE_INFINITY);
+    __m128d nan_lanes = _mm_setzero_pd();
+    size_t index = 0;
+    for (; index + 2 <= length; index += 2) {
+        __m128d block = _mm_loadu_pd(data + index);
+        nan_lanes = _mm_or_pd(nan_lanes, _mm_cmpunord_pd(block, block));
+        result = _mm_min_pd(block, result);
+    }
+    if (_mm_movemask_pd(nan_lanes) != 0) return NOT_A_NUMBER;
+
+    double lanes[2];
+    _mm_storeu_pd(lanes, result);
+    double rest = min_scalar(data + index, length - index);
+    if (std::isnan(rest)) return rest;
+    return std::min(std::min(lanes[0], lanes[1]), rest);
+}
+__attribute__((target("sse2")))
+static double max_sse2(const double *data, size_t length) {
+    __m128d result = _mm_set1_pd(NEGATIVE_INFINITY);
+    __m128d nan_lanes = _mm_setzero_pd();
+    size_t index = 0;
+    for (; index + 2 <= length; index += 2) {
+        __m128d block = _mm_loadu_pd(data + index);
+        nan_lanes = _mm_or_pd(nan_lanes, _mm_cmpunord_pd(block, block));
+        result = _mm_max_pd(block, result);
+    }
+    if (_mm_movemask_pd(nan_lanes) != 0) return NOT_A_NUMBER;
+
+    double lanes[2];
+    _mm_storeu_pd(lanes, result);
+    double rest = max_scalar(data + index, length - index);
+    if (std::isnan(rest)) return rest;
+    return std::max(std::max(lanes[0], lanes[1]), rest);
+}
+/* < SSE2 kernels */
+
+/* > AVX2 kernels */
+__attribute__((target("avx2")))
+static inline double horizontal_sum_avx2(__m256d vector) {
+    __m128d halves = _mm_add_pd(_mm256_castpd256_pd128(vector), _mm256_extractf128_pd(vector, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(halves, _mm_unpackhi_pd(halves, halves)));
+}
+__attribute__((target("avx2")))
+static double sum_avx2(const double *data, size_t length) {
+    __m256d first = _mm256_setzero_pd(), second = _mm256_setzero_pd();
+    __m256d third = _mm256_setzero_pd(), fourth = _mm256_setzero_pd();
+    size_t index = 0;
+    for (; index + 16 <= length; index += 16) {
+        first = _mm256_add_pd(first, _mm256_loadu_pd(data + index));
+        second = _mm256_add_pd(second, _mm256_loadu_pd(data + index + 4));
+        third = _mm256_add_pd(third, _mm256_loadu_pd(data + index + 8));
+        fourth = _mm256_add_pd(fourth, _mm256_loadu_pd(data + index + 12));
+    }
+    __m256d combined = _mm256_add_pd(_mm256_add_pd(first, second), _mm256_add_pd(third, fourth));
+    return horizontal_sum_avx2(combined) + sum_scalar(data + index, length - index);
+}
+__attribute__((target("avx2")))
+static double deviation_avx2(const double *data, size_t length, double center) {
+    const __m256d centers = _mm256_set1_pd(center);
+    __m256d first = _mm256_setzero_pd(), second = _mm256_setzero_pd();
+    size_t index = 0;
+    for (; index + 8 <= length; index += 8) {
+        __m256d first_deviation = _mm256_sub_pd(_mm256_loadu_pd(data + index), centers);
+        __m256d second_deviation = _mm256_sub_pd(_mm256_loadu_pd(data + index + 4), centers);
+        first = _mm256_add_pd(first, _mm256_mul_pd(first_deviation, first_deviation));
+        second = _mm256_add_pd(second, _mm256_mul_pd(second_deviation, second_deviation));
+    }
+    return horizontal_sum_avx2(_mm256_add_pd(first, second)) + deviation_scalar(data + index, length - index, center);
+}
+__attribute__((target("avx2")))
+static double dot_avx2(const double *left, const double *right, size_t length) {
+    __m256d first = _mm256_setzero_pd(), second = _mm256_setzero_pd();
+    size_t index = 0;
+    for (; index + 8 <= length; index += 8) {
+        first = _mm256_add_pd(first, _mm256_mul_pd(_mm256_loadu_pd(left + index), _mm256_loadu_pd(right + index)));
+        second = _mm256_add_pd(second, _mm256_mul_pd(_mm256_loadu_pd(left + index + 4), _mm256_loadu_pd(right + index + 4)));
+    }
+    return horizontal_sum_avx2(_mm256_add_pd(first, second)) + dot_scalar(left + index, right + index, length - index);
+}
+__attribute__((target("avx2")))
+static double min_avx2(const double *data, size_t length) {
+    __m256d result = _mm256_set1_pd(POSITIVE_INFINITY);
+    __m256d nan_lanes = _mm256_setzero_pd();
+    size_t index = 0;
+    for (; index + 4 <= length; index += 4) {
+        __m256d block = _mm256_loadu_pd(data + index);
+        nan_lanes = _mm256_or_pd(nan_lanes, _mm256_cmp_pd(block, block, _CMP_UNORD_Q));
+        result = _mm256_min_pd(block, result);
+    }
+    if (_mm256_movemask_pd(nan_lanes) != 0) return NOT_A_NUMBER;
+
+    __m128d halves = _mm_min_pd(_mm256_castpd256_pd128(result), _mm256_extractf128_pd(result, 1));
+    double lanes[2];
+    _mm_storeu_pd(lanes, halves);
+    double rest = min_scalar(data + index, length - index);
+    if (std::isnan(rest)) return rest;
+    return std::min(std::min(lanes[0], lanes[1]), rest);
+}
+__attribute__((target("avx2")))
+static double max_avx2(const double *data, size_t length) {
+    __m256d result = _mm256_set1_pd(NEGATIVE_INFINITY);
+    __m256d nan_lanes = _mm256_setzero_pd();
+    size_t index = 0;
+    for (; index + 4 <= length; index += 4) {
+        __m256d block = _mm256_loadu_pd(data + index);
+        nan_lanes = _mm256_or_pd(nan_lanes, _mm256_cmp_pd(block, block, _CMP_UNORD_Q));
+        result = _mm256_max_pd(block, result);
+    }
+    if (_mm256_movemask_pd(nan_lanes) != 0) return NOT_A_NUMBER;
+
+    __m128d halves = _mm_max_pd(_mm256_castpd256_pd128(result), _mm256_extractf128_pd(result, 1));
+    double lanes[2];
+    _mm_storeu_pd(lanes, halves);
+    double rest = max_scalar(data + index, length - index);
+    if (std::isnan(rest)) return rest;
+    return std::max(std::max(lanes[0], lanes[1]), rest);
+}
+/* < AVX2 kernels */
+#endif
+
+struct reduction_kernels_t {
+    sum_kernel_t sum;
+    deviation_kernel_t deviation;
+    dot_kernel_t dot;
+    extreme_kernel_t min;
+    extreme_kernel_t max;
+};
+static reduction_kernels_t select_kernels() {
+    #ifdef SGCPP_X86_SIMD
+    if (CPU::has_avx2()) return reduction_kernels_t{ sum_avx2, deviation_avx2, dot_avx2, min_avx2, max_avx2 };
+    if (CPU::has_sse2()) return reduction_kernels_t{ sum_sse2, deviation_sse2, dot_sse2, min_sse2, max_sse2 };
+    #endif
+    return reduction_kernels_t{ sum_scalar, deviation_scalar, dot_scalar, min_scalar, max_scalar };
+}
+static const reduction_kernels_t kernels = select_kernels();
+
+/* Splits [offset, offset + length) in two until a piece fits in a block, then adds the halves.
+    The split is rounded to a whole number of blocks so the kernels see full blocks. */
+template <typename BlockSum>
+static double pairwise(size_t offset, size_t length, const BlockSum &block_sum) {
+    if (length <= PAIRWISE_BLOCK) return block_sum(offset, length);
+
+    size_t half = (length / 2 + PAIRWISE_BLOCK - 1) / PAIRWISE_BLOCK * PAIRWISE_BLOCK;
+    return pairwise(offset, half, block_sum) + pairwise(offset + half, length - half, block_sum);
+}
+
+double VectorMath::sum(const double *data, size_t length) {
+    return pairwise(0, length, [data](size_t offset, size_t count) {
+        return kernels.sum(data + offset, count);
+    });
+}
+double VectorMath::sum_squared_deviations(const double *data, size_t length, double center) {
+    return pairwise(0, length, [data, center](size_t offset, size_t count) {
+        return kernels.deviation(data + offset, count, center);
+    });
+}
+double VectorMath::dot(const double *left, const double *right, size_t length) {
+    return pairwise(0, length, [left, right](size_t offset, size_t count) {
+        return kernels.dot(left + offset, right + offset, count);
+    });
+}
+double VectorMath::min(const double *data, size_t length) {
+    return kernels.min(data, length);
+}
+double VectorMath::max(const double *data, size_t length) {
+    return kernels.max(data, length);
+}
+
+/* > Elementwise kernels */
+typedef void (*binary_kernel_t)(const double *left, const double *right, double *out, size_t length);
+typedef void (*scale_kernel_t)(const double *data, double factor, double *out, size_t length);
+typedef void (*unary_kernel_t)(const double *data, double *out, size_t length);
+// Sine with quadrant_offset 0, cosine with 1, since cos(x) = sin(x + pi/2)
+typedef void (*trig_kernel_t)(const double *data, double *out, size_t length, uint64_t quadrant_offset);
+// data[i] to the power of a non-negative integer, or the reciprocal of that
+typedef void (*power_kernel_t)(const double *data, uint32_t exponent, bool reciprocal, double *out, size_t length);
+
+/* Sine and cosine follow FreeBSD's msun. x = n * pi/2 + r, where r is kept as a head and a tail,
+    and the quadrant n mod 4 picks +-sin(r) or +-cos(r). pi/2 is split into three 33-bit parts,
+    so n times each part is exact while n < 2^20, and the error of each subtraction is carried
+    in the tail. That keeps r accurate even when x is very close to a multiple of pi/2. */
+static const double TRIG_LIMIT = 1048576.0;
+static const double TWO_OVER_PI = 6.36619772367581382433e-01;
+static const double PIO2_1 = 1.57079632673412561417e+00;
+static const double PIO2_2 = 6.07710050630396597660e-11;
+static const double PIO2_3 = 2.02226624871116645580e-21;
+static const double PIO2_3_TAIL = 8.47842766036889956997e-32;
+// sin(x) rounds to x below this, and returning x keeps the sign of -0
+static const double TINY_SINE = 0x1p-27;
+// Adding then subtracting 1.5 * 2^52 rounds to the nearest integer, which is left in the low bits of the sum
+static const double ROUND_MAGIC = 6755399441055744.0;
+
+static const double S1 = -1.66666666666666324348e-01;
+static const double S2 = 8.33333333332248946124e-03;
+static const double S3 = -1.98412698298579493134e-04;
+static const double S4 = 2.75573137070700676789e-06;
+static const double S5 = -2.50507602534068634195e-08;
+static const double S6 = 1.58969099521155010221e-10;
+
+static const double C1 = 4.16666666666666019037e-02;
+static const double C2 = -1.38888888888741095749e-03;
+static const double C3 = 2.48015872894767294178e-05;
+static const double C4 = -2.75573143513906633035e-07;
+static const double C5 = 2.08757232129817482790e-09;
+static const double C6 = -1.13596475577881948265e-11;
+
+/* pow with an integer exponent squares and multiplies in double-double, which keeps it within
+    1 ULP however many multiplications there are. The splits overflow near the ends of the
+    double range, so results outside of [2^-960, 2^960] are redone by the C library. */
+static const double MAX_MULTIPLIED_EXPONENT = 1024;
+static const double MIN_MULTIPLIED_RESULT = 0x1p-960;
+static const double MAX_MULTIPLIED_RESULT = 0x1p960;
+// 2^27 + 1
+static const double SPLITTER = 134217729.0;
+
+/* > Scalar kernels */
+static void add_scalar(const double *left, const double *right, double *out, size_t length) {
+    for (size_t index = 0; index < length; index += 1) out[index] = left[index] + right[index];
+}
+static void scale_scalar(const double *data, double factor, double *out, size_t length) {
+    for (size_t index = 0; index < length; index += 1) out[index] = data[index] * factor;
+}
+static void sqrt_scalar(const double *data, double *out, size_t length) {
+    for (size_t index = 0; index < length; index += 1) out[index] = std::sqrt(data[index]);
+}
+
+// The rounding error of sum = a + b, exactly
+static inline double two_sum_error(double a, double b, double sum) {
+    double b_part = sum - a;
+    return (a - (sum - b_part)) + (b - b_part);
+}
+static inline double trig_scalar(double x, uint64_t quadrant_offset) {
+    if (!(std::fabs(x) < TRIG_LIMIT)) return quadrant_offset == 0 ? std::sin(x) : std::cos(x);
+    if (quadrant_offset == 0 && std::fabs(x) < TINY_SINE) return x;
+
+    double shifted = x * TWO_OVER_PI + ROUND_MAGIC;
+    double n = shifted - ROUND_MAGIC;
+    uint64_t quadrant;
+    memcpy(&quadrant, &shifted, sizeof(quadrant));
+    quadrant += quadrant_offset;
+
+    double first = x - n * PIO2_1;
+    double second_part = n * PIO2_2;
+    double second = first - second_part;
+    double second_error = two_sum_error(first, -second_part, second);
+    double third_part = n * PIO2_3;
+    double third = second - third_part;
+    double third_error = two_sum_error(second, -third_part, third);
+    double low = (second_error + third_error) - n * PIO2_3_TAIL;
+    double head = third + low;
+    double tail = (third - head) + low;
+
+    double z = head * head;
+    double w = z * z;
+    double result;
+    if (quadrant & 1) {
+        double r = z * (C1 + z * (C2 + z * C3)) + w * w * (C4 + z * (C5 + z * C6));
+        double half_z = 0.5 * z;
+        double one_minus = 1.0 - half_z;
+        result = one_minus + (((1.0 - one_minus) - half_z) + (z * r - head * tail));
+    }
+    else {
+        double r = S2 + z * (S3 + z * S4) + z * w * (S5 + z * S6);
+        double v = z * head;
+        result = head - ((z * (0.5 * tail - v * r) - tail) - v * S1);
+    }
+    return (quadrant & 2) ? -result : result;
+}
+static void trig_scalar_kernel(const double *data, double *out, size_t length, uint64_t quadrant_offset) {
+    for (size_t index = 0; index < length; index += 1) out[index] = trig_scalar(data[index], quadrant_offset);
+}
+
+/* Splitting a double into two 26-bit halves gives a product's rounding error
+    without fused multiply-adds (Dekker) */
+static inline void split(double value, double &high, double &low) {
+    double scaled = SPLITTER * value;
+    high = scaled - (scaled - value);
+    low = value - high;
+}
+static inline double two_product_error(double a, double b, double product) {
+    double a_high, a_low, b_high, b_low;
+    split(a, a_high, a_low);
+    split(b, b_high, b_low);
+    return (((a_high * b_high - product) + a_high * b_low) + a_low * b_high) + a_low * b_low;
+}
+// (high, low) *= (other_high, other_low), as double-doubles
+static inline void multiply_double_double(double &high, double &low, double other_high, double other_low) {
+    double product = high * other_high;
+    double error = two_product_error(high, other_high, product) + (high * other_low + low * other_high);
+    high = product + error;
+    low = error - (high - product);
+}
+static inline double power_scalar(double base, uint32_t exponent, bool reciprocal) {
+    double result_high = 1.0, result_low = 0.0;
+    double base_high = base, base_low = 0.0;
+    while (true) {
+        if (exponent & 1) multiply_double_double(result_high, result_low, base_high, base_low);
+        exponent >>= 1;
+        if (exponent == 0) break;
+        multiply_double_double(base_high, base_low, base_high, base_low);
+    }
+    if (!reciprocal) return result_high + result_low;
+
+    // 1 / (high + low), corrected with the exact remainder of 1 - high * quotient
+    double quotient = 1.0 / result_high;
+    double product = result_high * quotient;
+    double remainder = (1.0 - product) - two_product_error(result_high, quotient, product);
+    return quotient + quotient * (remainder - result_low * quotient);
+}
+static void power_scalar_kernel(const double *data, uint32_t exponent, bool reciprocal, double *out, size_t length) {
+    for (size_t index = 0; index < length; index += 1) out[index] = power_scalar(data[index], exponent, reciprocal);
+}
+/* < Scalar kernels */
+
+#ifdef SGCPP_X86_SIMD
+/* > SSE2 kernels */
+__attribute__((target("sse2")))
+static void add_sse2(const double *left, const double *right, double *out, size_t length) {
+    size_t index = 0;
+    for (; index + 2 <= length; index += 2) {
+        _mm_storeu_pd(out + index, _mm_add_pd(_mm_loadu_pd(left + index), _mm_loadu_pd(right + index)));
+    }
+    add_scalar(left + index, right + index, out + index, length - index);
+}
+__attribute__((target("sse2")))
+static void scale_sse2(const double *data, double factor, double *out, size_t length) {
+    const __m128d factors = _mm_set1_pd(factor);
+    size_t index = 0;
+    for (; index + 2 <= length; index += 2) {
+        _mm_storeu_pd(out + index, _mm_mul_pd(_mm_loadu_pd(data + index), factors));
+    }
+    scale_scalar(data + index, factor, out + index, length - index);
+}
+__attribute__((target("sse2")))
+static void sqrt_sse2(const double *data, double *out, size_t length) {
+    size_t index = 0;
+    for (; index + 2 <= length; index += 2) {
+        _mm_storeu_pd(out + index, _mm_sqrt_pd(_mm_loadu_pd(data + index)));
+    }
+    sqrt_scalar(data + index, out + index, length - index);
+}
+
+__attribute__((target("sse2")))
+static inline __m128d two_sum_error_sse2(__m128d a, __m128d b, __m128d sum) {
+    __m128d b_part = _mm_sub_pd(sum, a);
+    return _mm_add_pd(_mm_sub_pd(a, _mm_sub_pd(sum, b_part)), _mm_sub_pd(b, b_part));
+}
+__attribute__((target("sse2")))
+static void trig_sse2(const double *data, double *out, size_t length, uint64_t quadrant_offset) {
+    const __m128d sign_bit = _mm_set1_pd(-0.0);
+    const __m128d magic = _mm_set1_pd(ROUND_MAGIC);
+    const __m128i offset = _mm_set1_epi64x(static_cast<long long>(quadrant_offset));
+    const __m128i one = _mm_set1_epi64x(1), two = _mm_set1_epi64x(2);
+    const __m128d half = _mm_set1_pd(0.5), unit = _mm_set1_pd(1.0);
+    // All ones when computing sines, so that tiny inputs are passed through
+    const __m128d tiny_sine = _mm_castsi128_pd(_mm_set1_epi64x(quadrant_offset == 0 ? -1 : 0));
+
+    size_t index = 0;
+    for (; index + 2 <= length; index += 2) {
+        __m128d x = _mm_loadu_pd(data + index);
+
+        __m128d shifted = _mm_add_pd(_mm_mul_pd(x, _mm_set1_pd(TWO_OVER_PI)), magic);
+        __m128d n = _mm_sub_pd(shifted, magic);
+        __m128i quadrant = _mm_add_epi64(_mm_castpd_si128(shifted), offset);
+
+        __m128d first = _mm_sub_pd(x, _mm_mul_pd(n, _mm_set1_pd(PIO2_1)));
+        __m128d second_part = _mm_mul_pd(n, _mm_set1_pd(PIO2_2));
+        __m128d second = _mm_sub_pd(first, second_part);
+        __m128d second_error = two_sum_error_sse2(first, _mm_xor_pd(second_part, sign_bit), second);
+        __m128d third_part = _mm_mul_pd(n, _mm_set1_pd(PIO2_3));
+        __m128d third = _mm_sub_pd(second, third_part);
+        __m128d third_error = two_sum_error_sse2(second, _mm_xor_pd(third_part, sign_bit), third);
+        __m128d low = _mm_sub_pd(_mm_add_pd(second_error, third_error), _mm_mul_pd(n, _mm_set1_pd(PIO2_3_TAIL)));
+        __m128d head = _mm_add_pd(third, low);
+        __m128d tail = _mm_add_pd(_mm_sub_pd(third, head), low);
+
+        __m128d z = _mm_mul_pd(head, head);
+        __m128d w = _mm_mul_pd(z, z);
+
+        __m128d cos_r = _mm_add_pd(
+            _mm_mul_pd(z, _mm_add_pd(_mm_set1_pd(C1), _mm_mul_pd(z, _mm_add_pd(_mm_set1_pd(C2), _mm_mul_pd(z, _mm_set1_pd(C3)))))),
+            _mm_mul_pd(_mm_mul_pd(w, w), _mm_add_pd(_mm_set1_pd(C4), _mm_mul_pd(z, _mm_add_pd(_mm_set1_pd(C5), _mm_mul_pd(z, _mm_set1_pd(C6))))))
+        );
+        __m128d half_z = _mm_mul_pd(half, z);
+        __m128d one_minus = _mm_sub_pd(unit, half_z);
+        __m128d cosine = _mm_add_pd(one_minus, _mm_add_pd(
+            _mm_sub_pd(_mm_sub_pd(unit, one_minus), half_z),
+            _mm_sub_pd(_mm_mul_pd(z, cos_r), _mm_mul_pd(head, tail))
+        ));
+
+        __m128d sin_r = _mm_add_pd(
+            _mm_add_pd(_mm_set1_pd(S2), _mm_mul_pd(z, _mm_add_pd(_mm_set1_pd(S3), _mm_mul_pd(z, _mm_set1_pd(S4))))),
+            _mm_mul_pd(_mm_mul_pd(z, w), _mm_add_pd(_mm_set1_pd(S5), _mm_mul_pd(z, _mm_set1_pd(S6))))
+        );
+        __m128d v = _mm_mul_pd(z, head);
+        __m128d sine = _mm_sub_pd(head, _mm_sub_pd(
+            _mm_sub_pd(_mm_mul_pd(z, _mm_sub_pd(_mm_mul_pd(half, tail), _mm_mul_pd(v, sin_r))), tail),
+            _mm_mul_pd(v, _mm_set1_pd(S1))
+        ));
+
+        // SSE2 can't compare 64-bit integers, so compare the low halves and copy them over the high halves
+        __m128i odd = _mm_shuffle_epi32(_mm_cmpeq_epi32(_mm_and_si128(quadrant, one), one), _MM_SHUFFLE(2, 2, 0, 0));
+        __m128d use_cosine = _mm_castsi128_pd(odd);
+        __m128d result = _mm_or_pd(_mm_and_pd(use_cosine, cosine), _mm_andnot_pd(use_cosine, sine));
+        result = _mm_xor_pd(result, _mm_castsi128_pd(_mm_slli_epi64(_mm_and_si128(quadrant, two), 62)));
+        __m128d tiny = _mm_and_pd(tiny_sine, _mm_cmplt_pd(_mm_andnot_pd(sign_bit, x), _mm_set1_pd(TINY_SINE)));
+        result = _mm_or_pd(_mm_and_pd(tiny, x), _mm_andnot_pd(tiny, result));
+        _mm_storeu_pd(out + index, result);
+
+        // Redo the lanes that were too big to reduce, or weren't finite
+        __m128d in_range = _mm_cmplt_pd(_mm_andnot_pd(sign_bit, x), _mm_set1_pd(TRIG_LIMIT));
+        if (_mm_movemask_pd(in_range) != 0x3) {
+            for (size_t lane = 0; lane < 2; lane += 1) {
+                out[index + lane] = trig_scalar(data[index + lane], quadrant_offset);
+            }
+        }
+    }
+    trig_scalar_kernel(data + index, out + index, length - index, quadrant_offset);
+}
+
+__attribute__((target("sse2")))
+static inline void split_sse2(__m128d value, __m128d &high, __m128d &low) {
+    __m128d scaled = _mm_mul_pd(_mm_set1_pd(SPLITTER), value);
+    high = _mm_sub_pd(scaled, _mm_sub_pd(scaled, value));
+    low = _mm_sub_pd(value, high);
+}
+__attribute__((target("sse2")))
+static inline __m128d two_product_error_sse2(__m128d a, __m128d b, __m128d product) {
+    __m128d a_high, a_low, b_high, b_low;
+    split_sse2(a, a_high, a_low);
+    split_sse2(b, b_high, b_low);
+    __m128d error = _mm_add_pd(_mm_add_pd(_mm_sub_pd(_mm_mul_pd(a_high, b_high), product), _mm_mul_pd(a_high, b_low)), _mm_mul_pd(a_low, b_high));
+    return _mm_add_pd(error, _mm_mul_pd(a_low, b_low));
+}
+__attribute__((target("sse2")))
+static inline void multiply_double_double_sse2(__m128d &high, __m128d &low, __m128d other_high, __m128d other_low) {
+    __m128d product = _mm_mul_pd(high, other_high);
+    __m128d error = _mm_add_pd(
+        two_product_error_sse2(high, other_high, product),
+        _mm_add_pd(_mm_mul_pd(high, other_low), _mm_mul_pd(low, other_high))
+    );
+    high = _mm_add_pd(product, error);
+    low = _mm_sub_pd(error, _mm_sub_pd(high, product));
+}
+__attribute__((target("sse2")))
+static void power_sse2(const double *data, uint32_t exponent, bool reciprocal, double *out, size_t length) {
+    const __m128d unit = _mm_set1_pd(1.0);
+    size_t index = 0;
+    for (; index + 2 <= length; index += 2) {
+        __m128d base_high = _mm_loadu_pd(data + index), base_low = _mm_setzero_pd();
+        __m128d result_high = unit, result_low = _mm_setzero_pd();
+        uint32_t remaining = exponent;
+        while (true) {
+            if (remaining & 1) multiply_double_double_sse2(result_high, result_low, base_high, base_low);
+            remaining >>= 1;
+            if (remaining == 0) break;
+            multiply_double_double_sse2(base_high, base_low, base_high, base_low);
+        }
+
+        if (!reciprocal) {
+            _mm_storeu_pd(out + index, _mm_add_pd(result_high, result_low));
+            continue;
+        }
+        __m128d quotient = _mm_div_pd(unit, result_high);
+        __m128d product = _mm_mul_pd(result_high, quotient);
+        __m128d remainder = _mm_sub_pd(_mm_sub_pd(unit, product), two_product_error_sse2(result_high, quotient, product));
+        __m128d correction = _mm_mul_pd(quotient, _mm_sub_pd(remainder, _mm_mul_pd(result_low, quotient)));
+        _mm_storeu_pd(out + index, _mm_add_pd(quotient, correction));
+    }
+    power_scalar_kernel(data + index, exponent, reciprocal, out + index, length - index);
+}
+/* < SSE2 kernels */
+
+/* > AVX2 kernels */
+__attribute__((target("avx2")))
+static void add_avx2(const double *left, const double *right, double *out, size_t length) {
+    size_t index = 0;
+    for (; index + 4 <= length; index += 4) {
+        _mm256_storeu_pd(out + index, _mm256_add_pd(_mm256_loadu_pd(left + index), _mm256_loadu_pd(right + index)));
+    }
+    add_scalar(left + index, right + index, out + index, length - index);
+}
+__attribute__((target("avx2")))
+static void scale_avx2(const double *data, double factor, double *out, size_t length) {
+    const __m256d factors = _mm256_set1_pd(factor);
+    size_t index = 0;
+    for (; index + 4 <= length; index += 4) {
+        _mm256_storeu_pd(out + index, _mm256_mul_pd(_mm256_loadu_pd(data + index), factors));
+    }
+    scale_scalar(data + index, factor, out + index, length - index);
+}
+__attribute__((target("avx2")))
+static void sqrt_avx2(const double *data, double *out, size_t length) {
+    size_t index = 0;
+    for (; index + 4 <= length; index += 4) {
+        _mm256_storeu_pd(out + index, _mm256_sqrt_pd(_mm256_loadu_pd(data + index)));
+    }
+    sqrt_scalar(data + index, out + index, length - index);
+}
+
+__attribute__((target("avx2")))
+static inline __m256d two_sum_error_avx2(__m256d a, __m256d b, __m256d sum) {
+    __m256d b_part = _mm256_sub_pd(sum, a);
+    return _mm256_add_pd(_mm256_sub_pd(a, _mm256_sub_pd(sum, b_part)), _mm256_sub_pd(b, b_part));
+}
+__attribute__((target("avx2")))
+static void trig_avx2(const double *data, double *out, size_t length, uint64_t quadrant_offset) {
+    const __m256d sign_bit = _mm256_set1_pd(-0.0);
+    const __m256d magic = _mm256_set1_pd(ROUND_MAGIC);
+    const __m256i offset = _mm256_set1_epi64x(static_cast<long long>(quadrant_offset));
+    const __m256i one = _mm256_set1_epi64x(1), two = _mm256_set1_epi64x(2);
+    const __m256d half = _mm256_set1_pd(0.5), unit = _mm256_set1_pd(1.0);
+    const __m256d tiny_sine = _mm256_castsi256_pd(_mm256_set1_epi64x(quadrant_offset == 0 ? -1 : 0));
+
+    size_t index = 0;
+    for (; index + 4 <= length; index += 4) {
+        __m256d x = _mm256_loadu_pd(data + index);
+
+        __m256d shifted = _mm256_add_pd(_mm256_mul_pd(x, _mm256_set1_pd(TWO_OVER_PI)), magic);
+        __m256d n = _mm256_sub_pd(shifted, magic);
+        __m256i quadrant = _mm256_add_epi64(_mm256_castpd_si256(shifted), offset);
+
+        __m256d first = _mm256_sub_pd(x, _mm256_mul_pd(n, _mm256_set1_pd(PIO2_1)));
+        __m256d second_part = _mm256_mul_pd(n, _mm256_set1_pd(PIO2_2));
+        __m256d second = _mm256_sub_pd(first, second_part);
+        __m256d second_error = two_sum_error_avx2(first, _mm256_xor_pd(second_part, sign_bit), second);
+        __m256d third_part = _mm256_mul_pd(n, _mm256_set1_pd(PIO2_3));
+        __m256d third = _mm256_sub_pd(second, third_part);
+        __m256d third_error = two_sum_error_avx2(second, _mm256_xor_pd(third_part, sign_bit), third);
+        __m256d low = _mm256_sub_pd(_mm256_add_pd(second_error, third_error), _mm256_mul_pd(n, _mm256_set1_pd(PIO2_3_TAIL)));
+        __m256d head = _mm256_add_pd(third, low);
+        __m256d tail = _mm256_add_pd(_mm256_sub_pd(third, head), low);
+
+        __m256d z = _mm256_mul_pd(head, head);
+        __m256d w = _mm256_mul_pd(z, z);
+
+        __m256d cos_r = _mm256_add_pd(
+            _mm256_mul_pd(z, _mm256_add_pd(_mm256_set1_pd(C1), _mm256_mul_pd(z, _mm256_add_pd(_mm256_set1_pd(C2), _mm256_mul_pd(z, _mm256_set1_pd(C3)))))),
+            _mm256_mul_pd(_mm256_mul_pd(w, w), _mm256_add_pd(_mm256_set1_pd(C4), _mm256_mul_pd(z, _mm256_add_pd(_mm256_set1_pd(C5), _mm256_mul_pd(z, _mm256_set1_pd(C6))))))
+        );
+        __m256d half_z = _mm256_mul_pd(half, z);
+        __m256d one_minus = _mm256_sub_pd(unit, half_z);
+        __m256d cosine = _mm256_add_pd(one_minus, _mm256_add_pd(
+            _mm256_sub_pd(_mm256_sub_pd(unit, one_minus), half_z),
+            _mm256_sub_pd(_mm256_mul_pd(z, cos_r), _mm256_mul_pd(head, tail))
+        ));
+
+        __m256d sin_r = _mm256_add_pd(
+            _mm256_add_pd(_mm256_set1_pd(S2), _mm256_mul_pd(z, _mm256_add_pd(_mm256_set1_pd(S3), _mm256_mul_pd(z, _mm256_set1_pd(S4))))),
+            _mm256_mul_pd(_mm256_mul_pd(z, w), _mm256_add_pd(_mm256_set1_pd(S5), _mm256_mul_pd(z, _mm256_set1_pd(S6))))
+        );
+        __m256d v = _mm256_mul_pd(z, head);
+        __m256d sine = _mm256_sub_pd(head, _mm256_sub_pd(
+            _mm256_sub_pd(_mm256_mul_pd(z, _mm256_sub_pd(_mm256_mul_pd(half, tail), _mm256_mul_pd(v, sin_r))), tail),
+            _mm256_mul_pd(v, _mm256_set1_pd(S1))
+        ));
+
+        __m256d use_cosine = _mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(quadrant, one), one));
+        __m256d result = _mm256_blendv_pd(sine, cosine, use_cosine);
+        result = _mm256_xor_pd(result, _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_and_si256(quadrant, two), 62)));
+        __m256d tiny = _mm256_and_pd(tiny_sine, _mm256_cmp_pd(_mm256_andnot_pd(sign_bit, x), _mm256_set1_pd(TINY_SINE), _CMP_LT_OQ));
+        result = _mm256_blendv_pd(result, x, tiny);
+        _mm256_storeu_pd(out + index, result);
+
+        // Redo the lanes that were too big to reduce, or weren't finite
+        __m256d in_range = _mm256_cmp_pd(_mm256_andnot_pd(sign_bit, x), _mm256_set1_pd(TRIG_LIMIT), _CMP_LT_OQ);
+        if (_mm256_movemask_pd(in_range) != 0xF) {
+            for (size_t lane = 0; lane < 4; lane += 1) {
+                out[index + lane] = trig_scalar(data[index + lane], quadrant_offset);
+            }
+        }
+    }
+    trig_scalar_kernel(data + index, out + index, length - index, quadrant_offset);
+}
+
+__attribute__((target("avx2")))
+static inline void split_avx2(__m256d value, __m256d &high, __m256d &low) {
+    __m256d scaled = _mm256_mul_pd(_mm256_set1_pd(SPLITTER), value);
+    high = _mm256_sub_pd(scaled, _mm256_sub_pd(scaled, value));
+    low = _mm256_sub_pd(value, high);
+}
+__attribute__((target("avx2")))
+static inline __m256d two_product_error_avx2(__m256d a, __m256d b, __m256d product) {
+    __m256d a_high, a_low, b_high, b_low;
+    split_avx2(a, a_high, a_low);
+    split_avx2(b, b_high, b_low);
+    __m256d error = _mm256_add_pd(_mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(a_high, b_high), product), _mm256_mul_pd(a_high, b_low)), _mm256_mul_pd(a_low, b_high));
+    return _mm256_add_pd(error, _mm256_mul_pd(a_low, b_low));
+}
+__attribute__((target("avx2")))
+static inline void multiply_double_double_avx2(__m256d &high, __m256d &low, __m256d other_high, __m256d other_low) {
+    __m256d product = _mm256_mul_pd(high, other_high);
+    __m256d error = _mm256_add_pd(
+        two_product_error_avx2(high, other_high, product),
+        _mm256_add_pd(_mm256_mul_pd(high, other_low), _mm256_mul_pd(low, other_high))
+    );
+    high = _mm256_add_pd(product, error);
+    low = _mm256_sub_pd(error, _mm256_sub_pd(high, product));
+}
+__attribute__((target("avx2")))
+static void power_avx2(const double *data, uint32_t exponent, bool reciprocal, double *out, size_t length) {
+    const __m256d unit = _mm256_set1_pd(1.0);
+    size_t index = 0;
+    for (; index + 4 <= length; index += 4) {
+        __m256d base_high = _mm256_loadu_pd(data + index), base_low = _mm256_setzero_pd();
+        __m256d result_high = unit, result_low = _mm256_setzero_pd();
+        uint32_t remaining = exponent;
+        while (true) {
+            if (remaining & 1) multiply_double_double_avx2(result_high, result_low, base_high, base_low);
+            remaining >>= 1;
+            if (remaining == 0) break;
+            multiply_double_double_avx2(base_high, base_low, base_high, base_low);
+        }
+
+        if (!reciprocal) {
+            _mm256_storeu_pd(out + index, _mm256_add_pd(result_high, result_low));
+            continue;
+        }
+        __m256d quotient = _mm256_div_pd(unit, result_high);
+        __m256d product = _mm256_mul_pd(result_high, quotient);
+        __m256d remainder = _mm256_sub_pd(_mm256_sub_pd(unit, product), two_product_error_avx2(result_high, quotient, product));
+        __m256d correction = _mm256_mul_pd(quotient, _mm256_sub_pd(remainder, _mm256_mul_pd(result_low, quotient)));
+        _mm256_storeu_pd(out + index, _mm256_add_pd(quotient, correction));
+    }
+    power_scalar_kernel(data + index, exponent, reciprocal, out + index, length - index);
+}
+/* < AVX2 kernels */
+#endif
+
+struct elementwise_kernels_t {
+    binary_kernel_t add;
+    scale_kernel_t scale;
+    unary_kernel_t sqrt;
+    trig_kernel_t trig;
+    power_kernel_t power;
+};
+static elementwise_kernels_t select_elementwise_kernels() {
+    #ifdef SGCPP_X86_SIMD
+    if (CPU::has_avx2()) return elementwise_kernels_t{ add_avx2, scale_avx2, sqrt_avx2, trig_avx2, power_avx2 };
+    if (CPU::has_sse2()) return elementwise_kernels_t{ add_sse2, scale_sse2, sqrt_sse2, trig_sse2, power_sse2 };
+    #endif
+    return elementwise_kernels_t{ add_scalar, scale_scalar, sqrt_scalar, trig_scalar_kernel, power_scalar_kernel };
+}
+static const elementwise_kernels_t elementwise_kernels = select_elementwise_kernels();
+
+void VectorMath::add(const double *left, const double *right, double *out, size_t length) {
+    elementwise_kernels.add(left, right, out, length);
+}
+void VectorMath::scale(const double *data, double factor, double *out, size_t length) {
+    elementwise_kernels.scale(data, factor, out, length);
+}
+void VectorMath::sqrt(const double *data, double *out, size_t length) {
+    elementwise_kernels.sqrt(data, out, length);
+}
+void VectorMath::sin(const double *data, double *out, size_t length) {
+    elementwise_kernels.trig(data, out, length, 0);
+}
+void VectorMath::cos(const double *data, double *out, size_t length) {
+    elementwise_kernels.trig(data, out, length, 1);
+}
+void VectorMath::pow(const double *data, double exponent, double *out, size_t length) {
+    if (exponent != std::floor(exponent) || std::fabs(exponent) > MAX_MULTIPLIED_EXPONENT) {
+        for (size_t index = 0; index < length; index += 1) out[index] = std::pow(data[index], exponent);
+        return;
+    }
+
+    elementwise_kernels.power(data, static_cast<uint32_t>(std::fabs(exponent)), exponent < 0, out, length);
+    // Also catches zeros, infinities and NaNs, whose signs the C library gets right
+    for (size_t index = 0; index < length; index += 1) {
+        double magnitude = std::fabs(out[index]);
+        if (!(magnitude >= MIN_MULTIPLIED_RESULT && magnitude <= MAX_MULTIPLIED_RESULT)) {
+            out[index] = std::pow(data[index], exponent);
+        }
+    }
+}
+/* < Elementwise kernels */
@@ -0,0 +1,39 @@
+/* Reductions and elementwise kernels over contiguous arrays of doubles, used by the Array
+    and Math natives. On x86, the kernels run on 2 (SSE2) or 4 (AVX2) lanes at once, picked
+    at startup. Sums are pairwise: blocks are added with several vector accumulators, then the
+    block results are added as a balanced tree, so rounding error grows with log(n)
+    instead of n.
+    Every lane does the same operations in the same order as the scalar code, without fused
+    multiply-adds, so the result doesn't depend on which kernel ran. */
+
+#ifndef _SGCPP_VECTOR_MATH_HPP
+#define _SGCPP_VECTOR_MATH_HPP
+
+#include <cstddef>
+
+namespace VectorMath {
+    double sum(const double *data, size_t length);
+    /* Sum of (data[i] - center)^2, for the second pass of the variance */
+    double sum_squared_deviations(const double *data, size_t length, double center);
+    double dot(const double *left, const double *right, size_t length);
+
+    /* NaN if any element is NaN. Infinity for min and -Infinity for max when empty. */
+    double min(const double *data, size_t length);
+    double max(const double *data, size_t length);
+
+    /* Elementwise kernels. out may be the input itself, but must not overlap it otherwise. */
+
+    // Correctly rounded, like the operators
+    void add(const double *left, const double *right, double *out, size_t length);
+    void scale(const double *data, double factor, double *out, size_t length);
+    void sqrt(const double *data, double *out, size_t length);
+    /* Polynomials on [-pi/4, pi/4] after a three-part Cody-Waite reduction by pi/2, within 1 ULP
+        for |x| < 2^20. Larger and non-finite elements go through the C library instead. */
+    void sin(const double *data, double *out, size_t length);
+    void cos(const double *data, double *out, size_t length);
+    /* Integer exponents up to 1024 in magnitude square and multiply in double-double, within 1 ULP.
+        Other exponents call the C library's pow. */
+    void pow(const double *data, double exponent, double *out, size_t length);
+};
+
+#endif